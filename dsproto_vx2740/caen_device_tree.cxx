@@ -0,0 +1,411 @@
+#include "caen_device_tree.h"
+#include "caen_parameters.h"
+#include "CAEN_FELib.h"
+#include <atomic>
+#include <utility>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+namespace {
+   // Single-pass recursive-descent parser. Every JSON object becomes a node
+   // (named by its key); scalar members are properties of that node.
+   class TreeParser {
+   public:
+      TreeParser(const char* _p, const char* _end, std::vector<CaenDeviceTree::Node>& _nodes, std::unordered_map<std::string, int>& _path_to_idx) :
+         p(_p), end(_end), nodes(_nodes), path_to_idx(_path_to_idx) {}
+
+      bool parse() {
+         skip_ws();
+
+         if (peek() != '{') {
+            return false;
+         }
+
+         if (!parse_object(add_node(-1, ""))) {
+            return false;
+         }
+
+         skip_ws();
+         return p == end || *p == 0;
+      }
+
+   protected:
+      char peek() {
+         return p < end ? *p : 0;
+      }
+
+      void skip_ws() {
+         while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+            p++;
+         }
+      }
+
+      int add_node(int parent, const std::string& key) {
+         CaenDeviceTree::Node node;
+         node.parent = parent;
+         node.name = key;
+
+         if (parent >= 0) {
+            node.path = nodes[parent].path + "/" + key;
+            nodes[parent].children.push_back(nodes.size());
+         }
+
+         path_to_idx[node.path] = nodes.size();
+         nodes.push_back(std::move(node));
+         return nodes.size() - 1;
+      }
+
+      void set_property(int idx, const std::string& key, const std::string& val) {
+         CaenDeviceTree::Node& node = nodes[idx];
+
+         if (key == "type") {
+            node.type = val;
+         } else if (key == "handle") {
+            node.handle = strtoull(val.c_str(), NULL, 0);
+         } else if (key == "value") {
+            node.value = val;
+            node.has_value = true;
+         } else if (key != "name") {
+            node.attributes[key] = val;
+         }
+      }
+
+      // p is at '{'
+      bool parse_object(int idx) {
+         p++;
+         skip_ws();
+
+         if (peek() == '}') {
+            p++;
+            return true;
+         }
+
+         while (true) {
+            std::string key;
+
+            if (!parse_string(key)) {
+               return false;
+            }
+
+            skip_ws();
+
+            if (peek() != ':') {
+               return false;
+            }
+
+            p++;
+            skip_ws();
+
+            char c = peek();
+
+            if (c == '{') {
+               if (!parse_object(add_node(idx, key))) {
+                  return false;
+               }
+            } else if (c == '[') {
+               if (!skip_value()) {
+                  return false;
+               }
+            } else {
+               std::string val;
+
+               if (!parse_scalar(val)) {
+                  return false;
+               }
+
+               set_property(idx, key, val);
+            }
+
+            skip_ws();
+
+            if (peek() == ',') {
+               p++;
+               skip_ws();
+            } else if (peek() == '}') {
+               p++;
+               return true;
+            } else {
+               return false;
+            }
+         }
+      }
+
+      // p is at '"'
+      bool parse_string(std::string& val) {
+         if (peek() != '"') {
+            return false;
+         }
+
+         p++;
+         const char* start = p;
+
+         // Fast path for strings without escapes, which is nearly all of them.
+         while (p < end && *p != '"' && *p != '\\') {
+            p++;
+         }
+
+         val.assign(start, p - start);
+
+         while (p < end && *p != '"') {
+            if (*p == '\\') {
+               p++;
+
+               if (p >= end) {
+                  return false;
+               }
+
+               switch (*p) {
+                  case 'n': val += '\n'; break;
+                  case 't': val += '\t'; break;
+                  case 'r': val += '\r'; break;
+                  case 'b': val += '\b'; break;
+                  case 'f': val += '\f'; break;
+                  case 'u': {
+                     if (end - p < 5) {
+                        return false;
+                     }
+
+                     unsigned long code = strtoul(std::string(p + 1, 4).c_str(), NULL, 16);
+                     val += code < 0x80 ? (char)code : '?';
+                     p += 4;
+                     break;
+                  }
+                  default: val += *p; break;
+               }
+
+               p++;
+            } else {
+               val += *p++;
+            }
+         }
+
+         if (p >= end) {
+            return false;
+         }
+
+         p++;
+         return true;
+      }
+
+      // Strings, numbers, true/false/null - returned as text.
+      bool parse_scalar(std::string& val) {
+         if (peek() == '"') {
+            return parse_string(val);
+         }
+
+         const char* start = p;
+
+         while (p < end && *p != ',' && *p != '}' && *p != ']' && *p != ' ' && *p != '\n' && *p != '\r' && *p != '\t') {
+            p++;
+         }
+
+         val.assign(start, p - start);
+         return p > start;
+      }
+
+      // Skip over any value (used for arrays, which the tree doesn't need).
+      bool skip_value() {
+         char c = peek();
+
+         if (c == '{' || c == '[') {
+            char close = (c == '{') ? '}' : ']';
+            p++;
+            skip_ws();
+
+            if (peek() == close) {
+               p++;
+               return true;
+            }
+
+            while (true) {
+               if (close == '}') {
+                  std::string key;
+
+                  if (!parse_string(key)) {
+                     return false;
+                  }
+
+                  skip_ws();
+
+                  if (peek() != ':') {
+                     return false;
+                  }
+
+                  p++;
+                  skip_ws();
+               }
+
+               if (!skip_value()) {
+                  return false;
+               }
+
+               skip_ws();
+
+               if (peek() == ',') {
+                  p++;
+                  skip_ws();
+               } else if (peek() == close) {
+                  p++;
+                  return true;
+               } else {
+                  return false;
+               }
+            }
+         }
+
+         std::string val;
+         return parse_scalar(val);
+      }
+
+      const char* p;
+      const char* end;
+      std::vector<CaenDeviceTree::Node>& nodes;
+      std::unordered_map<std::string, int>& path_to_idx;
+   };
+}
+
+bool CaenDeviceTree::Node::is_type(const char* _type) const {
+   return strcasecmp(type.c_str(), _type) == 0;
+}
+
+bool CaenDeviceTree::parse(const char* json, size_t len) {
+   nodes.clear();
+   path_to_idx.clear();
+
+   TreeParser parser(json, json + len, nodes, path_to_idx);
+
+   if (!parser.parse()) {
+      nodes.clear();
+      path_to_idx.clear();
+      return false;
+   }
+
+   for (auto& node : nodes) {
+      if (node.is_type("ATTRIBUTE")) {
+         // Attributes are static, so the value in the JSON is good; also
+         // make it easy to look up from the parent.
+         if (node.has_value && node.parent >= 0) {
+            nodes[node.parent].attributes[node.name] = node.value;
+         }
+      } else {
+         // Anything else must be read from the board.
+         node.value = "";
+         node.has_value = false;
+      }
+   }
+
+   return true;
+}
+
+void CaenDeviceTree::fetch_values(const std::vector<int>& node_idxs, int num_threads, std::atomic<uint64_t>* num_felib_calls) {
+   std::atomic<size_t> next_idx{0};
+
+   // CAEN document FELib (and the Dig2 library behind it) as thread-safe,
+   // so several threads may read through handles of the same connection.
+   auto get_value = [&](uint64_t handle, char* value) {
+      if (num_felib_calls) {
+         num_felib_calls->fetch_add(1, std::memory_order_relaxed);
+      }
+
+      return CAEN_FELib_GetValue(handle, "", value);
+   };
+
+   auto worker = [&]() {
+      for (size_t i = next_idx++; i < node_idxs.size(); i = next_idx++) {
+         Node& node = nodes[node_idxs[i]];
+         char value[CAEN_PARAM_VALUE_LEN];
+
+         if (node.has_value || node.handle == 0) {
+            continue;
+         }
+
+         if (strcasecmp(node.path.c_str(), "/par/lvdstrgmask") == 0) {
+            // Value to read is selected by pre-setting the buffer to the line number.
+            std::string all_lines;
+
+            for (int line = 0; line < 16; line++) {
+               snprintf(value, sizeof(value), "%d", line);
+
+               if (get_value(node.handle, value) != CAEN_FELib_Success) {
+                  break;
+               }
+
+               all_lines += (line > 0 ? ", " : "") + std::string(value);
+
+               if (line == 15) {
+                  node.value = all_lines;
+                  node.has_value = true;
+               }
+            }
+
+            continue;
+         }
+
+         value[0] = 0;
+
+         if (get_value(node.handle, value) == CAEN_FELib_Success) {
+            node.value = value;
+            node.has_value = true;
+         }
+      }
+   };
+
+   if (num_threads < 1) {
+      num_threads = 1;
+   }
+
+   if ((size_t)num_threads > node_idxs.size()) {
+      num_threads = node_idxs.size();
+   }
+
+   std::vector<std::thread> threads;
+
+   for (int t = 1; t < num_threads; t++) {
+      threads.push_back(std::thread(worker));
+   }
+
+   worker();
+
+   for (auto& thread : threads) {
+      thread.join();
+   }
+}
+
+int CaenDeviceTree::find(const std::string& path) const {
+   auto it = path_to_idx.find(path);
+   return it == path_to_idx.end() ? -1 : it->second;
+}
+
+std::vector<int> CaenDeviceTree::get_subtree(const std::string& path) const {
+   std::vector<int> retval;
+   int start = find(path);
+
+   if (start < 0) {
+      return retval;
+   }
+
+   std::vector<int> stack = {start};
+
+   while (!stack.empty()) {
+      int idx = stack.back();
+      stack.pop_back();
+      retval.push_back(idx);
+
+      // Push in reverse so children come out in order.
+      const std::vector<int>& children = nodes[idx].children;
+
+      for (auto it = children.rbegin(); it != children.rend(); it++) {
+         stack.push_back(*it);
+      }
+   }
+
+   return retval;
+}
+
+bool CaenDeviceTree::is_writable(int idx) const {
+   const Node& n = nodes[idx];
+   auto it = n.attributes.find("accessmode");
+   return n.is_type("PARAMETER") && it != n.attributes.end() && strcasecmp(it->second.c_str(), "READ_WRITE") == 0;
+}
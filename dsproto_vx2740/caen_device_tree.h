@@ -0,0 +1,66 @@
+#ifndef CAEN_DEVICE_TREE_H
+#define CAEN_DEVICE_TREE_H
+
+#include <inttypes.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+// In-memory model of a board's parameter tree, built from the JSON that
+// CAEN_FELib_GetDeviceTree() returns (one FELib call for the whole tree,
+// rather than GetChildHandles/GetNodeProperties per node). The JSON is
+// parsed in one streaming pass, straight into a flat list of nodes.
+//
+// Parameter values aren't part of the JSON; fetch_values() reads the
+// values of whichever nodes are wanted, using several threads.
+class CaenDeviceTree {
+public:
+   struct Node {
+      std::string path; // E.g. "/ch/3/par/dcoffset"; root is ""
+      std::string name;
+      std::string type; // PARAMETER, FEATURE, ATTRIBUTE, FOLDER, ...
+      uint64_t handle = 0;
+      int parent = -1;
+      std::vector<int> children;
+      std::map<std::string, std::string> attributes; // E.g. accessmode
+      std::string value;
+      bool has_value = false;
+
+      bool is_type(const char* _type) const;
+   };
+
+   // Parse the JSON from GetDeviceTree(). Returns false if it's malformed.
+   bool parse(const char* json, size_t len);
+
+   // Read the values of the given nodes from the board, using up to
+   // `num_threads` threads. Nodes whose value can't be read are left
+   // without one. LVDSTrgMask is read once per line, and its value is
+   // the comma-separated list of lines. If given, `num_felib_calls` is
+   // incremented for each FELib call made (from whichever thread).
+   void fetch_values(const std::vector<int>& node_idxs, int num_threads=4, std::atomic<uint64_t>* num_felib_calls=nullptr);
+
+   // Index of the node at `path`, or -1.
+   int find(const std::string& path) const;
+
+   // Indices of every node at or beneath `path`, in tree order.
+   std::vector<int> get_subtree(const std::string& path) const;
+
+   const Node& node(int idx) const {
+      return nodes[idx];
+   }
+
+   size_t size() const {
+      return nodes.size();
+   }
+
+   // Whether a parameter can be read and written.
+   bool is_writable(int idx) const;
+
+protected:
+   std::vector<Node> nodes;
+   std::unordered_map<std::string, int> path_to_idx;
+};
+
+#endif
@@ -1,5 +1,6 @@
 #include "caen_event.h"
 #include <arpa/inet.h>
+#include <algorithm>
 
 CaenEventHeader::CaenEventHeader(uint64_t *buffer, bool is_host_order) {
    // Decode data directly from device, in network-order byte format
@@ -30,6 +31,40 @@ CaenEventHeader::CaenEventHeader(uint64_t *buffer, bool is_host_order) {
    }
 }
 
+CaenCounterExtender::CaenCounterExtender(int num_bits) {
+   mask = (num_bits >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << num_bits) - 1);
+}
+
+uint64_t CaenCounterExtender::extend(uint64_t raw) {
+   raw &= mask;
+
+   if (!have_last) {
+      have_last = true;
+      last = raw;
+      return last;
+   }
+
+   uint64_t forward = (raw - last) & mask;
+   uint64_t backward = (last - raw) & mask;
+
+   if (forward <= backward || backward > last) {
+      last += forward;
+   } else {
+      last -= backward;
+   }
+
+   return last;
+}
+
+uint64_t CaenCounterExtender::current() {
+   return last;
+}
+
+void CaenCounterExtender::reset() {
+   last = 0;
+   have_last = false;
+}
+
 // Encode in host-ordering
 void CaenEventHeader::hencode(uint64_t* buffer) {
    buffer[0] = ((uint64_t)(format & 0xFF) << 56) | ((uint64_t)(event_counter & 0xFFFFFF) << 32) | (size_64bit_words);
@@ -169,3 +204,106 @@ void CaenEvent::hencode(uint64_t* buffer) {
       *buffer++ = *p;
    }
 }
+
+uint32_t CaenEvent::channel_major_size_words() {
+   int num_chans = __builtin_popcountll(header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (wf_end - wf_begin) / num_chans : 0;
+   return 4 + num_chans * words_per_chan;
+}
+
+uint32_t CaenEvent::encode_channel_major(uint64_t* buffer) {
+   header.hencode(buffer);
+
+   int num_chans = __builtin_popcountll(header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (wf_end - wf_begin) / num_chans : 0;
+
+   buffer[3] = ((uint64_t)CAEN_CHANNEL_MAJOR_VERSION << 56) | (words_per_chan * 4);
+   uint64_t* out = buffer + 4;
+
+   if (num_chans == 1) {
+      std::copy(wf_begin, wf_begin + words_per_chan, out);
+      return 4 + words_per_chan;
+   }
+
+   // Each word holds 4 samples of one channel, with channels interleaved a
+   // word at a time, so this is a transpose of 64-bit words. Work in blocks
+   // of words so the reads and writes both stay in cache.
+   const uint32_t block_words = 64;
+
+   for (uint32_t start = 0; start < words_per_chan; start += block_words) {
+      uint32_t end = std::min(start + block_words, words_per_chan);
+
+      for (int c = 0; c < num_chans; c++) {
+         const uint64_t* in = wf_begin + c;
+         uint64_t* chan_out = out + (size_t)c * words_per_chan;
+
+         for (uint32_t w = start; w < end; w++) {
+            chan_out[w] = in[(size_t)w * num_chans];
+         }
+      }
+   }
+
+   return 4 + num_chans * words_per_chan;
+}
+
+CaenChannelMajorEvent::CaenChannelMajorEvent(const uint64_t* buffer, size_t size_words) {
+   if (size_words < 4) {
+      return;
+   }
+
+   header = CaenEventHeader((uint64_t*)buffer);
+
+   if ((buffer[3] >> 56) != CAEN_CHANNEL_MAJOR_VERSION) {
+      return;
+   }
+
+   samples_per_chan = buffer[3] & 0xFFFFFFFF;
+   size_t num_chans = __builtin_popcountll(header.ch_enable_mask);
+
+   if (samples_per_chan % 4 || 4 + num_chans * (samples_per_chan / 4) > size_words) {
+      return;
+   }
+
+   chan_begin = buffer + 4;
+   valid = true;
+}
+
+bool CaenChannelMajorEvent::is_valid() {
+   return valid;
+}
+
+const uint16_t* CaenChannelMajorEvent::get_channel_samples(int channel) {
+   if (!valid || channel < 0 || channel >= 64 || !(header.ch_enable_mask & ((uint64_t)1 << channel))) {
+      return NULL;
+   }
+
+   // Position of this channel among the enabled ones.
+   int idx = __builtin_popcountll(header.ch_enable_mask & (((uint64_t)1 << channel) - 1));
+   return (const uint16_t*)(chan_begin + (size_t)idx * (samples_per_chan / 4));
+}
+
+CaenEventIterator::CaenEventIterator(const uint64_t* buffer, size_t size_words) {
+   pos = buffer;
+   end = buffer + size_words;
+}
+
+const uint64_t* CaenEventIterator::next(uint32_t& size_words) {
+   if (pos >= end) {
+      return NULL;
+   }
+
+   size_words = pos[0] & 0xFFFFFFFF;
+
+   if (size_words < 3 || size_words > (size_t)(end - pos)) {
+      // Truncated or corrupt; don't go any further.
+      return NULL;
+   }
+
+   const uint64_t* event = pos;
+   pos += size_words;
+   return event;
+}
+
+bool CaenEventIterator::at_end() {
+   return pos >= end;
+}
@@ -24,6 +24,33 @@ struct CaenEventHeader {
    void hencode(uint64_t* buffer);
 };
 
+// Widths of the wrapping counters in the event header.
+#define CAEN_EVENT_COUNTER_BITS 24
+#define CAEN_TRIGGER_TIME_BITS 48
+
+// Extends a counter that wraps at `num_bits` bits to a 64-bit value that
+// keeps increasing. Each value is placed as close as possible to the
+// previous one, so consecutive values must be less than half the counter's
+// range apart (8M events for the event counter; ~13 days for the trigger
+// time). Small steps backwards are allowed.
+class CaenCounterExtender {
+public:
+   CaenCounterExtender(int num_bits);
+
+   uint64_t extend(uint64_t raw);
+
+   // The last value returned by extend() (0 if none yet).
+   uint64_t current();
+
+   // Start again from the next value (e.g. at the start of a run).
+   void reset();
+
+protected:
+   uint64_t mask;
+   uint64_t last = 0;
+   bool have_last = false;
+};
+
 // Helper struct for parsing event data.
 struct CaenEvent {
    CaenEvent(uint64_t *buffer, bool is_host_order=true);
@@ -35,9 +62,62 @@ struct CaenEvent {
    // Encode event in host-order byte format
    void hencode(uint64_t* buffer);
 
+   // Encode event in host-order byte format, but with all the samples of
+   // each channel contiguous (see CaenChannelMajorEvent). Returns the number
+   // of 64-bit words written, which is channel_major_size_words().
+   uint32_t encode_channel_major(uint64_t* buffer);
+   uint32_t channel_major_size_words();
+
    CaenEventHeader header;
    uint64_t *wf_begin;
    uint64_t *wf_end;
 };
 
+// Bump if the channel-major layout changes.
+#define CAEN_CHANNEL_MAJOR_VERSION 1
+
+// Reader for events written by CaenEvent::encode_channel_major(). Layout (in
+// 64-bit words):
+// * 3 words - the usual event header (size is that of the original event)
+// * 1 word  - version in bits 63-56, samples per channel in bits 31-0
+// * then for each enabled channel, in ascending order, all its samples as
+//   consecutive uint16s (4 per word, earliest in the low bits)
+struct CaenChannelMajorEvent {
+   CaenChannelMajorEvent(const uint64_t* buffer, size_t size_words);
+
+   // False if the buffer is too small or of an unknown version.
+   bool is_valid();
+
+   // Samples of a channel, or NULL if it wasn't read out. There are
+   // samples_per_chan of them. Points into the buffer, so no copying needed.
+   const uint16_t* get_channel_samples(int channel);
+
+   CaenEventHeader header;
+   uint32_t samples_per_chan = 0;
+
+protected:
+   const uint64_t* chan_begin = nullptr;
+   bool valid = false;
+};
+
+// Steps through events stored back to back, each starting with the usual
+// header (so its size is in the first word), as in the B banks written when
+// batching events. Also works for anything else the frontend writes to the
+// ring buffer (zero-suppressed, compressed, hit records).
+class CaenEventIterator {
+public:
+   CaenEventIterator(const uint64_t* buffer, size_t size_words);
+
+   // The next event and its size, or NULL at the end of the buffer. Also
+   // NULL if the rest of the buffer doesn't hold a whole event; check
+   // at_end() to tell the two apart.
+   const uint64_t* next(uint32_t& size_words);
+
+   bool at_end();
+
+protected:
+   const uint64_t* pos;
+   const uint64_t* end;
+};
+
 #endif
\ No newline at end of file
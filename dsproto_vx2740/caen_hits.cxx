@@ -0,0 +1,261 @@
+#include "caen_hits.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+   // Quiet stretches are skipped this many samples at a time.
+   const uint32_t block_samples = 64;
+
+   // Fixed trip counts, so the compiler vectorises these. SSE2 only has
+   // signed 16-bit min/max, so flip the top bit to compare as signed.
+   inline uint16_t block_min(const uint16_t* s) {
+      int16_t m = INT16_MAX;
+
+      for (uint32_t j = 0; j < block_samples; j++) {
+         m = std::min(m, (int16_t)(s[j] ^ 0x8000));
+      }
+
+      return (uint16_t)m ^ 0x8000;
+   }
+
+   inline uint16_t block_max(const uint16_t* s) {
+      int16_t m = INT16_MIN;
+
+      for (uint32_t j = 0; j < block_samples; j++) {
+         m = std::max(m, (int16_t)(s[j] ^ 0x8000));
+      }
+
+      return (uint16_t)m ^ 0x8000;
+   }
+
+   // Sum of (baseline - s) (or s - baseline) over up to `len` samples from
+   // `s`, stopping at `end`. Clamped to fit in 32 bits.
+   int32_t integrate(const uint16_t* s, const uint16_t* end, uint32_t len, int32_t baseline, bool negative, bool& truncated) {
+      uint32_t n = len;
+
+      if (s + len > end) {
+         n = end - s;
+         truncated = true;
+      }
+
+      int64_t sum = 0;
+
+      for (uint32_t j = 0; j < n; j++) {
+         sum += s[j];
+      }
+
+      sum = negative ? (int64_t)baseline * n - sum : sum - (int64_t)baseline * n;
+      return (int32_t)std::max<int64_t>(INT32_MIN, std::min<int64_t>(INT32_MAX, sum));
+   }
+}
+
+void CaenHit::encode(uint64_t* buffer) const {
+   buffer[0] = ((uint64_t)channel << 56) | ((uint64_t)flags << 48) | ((uint64_t)baseline << 32) | first_sample;
+   buffer[1] = ((uint64_t)(uint32_t)qlong << 32) | (uint32_t)qshort;
+}
+
+void CaenHit::decode(const uint64_t* buffer) {
+   channel = buffer[0] >> 56;
+   flags = (buffer[0] >> 48) & 0xFF;
+   baseline = (buffer[0] >> 32) & 0xFFFF;
+   first_sample = buffer[0] & 0xFFFFFFFF;
+   qlong = (int32_t)(uint32_t)(buffer[1] >> 32);
+   qshort = (int32_t)(uint32_t)(buffer[1] & 0xFFFFFFFF);
+}
+
+void CaenHitFinder::configure(const CaenHitConfig& _config) {
+   config = _config;
+   config.thresholds_adc.resize(64, 0);
+   config.qshort_samples.resize(64, 0);
+   config.qlong_samples.resize(64, 0);
+
+   // The firmware's window registers are in units of 4 samples.
+   for (int i = 0; i < 64; i++) {
+      config.qshort_samples[i] &= ~3;
+      config.qlong_samples[i] &= ~3;
+   }
+}
+
+void CaenHitFinder::reset() {
+   std::fill(baselines.begin(), baselines.end(), 0);
+   std::fill(have_baseline.begin(), have_baseline.end(), false);
+}
+
+bool CaenHitFinder::find_hits(CaenEvent& event, std::vector<CaenHit>& hits, uint32_t max_hits) {
+   hits.clear();
+
+   if (event.header.format != 0x10) {
+      return true;
+   }
+
+   int num_chans = __builtin_popcountll(event.header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (event.wf_end - event.wf_begin) / num_chans : 0;
+   uint32_t num_samples = words_per_chan * 4;
+   bool dropped = false;
+
+   transposed.resize(event.channel_major_size_words());
+   event.encode_channel_major(transposed.data());
+
+   for (int chan = 0, chan_idx = 0; chan < 64; chan++) {
+      if (!(event.header.ch_enable_mask & ((uint64_t)1 << chan))) {
+         continue;
+      }
+
+      const uint16_t* samples = (const uint16_t*)(transposed.data() + 4 + (size_t)chan_idx++ * words_per_chan);
+      find_channel_hits(chan, samples, num_samples, hits, max_hits, dropped);
+   }
+
+   return !dropped;
+}
+
+void CaenHitFinder::find_channel_hits(int channel, const uint16_t* samples, uint32_t num_samples, std::vector<CaenHit>& hits, uint32_t max_hits, bool& dropped) {
+   const uint16_t* end = samples + num_samples;
+   int32_t threshold = config.thresholds_adc[channel];
+   uint32_t len_short = config.qshort_samples[channel];
+   uint32_t len_long = config.qlong_samples[channel];
+   uint8_t flags = 0;
+
+   // Baseline from the start of the waveform, if nothing's happening there.
+   uint32_t n = std::min(num_samples, config.baseline_samples);
+   uint16_t lo = 0xFFFF, hi = 0;
+   uint64_t sum = 0;
+
+   for (uint32_t j = 0; j < n; j++) {
+      lo = std::min(lo, samples[j]);
+      hi = std::max(hi, samples[j]);
+      sum += samples[j];
+   }
+
+   if (n > 0 && hi - lo <= threshold) {
+      baselines[channel] = (sum + n / 2) / n;
+      have_baseline[channel] = true;
+   } else if (!have_baseline[channel]) {
+      // Nothing better to go on.
+      baselines[channel] = n ? (sum + n / 2) / n : 0;
+      flags |= CAEN_HIT_FLAG_OLD_BASELINE;
+   } else {
+      flags |= CAEN_HIT_FLAG_OLD_BASELINE;
+   }
+
+   int32_t baseline = baselines[channel];
+   bool negative = config.negative_pulses;
+
+   // Samples beyond `level` are over threshold. Blocks that don't reach it
+   // can be skipped (a level outside 0-65535 is never reached).
+   int32_t level = negative ? baseline - threshold : baseline + threshold;
+   bool armed = true;
+   uint32_t j = 0;
+
+   while (j < num_samples) {
+      if (armed && j % block_samples == 0 && j + block_samples <= num_samples) {
+         if (negative ? block_min(samples + j) >= level : block_max(samples + j) <= level) {
+            j += block_samples;
+            continue;
+         }
+      }
+
+      bool over = negative ? samples[j] < level : samples[j] > level;
+
+      if (!armed) {
+         // Wait for the signal to come back before looking for another pulse.
+         armed = !over;
+         j++;
+         continue;
+      }
+
+      if (!over) {
+         j++;
+         continue;
+      }
+
+      if (hits.size() >= max_hits) {
+         dropped = true;
+         return;
+      }
+
+      CaenHit hit;
+      bool truncated = false;
+      hit.channel = channel;
+      hit.baseline = baseline;
+      hit.first_sample = j;
+      hit.qshort = integrate(samples + j, end, len_short, baseline, negative, truncated);
+      hit.qlong = integrate(samples + j, end, len_long, baseline, negative, truncated);
+      hit.flags = flags | (truncated ? CAEN_HIT_FLAG_TRUNCATED : 0);
+      hits.push_back(hit);
+
+      j += std::max(1u, std::max(len_short, len_long));
+      armed = false;
+   }
+}
+
+uint32_t CaenHitFinder::record_size_words(uint32_t num_hits, uint32_t waveform_words) {
+   return CAEN_HITS_HEADER_WORDS + num_hits * CAEN_HIT_WORDS + waveform_words;
+}
+
+uint32_t CaenHitFinder::encode_record(const CaenEventHeader& header, const std::vector<CaenHit>& hits, uint8_t flags,
+                                      const uint64_t* waveform, uint32_t waveform_words, uint64_t* buffer) {
+   uint32_t size_words = record_size_words(hits.size(), waveform ? waveform_words : 0);
+
+   CaenEventHeader record_header = header;
+   record_header.format = CAEN_HITS_FORMAT;
+   record_header.size_64bit_words = size_words;
+   record_header.hencode(buffer);
+   buffer[3] = ((uint64_t)CAEN_HITS_VERSION << 56) | ((uint64_t)flags << 48) | hits.size();
+
+   uint64_t* out = buffer + CAEN_HITS_HEADER_WORDS;
+
+   for (const auto& hit : hits) {
+      hit.encode(out);
+      out += CAEN_HIT_WORDS;
+   }
+
+   if (waveform) {
+      memcpy(out, waveform, waveform_words * sizeof(uint64_t));
+   }
+
+   return size_words;
+}
+
+CaenHitsEvent::CaenHitsEvent(const uint64_t* buffer, size_t size_words) {
+   if (size_words < CAEN_HITS_HEADER_WORDS) {
+      return;
+   }
+
+   header = CaenEventHeader((uint64_t*)buffer);
+
+   if (header.format != CAEN_HITS_FORMAT || (buffer[3] >> 56) != CAEN_HITS_VERSION || header.size_64bit_words > size_words) {
+      return;
+   }
+
+   flags = (buffer[3] >> 48) & 0xFF;
+   uint32_t num_hits = buffer[3] & 0xFFFFFFFF;
+   uint64_t hits_end = CAEN_HITS_HEADER_WORDS + (uint64_t)num_hits * CAEN_HIT_WORDS;
+
+   if (hits_end > header.size_64bit_words) {
+      return;
+   }
+
+   hits.resize(num_hits);
+
+   for (uint32_t i = 0; i < num_hits; i++) {
+      hits[i].decode(buffer + CAEN_HITS_HEADER_WORDS + i * CAEN_HIT_WORDS);
+   }
+
+   if (hits_end < header.size_64bit_words) {
+      // The rest must be exactly one event.
+      waveform = buffer + hits_end;
+      waveform_size_words = header.size_64bit_words - hits_end;
+
+      if (waveform_size_words < 3 || (waveform[0] & 0xFFFFFFFF) != waveform_size_words) {
+         waveform = nullptr;
+         waveform_size_words = 0;
+         return;
+      }
+   }
+
+   valid = true;
+}
+
+bool CaenHitsEvent::is_valid() {
+   return valid;
+}
@@ -0,0 +1,125 @@
+#ifndef CAEN_HITS_H
+#define CAEN_HITS_H
+
+#include "caen_event.h"
+#include <inttypes.h>
+#include <vector>
+
+// Format byte of hit records (CAEN's own data events are 0x10).
+#define CAEN_HITS_FORMAT 0x1E
+
+// Bump if the layout changes.
+#define CAEN_HITS_VERSION 1
+
+// Words before the first hit, and words per hit.
+#define CAEN_HITS_HEADER_WORDS 4
+#define CAEN_HIT_WORDS 2
+
+// Per-hit flags.
+#define CAEN_HIT_FLAG_TRUNCATED 0x1    // Qshort/Qlong window ran past the end of the waveform
+#define CAEN_HIT_FLAG_OLD_BASELINE 0x2 // Start of the waveform wasn't quiet; used the last good baseline
+
+// Per-record flags.
+#define CAEN_HITS_FLAG_HITS_DROPPED 0x1     // More hits than fit; only the first ones were kept
+#define CAEN_HITS_FLAG_WAVEFORM_DROPPED 0x2 // Waveform should have been kept, but there wasn't space
+
+// Settings for pulse finding on one board's scope waveforms.
+struct CaenHitConfig {
+   // A pulse starts when the signal goes more than this beyond the baseline.
+   std::vector<uint16_t> thresholds_adc = std::vector<uint16_t>(64, 100);
+
+   // Integration windows, starting at the threshold crossing. Rounded down
+   // to a multiple of 4 samples, as the user firmware does.
+   std::vector<uint16_t> qshort_samples = std::vector<uint16_t>(64, 16);
+   std::vector<uint16_t> qlong_samples = std::vector<uint16_t>(64, 32);
+
+   // The baseline is the mean of this many samples at the start of each
+   // waveform (if they're quiet).
+   uint32_t baseline_samples = 16;
+
+   // Pulses go below the baseline (the usual case for PMTs/SiPMs).
+   bool negative_pulses = true;
+};
+
+struct CaenHit {
+   uint8_t channel = 0;
+   uint8_t flags = 0;
+   uint16_t baseline = 0;
+   uint32_t first_sample = 0; // Where the threshold was crossed
+   int32_t qshort = 0;        // Sum of (baseline - sample), or (sample - baseline) for positive pulses
+   int32_t qlong = 0;
+
+   void encode(uint64_t* buffer) const;
+   void decode(const uint64_t* buffer);
+};
+
+// Software version of the user firmware's pulse finding and Qshort/Qlong
+// integration, for scope-mode events.
+//
+// Once a channel crosses threshold, both windows are integrated from the
+// crossing sample, and the channel re-arms once the Qlong window has passed
+// and the signal is back within threshold. Quiet blocks of 64 samples are
+// skipped using a min/max over the block, which the compiler vectorises.
+//
+// Hit records (and H banks) have the layout (in 64-bit words):
+// * 3 words - the usual event header, but with format CAEN_HITS_FORMAT and
+//   size being that of the record
+// * 1 word  - version in bits 63-56, CAEN_HITS_FLAG_* in bits 55-48, number
+//   of hits in bits 31-0
+// * 2 words per hit:
+//   * channel in bits 63-56, CAEN_HIT_FLAG_* in bits 55-48, baseline in bits
+//     47-32, first sample in bits 31-0
+//   * Qlong (signed) in bits 63-32, Qshort (signed) in bits 31-0
+// * optionally, the waveform event (with its own header), as read from the
+//   board or zero-suppressed/compressed.
+//
+// Keeps state (the last good baselines), so use one finder per board.
+class CaenHitFinder {
+public:
+   void configure(const CaenHitConfig& _config);
+
+   // Forget the baselines (e.g. at the start of a run).
+   void reset();
+
+   // Find the hits in a scope-mode event, in channel order then time order.
+   // At most `max_hits` are kept; returns false if some were dropped.
+   bool find_hits(CaenEvent& event, std::vector<CaenHit>& hits, uint32_t max_hits);
+
+   // Size of a record with `num_hits` hits and a waveform of `waveform_words`.
+   static uint32_t record_size_words(uint32_t num_hits, uint32_t waveform_words);
+
+   // Write a record (see above) into `buffer`, which must hold at least
+   // record_size_words(). `waveform` may be NULL. Returns the words written.
+   static uint32_t encode_record(const CaenEventHeader& header, const std::vector<CaenHit>& hits, uint8_t flags,
+                                 const uint64_t* waveform, uint32_t waveform_words, uint64_t* buffer);
+
+protected:
+   // Hits of one channel, whose samples are contiguous.
+   void find_channel_hits(int channel, const uint16_t* samples, uint32_t num_samples, std::vector<CaenHit>& hits, uint32_t max_hits, bool& dropped);
+
+   CaenHitConfig config;
+   std::vector<uint16_t> baselines = std::vector<uint16_t>(64, 0);
+   std::vector<bool> have_baseline = std::vector<bool>(64, false);
+   std::vector<uint64_t> transposed; // Channel-major copy of the event
+};
+
+// Reader for hit records/H banks.
+struct CaenHitsEvent {
+   CaenHitsEvent(const uint64_t* buffer, size_t size_words);
+
+   // False if the buffer is truncated or of an unknown format/version.
+   bool is_valid();
+
+   CaenEventHeader header;
+   uint8_t flags = 0;
+   std::vector<CaenHit> hits;
+
+   // The waveform event that followed the hits, or NULL if it was dropped.
+   const uint64_t* waveform = nullptr;
+   uint32_t waveform_size_words = 0;
+
+protected:
+   bool valid = false;
+};
+
+#endif
@@ -0,0 +1,291 @@
+#include "caen_packing.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+   const uint32_t block_samples = CAEN_PACKED_BLOCK_SAMPLES;
+
+   uint32_t num_blocks(uint32_t num_samples) {
+      return (num_samples + block_samples - 1) / block_samples;
+   }
+
+   uint32_t width_words(uint32_t num_blocks) {
+      return (num_blocks + 7) / 8;
+   }
+
+   inline uint16_t zigzag(uint16_t delta) {
+      return (uint16_t)((delta << 1) ^ (uint16_t)((int16_t)delta >> 15));
+   }
+
+   inline uint16_t unzigzag(uint16_t val) {
+      return (uint16_t)((val >> 1) ^ (uint16_t)(0 - (val & 1)));
+   }
+
+   // The width is a template parameter so each width gets its own code with
+   // constant shifts. Values are combined 4 at a time (4*B <= 64 bits) before
+   // being added to the output. `out` must hold B words.
+   template <int B> void pack_block(const uint16_t* in, uint64_t* out) {
+      if (B == 0) {
+         return;
+      }
+
+      uint64_t acc = 0;
+      uint32_t bits = 0;
+
+      for (uint32_t j = 0; j < block_samples; j += 4) {
+         uint64_t v = (uint64_t)in[j] | ((uint64_t)in[j+1] << B) | ((uint64_t)in[j+2] << (2*B)) | ((uint64_t)in[j+3] << (3*B));
+         acc |= v << bits;
+         bits += 4*B;
+
+         if (bits >= 64) {
+            *out++ = acc;
+            bits -= 64;
+            acc = bits ? v >> (4*B - bits) : 0;
+         }
+      }
+   }
+
+   template <int B> void unpack_block(const uint64_t* in, uint16_t* out) {
+      if (B == 0) {
+         memset(out, 0, block_samples * sizeof(uint16_t));
+         return;
+      }
+
+      const uint64_t mask = (B == 16) ? 0xFFFF : (((uint64_t)1 << B) - 1);
+      uint64_t acc = *in++;
+      uint32_t bits = 0; // Already used from acc
+
+      for (uint32_t j = 0; j < block_samples; j += 4) {
+         uint64_t v;
+
+         if (bits + 4*B <= 64) {
+            v = acc >> bits;
+            bits += 4*B;
+
+            if (bits == 64 && j + 4 < block_samples) {
+               acc = *in++;
+               bits = 0;
+            }
+         } else {
+            uint64_t next = *in++;
+            v = (acc >> bits) | (next << (64 - bits));
+            acc = next;
+            bits += 4*B - 64;
+         }
+
+         out[j] = v & mask;
+         out[j+1] = (v >> B) & mask;
+         out[j+2] = (v >> (2*B)) & mask;
+         out[j+3] = (v >> (3*B)) & mask;
+      }
+   }
+
+   // Zigzagged deltas of a full block (s[-1] must be readable). The buffers
+   // can't overlap, which lets the compiler vectorise this.
+   inline void delta_block(const uint16_t* __restrict__ s, uint16_t* __restrict__ block) {
+      for (uint32_t j = 0; j < block_samples; j++) {
+         block[j] = zigzag(s[j] - s[(int)j - 1]);
+      }
+   }
+
+   typedef void (*PackFn)(const uint16_t*, uint64_t*);
+   typedef void (*UnpackFn)(const uint64_t*, uint16_t*);
+
+   const PackFn pack_fns[17] = {
+      pack_block<0>, pack_block<1>, pack_block<2>, pack_block<3>, pack_block<4>,
+      pack_block<5>, pack_block<6>, pack_block<7>, pack_block<8>, pack_block<9>,
+      pack_block<10>, pack_block<11>, pack_block<12>, pack_block<13>, pack_block<14>,
+      pack_block<15>, pack_block<16>
+   };
+
+   const UnpackFn unpack_fns[17] = {
+      unpack_block<0>, unpack_block<1>, unpack_block<2>, unpack_block<3>, unpack_block<4>,
+      unpack_block<5>, unpack_block<6>, unpack_block<7>, unpack_block<8>, unpack_block<9>,
+      unpack_block<10>, unpack_block<11>, unpack_block<12>, unpack_block<13>, unpack_block<14>,
+      unpack_block<15>, unpack_block<16>
+   };
+}
+
+uint32_t CaenPackEncoder::max_size_words(CaenEvent& event) {
+   int num_chans = __builtin_popcountll(event.header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (event.wf_end - event.wf_begin) / num_chans : 0;
+   uint32_t blocks = num_blocks(words_per_chan * 4);
+   uint32_t raw_words = event.wf_end - event.wf_begin + 3;
+
+   return std::max(raw_words, 4 + num_chans * (1 + width_words(blocks) + blocks * 16));
+}
+
+uint32_t CaenPackEncoder::encode(CaenEvent& event, uint64_t* buffer) {
+   CaenEventHeader header = event.header;
+   uint32_t raw_words = event.wf_end - event.wf_begin + 3;
+
+   if (header.format != 0x10) {
+      event.hencode(buffer);
+      return raw_words;
+   }
+
+   int num_chans = __builtin_popcountll(header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (event.wf_end - event.wf_begin) / num_chans : 0;
+   uint32_t num_samples = words_per_chan * 4;
+   uint32_t blocks = num_blocks(num_samples);
+   uint64_t* out = buffer + 4;
+
+   // De-interleave all the channels in one cache-friendly pass.
+   transposed.resize(event.channel_major_size_words());
+   event.encode_channel_major(transposed.data());
+
+   for (int chan = 0, chan_idx = 0; chan < 64; chan++) {
+      if (!(header.ch_enable_mask & ((uint64_t)1 << chan))) {
+         continue;
+      }
+
+      const uint16_t* samples = (const uint16_t*)(transposed.data() + 4 + (size_t)chan_idx++ * words_per_chan);
+      uint16_t first = num_samples ? samples[0] : 0;
+      uint16_t prev = first;
+
+      uint64_t* chan_word = out++;
+      uint8_t* widths = (uint8_t*)out;
+      uint32_t num_width_words = width_words(blocks);
+      memset(out, 0, num_width_words * sizeof(uint64_t));
+      out += num_width_words;
+
+      for (uint32_t b = 0; b < blocks; b++) {
+         const uint16_t* s = samples + b * block_samples;
+         uint32_t n = std::min(block_samples, num_samples - b * block_samples);
+         uint16_t block[block_samples];
+         uint16_t all_bits = 0;
+
+         if (n == block_samples) {
+            // s[-1] is the previous block, or the word before the first
+            // channel; block[0] is set properly below.
+            delta_block(s, block);
+         } else {
+            // Pad the last block with zero deltas.
+            for (uint32_t j = 0; j < block_samples; j++) {
+               block[j] = (j > 0 && j < n) ? zigzag(s[j] - s[j-1]) : 0;
+            }
+         }
+
+         block[0] = zigzag(s[0] - prev);
+         prev = s[n-1];
+
+         for (uint32_t j = 0; j < block_samples; j++) {
+            all_bits |= block[j];
+         }
+
+         int width = all_bits ? 32 - __builtin_clz(all_bits) : 0;
+         widths[b] = width;
+         pack_fns[width](block, out);
+         out += width;
+      }
+
+      *chan_word = ((uint64_t)(out - chan_word - 1) << 32) | first;
+   }
+
+   uint32_t size_words = out - buffer;
+
+   if (size_words >= raw_words) {
+      // Nothing to gain (e.g. very noisy data); keep the original.
+      event.hencode(buffer);
+      return raw_words;
+   }
+
+   header.format = CAEN_PACKED_FORMAT;
+   header.size_64bit_words = size_words;
+   header.hencode(buffer);
+   buffer[3] = ((uint64_t)CAEN_PACKED_VERSION << 56) | num_samples;
+
+   return size_words;
+}
+
+CaenPackedEvent::CaenPackedEvent(const uint64_t* buffer, size_t size_words) {
+   if (size_words < 4) {
+      return;
+   }
+
+   header = CaenEventHeader((uint64_t*)buffer);
+
+   if (header.format != CAEN_PACKED_FORMAT || (buffer[3] >> 56) != CAEN_PACKED_VERSION || header.size_64bit_words > size_words) {
+      return;
+   }
+
+   samples_per_chan = buffer[3] & 0xFFFFFFFF;
+   uint32_t blocks = num_blocks(samples_per_chan);
+   const uint64_t* p = buffer + 4;
+   const uint64_t* end = buffer + header.size_64bit_words;
+
+   for (int chan = 0; chan < 64; chan++) {
+      if (!(header.ch_enable_mask & ((uint64_t)1 << chan))) {
+         continue;
+      }
+
+      if (p >= end) {
+         return;
+      }
+
+      // Check the channel's blocks fit in the space it claims.
+      uint32_t chan_words = *p >> 32;
+      const uint8_t* widths = (const uint8_t*)(p + 1);
+      uint32_t needed = width_words(blocks);
+
+      if (p + 1 + std::min(needed, chan_words) > end) {
+         return;
+      }
+
+      for (uint32_t b = 0; b < blocks && needed <= chan_words; b++) {
+         if (widths[b] > 16) {
+            return;
+         }
+
+         needed += widths[b];
+      }
+
+      if (needed != chan_words || p + 1 + chan_words > end) {
+         return;
+      }
+
+      chan_data[chan] = p;
+      p += 1 + chan_words;
+   }
+
+   valid = true;
+}
+
+bool CaenPackedEvent::is_valid() {
+   return valid;
+}
+
+uint32_t CaenPackedEvent::get_channel_samples(int channel, uint16_t *chan_buffer, uint32_t chan_buf_size_samples) {
+   if (!valid || channel < 0 || channel >= 64 || chan_data[channel] == nullptr) {
+      return 0;
+   }
+
+   const uint64_t* p = chan_data[channel];
+   uint16_t prev = *p & 0xFFFF;
+   uint32_t blocks = num_blocks(samples_per_chan);
+   const uint8_t* widths = (const uint8_t*)(p + 1);
+   p += 1 + width_words(blocks);
+
+   uint32_t num_to_read = std::min(chan_buf_size_samples, samples_per_chan);
+   uint16_t block[block_samples];
+
+   for (uint32_t b = 0, i = 0; b < blocks && i < num_to_read; b++) {
+      unpack_fns[widths[b]](p, block);
+      p += widths[b];
+
+      uint32_t n = std::min(block_samples, num_to_read - i);
+
+      for (uint32_t j = 0; j < n; j++, i++) {
+         prev += unzigzag(block[j]);
+         chan_buffer[i] = prev;
+      }
+   }
+
+   return num_to_read;
+}
+
+std::vector<uint16_t> CaenPackedEvent::get_channel_samples_vec(int channel) {
+   std::vector<uint16_t> retval(samples_per_chan);
+   retval.resize(get_channel_samples(channel, retval.data(), retval.size()));
+   return retval;
+}
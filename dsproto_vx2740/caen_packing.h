@@ -0,0 +1,72 @@
+#ifndef CAEN_PACKING_H
+#define CAEN_PACKING_H
+
+#include "caen_event.h"
+#include <inttypes.h>
+#include <vector>
+
+// Format byte of losslessly compressed events (CAEN's own data events are 0x10).
+#define CAEN_PACKED_FORMAT 0x1C
+
+// Bump if the layout changes.
+#define CAEN_PACKED_VERSION 1
+
+// Samples per block; each block is bit-packed with its own width.
+#define CAEN_PACKED_BLOCK_SAMPLES 64
+
+// Lossless compression of scope-mode events. Each channel's waveform is
+// delta-coded (modulo 2^16, zigzag-encoded so small steps either way are
+// small numbers), then each block of 64 deltas is packed using just enough
+// bits for the largest. A block of width B is exactly B words.
+//
+// Layout (in 64-bit words):
+// * 3 words - the usual event header, but with format CAEN_PACKED_FORMAT and
+//   size being that of the encoded event
+// * 1 word  - version in bits 63-56, samples per channel in bits 31-0
+// * then for each enabled channel, in ascending order:
+//   * 1 word - number of words that follow for this channel in bits 63-32,
+//     first sample in bits 15-0
+//   * the width (0-16) of each block, one byte each, 8 per word (first in
+//     the low byte; the last word is padded with zeros)
+//   * each block in turn: delta j in bits j*B to j*B+B-1 of the block (bit 0
+//     being the low bit of the block's first word). The last block is padded
+//     with zero deltas.
+//
+// Stateless apart from scratch space, but not thread-safe: use one per thread.
+class CaenPackEncoder {
+public:
+   // Largest encoded size of an event, in 64-bit words.
+   static uint32_t max_size_words(CaenEvent& event);
+
+   // Encode a scope-mode event into `buffer`, which must hold at least
+   // max_size_words(). Returns the number of words written. Events that
+   // aren't normal data events, or wouldn't get smaller, are copied unchanged.
+   uint32_t encode(CaenEvent& event, uint64_t* buffer);
+
+protected:
+   std::vector<uint64_t> transposed; // Channel-major copy of the event
+};
+
+// Reader for events written by CaenPackEncoder::encode(). Channels are only
+// decoded when asked for, block by block, straight into the caller's buffer.
+struct CaenPackedEvent {
+   CaenPackedEvent(const uint64_t* buffer, size_t size_words);
+
+   // False if the buffer is truncated or of an unknown format/version.
+   bool is_valid();
+
+   // Decode up to `chan_buf_size_samples` samples of a channel. Returns the
+   // number of samples decoded (0 if the channel wasn't read out).
+   uint32_t get_channel_samples(int channel, uint16_t *chan_buffer, uint32_t chan_buf_size_samples);
+   std::vector<uint16_t> get_channel_samples_vec(int channel);
+
+   CaenEventHeader header;
+   uint32_t samples_per_chan = 0;
+
+protected:
+   // Start of each channel's data (its first word), or NULL.
+   std::vector<const uint64_t*> chan_data = std::vector<const uint64_t*>(64, nullptr);
+   bool valid = false;
+};
+
+#endif
@@ -10,6 +10,8 @@
 #include <cinttypes>
 #include <cstring>
 #include <sstream>
+#include <mutex>
+#include <strings.h>
 
 std::string CaenParameters::merge_string_options(std::vector<std::string> opts) {
    std::string retval = "";
@@ -44,17 +46,105 @@ std::vector<std::string> CaenParameters::split_string_options(std::string opts)
 }
 
 
+namespace {
+   // Allowed values of enumerated parameters, shared by all boards in this
+   // process. Keyed by "model|firmware version|parameter path", as the
+   // options only change with the firmware.
+   std::mutex allowed_values_mutex;
+   std::map<std::string, std::vector<std::string>> allowed_values_cache;
+   std::string allowed_values_cache_file;
+}
+
+void CaenParameters::set_allowed_values_cache_file(std::string path) {
+   std::lock_guard<std::mutex> guard(allowed_values_mutex);
+
+   if (path == allowed_values_cache_file) {
+      return;
+   }
+
+   allowed_values_cache_file = path;
+
+   if (path == "") {
+      return;
+   }
+
+   // File is "key<TAB>value1|value2|...", one parameter per line.
+   FILE* fp = fopen(path.c_str(), "r");
+
+   if (!fp) {
+      // Doesn't exist yet - will be created when we learn something.
+      return;
+   }
+
+   char line[4096];
+
+   while (fgets(line, sizeof(line), fp)) {
+      line[strcspn(line, "\r\n")] = 0;
+      char* tab = strchr(line, '\t');
+
+      if (!tab) {
+         continue;
+      }
+
+      *tab = 0;
+      std::vector<std::string> vals = split_string_options(tab + 1);
+
+      if (vals.size()) {
+         allowed_values_cache[line] = vals;
+      }
+   }
+
+   fclose(fp);
+}
+
+void CaenParameters::clear_allowed_values_cache() {
+   std::lock_guard<std::mutex> guard(allowed_values_mutex);
+   allowed_values_cache.clear();
+}
+
+size_t CaenParameters::read_device_tree_json() {
+   if (tree_buffer.empty()) {
+      tree_buffer.resize(1024*1024);
+   }
+
+   while (true) {
+      num_felib_calls++;
+      int len = CAEN_FELib_GetDeviceTree(dev->get_root_handle(), tree_buffer.data(), tree_buffer.size());
+
+      if (len < 0) {
+         throw CaenException(dev->get_last_error("Failed to get device tree"));
+      }
+
+      if ((size_t)len < tree_buffer.size()) {
+         return len;
+      }
+
+      // Returned the size it needs; try again with a big enough buffer.
+      tree_buffer.resize(len + 1);
+   }
+}
+
 std::string CaenParameters::get_param_list_json() {
-   size_t size = 1024*1024*10;
+   size_t len = read_device_tree_json();
+   return std::string(tree_buffer.data(), len);
+}
 
-   char* js = (char*)malloc(size);
+void CaenParameters::get_device_tree(CaenDeviceTree& tree) {
+   size_t len = read_device_tree_json();
 
-   int wrote_size = CAEN_FELib_GetDeviceTree(dev->get_root_handle(), js, size);
+   if (!tree.parse(tree_buffer.data(), len)) {
+      throw CaenException("Failed to parse device tree of " + dev->get_name());
+   }
 
-   std::string retval(js);
-   free(js);
+   // We now know the handle of every node, so later gets/sets of these
+   // paths needn't look them up.
+   for (size_t i = 0; i < tree.size(); i++) {
+      const CaenDeviceTree::Node& node = tree.node(i);
 
-   return retval;
+      if (node.handle != 0 && node.is_type("PARAMETER")) {
+         handle_cache[node.path] = node.handle;
+      }
+   }
 }
 
 std::vector<std::string> CaenParameters::recurse_get_param_list_human(std::string base_path, bool all_channels, std::map<std::string, std::vector<std::string>> extra_children, bool only_params) {
@@ -148,7 +238,77 @@ std::vector<std::string> CaenParameters::recurse_get_param_list_human(std::strin
 }
 
 std::string CaenParameters::get_param_list_human(std::string beneath, bool all_channels, std::map<std::string, std::vector<std::string>> extra_children, bool only_params) {
-   std::vector<std::string> list = recurse_get_param_list_human(beneath, all_channels, extra_children, only_params);
+   CaenDeviceTree tree;
+   get_device_tree(tree);
+
+   if (beneath != "" && beneath.back() == '/') {
+      beneath.pop_back();
+   }
+
+   // Work out which nodes to list (same rules as the node-by-node walk), then
+   // read all their values in one go.
+   std::vector<int> to_list;
+   std::vector<int> to_fetch;
+   std::vector<int> to_visit;
+   int start = tree.find(beneath);
+
+   if (start >= 0) {
+      to_visit.push_back(start);
+   }
+
+   while (!to_visit.empty()) {
+      const CaenDeviceTree::Node& node = tree.node(to_visit.back());
+      to_visit.pop_back();
+
+      for (auto child_idx : node.children) {
+         const CaenDeviceTree::Node& child = tree.node(child_idx);
+         bool has_value = child.is_type("PARAMETER") || child.is_type("FEATURE") || child.is_type("ATTRIBUTE");
+
+         if (!only_params || child.is_type("PARAMETER")) {
+            to_list.push_back(child_idx);
+
+            if (has_value) {
+               to_fetch.push_back(child_idx);
+            }
+         }
+
+         const std::string& path_str = child.path;
+
+         if (all_channels || path_str.find("/ch/") == std::string::npos || path_str.find("/ch/0/") != std::string::npos || path_str == "/ch/0") {
+            to_visit.push_back(child_idx);
+         }
+      }
+   }
+
+   tree.fetch_values(to_fetch, num_fetch_threads, &num_felib_calls);
+
+   std::vector<std::string> list;
+
+   for (auto idx : to_list) {
+      const CaenDeviceTree::Node& node = tree.node(idx);
+      std::string path_value = node.path;
+
+      if (node.is_type("PARAMETER") || node.is_type("FEATURE") || node.is_type("ATTRIBUTE")) {
+         path_value += " = ";
+         path_value += node.has_value ? node.value : "** UNKNOWN ** (failed to read value!)";
+      }
+
+      list.push_back(path_value);
+   }
+
+   // Handle any children that the calling code thinks should exist,
+   // but which aren't in the device tree.
+   for (auto& it : extra_children) {
+      for (auto& child : it.second) {
+         std::string path_str = it.first + "/" + child;
+
+         if (tree.find(path_str) < 0 && path_str.find(beneath) == 0) {
+            std::vector<std::string> subkeys = recurse_get_param_list_human(path_str, all_channels, {}, only_params);
+            list.insert(list.end(), subkeys.begin(), subkeys.end());
+         }
+      }
+   }
+
    std::sort(list.begin(), list.end());
 
    std::string retval;
@@ -160,45 +320,155 @@ std::string CaenParameters::get_param_list_human(std::string beneath, bool all_c
    return retval;
 }
 
-template<> void CaenParameters::set(std::string full_param_path, std::string val) {
+void CaenParameters::get_writable_params(std::vector<std::pair<std::string, std::string>>& params, std::string beneath) {
+   // Writable, but restoring them could make us lose the connection.
+   static const std::vector<std::string> skip = {
+      "/par/ipaddress",
+      "/par/netmask",
+      "/par/gateway"
+   };
+
+   CaenDeviceTree tree;
+   get_device_tree(tree);
+
+   std::vector<int> writable;
+
+   for (auto idx : tree.get_subtree(beneath)) {
+      if (tree.is_writable(idx) && std::find(skip.begin(), skip.end(), str_to_lower(tree.node(idx).path)) == skip.end()) {
+         writable.push_back(idx);
+      }
+   }
+
+   tree.fetch_values(writable, num_fetch_threads, &num_felib_calls);
+   params.clear();
+
+   for (auto idx : writable) {
+      const CaenDeviceTree::Node& node = tree.node(idx);
+
+      if (!node.has_value) {
+         continue;
+      }
+
+      if (str_to_lower(node.path) == "/par/lvdstrgmask") {
+         // Value is "mask0, mask1, ..."; each line is set as "<line>=<mask>".
+         std::stringstream ss(node.value);
+         std::string mask;
+         int line = 0;
+
+         while (std::getline(ss, mask, ',')) {
+            mask.erase(0, mask.find_first_not_of(' '));
+            params.push_back(std::make_pair(node.path, std::to_string(line++) + "=" + mask));
+         }
+      } else {
+         params.push_back(std::make_pair(node.path, node.value));
+      }
+   }
+}
+
+void CaenParameters::clear_handle_cache() {
+   handle_cache.clear();
+   allowed_values_key_prefix = "";
+}
+
+uint64_t CaenParameters::get_handle(const char* full_param_path, const char*& rel_path) {
+   uint64_t root = dev->get_root_handle();
+
+   auto it = handle_cache.find(full_param_path);
+
+   if (it == handle_cache.end()) {
+      uint64_t handle = 0;
+
+      // Channel ranges ("/ch/0..63/par/X") address several nodes at once,
+      // so can only be used as a path relative to the root.
+      if (strstr(full_param_path, "..") == NULL) {
+         num_felib_calls++;
+
+         if (CAEN_FELib_GetHandle(root, full_param_path, &handle) != CAEN_FELib_Success) {
+            handle = 0;
+         }
+      }
+
+      it = handle_cache.insert(std::make_pair(std::string(full_param_path), handle)).first;
+   }
+
+   if (it->second == 0) {
+      rel_path = full_param_path;
+      return root;
+   }
+
+   rel_path = "";
+   return it->second;
+}
+
+void CaenParameters::set(const char* full_param_path, const char* val) {
+   if (!writes_enabled) {
+      return;
+   }
+
+   if (debug) {
+      printf("Setting %s to %s on %s\n", full_param_path, val, dev->get_name().c_str());
+   }
+
+   std::unique_lock<std::mutex> lock = lock_call();
+   const char* rel_path = NULL;
+   uint64_t handle = get_handle(full_param_path, rel_path);
+
+   num_felib_calls++;
+   int ret = CAEN_FELib_SetValue(handle, rel_path, val);
+
+   if (ret != CAEN_FELib_Success) {
+      throw CaenException(dev->get_last_error(std::string("Failed to set ") + full_param_path + " to " + val));
+   }
+}
+
+void CaenParameters::get(const char* full_param_path, char* val) {
    if (debug) {
-      printf("Setting %s to %s on %s\n", full_param_path.c_str(), val.c_str(), dev->get_name().c_str());
+      printf("Reading %s from %s\n", full_param_path, dev->get_name().c_str());
    }
 
-   int ret = CAEN_FELib_SetValue(dev->get_root_handle(), full_param_path.c_str(), val.c_str());
+   std::unique_lock<std::mutex> lock = lock_call();
+   const char* rel_path = NULL;
+   uint64_t handle = get_handle(full_param_path, rel_path);
+
+   num_felib_calls++;
+   int ret = CAEN_FELib_GetValue(handle, rel_path, val);
 
    if (ret != CAEN_FELib_Success) {
-      throw CaenException(dev->get_last_error("Failed to set " + full_param_path + " to " + val));
+      val[0] = 0;
+      throw CaenException(dev->get_last_error(std::string("Failed to get ") + full_param_path));
    }
 }
 
+template<> void CaenParameters::set(std::string full_param_path, std::string val) {
+   set(full_param_path.c_str(), val.c_str());
+}
+
 template<> void CaenParameters::set(std::string full_param_path, const char* val) {
-   set<std::string>(full_param_path, val);
+   set(full_param_path.c_str(), val);
 }
 
 template<> void CaenParameters::set(std::string full_param_path, char* val) {
-   set<std::string>(full_param_path, val);
+   set(full_param_path.c_str(), (const char*)val);
 }
 
 template<> void CaenParameters::get(std::string full_param_path, std::string& val) {
-   if (debug) {
-      printf("Reading %s from %s\n", full_param_path.c_str(), dev->get_name().c_str());
-   }
-
-   char cval[256] = {0};
-   strncpy(cval, val.c_str(), 255);
-   int ret = CAEN_FELib_GetValue(dev->get_root_handle(), full_param_path.c_str(), cval);
-
-   if (ret == CAEN_FELib_Success) {
-      val = cval;
-   } else {
+   // Some parameters (e.g. lvdstrgmask) use the value passed in to select
+   // what to read, so pre-fill the buffer.
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   strncpy(cval, val.c_str(), CAEN_PARAM_VALUE_LEN - 1);
+
+   try {
+      get(full_param_path.c_str(), cval);
+   } catch (...) {
       val = "";
-      throw CaenException(dev->get_last_error("Failed to get " + full_param_path));
+      throw;
    }
+
+   val = cval;
 }
 
 template<> void CaenParameters::set(std::string full_param_path, bool val) {
-   set<std::string>(full_param_path, val ? "true" : "false");
+   set(full_param_path.c_str(), val ? "true" : "false");
 }
 
 template<> void CaenParameters::set(std::string full_param_path, uint8_t val) {
@@ -216,7 +486,7 @@ template<> void CaenParameters::set(std::string full_param_path, uint32_t val) {
 template<> void CaenParameters::set(std::string full_param_path, uint64_t val) {
    char sval[256];
    snprintf(sval, 255, "%" PRIu64, val);
-   set<std::string>(full_param_path, sval);
+   set(full_param_path.c_str(), (const char*)sval);
 }
 
 template<> void CaenParameters::set(std::string full_param_path, int32_t val) {
@@ -226,28 +496,28 @@ template<> void CaenParameters::set(std::string full_param_path, int32_t val) {
 template<> void CaenParameters::set(std::string full_param_path, int64_t val) {
    char sval[256];
    snprintf(sval, 255, "%" PRId64, val);
-   set<std::string>(full_param_path, sval);
+   set(full_param_path.c_str(), (const char*)sval);
 }
 
 template<> void CaenParameters::set(std::string full_param_path, float val) {
    char sval[256];
    snprintf(sval, 255, "%f", val);
-   set<std::string>(full_param_path, sval);
+   set(full_param_path.c_str(), (const char*)sval);
 }
 
 template<> void CaenParameters::set(std::string full_param_path, double val) {
    char sval[256];
    snprintf(sval, 255, "%lf", val);
-   set<std::string>(full_param_path, sval);
+   set(full_param_path.c_str(), (const char*)sval);
 }
 
 template<> void CaenParameters::get(std::string full_param_path, bool& val) {
-   std::string sval;
-   get(full_param_path, sval);
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   get(full_param_path.c_str(), cval);
 
-   if (sval == "true" || sval == "True") {
+   if (strcmp(cval, "true") == 0 || strcmp(cval, "True") == 0) {
       val = 1;
-   } else if (sval == "false" || sval == "False") {
+   } else if (strcmp(cval, "false") == 0 || strcmp(cval, "False") == 0) {
       val = 0;
    } else {
       throw CaenSetParamException(full_param_path, "Read unexpected value for boolean");
@@ -288,15 +558,14 @@ template<> void CaenParameters::get(std::string full_param_path, uint32_t& val)
 }
 
 template<> void CaenParameters::get(std::string full_param_path, uint64_t& val) {
-   char cval[256] = {0};
-   snprintf(cval, 255, "%" PRIu64, val);
-   std::string sval = cval;
-   
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   snprintf(cval, CAEN_PARAM_VALUE_LEN - 1, "%" PRIu64, val);
+
    val = 0;
-   
-   get(full_param_path, sval);
 
-   int n = sscanf(sval.c_str(), "%" PRIu64, &val);
+   get(full_param_path.c_str(), cval);
+
+   int n = sscanf(cval, "%" PRIu64, &val);
 
    if (n == 0) {
       throw CaenGetParamException(full_param_path, "Failed to parse value as an unsigned integer");
@@ -315,15 +584,14 @@ template<> void CaenParameters::get(std::string full_param_path, int32_t& val) {
 }
 
 template<> void CaenParameters::get(std::string full_param_path, int64_t& val) {
-   char cval[256] = {0};
-   snprintf(cval, 255, "%" PRId64, val);
-   std::string sval = cval;
-   
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   snprintf(cval, CAEN_PARAM_VALUE_LEN - 1, "%" PRId64, val);
+
    val = 0;
 
-   get(full_param_path, sval);
-   
-   int n = sscanf(sval.c_str(), "%" PRId64, &val);
+   get(full_param_path.c_str(), cval);
+
+   int n = sscanf(cval, "%" PRId64, &val);
 
    if (n == 0) {
       throw CaenGetParamException(full_param_path, "Failed to parse value as a signed integer");
@@ -331,15 +599,14 @@ template<> void CaenParameters::get(std::string full_param_path, int64_t& val) {
 }
 
 template<> void CaenParameters::get(std::string full_param_path, float& val) {
-   char cval[256] = {0};
-   snprintf(cval, 255, "%f", val);
-   std::string sval = cval;
-   
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   snprintf(cval, CAEN_PARAM_VALUE_LEN - 1, "%f", val);
+
    val = 0;
 
-   get(full_param_path, sval);
+   get(full_param_path.c_str(), cval);
 
-   int n = sscanf(sval.c_str(), "%f", &val);
+   int n = sscanf(cval, "%f", &val);
 
    if (n == 0) {
       throw CaenGetParamException(full_param_path, "Failed to parse value as a float");
@@ -347,15 +614,14 @@ template<> void CaenParameters::get(std::string full_param_path, float& val) {
 }
 
 template<> void CaenParameters::get(std::string full_param_path, double& val) {
-   char cval[256] = {0};
-   snprintf(cval, 255, "%lf", val);
-   std::string sval = cval;
-   
+   char cval[CAEN_PARAM_VALUE_LEN] = {0};
+   snprintf(cval, CAEN_PARAM_VALUE_LEN - 1, "%lf", val);
+
    val = 0;
 
-   get(full_param_path, sval);
+   get(full_param_path.c_str(), cval);
 
-   int n = sscanf(sval.c_str(), "%lf", &val);
+   int n = sscanf(cval, "%lf", &val);
 
    if (n == 0) {
       throw CaenGetParamException(full_param_path, "Failed to parse value as a double");
@@ -363,20 +629,87 @@ template<> void CaenParameters::get(std::string full_param_path, double& val) {
 }
 
 void CaenParameters::get_allowed_values(std::string full_param_path, std::vector<std::string> &allowed_values) {
+   if (allowed_values_key_prefix == "") {
+      std::string model, fw_ver;
+      get_model_name(model);
+      get_firmware_version(fw_ver);
+      allowed_values_key_prefix = model + "|" + fw_ver + "|";
+   }
+
+   std::string key = allowed_values_key_prefix + full_param_path;
+
+   {
+      std::lock_guard<std::mutex> guard(allowed_values_mutex);
+      auto it = allowed_values_cache.find(key);
+
+      if (it != allowed_values_cache.end()) {
+         allowed_values = it->second;
+         return;
+      }
+   }
+
+   read_allowed_values(full_param_path, allowed_values);
+
+   if (allowed_values.empty()) {
+      // Don't remember failures.
+      return;
+   }
+
+   std::lock_guard<std::mutex> guard(allowed_values_mutex);
+   allowed_values_cache[key] = allowed_values;
+
+   if (allowed_values_cache_file != "") {
+      FILE* fp = fopen(allowed_values_cache_file.c_str(), "a");
+
+      if (fp) {
+         fprintf(fp, "%s\t%s\n", key.c_str(), merge_string_options(allowed_values).c_str());
+         fclose(fp);
+      } else {
+         printf("Failed to write allowed values cache file %s\n", allowed_values_cache_file.c_str());
+      }
+   }
+}
+
+void CaenParameters::read_allowed_values(std::string full_param_path, std::vector<std::string> &allowed_values) {
    allowed_values.clear();
    full_param_path += "/allowedvalues";
 
    uint64_t handles[1000];
 
+   std::unique_lock<std::mutex> lock = lock_call();
+   num_felib_calls++;
    int num_children = CAEN_FELib_GetChildHandles(dev->get_root_handle(), full_param_path.c_str(), handles, 1000);
 
    for (int i = 0; i < num_children; i++) {
       char value[256] = {0};
+      num_felib_calls++;
       CAEN_FELib_GetValue(handles[i], "", value);
       allowed_values.push_back(value);
    }
 }
 
+void CaenParameters::set_enum(std::string full_param_path, std::string val) {
+   if (!writes_enabled) {
+      return;
+   }
+
+   std::vector<std::string> allowed;
+   get_allowed_values(full_param_path, allowed);
+
+   // If the board doesn't tell us the options, let it reject bad values itself.
+   // Some parameters (e.g. VetoSource) take several options separated by |;
+   // each must be allowed.
+   if (allowed.size()) {
+      for (auto& opt : split_string_options(val)) {
+         if (!validate_allowed_value(allowed, opt, full_param_path)) {
+            throw CaenSetParamException(full_param_path, "Invalid value provided");
+         }
+      }
+   }
+
+   set(full_param_path.c_str(), val.c_str());
+}
+
 std::string CaenParameters::get_dig_path(std::string param_name) {
    return "/par/" + param_name;
 }
@@ -404,11 +737,27 @@ std::string CaenParameters::get_all_chan_path(std::string param_name) {
    return "/ch/0..63/par/" + param_name;
 }
 
+std::string CaenParameters::get_chan_range_path(int first_chan, int last_chan, std::string param_name) {
+   if (first_chan == last_chan) {
+      return get_chan_path(first_chan, param_name);
+   }
+
+   char param_path[256];
+   snprintf(param_path, 255, "/ch/%d..%d/par/%s", first_chan, last_chan, param_name.c_str());
+   return param_path;
+}
+
 void CaenParameters::set_user_register(uint32_t reg, uint32_t val) {
+   if (!writes_enabled) {
+      return;
+   }
+
    if (debug) {
       printf("Setting user register 0x%x to %u on %s\n", reg, val, dev->get_name().c_str());
    }
 
+   std::unique_lock<std::mutex> lock = lock_call();
+   num_felib_calls++;
    int ret = CAEN_FELib_SetUserRegister(dev->get_root_handle(), reg, val);
 
    if (ret != CAEN_FELib_Success) {
@@ -442,6 +791,8 @@ template<> void CaenParameters::get_user_register<uint32_t>(uint32_t reg, uint32
       printf("Getting user register 0x%x from %s\n", reg, dev->get_name().c_str());
    }
 
+   std::unique_lock<std::mutex> lock = lock_call();
+   num_felib_calls++;
    int ret = CAEN_FELib_GetUserRegister(dev->get_root_handle(), reg, &val);
 
    if (ret != CAEN_FELib_Success) {
@@ -595,10 +946,14 @@ void CaenParameters::get_waveform_length_samples(uint32_t &nsamp) {
 }
 
 void CaenParameters::set_channel_enable_mask(uint32_t mask_31_0, uint32_t mask_63_32) {
-   for (DWORD i = 0; i < 32; i++) {
-      set_chan<bool>(i, "ChEnable", mask_31_0 & ((uint32_t)1<<i));
-      set_chan<bool>(i + 32, "ChEnable", mask_63_32 & ((uint32_t)1<<i));
+   uint64_t mask = ((uint64_t)mask_63_32 << 32) | mask_31_0;
+   std::vector<bool> enable(64);
+
+   for (int i = 0; i < 64; i++) {
+      enable[i] = mask & ((uint64_t)1<<i);
    }
+
+   set_chans("ChEnable", enable);
 }
 
 void CaenParameters::get_channel_enable_mask(uint32_t &mask_31_00, uint32_t &mask_63_32) {
@@ -621,9 +976,7 @@ void CaenParameters::get_channel_enable_mask(uint32_t &mask_31_00, uint32_t &mas
 }
 
 void CaenParameters::set_use_test_data_source(bool use_test_data) {
-   for (DWORD i = 0; i < 64; i++) {
-      set_chan(i, "WaveDataSource", std::string(use_test_data ? "ADC_TEST_SIN" : "ADC_DATA"));
-   }
+   set(get_all_chan_path("WaveDataSource"), std::string(use_test_data ? "ADC_TEST_SIN" : "ADC_DATA"));
 }
 
 void CaenParameters::set_enable_dc_offsets(bool enable) {
@@ -643,6 +996,14 @@ void CaenParameters::get_channel_dc_offset(int channel, float &dc_offset_pct) {
    get_chan(channel, "DcOffset", dc_offset_pct);
 }
 
+void CaenParameters::set_channel_dc_offsets(const std::vector<float>& dc_offset_pct, uint64_t chan_mask) {
+   set_chans("DcOffset", dc_offset_pct, chan_mask);
+}
+
+void CaenParameters::get_channel_dc_offsets(std::vector<float>& dc_offset_pct, uint64_t chan_mask) {
+   get_chans("DcOffset", dc_offset_pct, chan_mask);
+}
+
 void CaenParameters::set_pre_trigger_samples(uint16_t nsamp) {
    set_dig("PreTriggerS", nsamp);
 }
@@ -658,6 +1019,20 @@ void CaenParameters::set_channel_trigger_threshold(int channel, bool relative, i
    set_chan(channel, "SelfTriggerWidth", width_ns);
 }
 
+void CaenParameters::set_channel_trigger_thresholds(bool relative, const std::vector<int32_t>& threshold, const std::vector<bool>& rising_edge, const std::vector<uint32_t>& width_ns, uint64_t chan_mask) {
+   std::vector<std::string> thr_mode(threshold.size(), relative ? "Relative" : "Absolute");
+   std::vector<std::string> edge(rising_edge.size());
+
+   for (size_t i = 0; i < rising_edge.size(); i++) {
+      edge[i] = rising_edge[i] ? "RISE" : "FALL";
+   }
+
+   set_chans("TriggerThrMode", thr_mode, chan_mask);
+   set_chans("TriggerThr", threshold, chan_mask);
+   set_chans("SelfTriggerEdge", edge, chan_mask);
+   set_chans("SelfTriggerWidth", width_ns, chan_mask);
+}
+
 void CaenParameters::get_channel_trigger_threshold(int channel, bool& relative, int32_t &threshold, bool &rising_edge, uint32_t &width_ns) {
    get_chan(channel, "TriggerThr", threshold);
    get_chan(channel, "SelfTriggerWidth", width_ns);
@@ -765,14 +1140,7 @@ void CaenParameters::get_trigout_allowed_modes(std::vector<std::string>& modes)
 }
 
 void CaenParameters::set_trigout_mode(std::string mode) {
-   std::vector<std::string> allowed;
-   get_trigout_allowed_modes(allowed);
-
-   if (!validate_allowed_value(allowed, mode, "TrgOutMode")) {
-      throw CaenSetParamException(get_dig_path("TrgOutMode"), "Invalid value provided");
-   }
-
-   set_dig("TrgOutMode", mode);
+   set_enum(get_dig_path("TrgOutMode"), mode);
 }
 
 void CaenParameters::get_trigout_mode(std::string& mode) {
@@ -784,14 +1152,7 @@ void CaenParameters::get_trigger_id_allowed_modes(std::vector<std::string>& mode
 }
 
 void CaenParameters::set_trigger_id_mode(std::string mode) {
-   std::vector<std::string> allowed;
-   get_trigger_id_allowed_modes(allowed);
-
-   if (!validate_allowed_value(allowed, mode, "TriggerIDMode")) {
-      throw CaenSetParamException(get_dig_path("TriggerIDMode"), "Invalid value provided");
-   }
-
-   set_dig("TriggerIDMode", mode);
+   set_enum(get_dig_path("TriggerIDMode"), mode);
 }
 
 void CaenParameters::get_trigger_id_mode(std::string& mode) {
@@ -891,7 +1252,7 @@ void CaenParameters::get_enable_clock_out(bool &enable) {
 }
 
 void CaenParameters::set_gpio_mode(std::string mode) {
-   set_dig("GPIOMode", mode);
+   set_enum(get_dig_path("GPIOMode"), mode);
 }
 
 void CaenParameters::get_gpio_mode(std::string &mode) {
@@ -899,7 +1260,7 @@ void CaenParameters::get_gpio_mode(std::string &mode) {
 }
 
 void CaenParameters::set_busy_in_source(std::string source) {
-   set_dig("BusyInSource", source);
+   set_enum(get_dig_path("BusyInSource"), source);
 }
 
 void CaenParameters::get_busy_in_source(std::string &source) {
@@ -907,7 +1268,7 @@ void CaenParameters::get_busy_in_source(std::string &source) {
 }
 
 void CaenParameters::set_sync_out_mode(std::string source) {
-   set_dig("SyncOutMode", source);
+   set_enum(get_dig_path("SyncOutMode"), source);
 }
 
 void CaenParameters::get_sync_out_mode(std::string &source) {
@@ -931,7 +1292,7 @@ void CaenParameters::get_enable_trigger_overlap(bool &enable) {
 }
 
 void CaenParameters::set_veto_params(std::string source, bool active_high, uint32_t width_ns) {
-   set_dig("VetoSource", source);
+   set_enum(get_dig_path("VetoSource"), source);
    set_dig("VetoWidth", width_ns);
    set_dig("VetoPolarity", std::string(active_high ? "ActiveHigh" : "ActiveLow"));
 }
@@ -966,7 +1327,7 @@ void CaenParameters::get_test_pulse(double& period_ms, uint32_t& width_ns, uint1
 
 void CaenParameters::set_lvds_quartet_params(int quartet, bool is_input, std::string mode) {
    set_lvds(quartet, "LVDSDirection", std::string(is_input ? "Input" : "Output"));
-   set_lvds(quartet, "LVDSMode", mode);
+   set_enum(get_lvds_path(quartet, "LVDSMode"), mode);
 }
 
 void CaenParameters::get_lvds_quartet_params(int quartet, bool &is_input, std::string &mode) {
@@ -1027,8 +1388,8 @@ void CaenParameters::get_max_raw_bytes_per_read(uint32_t& num_bytes) {
 bool CaenParameters::validate_allowed_value(std::vector<std::string>& allowed, std::string requested, std::string param_name) {
    bool ok = false;
 
-   for (auto it : allowed) {
-      if (str_to_lower(it) == str_to_lower(requested)) {
+   for (auto& it : allowed) {
+      if (strcasecmp(it.c_str(), requested.c_str()) == 0) {
          ok = true;
          break;
       }
@@ -3,12 +3,22 @@
 
 #include "midas.h"
 #include "caen_device.h"
+#include "caen_device_tree.h"
 #include <inttypes.h>
 #include <stdlib.h>
 #include <map>
+#include <unordered_map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <vector>
 #include <exception>
 
+#define ALL_CHANNELS 0xFFFFFFFFFFFFFFFFull
+
+// Size of the buffer FELib writes parameter values into.
+#define CAEN_PARAM_VALUE_LEN 256
+
 class CaenParameters {
 public:
    CaenParameters() {}
@@ -16,6 +26,34 @@ public:
 
    void set_device(std::shared_ptr<CaenDevice> _dev) {
       dev = _dev;
+      clear_handle_cache();
+   }
+
+   // Forget the node handles we've looked up. They're only valid for the
+   // current connection, so VX2740::connect() and disconnect() call this.
+   void clear_handle_cache();
+
+   // Number of calls made to FELib since the last reset, for profiling.
+   // Atomic as fetch_values() makes calls from several threads.
+   uint64_t get_num_felib_calls() {
+      return num_felib_calls;
+   }
+
+   void reset_num_felib_calls() {
+      num_felib_calls = 0;
+   }
+
+   // If set, `mutex` is held for each FELib call (and not in between), so
+   // a connection can be shared between threads without one of them
+   // blocking the other for a whole sequence of reads.
+   void set_call_mutex(std::mutex* mutex) {
+      call_mutex = mutex;
+   }
+
+   // If disabled, all set functions silently do nothing (so the same
+   // code can be used to only read back and check a configuration).
+   void set_writes_enabled(bool enabled) {
+      writes_enabled = enabled;
    }
 
    void set_debug(bool _debug) {
@@ -26,9 +64,26 @@ public:
       debug = _debug;
    }
 
+   // The whole parameter tree, as returned by FELib.
    std::string get_param_list_json();
+
+   // Parse the parameter tree into `tree` (without values). One FELib call.
+   // Also fills the handle cache for every parameter in the tree.
+   void get_device_tree(CaenDeviceTree& tree);
+
+   // "path = value" for each node beneath `beneath`, one per line, sorted.
    std::string get_param_list_human(std::string beneath="", bool all_channels=false, std::map<std::string, std::vector<std::string>> extra_children={}, bool only_params=false);
 
+   // Every parameter that can be written back to the board (all channels),
+   // as (path, value) pairs in tree order. Network settings are excluded.
+   // LVDSTrgMask is returned once per line, as "<line>=<mask>".
+   void get_writable_params(std::vector<std::pair<std::string, std::string>>& params, std::string beneath="");
+
+   // Number of threads used to read values in the functions above.
+   void set_num_fetch_threads(int num) {
+      num_fetch_threads = num;
+   }
+
 
 
    // Firmware type - Scope or DPP_OPEN
@@ -83,6 +138,8 @@ public:
    void get_enable_dc_offsets(bool &enable);
    void set_channel_dc_offset(int channel, float dc_offset_pct);
    void get_channel_dc_offset(int channel, float &dc_offset_pct);
+   void set_channel_dc_offsets(const std::vector<float>& dc_offset_pct, uint64_t chan_mask=ALL_CHANNELS);
+   void get_channel_dc_offsets(std::vector<float>& dc_offset_pct, uint64_t chan_mask=ALL_CHANNELS);
 
    // Waveform pre-trigger.
    void set_pre_trigger_samples(uint16_t nsamp);
@@ -91,6 +148,7 @@ public:
    // Thresholds for "channel over threshold" trigger.
    void set_channel_trigger_threshold(int channel, bool relative, int32_t threshold, bool rising_edge, uint32_t width_ns);
    void get_channel_trigger_threshold(int channel, bool &relative, int32_t &threshold, bool &rising_edge, uint32_t &width_ns);
+   void set_channel_trigger_thresholds(bool relative, const std::vector<int32_t>& threshold, const std::vector<bool>& rising_edge, const std::vector<uint32_t>& width_ns, uint64_t chan_mask=ALL_CHANNELS);
 
    // Which channels can trigger in first "channel over threshold" trigger (ITLA).
    void set_channel_over_threshold_trigger_A_enable_mask(uint32_t multiplicity, uint32_t mask_31_0, uint32_t mask_63_32);
@@ -177,13 +235,19 @@ public:
 
    // Some parameters accept multiple options, separated by pipes (|).
    // This function creates a pipe-separated string from a vector of strings.
-   std::string merge_string_options(std::vector<std::string> opts);
-   std::vector<std::string> split_string_options(std::string opts);
+   static std::string merge_string_options(std::vector<std::string> opts);
+   static std::vector<std::string> split_string_options(std::string opts);
 
    // Low-level functions that work for any parameter
    template<typename T> void set(std::string full_param_path, T val) = delete;
    template<typename T> void get(std::string full_param_path, T& val) = delete;
 
+   // Versions for paths and values that are already C strings, which avoid
+   // creating std::string temporaries. `val` for get() must have room for
+   // CAEN_PARAM_VALUE_LEN chars; its initial content is passed to FELib.
+   void set(const char* full_param_path, const char* val);
+   void get(const char* full_param_path, char* val);
+
    template<typename T> void set_dig(std::string param_name, T val) {
       set(get_dig_path(param_name), val);
    }
@@ -198,6 +262,42 @@ public:
       get(get_chan_path(chan, param_name), val);
    }
 
+   // Set a parameter for every channel in `chan_mask` (vals indexed by channel).
+   // Consecutive channels with the same value are set in one call using a
+   // "/ch/N..M/par/X" range path.
+   template<typename T> void set_chans(std::string param_name, const std::vector<T>& vals, uint64_t chan_mask=ALL_CHANNELS) {
+      int num_chans = vals.size();
+      int first = 0;
+
+      while (first < num_chans) {
+         if (!(chan_mask & ((uint64_t)1 << first))) {
+            first++;
+            continue;
+         }
+
+         int last = first;
+
+         while (last + 1 < num_chans && (chan_mask & ((uint64_t)1 << (last + 1))) && vals[last + 1] == vals[first]) {
+            last++;
+         }
+
+         set(get_chan_range_path(first, last, param_name), (T)vals[first]);
+         first = last + 1;
+      }
+   }
+
+   // Read a parameter for every channel in `chan_mask`. FELib has no
+   // multi-value get, so this is one call per channel.
+   template<typename T> void get_chans(std::string param_name, std::vector<T>& vals, uint64_t chan_mask=ALL_CHANNELS) {
+      for (size_t c = 0; c < vals.size(); c++) {
+         if (chan_mask & ((uint64_t)1 << c)) {
+            T val = vals[c];
+            get(get_chan_path(c, param_name), val);
+            vals[c] = val;
+         }
+      }
+   }
+
    template<typename T> void set_lvds(int quartet, std::string param_name, T val) {
       set(get_lvds_path(quartet, param_name), val);
    }
@@ -215,11 +315,25 @@ public:
    std::string get_dig_path(std::string param_name);
    std::string get_chan_path(int chan, std::string param_name);
    std::string get_all_chan_path(std::string param_name);
+   std::string get_chan_range_path(int first_chan, int last_chan, std::string param_name);
    std::string get_lvds_path(int quartet, std::string param_name);
    std::string get_vga_path(int group, std::string param_name);
 
+   // Options for an enumerated parameter. Lists are cached per (model, firmware
+   // version, path) and shared between all boards, so the board is only asked
+   // once per process (or never, if a cache file is used).
    void get_allowed_values(std::string full_param_path, std::vector<std::string> &val);
 
+   // Set an enumerated parameter, first checking (case-insensitively) that
+   // the value is one of the allowed options (or, for parameters that take
+   // several, that each of the |-separated options is).
+   void set_enum(std::string full_param_path, std::string val);
+
+   // Also save allowed-value lists to a file, and load any already in it.
+   // Empty string means only cache in memory.
+   static void set_allowed_values_cache_file(std::string path);
+   static void clear_allowed_values_cache();
+
    // User registers
    void set_user_register(uint32_t reg, uint32_t val);
    template<typename T> void get_user_register(uint32_t reg, T& val) = delete;
@@ -233,10 +347,44 @@ public:
    static std::string str_to_lower(std::string str);
 
 protected:
+   // Get the FELib node handle for a parameter path. The first time a path is
+   // seen it's resolved with CAEN_FELib_GetHandle and cached, so later calls
+   // don't make FELib parse the path again. `rel_path` is set to the path to
+   // pass along with the returned handle ("" if we have a handle for the node
+   // itself, or the full path relative to the root if not).
+   uint64_t get_handle(const char* full_param_path, const char*& rel_path);
+
+   // Lock call_mutex (if set) until the returned lock goes out of scope.
+   std::unique_lock<std::mutex> lock_call() {
+      return call_mutex ? std::unique_lock<std::mutex>(*call_mutex) : std::unique_lock<std::mutex>();
+   }
+
+   // Ask the board for the options of an enumerated parameter.
+   void read_allowed_values(std::string full_param_path, std::vector<std::string> &val);
+
    bool validate_allowed_value(std::vector<std::string>& allowed, std::string requested, std::string param_name);
+   // Fill tree_buffer with the device tree JSON, growing it if needed.
+   // Returns the length of the JSON.
+   size_t read_device_tree_json();
+
+   // Walk the tree node by node. Only used for extra children that aren't in the device tree.
    std::vector<std::string> recurse_get_param_list_human(std::string base_path, bool all_channels, std::map<std::string, std::vector<std::string>> extra_children, bool only_params);
    std::shared_ptr<CaenDevice> dev = nullptr;
    bool debug = false;
+   std::atomic<uint64_t> num_felib_calls{0};
+   std::mutex* call_mutex = nullptr;
+   bool writes_enabled = true;
+   int num_fetch_threads = 4;
+
+   // Reused between calls, so we normally only need one GetDeviceTree call.
+   std::vector<char> tree_buffer;
+
+   // Parameter path -> node handle (0 if the path can't be resolved to a
+   // single node), for the current connection.
+   std::unordered_map<std::string, uint64_t> handle_cache;
+
+   // "model|firmware|" for keys in the allowed values cache.
+   std::string allowed_values_key_prefix;
 
    std::map<uint8_t, std::string> error_bit_to_text = {
       {0, "Power supply fail"},
@@ -0,0 +1,382 @@
+#include "caen_snapshot.h"
+#include "caen_exceptions.h"
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <iterator>
+
+namespace {
+   const char snapshot_magic[8] = {'V', 'X', 'S', 'N', 'A', 'P', 'S', 'H'};
+   const uint16_t no_channel = 0xFFFF;
+
+   uint32_t fnv1a(const char* data, size_t len) {
+      uint32_t hash = 2166136261u;
+
+      for (size_t i = 0; i < len; i++) {
+         hash ^= (uint8_t)data[i];
+         hash *= 16777619u;
+      }
+
+      return hash;
+   }
+
+   // If `path` is "/ch/N/par/X", set `chan` and `name` (to "X").
+   bool split_chan_path(const std::string& path, int& chan, std::string& name) {
+      int prefix_len = 0;
+
+      if (sscanf(path.c_str(), "/ch/%d/par/%n", &chan, &prefix_len) != 1 || prefix_len == 0 || chan < 0 || chan >= no_channel) {
+         return false;
+      }
+
+      name = path.substr(prefix_len);
+      return name.find('/') == std::string::npos;
+   }
+
+   template <class T> void put(std::string& buf, T val) {
+      buf.append((const char*)&val, sizeof(T));
+   }
+
+   void put_string(std::string& buf, const std::string& val) {
+      put<uint16_t>(buf, val.size());
+      buf.append(val);
+   }
+
+   // Reads values from a buffer, remembering if we ran off the end.
+   class Reader {
+   public:
+      Reader(const std::string& _buf, size_t _end) : buf(_buf), end(_end) {}
+
+      template <class T> T get() {
+         T val = 0;
+
+         if (pos + sizeof(T) > end) {
+            ok = false;
+            return val;
+         }
+
+         memcpy(&val, buf.data() + pos, sizeof(T));
+         pos += sizeof(T);
+         return val;
+      }
+
+      std::string get_string() {
+         uint16_t len = get<uint16_t>();
+
+         if (!ok || pos + len > end) {
+            ok = false;
+            return "";
+         }
+
+         pos += len;
+         return buf.substr(pos - len, len);
+      }
+
+      size_t remaining() {
+         return pos < end ? end - pos : 0;
+      }
+
+      bool ok = true;
+
+   protected:
+      const std::string& buf;
+      size_t end;
+      size_t pos = sizeof(snapshot_magic);
+   };
+}
+
+void CaenSnapshot::capture(CaenParameters& params_helper, const std::map<uint32_t, uint32_t>& _user_registers) {
+   params_helper.get_model_name(model_name);
+   params_helper.get_serial_number(serial_number);
+   params_helper.get_firmware_version(firmware_version);
+   params_helper.get_firmware_type(firmware_type);
+   params_helper.get_writable_params(params);
+   user_registers = _user_registers;
+}
+
+int CaenSnapshot::restore(CaenParameters& params_helper, const CaenSnapshot* current, std::string* errors, int* num_writes) {
+   std::set<std::pair<std::string, std::string>> already_set;
+   int num_failed = 0;
+   int num_ok = 0;
+
+   if (current) {
+      already_set.insert(current->params.begin(), current->params.end());
+   }
+
+   auto try_set = [&](const std::string& path, const std::string& value) {
+      try {
+         params_helper.set(path.c_str(), value.c_str());
+         num_ok++;
+      } catch (CaenException& e) {
+         num_failed++;
+
+         if (errors) {
+            *errors += std::string(e.what()) + "\n";
+         }
+      }
+   };
+
+   // Channel parameters from a contiguous block of the tree, grouped by name
+   // (in the order first seen), then by channel.
+   std::vector<std::string> chan_param_order;
+   std::map<std::string, std::map<int, std::string>> chan_params;
+
+   auto flush_chan_params = [&]() {
+      for (auto& name : chan_param_order) {
+         std::map<int, std::string>& vals = chan_params[name];
+         auto it = vals.begin();
+
+         while (it != vals.end()) {
+            auto last = it;
+            auto next = std::next(it);
+
+            while (next != vals.end() && next->first == last->first + 1 && next->second == it->second) {
+               last = next++;
+            }
+
+            try_set(params_helper.get_chan_range_path(it->first, last->first, name), it->second);
+            it = next;
+         }
+      }
+
+      chan_param_order.clear();
+      chan_params.clear();
+   };
+
+   for (auto& param : params) {
+      if (already_set.count(param)) {
+         continue;
+      }
+
+      int chan = 0;
+      std::string name;
+
+      if (split_chan_path(param.first, chan, name)) {
+         if (chan_params.find(name) == chan_params.end()) {
+            chan_param_order.push_back(name);
+         }
+
+         chan_params[name][chan] = param.second;
+      } else {
+         flush_chan_params();
+         try_set(param.first, param.second);
+      }
+   }
+
+   flush_chan_params();
+
+   for (auto& reg : user_registers) {
+      if (current) {
+         auto it = current->user_registers.find(reg.first);
+
+         if (it != current->user_registers.end() && it->second == reg.second) {
+            continue;
+         }
+      }
+
+      try {
+         params_helper.set_user_register(reg.first, reg.second);
+         num_ok++;
+      } catch (CaenException& e) {
+         num_failed++;
+
+         if (errors) {
+            *errors += std::string(e.what()) + "\n";
+         }
+      }
+   }
+
+   if (num_writes) {
+      *num_writes = num_ok;
+   }
+
+   return num_failed;
+}
+
+bool CaenSnapshot::save(std::string filename) {
+   std::string buf(snapshot_magic, sizeof(snapshot_magic));
+   put<uint32_t>(buf, CAEN_SNAPSHOT_VERSION);
+   put_string(buf, model_name);
+   put_string(buf, serial_number);
+   put_string(buf, firmware_version);
+   put_string(buf, firmware_type);
+   put_string(buf, tag);
+
+   // Each distinct name is stored once; entries refer to it by index.
+   std::vector<std::string> names;
+   std::map<std::string, uint16_t> name_idx;
+   std::vector<std::pair<uint16_t, uint16_t>> entries;
+
+   for (auto& param : params) {
+      int chan = 0;
+      std::string name;
+
+      if (!split_chan_path(param.first, chan, name)) {
+         chan = no_channel;
+         name = param.first;
+      }
+
+      auto it = name_idx.find(name);
+
+      if (it == name_idx.end()) {
+         it = name_idx.insert(std::make_pair(name, (uint16_t)names.size())).first;
+         names.push_back(name);
+      }
+
+      entries.push_back(std::make_pair((uint16_t)chan, it->second));
+   }
+
+   put<uint32_t>(buf, names.size());
+
+   for (auto& name : names) {
+      put_string(buf, name);
+   }
+
+   put<uint32_t>(buf, entries.size());
+
+   for (size_t i = 0; i < entries.size(); i++) {
+      put<uint16_t>(buf, entries[i].first);
+      put<uint16_t>(buf, entries[i].second);
+      put_string(buf, params[i].second);
+   }
+
+   put<uint32_t>(buf, user_registers.size());
+
+   for (auto& reg : user_registers) {
+      put<uint32_t>(buf, reg.first);
+      put<uint32_t>(buf, reg.second);
+   }
+
+   put<uint32_t>(buf, fnv1a(buf.data(), buf.size()));
+
+   // Write to a temporary file first, so a crash can't leave a truncated snapshot.
+   std::string tmp_filename = filename + ".tmp";
+   FILE* fp = fopen(tmp_filename.c_str(), "wb");
+
+   if (!fp) {
+      return false;
+   }
+
+   bool ok = (fwrite(buf.data(), 1, buf.size(), fp) == buf.size());
+   ok = (fclose(fp) == 0) && ok;
+
+   if (!ok || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+      remove(tmp_filename.c_str());
+      return false;
+   }
+
+   return true;
+}
+
+bool CaenSnapshot::load(std::string filename) {
+   FILE* fp = fopen(filename.c_str(), "rb");
+
+   if (!fp) {
+      return false;
+   }
+
+   std::string buf;
+   char chunk[65536];
+   size_t n = 0;
+
+   while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+      buf.append(chunk, n);
+   }
+
+   fclose(fp);
+
+   size_t min_size = sizeof(snapshot_magic) + 2 * sizeof(uint32_t);
+
+   if (buf.size() < min_size || memcmp(buf.data(), snapshot_magic, sizeof(snapshot_magic)) != 0) {
+      return false;
+   }
+
+   size_t payload_size = buf.size() - sizeof(uint32_t);
+   uint32_t checksum = 0;
+   memcpy(&checksum, buf.data() + payload_size, sizeof(uint32_t));
+
+   if (checksum != fnv1a(buf.data(), payload_size)) {
+      return false;
+   }
+
+   Reader rd(buf, payload_size);
+
+   if (rd.get<uint32_t>() != CAEN_SNAPSHOT_VERSION) {
+      return false;
+   }
+
+   CaenSnapshot snap;
+   snap.model_name = rd.get_string();
+   snap.serial_number = rd.get_string();
+   snap.firmware_version = rd.get_string();
+   snap.firmware_type = rd.get_string();
+   snap.tag = rd.get_string();
+
+   // Each name takes at least its 2-byte length, so a larger count can
+   // only come from a corrupt file; don't allocate for it.
+   uint32_t num_names = rd.get<uint32_t>();
+
+   if (!rd.ok || num_names > rd.remaining() / sizeof(uint16_t)) {
+      return false;
+   }
+
+   std::vector<std::string> names(num_names);
+
+   for (size_t i = 0; i < names.size() && rd.ok; i++) {
+      names[i] = rd.get_string();
+   }
+
+   uint32_t num_entries = rd.get<uint32_t>();
+
+   for (uint32_t i = 0; i < num_entries && rd.ok; i++) {
+      uint16_t chan = rd.get<uint16_t>();
+      uint16_t idx = rd.get<uint16_t>();
+      std::string value = rd.get_string();
+
+      if (idx >= names.size()) {
+         return false;
+      }
+
+      std::string path = names[idx];
+
+      if (chan != no_channel) {
+         path = "/ch/" + std::to_string(chan) + "/par/" + path;
+      }
+
+      snap.params.push_back(std::make_pair(path, value));
+   }
+
+   uint32_t num_regs = rd.get<uint32_t>();
+
+   for (uint32_t i = 0; i < num_regs && rd.ok; i++) {
+      uint32_t reg = rd.get<uint32_t>();
+      snap.user_registers[reg] = rd.get<uint32_t>();
+   }
+
+   if (!rd.ok) {
+      return false;
+   }
+
+   *this = snap;
+   return true;
+}
+
+bool CaenSnapshot::matches(std::string _model_name, std::string _serial_number, std::string _firmware_version) {
+   return model_name == _model_name && serial_number == _serial_number && firmware_version == _firmware_version;
+}
+
+std::string CaenSnapshot::get_filename(std::string dir, std::string _model_name, std::string _serial_number, std::string _firmware_version) {
+   std::string name = _model_name + "_" + _serial_number + "_" + _firmware_version + ".vxsnap";
+
+   // Firmware versions may contain characters we don't want in a filename.
+   for (auto& c : name) {
+      if (c == '/' || c == ' ') {
+         c = '_';
+      }
+   }
+
+   if (dir != "" && dir.back() != '/') {
+      dir += "/";
+   }
+
+   return dir + name;
+}
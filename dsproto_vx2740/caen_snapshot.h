@@ -0,0 +1,58 @@
+#ifndef CAEN_SNAPSHOT_H
+#define CAEN_SNAPSHOT_H
+
+#include "caen_parameters.h"
+#include <inttypes.h>
+#include <string>
+#include <vector>
+#include <map>
+
+// Bump if the file layout changes; older files are then ignored.
+#define CAEN_SNAPSHOT_VERSION 1
+
+// The full writable parameter state of one board (plus any user registers
+// the caller knows about), for putting a board back how it was after a
+// power-cycle. Saved in a compact binary format:
+//
+// "VXSNAPSH", version, then length-prefixed model/serial/firmware strings,
+// the table of distinct parameter names, one (channel, name index, value)
+// entry per parameter, the user registers, and a trailing checksum.
+// Channel parameters ("/ch/N/par/X") only store the name "X" once.
+class CaenSnapshot {
+public:
+   // Read everything from the board. Throws CaenException on failure.
+   void capture(CaenParameters& params, const std::map<uint32_t, uint32_t>& _user_registers={});
+
+   // Write everything to the board. If `current` is given, parameters that
+   // already have the same value there are skipped. Channel parameters
+   // that have the same value on consecutive channels are set with a single
+   // "/ch/N..M/par/X" write. Returns the number of parameters that failed
+   // to be set (and sets `errors`). `num_writes` is set to the number of
+   // successful writes (a channel range counts as one).
+   int restore(CaenParameters& params, const CaenSnapshot* current=nullptr, std::string* errors=nullptr, int* num_writes=nullptr);
+
+   // Return false if the file can't be written/read, or isn't a valid
+   // snapshot of the current version.
+   bool save(std::string filename);
+   bool load(std::string filename);
+
+   // Whether this snapshot was taken from a board of this type/firmware.
+   bool matches(std::string _model_name, std::string _serial_number, std::string _firmware_version);
+
+   // Standard name for a board's snapshot file within `dir`.
+   static std::string get_filename(std::string dir, std::string _model_name, std::string _serial_number, std::string _firmware_version);
+
+   std::string model_name;
+   std::string serial_number;
+   std::string firmware_version;
+   std::string firmware_type;
+
+   // Free-form string the caller can use to record what produced this state.
+   std::string tag;
+
+   // (path, value) pairs, in the order they should be written.
+   std::vector<std::pair<std::string, std::string>> params;
+   std::map<uint32_t, uint32_t> user_registers;
+};
+
+#endif
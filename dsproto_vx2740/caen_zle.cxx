@@ -0,0 +1,244 @@
+#include "caen_zle.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+   // A new segment costs up to 2 words (its header and padding), so gaps
+   // shorter than 3 words aren't worth suppressing.
+   const uint32_t min_gap_samples = 12;
+
+   uint32_t words_for_samples(uint32_t num_samples) {
+      return (num_samples + 3) / 4;
+   }
+}
+
+void CaenZleEncoder::configure(const CaenZleConfig& _config) {
+   config = _config;
+   config.thresholds_adc.resize(64, 0);
+}
+
+void CaenZleEncoder::reset() {
+   std::fill(baselines.begin(), baselines.end(), 0);
+   std::fill(have_baseline.begin(), have_baseline.end(), false);
+}
+
+uint32_t CaenZleEncoder::max_size_words(CaenEvent& event) {
+   int num_chans = __builtin_popcountll(event.header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (event.wf_end - event.wf_begin) / num_chans : 0;
+   uint32_t raw_words = event.wf_end - event.wf_begin + 3;
+
+   // Each channel's encoding is at most 3 words more than its samples.
+   return std::max(raw_words, 4 + num_chans * (words_per_chan + 3));
+}
+
+void CaenZleEncoder::update_baseline(int channel, const uint16_t* samples, uint32_t num_samples) {
+   uint32_t n = std::min(num_samples, config.baseline_samples);
+
+   if (n == 0) {
+      return;
+   }
+
+   double sum = 0;
+
+   for (uint32_t i = 0; i < n; i++) {
+      sum += samples[i];
+   }
+
+   double mean = sum / n;
+
+   if (!have_baseline[channel]) {
+      baselines[channel] = mean;
+      have_baseline[channel] = true;
+   } else {
+      // Follow slow drifts, but don't jump with noise.
+      baselines[channel] += (mean - baselines[channel]) / 8;
+   }
+}
+
+uint32_t CaenZleEncoder::encode(CaenEvent& event, uint64_t* buffer) {
+   CaenEventHeader header = event.header;
+   uint32_t raw_words = event.wf_end - event.wf_begin + 3;
+
+   if (header.format != 0x10) {
+      event.hencode(buffer);
+      return raw_words;
+   }
+
+   int num_chans = __builtin_popcountll(header.ch_enable_mask);
+   uint32_t words_per_chan = num_chans ? (event.wf_end - event.wf_begin) / num_chans : 0;
+   uint32_t num_samples = words_per_chan * 4;
+   uint64_t* out = buffer + 4;
+
+   chan_samples.resize(num_samples);
+
+   for (int chan = 0, chan_idx = 0; chan < 64; chan++) {
+      if (!(header.ch_enable_mask & ((uint64_t)1 << chan))) {
+         continue;
+      }
+
+      // Unpack this channel's samples (one word in every num_chans).
+      const uint64_t* in = event.wf_begin + chan_idx++;
+      uint16_t* samples = chan_samples.data();
+
+      for (uint32_t w = 0; w < words_per_chan; w++) {
+         uint64_t word = in[(size_t)w * num_chans];
+         samples[w*4 + 0] = word & 0xFFFF;
+         samples[w*4 + 1] = (word >> 16) & 0xFFFF;
+         samples[w*4 + 2] = (word >> 32) & 0xFFFF;
+         samples[w*4 + 3] = word >> 48;
+      }
+
+      if (!have_baseline[chan]) {
+         update_baseline(chan, samples, num_samples);
+      }
+
+      int baseline = (int)(baselines[chan] + 0.5);
+      int threshold = config.thresholds_adc[chan];
+      uint64_t* chan_word = out++;
+      uint32_t num_segments = 0;
+      uint32_t first_excursion = num_samples;
+
+      // Find the excursions and write the samples around them.
+      uint32_t seg_start = 0;
+      uint32_t seg_end = 0;
+      bool in_segment = false;
+
+      auto write_segment = [&]() {
+         uint32_t len = seg_end - seg_start;
+         *out++ = ((uint64_t)seg_start << 32) | len;
+
+         uint32_t num_words = words_for_samples(len);
+         out[num_words - 1] = 0;
+         memcpy(out, samples + seg_start, len * sizeof(uint16_t));
+         out += num_words;
+         num_segments++;
+      };
+
+      for (uint32_t i = 0; i < num_samples; i++) {
+         if (abs((int)samples[i] - baseline) <= threshold) {
+            continue;
+         }
+
+         first_excursion = std::min(first_excursion, i);
+         uint32_t start = (i > config.pre_samples) ? i - config.pre_samples : 0;
+         uint32_t end = std::min(num_samples, i + config.post_samples + 1);
+
+         if (in_segment && start <= seg_end + min_gap_samples) {
+            seg_end = std::max(seg_end, end);
+         } else {
+            if (in_segment) {
+               write_segment();
+            }
+
+            in_segment = true;
+            seg_start = start;
+            seg_end = end;
+         }
+      }
+
+      if (in_segment) {
+         write_segment();
+      }
+
+      *chan_word = ((uint64_t)(baseline & 0xFFFF) << 32) | num_segments;
+
+      // Only learn from the start of the waveform if it's quiet.
+      if (first_excursion >= config.baseline_samples) {
+         update_baseline(chan, samples, num_samples);
+      }
+   }
+
+   uint32_t size_words = out - buffer;
+
+   if (size_words >= raw_words) {
+      // Nothing to gain (e.g. every channel is busy); keep the original.
+      event.hencode(buffer);
+      return raw_words;
+   }
+
+   header.format = CAEN_ZLE_FORMAT;
+   header.size_64bit_words = size_words;
+   header.hencode(buffer);
+   buffer[3] = ((uint64_t)CAEN_ZLE_VERSION << 56) | num_samples;
+
+   return size_words;
+}
+
+CaenZleEvent::CaenZleEvent(const uint64_t* buffer, size_t size_words) {
+   if (size_words < 4) {
+      return;
+   }
+
+   header = CaenEventHeader((uint64_t*)buffer);
+
+   if (header.format != CAEN_ZLE_FORMAT || (buffer[3] >> 56) != CAEN_ZLE_VERSION || header.size_64bit_words > size_words) {
+      return;
+   }
+
+   samples_per_chan = buffer[3] & 0xFFFFFFFF;
+   const uint64_t* p = buffer + 4;
+   const uint64_t* end = buffer + header.size_64bit_words;
+
+   for (int chan = 0; chan < 64; chan++) {
+      if (!(header.ch_enable_mask & ((uint64_t)1 << chan))) {
+         continue;
+      }
+
+      if (p >= end) {
+         return;
+      }
+
+      baselines[chan] = (*p >> 32) & 0xFFFF;
+      uint32_t num_segments = *p++ & 0xFFFFFFFF;
+
+      for (uint32_t s = 0; s < num_segments; s++) {
+         if (p >= end) {
+            return;
+         }
+
+         Segment seg;
+         seg.first_sample = *p >> 32;
+         seg.num_samples = *p++ & 0xFFFFFFFF;
+         seg.samples = (const uint16_t*)p;
+
+         uint32_t num_words = words_for_samples(seg.num_samples);
+
+         if (seg.first_sample + seg.num_samples > samples_per_chan || p + num_words > end) {
+            return;
+         }
+
+         p += num_words;
+         segments[chan].push_back(seg);
+      }
+   }
+
+   valid = true;
+}
+
+bool CaenZleEvent::is_valid() {
+   return valid;
+}
+
+const std::vector<CaenZleEvent::Segment>& CaenZleEvent::get_segments(int channel) {
+   return segments[channel & 63];
+}
+
+uint16_t CaenZleEvent::get_baseline(int channel) {
+   return baselines[channel & 63];
+}
+
+uint32_t CaenZleEvent::get_channel_samples(int channel, std::vector<uint16_t>& samples) {
+   if (!valid || channel < 0 || channel >= 64 || !(header.ch_enable_mask & ((uint64_t)1 << channel))) {
+      samples.clear();
+      return 0;
+   }
+
+   samples.assign(samples_per_chan, baselines[channel]);
+
+   for (auto& seg : segments[channel]) {
+      memcpy(samples.data() + seg.first_sample, seg.samples, seg.num_samples * sizeof(uint16_t));
+   }
+
+   return samples_per_chan;
+}
@@ -0,0 +1,101 @@
+#ifndef CAEN_ZLE_H
+#define CAEN_ZLE_H
+
+#include "caen_event.h"
+#include <inttypes.h>
+#include <vector>
+
+// Format byte of zero-suppressed events (CAEN's own data events are 0x10).
+#define CAEN_ZLE_FORMAT 0x1A
+
+// Bump if the layout changes.
+#define CAEN_ZLE_VERSION 1
+
+// Settings for zero suppression of one board's scope waveforms.
+struct CaenZleConfig {
+   // Keep samples that differ from the channel's baseline by more than this.
+   std::vector<uint16_t> thresholds_adc = std::vector<uint16_t>(64, 100);
+
+   // Samples to keep before/after each excursion.
+   uint32_t pre_samples = 16;
+   uint32_t post_samples = 16;
+
+   // The baseline is updated from the start of each waveform, if no
+   // excursion is found there.
+   uint32_t baseline_samples = 16;
+};
+
+// Zero-length encoding of scope-mode events. Only the parts of each channel's
+// waveform around excursions from a running baseline are kept.
+//
+// Layout (in 64-bit words):
+// * 3 words - the usual event header, but with format CAEN_ZLE_FORMAT and
+//   size being that of the encoded event
+// * 1 word  - version in bits 63-56, samples per channel in bits 31-0
+// * then for each enabled channel, in ascending order:
+//   * 1 word - baseline in bits 47-32, number of segments in bits 31-0
+//   * for each segment, 1 word with the first sample in bits 63-32 and the
+//     number of samples in bits 31-0, followed by the samples packed 4 per
+//     word (earliest in the low bits; the last word is padded with zeros)
+//
+// Keeps state (the baselines), so use one encoder per board.
+class CaenZleEncoder {
+public:
+   void configure(const CaenZleConfig& _config);
+
+   // Forget the baselines (e.g. at the start of a run).
+   void reset();
+
+   // Largest encoded size of an event, in 64-bit words.
+   static uint32_t max_size_words(CaenEvent& event);
+
+   // Encode a scope-mode event into `buffer`, which must hold at least
+   // max_size_words(). Returns the number of words written. Events that
+   // aren't normal data events are copied unchanged.
+   uint32_t encode(CaenEvent& event, uint64_t* buffer);
+
+protected:
+   void update_baseline(int channel, const uint16_t* samples, uint32_t num_samples);
+
+   CaenZleConfig config;
+   std::vector<double> baselines = std::vector<double>(64, 0);
+   std::vector<bool> have_baseline = std::vector<bool>(64, false);
+
+   // Scratch space for one channel's samples, reused between events.
+   std::vector<uint16_t> chan_samples;
+};
+
+// Reader for events written by CaenZleEncoder::encode().
+struct CaenZleEvent {
+   struct Segment {
+      uint32_t first_sample;
+      uint32_t num_samples;
+      const uint16_t* samples; // Points into the buffer
+   };
+
+   CaenZleEvent(const uint64_t* buffer, size_t size_words);
+
+   // False if the buffer is truncated or of an unknown format/version.
+   bool is_valid();
+
+   // The kept parts of a channel's waveform. Empty if the channel wasn't
+   // read out or had no excursions.
+   const std::vector<Segment>& get_segments(int channel);
+
+   // Baseline the channel was suppressed relative to.
+   uint16_t get_baseline(int channel);
+
+   // The full waveform of a channel, with suppressed samples set to the
+   // baseline. Returns the number of samples (0 if the channel wasn't read).
+   uint32_t get_channel_samples(int channel, std::vector<uint16_t>& samples);
+
+   CaenEventHeader header;
+   uint32_t samples_per_chan = 0;
+
+protected:
+   std::vector<std::vector<Segment>> segments = std::vector<std::vector<Segment>>(64);
+   std::vector<uint16_t> baselines = std::vector<uint16_t>(64, 0);
+   bool valid = false;
+};
+
+#endif
@@ -54,13 +54,25 @@ ds.vx2740 = (function() {
     "User registers/Enable LVDS pair 12 trigger": "Trigger when signal seen on LVDS pair 12. Quartet 3 should be set to input and User mode.<br>NOT the same as 'Trigger on LVDS Sync signal'!",
     "User registers/Upper 32 mirror raw of lower 32": "Raw data for upper 32 channels should be same as lower 32 channels",
     "VGA gain": "0-40dB in 0.5dB increments<br>Group 0 affects channels 0-15, group 1 affects channels 16-31 etc.",
-    "Test pulse width (ns)": "Multiples of 8ns"
+    "Test pulse width (ns)": "Multiples of 8ns",
+    "Ring buffer size (MB)": "Host-side buffer for this board. Max 2000MB.<br>Size for the first run if 'Adaptive ring buffer sizes' is enabled.",
+    "Max event size (MB)": "Largest single read from the board. Max 320MB.",
+    "Compress waveforms (lossless)": "Done by the frontend. Delta-code and bit-pack each channel's waveform (P banks rather than D/C banks).",
+    "Zero suppression/Enable": "Done by the frontend. Only keep the parts of each waveform that go more than the threshold away from the channel's baseline (Z banks rather than D/C banks).",
+    "Zero suppression/Threshold (ADC)": "Relative to the baseline, which is tracked from the start of each quiet waveform",
+    "Pulse finding/Enable": "Done by the frontend. Find pulses in each waveform and integrate them like the user firmware does (H banks, followed by the waveforms' usual bank if they're kept).",
+    "Pulse finding/Waveform prescale (0=none)": "Keep the waveforms of 1 in this many events (1 keeps them all)",
+    "Pulse finding/Threshold (ADC)": "Relative to the baseline, which is the mean of the first few samples of each quiet waveform",
+    "Pulse finding/Qshort length (samples)": "From the threshold crossing. Rounded down to a multiple of 4"
   };
 
   let rdb_help_texts = {
     "LVDS IO register": "This reports the current LVDS state for both input quartets and output quartets.<br>The true state is reported regardless of the quartet mode.",
     "User registers/LVDS output": "This reports the LVDS state that would be output if all quartets were in output and User mode.",
     "User registers/LVDS input": "This reports the LVDS state for input quartets, regardless of the quartet mode.",
+    "Rates/Missed triggers": "Gaps in the event counter since the last update. Only meaningful if 'Trigger ID mode' is TriggerCnt.",
+    "Rates/Max trigger gap (us)": "Largest time between consecutive triggers since the last update.",
+    "Rates/RB full deadtime (pct)": "Fraction of time the frontend couldn't read from the board because its ring buffer was full.",
   };
 
   let display_names = {
@@ -267,6 +279,20 @@ ds.vx2740 = (function() {
       html += add_group_row("Debug settings", properties, as_checkbox);
       html += add_group_row("Debug ring buffers", properties, as_checkbox);
       html += add_group_row("Multi-threaded readout", properties, as_checkbox);
+      html += add_group_row("Write extended event ID bank", properties, as_checkbox);
+      html += add_group_row("Write channel-major data banks", properties, as_checkbox);
+      html += add_group_row("Adaptive ring buffer sizes", properties, as_checkbox);
+      html += add_group_row("Adaptive ring buffer max (MB) (0=configured size)", properties);
+      html += add_group_row("Only write changed settings", properties, as_checkbox);
+      html += add_group_row("Reset marker user register (0=none)", properties);
+      html += add_group_row("Readback verification (Full/Sampled/Deferred)", properties);
+      html += add_group_row("Stop run if deferred verification fails", properties, as_checkbox);
+      html += add_group_row("Allowed values cache file", properties);
+      html += add_group_row("Snapshot directory", properties);
+      html += add_group_row("Ring buffer budget (MB) (0=no limit)", properties);
+      html += add_group_row("Max parallel config threads (0=one per board)", properties);
+      html += add_group_row("Batch size (kB) (0=no batching)", properties);
+      html += add_group_row("Batch latency (ms)", properties);
     }
     
     html += '</tbody>';
@@ -401,6 +427,9 @@ ds.vx2740 = (function() {
       html += add_row("Enable", properties, one_checkbox);
       html += add_row("Read data", properties, one_checkbox), 
       html += add_row("Scope mode (restart on change)", properties, fmt_scope_mode);
+      html += add_row("Ring buffer size (MB)", properties);
+      html += add_row("Max event size (MB)", properties);
+      html += add_row("Compress waveforms (lossless)", properties, one_checkbox, only_scope);
   
       html += begin_section("Waveform readout", properties);
       html += add_row("Waveform length (samples)", properties, convert_ns, only_scope);
@@ -437,6 +466,21 @@ ds.vx2740 = (function() {
       html += add_row("Use relative trig thresholds", properties, one_checkbox, only_scope);
       html += add_row("Chan over thresh thresholds", properties, chan_arr, only_scope);
       html += add_row("Chan over thresh width (ns)", properties, chan_arr, only_scope);
+
+      html += begin_section("Zero suppression", properties, only_scope);
+      html += add_row("Zero suppression/Enable", properties, one_checkbox, only_scope);
+      html += add_row("Zero suppression/Pre samples", properties, fmt_default, only_scope);
+      html += add_row("Zero suppression/Post samples", properties, fmt_default, only_scope);
+      html += add_row("Zero suppression/Threshold (ADC)", properties, chan_arr, only_scope);
+
+      html += begin_section("Pulse finding", properties, only_scope);
+      html += add_row("Pulse finding/Enable", properties, one_checkbox, only_scope);
+      html += add_row("Pulse finding/Negative pulses", properties, one_checkbox, only_scope);
+      html += add_row("Pulse finding/Baseline samples", properties, fmt_default, only_scope);
+      html += add_row("Pulse finding/Waveform prescale (0=none)", properties, fmt_default, only_scope);
+      html += add_row("Pulse finding/Threshold (ADC)", properties, chan_arr, only_scope);
+      html += add_row("Pulse finding/Qshort length (samples)", properties, chan_arr, only_scope);
+      html += add_row("Pulse finding/Qlong length (samples)", properties, chan_arr, only_scope);
       
       html += begin_section("Darkside trigger", properties, only_dpp);
       html += add_row("User registers/Expert mode for trig settings", properties, fmt_expert_mode, only_dpp);
@@ -509,6 +553,16 @@ ds.vx2740 = (function() {
       html += add_row("Test pulse width (ns)", properties);
       html += add_row("Test pulse low level (ADC)", properties);
       html += add_row("Test pulse high level (ADC)", properties);
+
+      html += begin_section("Rates", properties);
+      html += add_readback_row("Rates/Event rate (Hz)", properties);
+      html += add_readback_row("Rates/Data rate (MB/s)", properties);
+      html += add_readback_row("Rates/Missed triggers", properties);
+      html += add_readback_row("Rates/Missed triggers (run)", properties);
+      html += add_readback_row("Rates/Mean trigger gap (us)", properties);
+      html += add_readback_row("Rates/Max trigger gap (us)", properties);
+      html += add_readback_row("Rates/Ring buffer fill (pct)", properties);
+      html += add_readback_row("Rates/RB full deadtime (pct)", properties);
     }
     
     html += '</tbody>';
@@ -570,7 +624,7 @@ ds.vx2740 = (function() {
     let help_html = help_texts.hasOwnProperty(name) ? "<br><div style='font-size:smaller;max-width:350px;font-style:italic'>" + help_texts[name] + "</small>" : "";
     let defaults_full_path = properties["defaults_odb_path"] + "/" + name;
 
-    let display_name = name.replace("User registers/", "");
+    let display_name = name.replace("User registers/", "").replace("Zero suppression/", "").replace("Pulse finding/", "");
 
     if (display_names.hasOwnProperty(name)) {
       display_name = display_names[name];
@@ -641,7 +695,7 @@ ds.vx2740 = (function() {
     let row_id = "board_row_" + num_group_board_rows;
     let help_html = rdb_help_texts.hasOwnProperty(name) ? "<br><div style='font-size:smaller;max-width:350px;font-style:italic'>" + rdb_help_texts[name] + "</small>" : "";
 
-    let display_name = name.replace("User registers/", "");
+    let display_name = name.replace("User registers/", "").replace("Rates/", "");
 
     if (display_names.hasOwnProperty(name)) {
       display_name = display_names[name];
@@ -54,13 +54,29 @@ class VX2740Data:
 
     Members if format is NOT 0x10 (special events):
         * data (list of int) - The raw data
-    
+
+    If `channel_major` is True, `data` is from a "C" bank, where each channel's
+    samples are already contiguous (see CaenChannelMajorEvent in caen_event.h).
+
+    Data from "Z" banks (format 0x1A, zero-suppressed by the frontend; see
+    caen_zle.h) is expanded, with suppressed samples set to the channel's
+    baseline. `format` is then reported as 0x10, `zero_suppressed` is True,
+    and `baselines` maps channel number to baseline.
+
+    Data from "P" banks (format 0x1C, losslessly compressed by the frontend;
+    see caen_packing.h) is decompressed. `format` is then reported as 0x10
+    and `compressed` is True.
     """
-    def __init__(self, fe_id, board_id, data):
+    def __init__(self, fe_id, board_id, data, channel_major=False):
         self.fe_id = fe_id
         self.board_id = board_id
         self.format = (data[0] >> 56) & 0xFF
-        
+        self.zero_suppressed = (self.format == 0x1A)
+        self.compressed = (self.format == 0x1C)
+
+        if self.zero_suppressed or self.compressed:
+            self.format = 0x10
+
         if self.format == 0x10:
             self.event_counter = (data[0] >> 32) & 0xFFFFFF
             self.size_64bit_words = data[0] & 0xFFFFFFFF
@@ -72,6 +88,83 @@ class VX2740Data:
             chan_enable_mask = data[2]
             self.channels_enabled = [c for c in range(64) if chan_enable_mask & (0x1<<c)]
             
+            if self.zero_suppressed:
+                if (data[3] >> 56) != 1:
+                    raise ValueError("Unknown zero-suppressed bank version %d" % (data[3] >> 56))
+
+                num_samples_per_chan = data[3] & 0xFFFFFFFF
+                self.waveforms = {}
+                self.baselines = {}
+                pos = 4
+
+                for chan in self.channels_enabled:
+                    baseline = (data[pos] >> 32) & 0xFFFF
+                    num_segments = data[pos] & 0xFFFFFFFF
+                    pos += 1
+                    wf = [baseline] * num_samples_per_chan
+
+                    for s in range(num_segments):
+                        first = data[pos] >> 32
+                        num = data[pos] & 0xFFFFFFFF
+                        num_words = (num + 3) // 4
+                        samples = [(w >> shift) & 0xFFFF for w in data[pos + 1:pos + 1 + num_words] for shift in (0, 16, 32, 48)]
+                        wf[first:first + num] = samples[:num]
+                        pos += 1 + num_words
+
+                    self.waveforms[chan] = wf
+                    self.baselines[chan] = baseline
+
+                return
+
+            if self.compressed:
+                if (data[3] >> 56) != 1:
+                    raise ValueError("Unknown compressed bank version %d" % (data[3] >> 56))
+
+                num_samples_per_chan = data[3] & 0xFFFFFFFF
+                num_blocks = (num_samples_per_chan + 63) // 64
+                self.waveforms = {}
+                pos = 4
+
+                for chan in self.channels_enabled:
+                    prev = data[pos] & 0xFFFF
+                    num_chan_words = data[pos] >> 32
+                    widths = [(data[pos + 1 + b // 8] >> (8 * (b % 8))) & 0xFF for b in range(num_blocks)]
+                    block_pos = pos + 1 + (num_blocks + 7) // 8
+                    wf = []
+
+                    for width in widths:
+                        # 64 zigzagged deltas of `width` bits each
+                        bits = 0
+
+                        for w in range(width):
+                            bits |= data[block_pos + w] << (64 * w)
+
+                        for j in range(64):
+                            z = (bits >> (j * width)) & ((1 << width) - 1)
+                            prev = (prev + ((z >> 1) ^ -(z & 1))) & 0xFFFF
+                            wf.append(prev)
+
+                        block_pos += width
+
+                    self.waveforms[chan] = wf[:num_samples_per_chan]
+                    pos += 1 + num_chan_words
+
+                return
+
+            if channel_major:
+                # Version in bits 63-56 of word 3; samples per channel in bits 31-0.
+                if (data[3] >> 56) != 1:
+                    raise ValueError("Unknown channel-major bank version %d" % (data[3] >> 56))
+
+                num_words_per_chan = (data[3] & 0xFFFFFFFF) // 4
+                self.waveforms = {}
+
+                for c_idx, chan in enumerate(self.channels_enabled):
+                    start = 4 + c_idx * num_words_per_chan
+                    self.waveforms[chan] = [(w >> shift) & 0xFFFF for w in data[start:start + num_words_per_chan] for shift in (0, 16, 32, 48)]
+
+                return
+
             num_header_words = 3
             num_samples_per_chan = (self.size_64bit_words - num_header_words) * 4
             
@@ -110,6 +203,93 @@ class VX2740Data:
         else:
             print("  Event of unhandled format 0x%x for board %03d/%02d" % (self.format, self.fe_id, self.board_id))
 
+class VX2740Hits:
+    """
+    Pulses found by the frontend in a scope-mode event ("H" banks, format
+    0x1E; see caen_hits.h). If the waveforms were kept, they're in the
+    board's usual bank in the same midas event.
+
+    Members:
+        * fe_id (int) - Frontend index of the program that acquired the data
+        * board_id (int) - Board index within the frontend index
+        * format (int) - 0x1E
+        * event_counter (int) - As for VX2740Data
+        * trigger_time_ticks (int) - Time since start of run in ticks of the 125MHz clock
+        * trigger_time_secs (float) - Time since start of run in seconds
+        * hits_dropped (bool) - Too many hits; only the first ones were kept
+        * waveform_dropped (bool) - Waveforms weren't kept due to lack of space
+        * hits (list of dict) - Each with "channel", "first_sample",
+            "baseline", "qshort", "qlong", "truncated" and "old_baseline"
+    """
+    def __init__(self, fe_id, board_id, data):
+        self.fe_id = fe_id
+        self.board_id = board_id
+        self.format = (data[0] >> 56) & 0xFF
+        self.event_counter = (data[0] >> 32) & 0xFFFFFF
+        self.trigger_time_ticks = data[1] & 0xFFFFFFFFFFFF
+        self.trigger_time_secs = self.trigger_time_ticks / 125e6
+
+        if (data[3] >> 56) != 1:
+            raise ValueError("Unknown hits bank version %d" % (data[3] >> 56))
+
+        flags = (data[3] >> 48) & 0xFF
+        self.hits_dropped = bool(flags & 0x1)
+        self.waveform_dropped = bool(flags & 0x2)
+        self.hits = []
+
+        for i in range(data[3] & 0xFFFFFFFF):
+            a = data[4 + 2 * i]
+            b = data[5 + 2 * i]
+            qshort = b & 0xFFFFFFFF
+            qlong = b >> 32
+
+            self.hits.append({"channel": a >> 56,
+                              "first_sample": a & 0xFFFFFFFF,
+                              "baseline": (a >> 32) & 0xFFFF,
+                              "qshort": qshort - (1 << 32) if qshort & 0x80000000 else qshort,
+                              "qlong": qlong - (1 << 32) if qlong & 0x80000000 else qlong,
+                              "truncated": bool((a >> 48) & 0x1),
+                              "old_baseline": bool((a >> 48) & 0x2)})
+
+    def dump_summary(self):
+        print("  Hits for trigger # %d for board %03d/%02d" % (self.event_counter, self.fe_id, self.board_id))
+        print("    Trigger time: %.6fs" % self.trigger_time_secs)
+        print("    %d hits%s%s" % (len(self.hits), " (some dropped)" if self.hits_dropped else "", ", waveforms dropped" if self.waveform_dropped else ""))
+
+        for hit in self.hits[:10]:
+            print("    Chan %d at sample %d: Qshort %d, Qlong %d (baseline %d)" % (hit["channel"], hit["first_sample"], hit["qshort"], hit["qlong"], hit["baseline"]))
+
+def batch_to_vx2740(fe_id, board_id, data):
+    """
+    Split a "B" bank (several events from one board, back to back; written
+    when "Batch size (kB)" is set) into `VX2740Data`/`VX2740Hits` objects.
+    Waveforms kept with hits come straight after the `VX2740Hits` object.
+    """
+    retval = []
+    pos = 0
+
+    while pos < len(data):
+        size = data[pos] & 0xFFFFFFFF
+
+        if size < 3 or pos + size > len(data):
+            raise ValueError("Corrupt batch bank for board %03d/%02d at word %d" % (fe_id, board_id, pos))
+
+        event = data[pos:pos + size]
+
+        if (event[0] >> 56) & 0xFF == 0x1E:
+            hits = VX2740Hits(fe_id, board_id, event)
+            retval.append(hits)
+            hits_size = 4 + 2 * len(hits.hits)
+
+            if hits_size < size:
+                retval.append(VX2740Data(fe_id, board_id, event[hits_size:]))
+        else:
+            retval.append(VX2740Data(fe_id, board_id, event))
+
+        pos += size
+
+    return retval
+
 def midas_to_vx2740(ev):
     """
     Args:
@@ -117,7 +297,9 @@ def midas_to_vx2740(ev):
     * ev (`midas.event.MidasEvent`)
 
     Returns:
-        list of `VX2740Data` objects, one per board.
+        list of `VX2740Data` objects, one per board, plus `VX2740Hits`
+        objects for boards that had pulse finding enabled. If events were
+        batched, there are several per board, in the order they were read.
     """
     if ev is None or ev.header.is_midas_internal_event():
         # Not a data event
@@ -127,16 +309,20 @@ def midas_to_vx2740(ev):
     fe_id = ev.header.trigger_mask
     
     for bank in ev.banks.values():
-        if bank.name.startswith("D"):
+        if bank.name[0] in ("D", "C", "Z", "P", "H", "B"):
             try:
-                # Extract board ID for banks named D001 etc
-                board_id = int(bank.name.replace("D", ""))
+                # Extract board ID for banks named D001/C001/Z001/P001/H001/B001 etc
+                board_id = int(bank.name[1:])
             except ValueError:
-                # Some other bank starting with D...
+                # Some other bank starting with D/C/Z/P/H/B...
                 continue
             
-            parsed_data = VX2740Data(fe_id, board_id, bank.data)
-            vx_data.append(parsed_data)
+            if bank.name.startswith("B"):
+                vx_data.extend(batch_to_vx2740(fe_id, board_id, bank.data))
+            elif bank.name.startswith("H"):
+                vx_data.append(VX2740Hits(fe_id, board_id, bank.data))
+            else:
+                vx_data.append(VX2740Data(fe_id, board_id, bank.data, bank.name.startswith("C")))
     
     return vx_data
 
@@ -0,0 +1,235 @@
+#include "fe_logger.h"
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#define FE_LOG_QUEUE_LEN 1024 // Must be a power of 2
+#define FE_LOG_MAX_MSG_LEN 10000 // As ts_printf() has always allowed
+
+std::atomic<int> fe_log::current_level{(int)fe_log::Level::Info};
+
+namespace {
+   // Bounded MPSC queue (based on Dmitry Vyukov's bounded MPMC queue).
+   // Each slot's sequence number says whether it is free for producer
+   // `pos` (seq == pos) or holds a message for the consumer (seq == pos + 1).
+   struct LogSlot {
+      std::atomic<size_t> seq;
+      int64_t timestamp_us;
+      char text[FE_LOG_MAX_MSG_LEN];
+   };
+
+   class AsyncLogger {
+   public:
+      AsyncLogger() {
+         for (size_t i = 0; i < FE_LOG_QUEUE_LEN; i++) {
+            slots[i].seq.store(i, std::memory_order_relaxed);
+         }
+
+         thread = std::thread(&AsyncLogger::run, this);
+      }
+
+      void enqueue(fe_log::Level level, const char *format, va_list args) {
+         size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+         LogSlot* slot = NULL;
+
+         // Keep the last quarter of the queue for more important messages,
+         // so a flood of debug output can't hide them.
+         if (level < fe_log::Level::Info && pos - dequeue_pos_pub.load(std::memory_order_relaxed) > FE_LOG_QUEUE_LEN * 3 / 4) {
+            num_dropped++;
+            return;
+         }
+
+         while (true) {
+            slot = &slots[pos & (FE_LOG_QUEUE_LEN - 1)];
+            size_t seq = slot->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+               if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                  break;
+               }
+            } else if (diff < 0) {
+               // Queue is full
+               num_dropped++;
+               return;
+            } else {
+               pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+         }
+
+         slot->timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+         vsnprintf(slot->text, FE_LOG_MAX_MSG_LEN, format, args);
+         slot->seq.store(pos + 1, std::memory_order_release);
+
+         if (consumer_sleeping.load(std::memory_order_relaxed)) {
+            cv.notify_one();
+         }
+      }
+
+      void flush() {
+         size_t target = enqueue_pos.load(std::memory_order_acquire);
+
+         while (dequeue_pos_pub.load(std::memory_order_acquire) < target) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+         }
+      }
+
+      void stop() {
+         flush();
+         stopping = true;
+         cv.notify_one();
+
+         if (thread.joinable()) {
+            thread.join();
+         }
+      }
+
+      std::atomic<uint64_t> num_dropped{0};
+
+   protected:
+      void run() {
+         while (true) {
+            bool any = false;
+
+            while (dequeue_one()) {
+               any = true;
+            }
+
+            if (any) {
+               fflush(stdout);
+               continue;
+            }
+
+            if (stopping) {
+               break;
+            }
+
+            // Producers only notify if we're sleeping; the timeout covers
+            // the race between them checking and us starting to wait.
+            std::unique_lock<std::mutex> lock(mutex);
+            consumer_sleeping = true;
+            cv.wait_for(lock, std::chrono::milliseconds(10));
+            consumer_sleeping = false;
+         }
+      }
+
+      bool dequeue_one() {
+         LogSlot& slot = slots[dequeue_pos & (FE_LOG_QUEUE_LEN - 1)];
+
+         if (slot.seq.load(std::memory_order_acquire) != dequeue_pos + 1) {
+            return false;
+         }
+
+         print_message(slot.timestamp_us, slot.text);
+
+         slot.seq.store(dequeue_pos + FE_LOG_QUEUE_LEN, std::memory_order_release);
+         dequeue_pos++;
+         dequeue_pos_pub.store(dequeue_pos, std::memory_order_release);
+         return true;
+      }
+
+      void print_message(int64_t timestamp_us, const char* text) {
+         time_t secs = timestamp_us / 1000000;
+         int milli = (timestamp_us / 1000) % 1000;
+
+         // Only redo the (slow) broken-down time formatting once per second.
+         if (secs != last_formatted_secs) {
+            tm buf;
+            strftime(formatted_time, sizeof(formatted_time), "%Y-%m-%d %H:%M:%S", localtime_r(&secs, &buf));
+            last_formatted_secs = secs;
+         }
+
+         printf("%s.%03d %s", formatted_time, milli, text);
+      }
+
+      LogSlot slots[FE_LOG_QUEUE_LEN];
+      std::atomic<size_t> enqueue_pos{0};
+      size_t dequeue_pos = 0;
+      std::atomic<size_t> dequeue_pos_pub{0};
+
+      std::thread thread;
+      std::mutex mutex;
+      std::condition_variable cv;
+      std::atomic<bool> consumer_sleeping{false};
+      std::atomic<bool> stopping{false};
+
+      time_t last_formatted_secs = -1;
+      char formatted_time[80] = {};
+   };
+
+   AsyncLogger* logger = NULL;
+   std::once_flag logger_once;
+
+   void stop_logger() {
+      logger->stop();
+   }
+
+   AsyncLogger& get_logger() {
+      // Never deleted, so it's safe to log from static destructors;
+      // the atexit handler prints anything still queued.
+      std::call_once(logger_once, []() {
+         logger = new AsyncLogger();
+         atexit(stop_logger);
+      });
+
+      return *logger;
+   }
+}
+
+void fe_log::set_level(Level level) {
+   current_level = (int)level;
+}
+
+fe_log::Level fe_log::get_level() {
+   return (Level)current_level.load();
+}
+
+void fe_log::log(Level level, const char *format, ...) {
+   if (!would_log(level)) {
+      return;
+   }
+
+   va_list args;
+   va_start(args, format);
+   get_logger().enqueue(level, format, args);
+   va_end(args);
+}
+
+void fe_log::vlog(Level level, const char *format, va_list args) {
+   if (!would_log(level)) {
+      return;
+   }
+
+   get_logger().enqueue(level, format, args);
+}
+
+void fe_log::flush() {
+   get_logger().flush();
+}
+
+uint64_t fe_log::get_num_dropped() {
+   return get_logger().num_dropped;
+}
+
+bool fe_log::RateLimiter::allow(uint64_t& num_suppressed) {
+   int64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   int64_t start_ms = window_start_ms.load(std::memory_order_relaxed);
+   num_suppressed = 0;
+
+   if (now_ms - start_ms >= 1000 && window_start_ms.compare_exchange_strong(start_ms, now_ms)) {
+      // New window
+      count_in_window = 0;
+      num_suppressed = suppressed.exchange(0);
+   }
+
+   if (count_in_window.fetch_add(1, std::memory_order_relaxed) < max_per_sec) {
+      return true;
+   }
+
+   suppressed++;
+   return false;
+}
@@ -0,0 +1,81 @@
+#ifndef FE_LOGGER_H
+#define FE_LOGGER_H
+
+#include <atomic>
+#include <cstdarg>
+#include <inttypes.h>
+
+// Asynchronous logging for the frontend. Callers format their message
+// straight into a slot of a lock-free queue and return; a background
+// thread adds the timestamp and does the actual printing. If the queue
+// is full the message is dropped (and counted) rather than blocking the
+// caller, so logging from the readout threads can't stall data taking.
+namespace fe_log {
+   enum class Level {
+      Debug = 0,
+      Info = 1,
+      Warning = 2,
+      Error = 3
+   };
+
+   /**
+    * Messages below this level are discarded before being formatted.
+    */
+   void set_level(Level level);
+   Level get_level();
+
+   /**
+    * Queue a printf-style message. Never blocks.
+    */
+   void log(Level level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+   void vlog(Level level, const char *format, va_list args);
+
+   /**
+    * Wait until everything queued so far has been printed.
+    */
+   void flush();
+
+   /**
+    * Number of messages dropped because the queue was full.
+    */
+   uint64_t get_num_dropped();
+
+   /**
+    * Allows at most `max_per_sec` messages per second. Use via the
+    * FE_LOG_RATE_LIMITED macro, which gives each call site its own limiter.
+    */
+   class RateLimiter {
+   public:
+      RateLimiter(int _max_per_sec) : max_per_sec(_max_per_sec) {}
+
+      // Returns true if this message should be logged. If messages were
+      // suppressed since the last one allowed, `num_suppressed` says how many.
+      bool allow(uint64_t& num_suppressed);
+
+   protected:
+      int max_per_sec;
+      std::atomic<int64_t> window_start_ms{-1};
+      std::atomic<int> count_in_window{0};
+      std::atomic<uint64_t> suppressed{0};
+   };
+
+   extern std::atomic<int> current_level;
+
+   inline bool would_log(Level level) {
+      return (int)level >= current_level.load(std::memory_order_relaxed);
+   }
+};
+
+#define FE_LOG_RATE_LIMITED(max_per_sec, level, ...) \
+   do { \
+      static fe_log::RateLimiter fe_log_limiter_(max_per_sec); \
+      uint64_t fe_log_suppressed_ = 0; \
+      if (fe_log::would_log(level) && fe_log_limiter_.allow(fe_log_suppressed_)) { \
+         if (fe_log_suppressed_) { \
+            fe_log::log(level, "(suppressed %" PRIu64 " similar messages)\n", fe_log_suppressed_); \
+         } \
+         fe_log::log(level, __VA_ARGS__); \
+      } \
+   } while (0)
+
+#endif
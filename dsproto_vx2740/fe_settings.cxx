@@ -4,28 +4,56 @@
 #include "midas.h"
 #include <numeric>
 #include <cmath>
+#include <chrono>
+#include <sstream>
 
 void VX2740FeSettings::set_board_firmware_info(int board_id, std::string firmware_version, std::string model_name) {
-   board_readback[board_id].strings.at("Firmware version") = firmware_version;
-   board_readback[board_id].strings.at("Model name") = model_name;
+   board_readback[board_id].strings[StringParam::FIRMWARE_VERSION] = firmware_version;
+   board_readback[board_id].strings[StringParam::MODEL_NAME] = model_name;
 }
 
 void VX2740FeSettings::set_board_user_firmware_info(int board_id, uint32_t user_fw_version, uint32_t user_reg_revision, bool user_upper_32_mirror_lower_32) {
-   board_readback[board_id].uint32s.at("User FW revision") = user_fw_version;
-   board_readback[board_id].uint32s.at("User register revision") = user_reg_revision;
-   board_readback[board_id].bools.at("Upper 32 mirror raw of lower 32") = user_upper_32_mirror_lower_32;
+   board_readback[board_id].uint32s[Uint32Param::USER_FW_REVISION] = user_fw_version;
+   board_readback[board_id].uint32s[Uint32Param::USER_REGISTER_REVISION] = user_reg_revision;
+   board_readback[board_id].bools[BoolParam::UPPER_32_MIRROR_RAW_OF_LOWER_32] = user_upper_32_mirror_lower_32;
 }
 
 void VX2740FeSettings::set_lvds_readback(int board_id, uint16_t lvds_ioreg, uint32_t lvds_userreg_out, uint32_t lvds_userreg_in) {
-   board_readback[board_id].uint16s.at("LVDS IO register") = lvds_ioreg;
-   board_readback[board_id].uint16s.at("User registers/LVDS output") = lvds_userreg_out;
-   board_readback[board_id].uint32s.at("User registers/LVDS input") = lvds_userreg_in;
+   board_readback[board_id].uint16s[Uint16Param::LVDS_IO_REGISTER] = lvds_ioreg;
+   board_readback[board_id].uint16s[Uint16Param::UREG_LVDS_OUTPUT] = lvds_userreg_out;
+   board_readback[board_id].uint32s[Uint32Param::UREG_LVDS_INPUT] = lvds_userreg_in;
+}
+
+void VX2740FeSettings::set_rates_readback(int board_id, const std::vector<double>& rates) {
+#define VX2740_RATE_ID(unused, id, ...) DoubleParam::id,
+   static const DoubleParam rate_ids[] = { VX2740_RATE_READBACK(VX2740_RATE_ID, _) };
+#undef VX2740_RATE_ID
+
+   for (size_t i = 0; i < rates.size() && i < sizeof(rate_ids) / sizeof(rate_ids[0]); i++) {
+      board_readback[board_id].doubles[rate_ids[i]] = rates[i];
+   }
 }
 
 void VX2740FeSettings::set_board_errors(int board_id, BoardErrors& err) {
    board_errors[board_id] = err;
 }
 
+uint64_t VX2740FeSettings::get_expected_event_size_bytes(int board_id) {
+   BoardSettings& set = board_settings[board_id];
+   uint64_t mask = set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_LO] | ((uint64_t)set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_HI] << 32);
+   uint64_t num_words = 3; // Header
+
+   for (int chan = 0; chan < 64; chan++) {
+      if (mask & ((uint64_t)1 << chan)) {
+         // 4 16-bit samples per 64-bit word. The user firmware has a length per channel.
+         uint64_t len = is_scope_mode(board_id) ? set.uint32s[Uint32Param::WAVEFORM_LENGTH_SAMPLES] : set.vec_uint16s[VecUint16Param::UREG_WAVEFORM_LENGTH_SAMPLES][chan];
+         num_words += (len + 3) / 4;
+      }
+   }
+
+   return num_words * sizeof(uint64_t);
+}
+
 std::vector<int> VX2740FeSettings::get_boards_enabled() {
    std::vector<int> retval;
 
@@ -42,7 +70,7 @@ std::vector<int> VX2740FeSettings::get_boards_to_read_from() {
    std::vector<int> retval;
 
    for (auto& b : board_settings) {
-      if (is_board_enabled(b.first) && b.second.bools.at("Read data")) {
+      if (is_board_enabled(b.first) && b.second.bools[BoolParam::READ_DATA]) {
          retval.push_back(b.first);
       }
    }
@@ -50,11 +78,51 @@ std::vector<int> VX2740FeSettings::get_boards_to_read_from() {
    return retval;
 }
 
+RunConfig VX2740FeSettings::freeze_run_config() {
+   RunConfig cfg;
+
+   for (auto i : get_boards_enabled()) {
+      cfg.boards_enabled.set(i);
+      cfg.boards_enabled_list.push_back(i);
+   }
+
+   for (auto i : get_boards_to_read_from()) {
+      cfg.boards_to_read.set(i);
+      cfg.boards_to_read_list.push_back(i);
+   }
+
+   for (int i = 0; i < get_num_boards(); i++) {
+      cfg.read_data_timeout_ms.push_back(get_read_data_timeout(i));
+   }
+
+   cfg.merge_data = merge_data();
+   cfg.debug_data = debug_data();
+   cfg.debug_rates = debug_rates();
+   cfg.debug_ring_buffers = debug_ring_buffers();
+   cfg.multithreaded_readout = multithreaded_readout();
+   cfg.write_extended_ids = write_extended_ids();
+   cfg.channel_major_banks = channel_major_banks();
+   cfg.batch_size_bytes = (size_t)get_batch_size_kb() * 1000;
+   cfg.batch_latency_ms = get_batch_latency_ms();
+
+   return cfg;
+}
+
 void VX2740FeSettings::sync_settings_structs() {
-   strategy->fill_group_settings_struct(group_settings);
+   // The strategy only re-reads what changed since last time.
+   int num_updated = strategy->update_group_settings_struct(group_settings) ? 1 : 0;
 
    for (int i = 0; i < get_num_boards(); i++) {
-      strategy->fill_board_settings_struct(board_settings[i], i);
+      num_updated += strategy->update_board_settings_struct(board_settings[i], i) ? 1 : 0;
+
+      // Create the per-board entries now, so boards can be configured
+      // from several threads without modifying the maps.
+      board_readback[i];
+      applied_state[i];
+   }
+
+   if (debug_settings() && num_updated == 0) {
+      fe_utils::ts_printf("No settings changed in ODB since last sync\n");
    }
 }
 
@@ -76,10 +144,266 @@ void VX2740FeSettings::write_settings_to_board(int board_id, VX2740& board) {
    }
 
    CaenParameters& vx = board.params();
-   BoardSettings& this_board_settings = board_settings[board_id];
-   BoardReadback& this_board_readback = board_readback[board_id];
+   BoardSettings& this_board_settings = board_settings.at(board_id);
+   BoardReadback& this_board_readback = board_readback.at(board_id);
+   AppliedBoardState& applied = applied_state.at(board_id);
 
    vx.set_debug(debug_settings());
+   CaenParameters::set_allowed_values_cache_file(get_allowed_values_cache_file());
+
+   // Our record of what's on the board is only good for the firmware it was made with.
+   if (!only_write_changed_settings() ||
+         applied.firmware_version != this_board_readback.strings[StringParam::FIRMWARE_VERSION] ||
+         applied.model_name != this_board_readback.strings[StringParam::MODEL_NAME]) {
+      invalidate_applied_settings(board_id);
+   }
+
+   // Nor if the board has been reset since (while staying connected).
+   if (applied.valid && !has_reset_marker(board_id, board)) {
+      invalidate_applied_settings(board_id);
+   }
+
+   bool write_reset_marker = !applied.valid;
+   applied.num_written = 0;
+   applied.num_skipped = 0;
+   applied.verify_counter = 0;
+   applied.sample_offset = (applied.sample_offset + 1) % VX2740_VERIFY_SAMPLE_INTERVAL;
+   applied.deferred_pending = false;
+   vx.reset_num_felib_calls();
+   std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+   try {
+      write_settings_to_board_unchecked(board_id, board, this_board_settings, this_board_readback);
+   } catch (...) {
+      // Don't know what state the board is in any more.
+      invalidate_applied_settings(board_id);
+      throw;
+   }
+
+   if (write_reset_marker) {
+      mark_board(board_id, board);
+   }
+
+   applied.settings = this_board_settings;
+   applied.firmware_version = this_board_readback.strings[StringParam::FIRMWARE_VERSION];
+   applied.model_name = this_board_readback.strings[StringParam::MODEL_NAME];
+   applied.valid = true;
+
+   if (debug_settings()) {
+      double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+      fe_utils::ts_printf("Finished setting parameters for board %s in %.1fms (%d written, %d unchanged, %" PRIu64 " FELib calls)\n", board.get_name().c_str(), elapsed_ms, applied.num_written, applied.num_skipped, vx.get_num_felib_calls());
+   }
+}
+
+void VX2740FeSettings::verify_settings_on_board(int board_id, VX2740& board, std::mutex& state_mutex) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+
+   // Check against what we wrote. Readback goes into a scratch struct, as the
+   // main thread may be publishing board_readback while we run.
+   BoardSettings expected;
+   BoardReadback rdb;
+
+   {
+      std::lock_guard<std::mutex> guard(state_mutex);
+      expected = applied.settings;
+      rdb.strings[StringParam::MODEL_NAME] = applied.model_name;
+      applied.verify_only = true;
+   }
+
+   board.params().set_writes_enabled(false);
+
+   try {
+      write_settings_to_board_unchecked(board_id, board, expected, rdb);
+   } catch (...) {
+      std::lock_guard<std::mutex> guard(state_mutex);
+      applied.verify_only = false;
+      invalidate_applied_settings(board_id);
+      throw;
+   }
+
+   std::lock_guard<std::mutex> guard(state_mutex);
+   applied.verify_only = false;
+   applied.deferred_pending = false;
+}
+
+bool VX2740FeSettings::verify_now(int board_id, bool critical) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+
+   if (critical || applied.verify_only) {
+      return true;
+   }
+
+   switch (group_settings.verify_policy) {
+      case VerifyPolicy::Sampled:
+         // Offset changes on each write, so repeated writes cover everything.
+         return (applied.verify_counter++ % VX2740_VERIFY_SAMPLE_INTERVAL) == applied.sample_offset;
+      case VerifyPolicy::Deferred:
+         applied.deferred_pending = true;
+         return false;
+      case VerifyPolicy::Full:
+      default:
+         return true;
+   }
+}
+
+bool VX2740FeSettings::can_mark_board(int board_id) {
+   // Only the user firmware has user registers.
+   return get_reset_marker_register() != 0 && !is_scope_mode(board_id);
+}
+
+void VX2740FeSettings::mark_board(int board_id, VX2740& board) {
+   if (!can_mark_board(board_id)) {
+      return;
+   }
+
+   try {
+      board.params().set_user_register(get_reset_marker_register(), VX2740_RESET_MARKER);
+   } catch (CaenException& e) {
+      // Only costs a full write next time.
+      if (debug_settings()) {
+         fe_utils::ts_printf("Failed to write reset marker of board %s: %s\n", board.get_name().c_str(), e.what());
+      }
+   }
+}
+
+bool VX2740FeSettings::has_reset_marker(int board_id, VX2740& board) {
+   uint32_t marker = 0;
+
+   if (!can_mark_board(board_id)) {
+      // Can't tell; trust what we wrote since connecting.
+      return true;
+   }
+
+   try {
+      board.params().get_user_register(get_reset_marker_register(), marker);
+   } catch (CaenException& e) {
+      // Can't tell, so assume the worst.
+      if (debug_settings()) {
+         fe_utils::ts_printf("Failed to read reset marker of board %s: %s\n", board.get_name().c_str(), e.what());
+      }
+
+      return false;
+   }
+
+   if (marker != VX2740_RESET_MARKER && debug_settings()) {
+      fe_utils::ts_printf("Board %s has been reset; writing all parameters\n", board.get_name().c_str());
+   }
+
+   return marker == VX2740_RESET_MARKER;
+}
+
+void VX2740FeSettings::invalidate_applied_settings(int board_id) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+   applied.valid = false;
+   applied.user_registers.clear();
+}
+
+void VX2740FeSettings::invalidate_applied_settings() {
+   for (auto& it : applied_state) {
+      invalidate_applied_settings(it.first);
+   }
+}
+
+namespace {
+   template <class T> void append_fingerprint(std::ostringstream& s, const T& val) {
+      s << val;
+   }
+
+   template <class T> void append_fingerprint(std::ostringstream& s, const std::vector<T>& vals) {
+      for (size_t i = 0; i < vals.size(); i++) {
+         s << (i ? "," : "") << (T)vals[i];
+      }
+   }
+
+   template <class Table> void append_fingerprint_table(std::ostringstream& s, const Table& table) {
+      for (auto& it : table) {
+         s << it.first << "=";
+         append_fingerprint(s, it.second);
+         s << "\n";
+      }
+   }
+
+   std::string fingerprint(const BoardSettings& settings) {
+      std::ostringstream s;
+      s.precision(17);
+      append_fingerprint_table(s, settings.strings);
+      append_fingerprint_table(s, settings.bools);
+      append_fingerprint_table(s, settings.uint32s);
+      append_fingerprint_table(s, settings.uint16s);
+      append_fingerprint_table(s, settings.doubles);
+      append_fingerprint_table(s, settings.int32s);
+      append_fingerprint_table(s, settings.vec_bools);
+      append_fingerprint_table(s, settings.vec_strings);
+      append_fingerprint_table(s, settings.vec_int16s);
+      append_fingerprint_table(s, settings.vec_uint16s);
+      append_fingerprint_table(s, settings.vec_uint32s);
+      append_fingerprint_table(s, settings.vec_int32s);
+      append_fingerprint_table(s, settings.vec_floats);
+
+      // FNV-1a
+      std::string text = s.str();
+      uint64_t hash = 14695981039346656037ull;
+
+      for (char c : text) {
+         hash ^= (uint8_t)c;
+         hash *= 1099511628211ull;
+      }
+
+      char hex[17];
+      snprintf(hex, sizeof(hex), "%016" PRIx64, hash);
+      return hex;
+   }
+}
+
+std::string VX2740FeSettings::get_applied_settings_tag(int board_id) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+
+   if (!applied.valid || applied.deferred_pending) {
+      return "";
+   }
+
+   return fingerprint(applied.settings);
+}
+
+bool VX2740FeSettings::adopt_restored_snapshot(int board_id, const CaenSnapshot& snapshot) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+   BoardReadback& rdb = board_readback.at(board_id);
+
+   if (snapshot.tag == "" || snapshot.tag != fingerprint(board_settings.at(board_id)) ||
+         snapshot.firmware_version != rdb.strings[StringParam::FIRMWARE_VERSION] ||
+         snapshot.model_name != rdb.strings[StringParam::MODEL_NAME]) {
+      return false;
+   }
+
+   applied.settings = board_settings.at(board_id);
+   applied.user_registers = snapshot.user_registers;
+   applied.firmware_version = snapshot.firmware_version;
+   applied.model_name = snapshot.model_name;
+   applied.valid = true;
+   return true;
+}
+
+bool VX2740FeSettings::user_register_changed(int board_id, uint32_t reg, uint32_t val) {
+   AppliedBoardState& applied = applied_state.at(board_id);
+
+   if (applied.verify_only) {
+      return true;
+   }
+
+   auto it = applied.user_registers.find(reg);
+
+   if (applied.valid && it != applied.user_registers.end() && it->second == val) {
+      applied.num_skipped++;
+      return false;
+   }
+
+   // Safe to record now; if the write fails the whole cache is invalidated.
+   applied.user_registers[reg] = val;
+   applied.num_written++;
+   return true;
+}
+
+void VX2740FeSettings::write_settings_to_board_unchecked(int board_id, VX2740& board, BoardSettings& this_board_settings, BoardReadback& this_board_readback) {
 
    // Set the parameters in CAEN part of firmware
    set_and_check_start_sources(board_id, board, this_board_settings, this_board_readback);
@@ -101,251 +425,435 @@ void VX2740FeSettings::write_settings_to_board(int board_id, VX2740& board) {
       set_and_check_user_registers(board_id, board, this_board_settings, this_board_readback);
    }
 
-   if (this_board_readback.strings.at("Model name") == "VX2745") {
+   if (this_board_readback.strings[StringParam::MODEL_NAME] == "VX2745") {
       // Only available in VX2745, not VX2740
       set_and_check_2745(board_id, board, this_board_settings, this_board_readback);
    }
-
-   if (debug_settings()) {
-      fe_utils::ts_printf("Finished setting parameters for board %s\n", board.get_name().c_str());
-   }
 }
 
 void VX2740FeSettings::set_and_check_start_sources(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_start_sources(set.bools.at("Start acq on midas run start"),
-                                    set.bools.at("Start acq on encoded CLKIN"),
-                                    set.bools.at("Start acq on SIN level"),
-                                    set.bools.at("Start acq on SIN edge"),
-                                    set.bools.at("Start acq on LVDS"),
-                                    set.bools.at("Start acq on first trigger"),
-                                    set.bools.at("Start acq on P0"));
-   board.params().get_start_sources(rdb.bools.at("Start acq on midas run start"),
-                                    rdb.bools.at("Start acq on encoded CLKIN"),
-                                    rdb.bools.at("Start acq on SIN level"),
-                                    rdb.bools.at("Start acq on SIN edge"),
-                                    rdb.bools.at("Start acq on LVDS"),
-                                    rdb.bools.at("Start acq on first trigger"),
-                                    rdb.bools.at("Start acq on P0"));
-   validate(set.bools, rdb.bools, "Start acq on midas run start", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on encoded CLKIN", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on SIN level", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on SIN edge", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on LVDS", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on first trigger", board.get_name());
-   validate(set.bools, rdb.bools, "Start acq on P0", board.get_name());
-
-   board.params().set_run_start_delay_cycles(set.uint32s.at("Run start delay (cycles)"));
-   board.params().get_run_start_delay_cycles(rdb.uint32s.at("Run start delay (cycles)"));
-   validate(set.uint32s, rdb.uint32s, "Run start delay (cycles)", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::START_ACQ_ON_MIDAS_RUN_START, BoolParam::START_ACQ_ON_ENCODED_CLKIN, BoolParam::START_ACQ_ON_SIN_LEVEL,
+                                                 BoolParam::START_ACQ_ON_SIN_EDGE, BoolParam::START_ACQ_ON_LVDS, BoolParam::START_ACQ_ON_FIRST_TRIGGER, BoolParam::START_ACQ_ON_P0})) {
+      board.params().set_start_sources(set.bools[BoolParam::START_ACQ_ON_MIDAS_RUN_START],
+                                       set.bools[BoolParam::START_ACQ_ON_ENCODED_CLKIN],
+                                       set.bools[BoolParam::START_ACQ_ON_SIN_LEVEL],
+                                       set.bools[BoolParam::START_ACQ_ON_SIN_EDGE],
+                                       set.bools[BoolParam::START_ACQ_ON_LVDS],
+                                       set.bools[BoolParam::START_ACQ_ON_FIRST_TRIGGER],
+                                       set.bools[BoolParam::START_ACQ_ON_P0]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_start_sources(rdb.bools[BoolParam::START_ACQ_ON_MIDAS_RUN_START],
+                                          rdb.bools[BoolParam::START_ACQ_ON_ENCODED_CLKIN],
+                                          rdb.bools[BoolParam::START_ACQ_ON_SIN_LEVEL],
+                                          rdb.bools[BoolParam::START_ACQ_ON_SIN_EDGE],
+                                          rdb.bools[BoolParam::START_ACQ_ON_LVDS],
+                                          rdb.bools[BoolParam::START_ACQ_ON_FIRST_TRIGGER],
+                                          rdb.bools[BoolParam::START_ACQ_ON_P0]);
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_MIDAS_RUN_START, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_ENCODED_CLKIN, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_SIN_LEVEL, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_SIN_EDGE, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_LVDS, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_FIRST_TRIGGER, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::START_ACQ_ON_P0, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::RUN_START_DELAY_CYCLES})) {
+      board.params().set_run_start_delay_cycles(set.uint32s[Uint32Param::RUN_START_DELAY_CYCLES]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_run_start_delay_cycles(rdb.uint32s[Uint32Param::RUN_START_DELAY_CYCLES]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::RUN_START_DELAY_CYCLES, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_trigger_sources(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
+   if (!changed(board_id, &BoardSettings::bools, {BoolParam::SCOPE_MODE, BoolParam::TRIGGER_ON_CH_OVER_THRESH_A, BoolParam::TRIGGER_ON_CH_OVER_THRESH_B,
+                                                  BoolParam::TRIGGER_ON_CH_OVER_THRESH_A_AND_B, BoolParam::TRIGGER_ON_EXTERNAL_SIGNAL, BoolParam::TRIGGER_ON_SOFTWARE_SIGNAL,
+                                                  BoolParam::TRIGGER_ON_USER_MODE_SIGNAL, BoolParam::TRIGGER_ON_TEST_PULSE, BoolParam::TRIGGER_ON_LVDS})) {
+      return;
+   }
+
    // Simplify life by ignoring CAEN threshold trigger in dpp mode
-   bool thresh_a = is_scope_mode(board_id) ? set.bools.at("Trigger on ch over thresh A") : false;
-   bool thresh_b = is_scope_mode(board_id) ? set.bools.at("Trigger on ch over thresh B") : false;
-   bool thresh_ab = is_scope_mode(board_id) ? set.bools.at("Trigger on ch over thresh A&&B") : false;
+   bool thresh_a = is_scope_mode(board_id) ? set.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A] : false;
+   bool thresh_b = is_scope_mode(board_id) ? set.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_B] : false;
+   bool thresh_ab = is_scope_mode(board_id) ? set.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A_AND_B] : false;
 
    // Set board value
    board.params().set_trigger_sources(thresh_a, 
                                       thresh_b, 
                                       thresh_ab, 
-                                      set.bools.at("Trigger on external signal"), 
-                                      set.bools.at("Trigger on software signal"),
-                                      set.bools.at("Trigger on user mode signal"),
-                                      set.bools.at("Trigger on test pulse"),
-                                      set.bools.at("Trigger on LVDS"));
+                                      set.bools[BoolParam::TRIGGER_ON_EXTERNAL_SIGNAL], 
+                                      set.bools[BoolParam::TRIGGER_ON_SOFTWARE_SIGNAL],
+                                      set.bools[BoolParam::TRIGGER_ON_USER_MODE_SIGNAL],
+                                      set.bools[BoolParam::TRIGGER_ON_TEST_PULSE],
+                                      set.bools[BoolParam::TRIGGER_ON_LVDS]);
+
+   if (!verify_now(board_id, false)) {
+      return;
+   }
 
    // Readback board values
-   board.params().get_trigger_sources(rdb.bools.at("Trigger on ch over thresh A"),
-                                      rdb.bools.at("Trigger on ch over thresh B"),
-                                      rdb.bools.at("Trigger on ch over thresh A&&B"),
-                                      rdb.bools.at("Trigger on external signal"), 
-                                      rdb.bools.at("Trigger on software signal"),
-                                      rdb.bools.at("Trigger on user mode signal"),
-                                      rdb.bools.at("Trigger on test pulse"),
-                                      rdb.bools.at("Trigger on LVDS"));
+   board.params().get_trigger_sources(rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A],
+                                      rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_B],
+                                      rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A_AND_B],
+                                      rdb.bools[BoolParam::TRIGGER_ON_EXTERNAL_SIGNAL], 
+                                      rdb.bools[BoolParam::TRIGGER_ON_SOFTWARE_SIGNAL],
+                                      rdb.bools[BoolParam::TRIGGER_ON_USER_MODE_SIGNAL],
+                                      rdb.bools[BoolParam::TRIGGER_ON_TEST_PULSE],
+                                      rdb.bools[BoolParam::TRIGGER_ON_LVDS]);
 
    // Check the two agree
-   vx2740_comparisons::validate(thresh_a, rdb.bools.at("Trigger on ch over thresh A"), "Trigger on ch over thresh A", board.get_name());
-   vx2740_comparisons::validate(thresh_b, rdb.bools.at("Trigger on ch over thresh B"), "Trigger on ch over thresh B", board.get_name());
-   vx2740_comparisons::validate(thresh_ab, rdb.bools.at("Trigger on ch over thresh A&&B"), "Trigger on ch over thresh A&&B", board.get_name());
-   validate(set.bools, rdb.bools, "Trigger on external signal", board.get_name());
-   validate(set.bools, rdb.bools, "Trigger on software signal", board.get_name());
-   validate(set.bools, rdb.bools, "Trigger on user mode signal", board.get_name());
-   validate(set.bools, rdb.bools, "Trigger on test pulse", board.get_name());
-   validate(set.bools, rdb.bools, "Trigger on LVDS", board.get_name());
+   vx2740_comparisons::validate(thresh_a, rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A], "Trigger on ch over thresh A", board.get_name());
+   vx2740_comparisons::validate(thresh_b, rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_B], "Trigger on ch over thresh B", board.get_name());
+   vx2740_comparisons::validate(thresh_ab, rdb.bools[BoolParam::TRIGGER_ON_CH_OVER_THRESH_A_AND_B], "Trigger on ch over thresh A&&B", board.get_name());
+   validate(set.bools, rdb.bools, BoolParam::TRIGGER_ON_EXTERNAL_SIGNAL, board.get_name());
+   validate(set.bools, rdb.bools, BoolParam::TRIGGER_ON_SOFTWARE_SIGNAL, board.get_name());
+   validate(set.bools, rdb.bools, BoolParam::TRIGGER_ON_USER_MODE_SIGNAL, board.get_name());
+   validate(set.bools, rdb.bools, BoolParam::TRIGGER_ON_TEST_PULSE, board.get_name());
+   validate(set.bools, rdb.bools, BoolParam::TRIGGER_ON_LVDS, board.get_name());
 }
 
 void VX2740FeSettings::set_and_check_readout_params(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_channel_enable_mask(set.uint32s.at("Readout channel mask (31-0)"), set.uint32s.at("Readout channel mask (63-32)"));
-   board.params().get_channel_enable_mask(rdb.uint32s.at("Readout channel mask (31-0)"), rdb.uint32s.at("Readout channel mask (63-32)"));
-   validate(set.uint32s, rdb.uint32s, "Readout channel mask (31-0)", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Readout channel mask (63-32)", board.get_name());
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::READOUT_CHANNEL_MASK_LO, Uint32Param::READOUT_CHANNEL_MASK_HI})) {
+      board.params().set_channel_enable_mask(set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_LO], set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_HI]);
+
+      if (verify_now(board_id, true)) {
+         board.params().get_channel_enable_mask(rdb.uint32s[Uint32Param::READOUT_CHANNEL_MASK_LO], rdb.uint32s[Uint32Param::READOUT_CHANNEL_MASK_HI]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::READOUT_CHANNEL_MASK_LO, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::READOUT_CHANNEL_MASK_HI, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_ch_over_thresh(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_channel_over_threshold_trigger_A_enable_mask(set.uint32s.at("Ch over thresh A multiplicity"),
-                                                                   set.uint32s.at("Ch over thresh A en mask(31-0)"),
-                                                                   set.uint32s.at("Ch over thresh A en mask(63-32)"));
-   board.params().get_channel_over_threshold_trigger_A_enable_mask(rdb.uint32s.at("Ch over thresh A multiplicity"),
-                                                                   rdb.uint32s.at("Ch over thresh A en mask(31-0)"),
-                                                                   rdb.uint32s.at("Ch over thresh A en mask(63-32)"));
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh A multiplicity", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh A en mask(31-0)", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh A en mask(63-32)", board.get_name());
-
-   board.params().set_channel_over_threshold_trigger_B_enable_mask(set.uint32s.at("Ch over thresh B multiplicity"),
-                                                                   set.uint32s.at("Ch over thresh B en mask(31-0)"),
-                                                                   set.uint32s.at("Ch over thresh B en mask(63-32)"));
-   board.params().get_channel_over_threshold_trigger_B_enable_mask(rdb.uint32s.at("Ch over thresh B multiplicity"),
-                                                                   rdb.uint32s.at("Ch over thresh B en mask(31-0)"),
-                                                                   rdb.uint32s.at("Ch over thresh B en mask(63-32)"));
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh B multiplicity", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh B en mask(31-0)", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Ch over thresh B en mask(63-32)", board.get_name());
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::CH_OVER_THRESH_A_MULTIPLICITY, Uint32Param::CH_OVER_THRESH_A_EN_MASK_LO, Uint32Param::CH_OVER_THRESH_A_EN_MASK_HI})) {
+      board.params().set_channel_over_threshold_trigger_A_enable_mask(set.uint32s[Uint32Param::CH_OVER_THRESH_A_MULTIPLICITY],
+                                                                      set.uint32s[Uint32Param::CH_OVER_THRESH_A_EN_MASK_LO],
+                                                                      set.uint32s[Uint32Param::CH_OVER_THRESH_A_EN_MASK_HI]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_channel_over_threshold_trigger_A_enable_mask(rdb.uint32s[Uint32Param::CH_OVER_THRESH_A_MULTIPLICITY],
+                                                                         rdb.uint32s[Uint32Param::CH_OVER_THRESH_A_EN_MASK_LO],
+                                                                         rdb.uint32s[Uint32Param::CH_OVER_THRESH_A_EN_MASK_HI]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_A_MULTIPLICITY, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_A_EN_MASK_LO, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_A_EN_MASK_HI, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::CH_OVER_THRESH_B_MULTIPLICITY, Uint32Param::CH_OVER_THRESH_B_EN_MASK_LO, Uint32Param::CH_OVER_THRESH_B_EN_MASK_HI})) {
+      board.params().set_channel_over_threshold_trigger_B_enable_mask(set.uint32s[Uint32Param::CH_OVER_THRESH_B_MULTIPLICITY],
+                                                                      set.uint32s[Uint32Param::CH_OVER_THRESH_B_EN_MASK_LO],
+                                                                      set.uint32s[Uint32Param::CH_OVER_THRESH_B_EN_MASK_HI]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_channel_over_threshold_trigger_B_enable_mask(rdb.uint32s[Uint32Param::CH_OVER_THRESH_B_MULTIPLICITY],
+                                                                         rdb.uint32s[Uint32Param::CH_OVER_THRESH_B_EN_MASK_LO],
+                                                                         rdb.uint32s[Uint32Param::CH_OVER_THRESH_B_EN_MASK_HI]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_B_MULTIPLICITY, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_B_EN_MASK_LO, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::CH_OVER_THRESH_B_EN_MASK_HI, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_front_panel(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_nim_ttl(set.bools.at("Use NIM IO"));
-   board.params().get_nim_ttl(rdb.bools.at("Use NIM IO"));
-   validate(set.bools, rdb.bools, "Use NIM IO", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::USE_NIM_IO})) {
+      board.params().set_nim_ttl(set.bools[BoolParam::USE_NIM_IO]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_nim_ttl(rdb.bools[BoolParam::USE_NIM_IO]);
+         validate(set.bools, rdb.bools, BoolParam::USE_NIM_IO, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::strings, {StringParam::TRIGGER_OUT_MODE})) {
+      board.params().set_trigout_mode(set.strings[StringParam::TRIGGER_OUT_MODE]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_trigout_mode(rdb.strings[StringParam::TRIGGER_OUT_MODE]);
+         validate(set.strings, rdb.strings, StringParam::TRIGGER_OUT_MODE, board.get_name());
+      }
+   }
 
-   board.params().set_trigout_mode(set.strings.at("Trigger out mode"));
-   board.params().get_trigout_mode(rdb.strings.at("Trigger out mode"));
-   validate(set.strings, rdb.strings, "Trigger out mode", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::USE_EXTERNAL_CLOCK})) {
+      board.params().set_use_external_clock(set.bools[BoolParam::USE_EXTERNAL_CLOCK]);
 
-   board.params().set_use_external_clock(set.bools.at("Use external clock"));
-   board.params().get_use_external_clock(rdb.bools.at("Use external clock"));
-   validate(set.bools, rdb.bools, "Use external clock", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_use_external_clock(rdb.bools[BoolParam::USE_EXTERNAL_CLOCK]);
+         validate(set.bools, rdb.bools, BoolParam::USE_EXTERNAL_CLOCK, board.get_name());
+      }
+   }
 
-   board.params().set_enable_clock_out(set.bools.at("Enable clock out"));
-   board.params().get_enable_clock_out(rdb.bools.at("Enable clock out"));
-   validate(set.bools, rdb.bools, "Enable clock out", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::ENABLE_CLOCK_OUT})) {
+      board.params().set_enable_clock_out(set.bools[BoolParam::ENABLE_CLOCK_OUT]);
 
-   board.params().set_gpio_mode(set.strings.at("GPIO mode"));
-   board.params().get_gpio_mode(rdb.strings.at("GPIO mode"));
-   validate(set.strings, rdb.strings, "GPIO mode", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_enable_clock_out(rdb.bools[BoolParam::ENABLE_CLOCK_OUT]);
+         validate(set.bools, rdb.bools, BoolParam::ENABLE_CLOCK_OUT, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::strings, {StringParam::GPIO_MODE})) {
+      board.params().set_gpio_mode(set.strings[StringParam::GPIO_MODE]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_gpio_mode(rdb.strings[StringParam::GPIO_MODE]);
+         validate(set.strings, rdb.strings, StringParam::GPIO_MODE, board.get_name());
+      }
+   }
 
-   board.params().set_sync_out_mode(set.strings.at("Sync out mode"));
-   board.params().get_sync_out_mode(rdb.strings.at("Sync out mode"));
-   validate(set.strings, rdb.strings, "Sync out mode", board.get_name());
+   if (changed(board_id, &BoardSettings::strings, {StringParam::SYNC_OUT_MODE})) {
+      board.params().set_sync_out_mode(set.strings[StringParam::SYNC_OUT_MODE]);
 
-   board.params().set_enable_fake_sine_data(set.bools.at("Read fake sinewave data"));
-   board.params().get_enable_fake_sine_data(rdb.bools.at("Read fake sinewave data"));
-   validate(set.bools, rdb.bools, "Read fake sinewave data", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_sync_out_mode(rdb.strings[StringParam::SYNC_OUT_MODE]);
+         validate(set.strings, rdb.strings, StringParam::SYNC_OUT_MODE, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::READ_FAKE_SINEWAVE_DATA})) {
+      board.params().set_enable_fake_sine_data(set.bools[BoolParam::READ_FAKE_SINEWAVE_DATA]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_enable_fake_sine_data(rdb.bools[BoolParam::READ_FAKE_SINEWAVE_DATA]);
+         validate(set.bools, rdb.bools, BoolParam::READ_FAKE_SINEWAVE_DATA, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_scope_readout(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_num_trigger_delay_samples(set.uint32s.at("Trigger delay (samples)"));
-   board.params().get_num_trigger_delay_samples(rdb.uint32s.at("Trigger delay (samples)"));
-   validate(set.uint32s, rdb.uint32s, "Trigger delay (samples)", board.get_name());
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::TRIGGER_DELAY_SAMPLES})) {
+      board.params().set_num_trigger_delay_samples(set.uint32s[Uint32Param::TRIGGER_DELAY_SAMPLES]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_num_trigger_delay_samples(rdb.uint32s[Uint32Param::TRIGGER_DELAY_SAMPLES]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::TRIGGER_DELAY_SAMPLES, board.get_name());
+      }
+   }
 
-   board.params().set_waveform_length_samples(set.uint32s.at("Waveform length (samples)"));
-   board.params().get_waveform_length_samples(rdb.uint32s.at("Waveform length (samples)"));
-   validate(set.uint32s, rdb.uint32s, "Waveform length (samples)", board.get_name());
+   if (changed(board_id, &BoardSettings::uint32s, {Uint32Param::WAVEFORM_LENGTH_SAMPLES})) {
+      board.params().set_waveform_length_samples(set.uint32s[Uint32Param::WAVEFORM_LENGTH_SAMPLES]);
 
-   board.params().set_enable_trigger_overlap(set.bools.at("Allow trigger overlap"));
-   board.params().get_enable_trigger_overlap(rdb.bools.at("Allow trigger overlap"));
-   validate(set.bools, rdb.bools, "Allow trigger overlap", board.get_name());
+      if (verify_now(board_id, true)) {
+         board.params().get_waveform_length_samples(rdb.uint32s[Uint32Param::WAVEFORM_LENGTH_SAMPLES]);
+         validate(set.uint32s, rdb.uint32s, Uint32Param::WAVEFORM_LENGTH_SAMPLES, board.get_name());
+      }
+   }
 
-   board.params().set_pre_trigger_samples(set.uint16s.at("Pre-trigger (samples)"));
-   board.params().get_pre_trigger_samples(rdb.uint16s.at("Pre-trigger (samples)"));
-   validate(set.uint16s, rdb.uint16s, "Pre-trigger (samples)", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::ALLOW_TRIGGER_OVERLAP})) {
+      board.params().set_enable_trigger_overlap(set.bools[BoolParam::ALLOW_TRIGGER_OVERLAP]);
 
-   board.params().set_trigger_id_mode(set.strings.at("Trigger ID mode"));
-   board.params().get_trigger_id_mode(rdb.strings.at("Trigger ID mode"));
-   validate(set.strings, rdb.strings, "Trigger ID mode", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_enable_trigger_overlap(rdb.bools[BoolParam::ALLOW_TRIGGER_OVERLAP]);
+         validate(set.bools, rdb.bools, BoolParam::ALLOW_TRIGGER_OVERLAP, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::uint16s, {Uint16Param::PRE_TRIGGER_SAMPLES})) {
+      board.params().set_pre_trigger_samples(set.uint16s[Uint16Param::PRE_TRIGGER_SAMPLES]);
+
+      if (verify_now(board_id, true)) {
+         board.params().get_pre_trigger_samples(rdb.uint16s[Uint16Param::PRE_TRIGGER_SAMPLES]);
+         validate(set.uint16s, rdb.uint16s, Uint16Param::PRE_TRIGGER_SAMPLES, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::strings, {StringParam::TRIGGER_ID_MODE})) {
+      board.params().set_trigger_id_mode(set.strings[StringParam::TRIGGER_ID_MODE]);
+
+      if (verify_now(board_id, true)) {
+         board.params().get_trigger_id_mode(rdb.strings[StringParam::TRIGGER_ID_MODE]);
+         validate(set.strings, rdb.strings, StringParam::TRIGGER_ID_MODE, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_scope_trigger(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) { 
+   // Relative/absolute applies to every channel
+   bool all_chans = changed(board_id, &BoardSettings::bools, {BoolParam::USE_RELATIVE_TRIG_THRESHOLDS});
+
+   uint64_t chan_mask = 0;
+
    for (int c = 0; c < 64; c++) {
+      if (all_chans ||
+            changed(board_id, &BoardSettings::vec_int32s, VecInt32Param::CHAN_OVER_THRESH_THRESHOLDS, c) ||
+            changed(board_id, &BoardSettings::vec_bools, VecBoolParam::CHAN_OVER_THRESH_RISING_EDGE, c) ||
+            changed(board_id, &BoardSettings::vec_uint32s, VecUint32Param::CHAN_OVER_THRESH_WIDTH_NS, c)) {
+         chan_mask |= ((uint64_t)1 << c);
+      }
+   }
+
+   // Channels with the same settings are written together.
+   board.params().set_channel_trigger_thresholds(set.bools[BoolParam::USE_RELATIVE_TRIG_THRESHOLDS],
+                                                 set.vec_int32s[VecInt32Param::CHAN_OVER_THRESH_THRESHOLDS],
+                                                 set.vec_bools[VecBoolParam::CHAN_OVER_THRESH_RISING_EDGE],
+                                                 set.vec_uint32s[VecUint32Param::CHAN_OVER_THRESH_WIDTH_NS],
+                                                 chan_mask);
+
+   for (int c = 0; c < 64; c++) {
+      if (!(chan_mask & ((uint64_t)1 << c))) {
+         continue;
+      }
+
       bool rdb_rising = false;
-      board.params().set_channel_trigger_threshold(c, 
-                                                   set.bools.at("Use relative trig thresholds"), 
-                                                   set.vec_int32s.at("Chan over thresh thresholds")[c],
-                                                   set.vec_bools.at("Chan over thresh rising edge")[c],
-                                                   set.vec_uint32s.at("Chan over thresh width (ns)")[c]);
-      board.params().get_channel_trigger_threshold(c, 
-                                                   rdb.bools.at("Use relative trig thresholds"), 
-                                                   rdb.vec_int32s.at("Chan over thresh thresholds")[c],
-                                                   rdb_rising,
-                                                   rdb.vec_uint32s.at("Chan over thresh width (ns)")[c]);
-      rdb.vec_bools.at("Chan over thresh rising edge")[c] = rdb_rising;
-
-      std::stringstream param;
-      param << "Use relative trig thresholds for channel " << c;
-      vx2740_comparisons::validate(set.bools.at("Use relative trig thresholds"), rdb.bools.at("Use relative trig thresholds"), param.str(), board.get_name());
-      validate_array_element(set.vec_int32s, rdb.vec_int32s, "Chan over thresh thresholds", board.get_name(), c);
-      validate_array_element(set.vec_bools, rdb.vec_bools, "Chan over thresh rising edge", board.get_name(), c);
-      validate_array_element(set.vec_uint32s, rdb.vec_uint32s, "Chan over thresh width (ns)", board.get_name(), c);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_channel_trigger_threshold(c, 
+                                                      rdb.bools[BoolParam::USE_RELATIVE_TRIG_THRESHOLDS], 
+                                                      rdb.vec_int32s[VecInt32Param::CHAN_OVER_THRESH_THRESHOLDS][c],
+                                                      rdb_rising,
+                                                      rdb.vec_uint32s[VecUint32Param::CHAN_OVER_THRESH_WIDTH_NS][c]);
+         rdb.vec_bools[VecBoolParam::CHAN_OVER_THRESH_RISING_EDGE][c] = rdb_rising;
+
+         std::stringstream param;
+         param << "Use relative trig thresholds for channel " << c;
+         vx2740_comparisons::validate(set.bools[BoolParam::USE_RELATIVE_TRIG_THRESHOLDS], rdb.bools[BoolParam::USE_RELATIVE_TRIG_THRESHOLDS], param.str(), board.get_name());
+         validate_array_element(set.vec_int32s, rdb.vec_int32s, VecInt32Param::CHAN_OVER_THRESH_THRESHOLDS, board.get_name(), c);
+         validate_array_element(set.vec_bools, rdb.vec_bools, VecBoolParam::CHAN_OVER_THRESH_RISING_EDGE, board.get_name(), c);
+         validate_array_element(set.vec_uint32s, rdb.vec_uint32s, VecUint32Param::CHAN_OVER_THRESH_WIDTH_NS, board.get_name(), c);
+      }
    }
 }
 
 void VX2740FeSettings::set_and_check_dc_offsets(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_enable_dc_offsets(set.bools.at("Enable DC offsets"));
-   board.params().get_enable_dc_offsets(rdb.bools.at("Enable DC offsets"));
-   validate(set.bools, rdb.bools, "Enable DC offsets", board.get_name());
+   if (changed(board_id, &BoardSettings::bools, {BoolParam::ENABLE_DC_OFFSETS})) {
+      board.params().set_enable_dc_offsets(set.bools[BoolParam::ENABLE_DC_OFFSETS]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_enable_dc_offsets(rdb.bools[BoolParam::ENABLE_DC_OFFSETS]);
+         validate(set.bools, rdb.bools, BoolParam::ENABLE_DC_OFFSETS, board.get_name());
+      }
+   }
+
+   uint64_t chan_mask = 0;
 
    for (int i = 0; i < 64; i++) {
-      board.params().set_channel_dc_offset(i, set.vec_floats.at("DC offset (pct)")[i]);
-      board.params().get_channel_dc_offset(i, rdb.vec_floats.at("DC offset (pct)")[i]);
-      validate_array_element(set.vec_floats, rdb.vec_floats, "DC offset (pct)", board.get_name(), i);
+      if (changed(board_id, &BoardSettings::vec_floats, VecFloatParam::DC_OFFSET_PCT, i)) {
+         chan_mask |= ((uint64_t)1 << i);
+      }
+   }
+
+   if (chan_mask == 0) {
+      // Nothing to write, so nothing to verify (or defer verifying).
+      return;
+   }
+
+   board.params().set_channel_dc_offsets(set.vec_floats[VecFloatParam::DC_OFFSET_PCT], chan_mask);
+
+   if (!verify_now(board_id, false)) {
+      return;
+   }
+
+   board.params().get_channel_dc_offsets(rdb.vec_floats[VecFloatParam::DC_OFFSET_PCT], chan_mask);
+
+   for (int i = 0; i < 64; i++) {
+      if (chan_mask & ((uint64_t)1 << i)) {
+         validate_array_element(set.vec_floats, rdb.vec_floats, VecFloatParam::DC_OFFSET_PCT, board.get_name(), i);
+      }
    }
 }
 
 void VX2740FeSettings::set_and_check_busy_veto(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_busy_in_source(set.strings.at("Busy in source"));
-   board.params().get_busy_in_source(rdb.strings.at("Busy in source"));
-   validate(set.strings, rdb.strings, "Busy in source", board.get_name());
+   if (changed(board_id, &BoardSettings::strings, {StringParam::BUSY_IN_SOURCE})) {
+      board.params().set_busy_in_source(set.strings[StringParam::BUSY_IN_SOURCE]);
 
-   board.params().set_veto_params(set.strings.at("Veto source"),
-                                  set.bools.at("Veto when source is high"),
-                                  set.uint32s.at("Veto width (ns) (0=source len)"));
-   board.params().get_veto_params(rdb.strings.at("Veto source"),
-                                  rdb.bools.at("Veto when source is high"),
-                                  rdb.uint32s.at("Veto width (ns) (0=source len)"));
-   validate(set.strings, rdb.strings, "Veto source", board.get_name());
-   validate(set.bools, rdb.bools, "Veto when source is high", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Veto width (ns) (0=source len)", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_busy_in_source(rdb.strings[StringParam::BUSY_IN_SOURCE]);
+         validate(set.strings, rdb.strings, StringParam::BUSY_IN_SOURCE, board.get_name());
+      }
+   }
+
+   if (changed(board_id, &BoardSettings::strings, {StringParam::VETO_SOURCE}) ||
+         changed(board_id, &BoardSettings::bools, {BoolParam::VETO_WHEN_SOURCE_IS_HIGH}) ||
+         changed(board_id, &BoardSettings::uint32s, {Uint32Param::VETO_WIDTH_NS})) {
+      board.params().set_veto_params(set.strings[StringParam::VETO_SOURCE],
+                                     set.bools[BoolParam::VETO_WHEN_SOURCE_IS_HIGH],
+                                     set.uint32s[Uint32Param::VETO_WIDTH_NS]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_veto_params(rdb.strings[StringParam::VETO_SOURCE],
+                                        rdb.bools[BoolParam::VETO_WHEN_SOURCE_IS_HIGH],
+                                        rdb.uint32s[Uint32Param::VETO_WIDTH_NS]);
+         validate(set.strings, rdb.strings, StringParam::VETO_SOURCE, board.get_name());
+         validate(set.bools, rdb.bools, BoolParam::VETO_WHEN_SOURCE_IS_HIGH, board.get_name());
+         validate(set.uint32s, rdb.uint32s, Uint32Param::VETO_WIDTH_NS, board.get_name());
+      }
+   }
 }
 
 void VX2740FeSettings::set_and_check_lvds(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
+   bool any_quartet_changed = false;
+
    // Per-quartet
    for (int q = 0; q < 4; q++) {
+      if (!changed(board_id, &BoardSettings::vec_bools, VecBoolParam::LVDS_QUARTET_IS_INPUT, q) &&
+            !changed(board_id, &BoardSettings::vec_strings, VecStringParam::LVDS_QUARTET_MODE, q)) {
+         continue;
+      }
+
+      any_quartet_changed = true;
+
       // Shenanigans to get around vector<bool> not being like a regular vector,
       // (and you can't just get a reference to an element as a bool&).
       bool rdb_bool = false;
-      board.params().set_lvds_quartet_params(q, set.vec_bools.at("LVDS quartet is input")[q], set.vec_strings.at("LVDS quartet mode")[q]);
-      board.params().get_lvds_quartet_params(q, rdb_bool, rdb.vec_strings.at("LVDS quartet mode")[q]);
-      
-      rdb.vec_bools.at("LVDS quartet is input")[q] = rdb_bool;
+      board.params().set_lvds_quartet_params(q, set.vec_bools[VecBoolParam::LVDS_QUARTET_IS_INPUT][q], set.vec_strings[VecStringParam::LVDS_QUARTET_MODE][q]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_lvds_quartet_params(q, rdb_bool, rdb.vec_strings[VecStringParam::LVDS_QUARTET_MODE][q]);
 
-      validate_array_element(set.vec_bools, rdb.vec_bools, "LVDS quartet is input", board.get_name(), q);
-      validate_array_element(set.vec_strings, rdb.vec_strings, "LVDS quartet mode", board.get_name(), q);
+         rdb.vec_bools[VecBoolParam::LVDS_QUARTET_IS_INPUT][q] = rdb_bool;
+
+         validate_array_element(set.vec_bools, rdb.vec_bools, VecBoolParam::LVDS_QUARTET_IS_INPUT, board.get_name(), q);
+         validate_array_element(set.vec_strings, rdb.vec_strings, VecStringParam::LVDS_QUARTET_MODE, board.get_name(), q);
+      }
    }
 
    // Per-line
    for (int l = 0; l < 16; l++) {
-      board.params().set_lvds_trigger_mask(l, set.vec_uint32s.at("LVDS trigger mask (31-0)")[l], set.vec_uint32s.at("LVDS trigger mask (63-32)")[l]);
-      board.params().get_lvds_trigger_mask(l, rdb.vec_uint32s.at("LVDS trigger mask (31-0)")[l], rdb.vec_uint32s.at("LVDS trigger mask (63-32)")[l]);
-      validate_array_element(set.vec_uint32s, rdb.vec_uint32s, "LVDS trigger mask (31-0)", board.get_name(), l);
-      validate_array_element(set.vec_uint32s, rdb.vec_uint32s, "LVDS trigger mask (63-32)", board.get_name(), l);
+      if (!changed(board_id, &BoardSettings::vec_uint32s, VecUint32Param::LVDS_TRIGGER_MASK_LO, l) &&
+            !changed(board_id, &BoardSettings::vec_uint32s, VecUint32Param::LVDS_TRIGGER_MASK_HI, l)) {
+         continue;
+      }
+
+      board.params().set_lvds_trigger_mask(l, set.vec_uint32s[VecUint32Param::LVDS_TRIGGER_MASK_LO][l], set.vec_uint32s[VecUint32Param::LVDS_TRIGGER_MASK_HI][l]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_lvds_trigger_mask(l, rdb.vec_uint32s[VecUint32Param::LVDS_TRIGGER_MASK_LO][l], rdb.vec_uint32s[VecUint32Param::LVDS_TRIGGER_MASK_HI][l]);
+         validate_array_element(set.vec_uint32s, rdb.vec_uint32s, VecUint32Param::LVDS_TRIGGER_MASK_LO, board.get_name(), l);
+         validate_array_element(set.vec_uint32s, rdb.vec_uint32s, VecUint32Param::LVDS_TRIGGER_MASK_HI, board.get_name(), l);
+      }
+   }
+
+   // Readback of the IO register depends on the quartet directions, so
+   // rewrite it if they changed too.
+   if (!changed(board_id, &BoardSettings::uint16s, {Uint16Param::LVDS_IO_REGISTER}) && !any_quartet_changed) {
+      return;
    }
 
    // IO Register value readback depends on whether each quartet
    // is set to input or output. Input quartet readback matches
    // the voltage levels present. Output quartet readback should
    // match what we set.
-   board.params().set_lvds_io_register(set.uint16s.at("LVDS IO register"));
-   board.params().get_lvds_io_register(rdb.uint16s.at("LVDS IO register"));
+   board.params().set_lvds_io_register(set.uint16s[Uint16Param::LVDS_IO_REGISTER]);
+
+   if (!verify_now(board_id, false)) {
+      return;
+   }
+
+   board.params().get_lvds_io_register(rdb.uint16s[Uint16Param::LVDS_IO_REGISTER]);
 
    for (int q = 0; q < 4; q++) {
-      bool is_ioreg = set.vec_strings.at("LVDS quartet mode")[q] == "IORegister";
-      bool is_input = set.vec_bools.at("LVDS quartet is input")[q];
+      bool is_ioreg = set.vec_strings[VecStringParam::LVDS_QUARTET_MODE][q] == "IORegister";
+      bool is_input = set.vec_bools[VecBoolParam::LVDS_QUARTET_IS_INPUT][q];
 
       if (is_ioreg && !is_input) {
-         uint16_t set_quartet = (set.uint16s.at("LVDS IO register") >> (q*4)) & 0xf;
-         uint16_t rdb_quartet = (rdb.uint16s.at("LVDS IO register") >> (q*4)) & 0xf;
+         uint16_t set_quartet = (set.uint16s[Uint16Param::LVDS_IO_REGISTER] >> (q*4)) & 0xf;
+         uint16_t rdb_quartet = (rdb.uint16s[Uint16Param::LVDS_IO_REGISTER] >> (q*4)) & 0xf;
 
          std::stringstream param;
          param << "LVDS IO register quartet" << q;
@@ -356,92 +864,144 @@ void VX2740FeSettings::set_and_check_lvds(int board_id, VX2740& board, BoardSett
 }
 
 void VX2740FeSettings::set_and_check_test_pulse(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_test_pulse(set.doubles.at("Test pulse period (ms)"),
-                                 set.uint32s.at("Test pulse width (ns)"),
-                                 set.uint16s.at("Test pulse low level (ADC)"),
-                                 set.uint16s.at("Test pulse high level (ADC)"));
-   board.params().get_test_pulse(rdb.doubles.at("Test pulse period (ms)"),
-                                 rdb.uint32s.at("Test pulse width (ns)"),
-                                 rdb.uint16s.at("Test pulse low level (ADC)"),
-                                 rdb.uint16s.at("Test pulse high level (ADC)"));
-   validate(set.doubles, rdb.doubles, "Test pulse period (ms)", board.get_name());
-   validate(set.uint32s, rdb.uint32s, "Test pulse width (ns)", board.get_name());
-   validate(set.uint16s, rdb.uint16s, "Test pulse low level (ADC)", board.get_name());
-   validate(set.uint16s, rdb.uint16s, "Test pulse high level (ADC)", board.get_name());
+   if (!changed(board_id, &BoardSettings::doubles, {DoubleParam::TEST_PULSE_PERIOD_MS}) &&
+         !changed(board_id, &BoardSettings::uint32s, {Uint32Param::TEST_PULSE_WIDTH_NS}) &&
+         !changed(board_id, &BoardSettings::uint16s, {Uint16Param::TEST_PULSE_LOW_LEVEL_ADC, Uint16Param::TEST_PULSE_HIGH_LEVEL_ADC})) {
+      return;
+   }
+
+   board.params().set_test_pulse(set.doubles[DoubleParam::TEST_PULSE_PERIOD_MS],
+                                 set.uint32s[Uint32Param::TEST_PULSE_WIDTH_NS],
+                                 set.uint16s[Uint16Param::TEST_PULSE_LOW_LEVEL_ADC],
+                                 set.uint16s[Uint16Param::TEST_PULSE_HIGH_LEVEL_ADC]);
+
+   if (verify_now(board_id, false)) {
+      board.params().get_test_pulse(rdb.doubles[DoubleParam::TEST_PULSE_PERIOD_MS],
+                                    rdb.uint32s[Uint32Param::TEST_PULSE_WIDTH_NS],
+                                    rdb.uint16s[Uint16Param::TEST_PULSE_LOW_LEVEL_ADC],
+                                    rdb.uint16s[Uint16Param::TEST_PULSE_HIGH_LEVEL_ADC]);
+      validate(set.doubles, rdb.doubles, DoubleParam::TEST_PULSE_PERIOD_MS, board.get_name());
+      validate(set.uint32s, rdb.uint32s, Uint32Param::TEST_PULSE_WIDTH_NS, board.get_name());
+      validate(set.uint16s, rdb.uint16s, Uint16Param::TEST_PULSE_LOW_LEVEL_ADC, board.get_name());
+      validate(set.uint16s, rdb.uint16s, Uint16Param::TEST_PULSE_HIGH_LEVEL_ADC, board.get_name());
+   }
 }
 
 void VX2740FeSettings::set_and_check_2745(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
    for (int g = 0; g < 4; g++) {
-      board.params().set_vga_gain(g, set.vec_floats.at("VGA gain")[g]);
-      board.params().get_vga_gain(g, rdb.vec_floats.at("VGA gain")[g]);
-      validate_array_element(set.vec_floats, rdb.vec_floats, "VGA gain", board.get_name(), g);
+      if (changed(board_id, &BoardSettings::vec_floats, VecFloatParam::VGA_GAIN, g)) {
+         board.params().set_vga_gain(g, set.vec_floats[VecFloatParam::VGA_GAIN][g]);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_vga_gain(g, rdb.vec_floats[VecFloatParam::VGA_GAIN][g]);
+            validate_array_element(set.vec_floats, rdb.vec_floats, VecFloatParam::VGA_GAIN, board.get_name(), g);
+         }
+      }
    }
 }
 
 void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb) {
-   board.params().set_user_register(0x44, set.uint16s.at("User registers/LVDS output"));
-   board.params().get_user_register(0x44, rdb.uint16s.at("User registers/LVDS output"));
-   validate(set.uint16s, rdb.uint16s, "User registers/LVDS output", board.get_name());
+   // Most of these registers are derived from several settings, so we
+   // track what we last wrote to each register rather than the settings.
+   if (user_register_changed(board_id, 0x44, set.uint16s[Uint16Param::UREG_LVDS_OUTPUT])) {
+      board.params().set_user_register(0x44, set.uint16s[Uint16Param::UREG_LVDS_OUTPUT]);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_user_register(0x44, rdb.uint16s[Uint16Param::UREG_LVDS_OUTPUT]);
+         validate(set.uint16s, rdb.uint16s, Uint16Param::UREG_LVDS_OUTPUT, board.get_name());
+      }
+   }
 
    uint16_t set_loopback = 0;
    uint16_t rdb_loopback = 0;
 
-   if (set.bools.at("User registers/Enable LVDS loopback")) {
+   if (set.bools[BoolParam::UREG_ENABLE_LVDS_LOOPBACK]) {
       set_loopback |= 0x1;
    }
 
-   if (set.bools.at("User registers/Enable LVDS pair 12 trigger")) {
+   if (set.bools[BoolParam::UREG_ENABLE_LVDS_PAIR_12_TRIGGER]) {
       set_loopback |= 0x2;
    }
 
-   board.params().set_user_register(0x50, set_loopback);
-   board.params().get_user_register(0x50, rdb_loopback);
-   vx2740_comparisons::validate(set_loopback, rdb_loopback, "LVDS loopback", board.get_name());
-   
-   rdb.bools.at("User registers/Enable LVDS loopback") = (rdb_loopback & 0x1);
-   rdb.bools.at("User registers/Enable LVDS pair 12 trigger") = (rdb_loopback & 0x2);
+   if (user_register_changed(board_id, 0x50, set_loopback)) {
+      board.params().set_user_register(0x50, set_loopback);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_user_register(0x50, rdb_loopback);
+         vx2740_comparisons::validate(set_loopback, rdb_loopback, "LVDS loopback", board.get_name());
+
+         rdb.bools[BoolParam::UREG_ENABLE_LVDS_LOOPBACK] = (rdb_loopback & 0x1);
+         rdb.bools[BoolParam::UREG_ENABLE_LVDS_PAIR_12_TRIGGER] = (rdb_loopback & 0x2);
+      }
+   }
 
    for (int chan = 0; chan < 64; chan++) {
       // Wavelength, Qlong, Qshort registers use "samples = reg_value * 4"
-      uint16_t set_wf_conv = set.vec_uint16s.at("User registers/Waveform length (samples)")[chan] / 4;
-      uint16_t set_qs_conv = set.vec_uint16s.at("User registers/Qshort length (samples)")[chan] / 4;
-      uint16_t set_ql_conv = set.vec_uint16s.at("User registers/Qlong length (samples)")[chan] / 4;
+      uint16_t set_wf_conv = set.vec_uint16s[VecUint16Param::UREG_WAVEFORM_LENGTH_SAMPLES][chan] / 4;
+      uint16_t set_qs_conv = set.vec_uint16s[VecUint16Param::UREG_QSHORT_LENGTH_SAMPLES][chan] / 4;
+      uint16_t set_ql_conv = set.vec_uint16s[VecUint16Param::UREG_QLONG_LENGTH_SAMPLES][chan] / 4;
       uint16_t rdb_wf_conv = 0;
       uint16_t rdb_qs_conv = 0;
       uint16_t rdb_ql_conv = 0;
 
-      board.params().set_user_register(0x300 + chan*4, set_wf_conv);
-      board.params().get_user_register(0x300 + chan*4, rdb_wf_conv);
-      board.params().set_user_register(0x400 + chan*4, set_qs_conv);
-      board.params().get_user_register(0x400 + chan*4, rdb_qs_conv);
-      board.params().set_user_register(0x500 + chan*4, set_ql_conv);
-      board.params().get_user_register(0x500 + chan*4, rdb_ql_conv);
-
-      rdb.vec_uint16s.at("User registers/Waveform length (samples)")[chan] = rdb_wf_conv * 4;
-      rdb.vec_uint16s.at("User registers/Qshort length (samples)")[chan] = rdb_qs_conv * 4;
-      rdb.vec_uint16s.at("User registers/Qlong length (samples)")[chan] = rdb_ql_conv * 4;
-      
-      validate_array_element(set.vec_uint16s, rdb.vec_uint16s, "User registers/Waveform length (samples)", board.get_name(), chan);
-      validate_array_element(set.vec_uint16s, rdb.vec_uint16s, "User registers/Qshort length (samples)", board.get_name(), chan);
-      validate_array_element(set.vec_uint16s, rdb.vec_uint16s, "User registers/Qlong length (samples)", board.get_name(), chan);
+      if (user_register_changed(board_id, 0x300 + chan*4, set_wf_conv)) {
+         board.params().set_user_register(0x300 + chan*4, set_wf_conv);
+
+         if (verify_now(board_id, true)) {
+            board.params().get_user_register(0x300 + chan*4, rdb_wf_conv);
+            rdb.vec_uint16s[VecUint16Param::UREG_WAVEFORM_LENGTH_SAMPLES][chan] = rdb_wf_conv * 4;
+            validate_array_element(set.vec_uint16s, rdb.vec_uint16s, VecUint16Param::UREG_WAVEFORM_LENGTH_SAMPLES, board.get_name(), chan);
+         }
+      }
+
+      if (user_register_changed(board_id, 0x400 + chan*4, set_qs_conv)) {
+         board.params().set_user_register(0x400 + chan*4, set_qs_conv);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x400 + chan*4, rdb_qs_conv);
+            rdb.vec_uint16s[VecUint16Param::UREG_QSHORT_LENGTH_SAMPLES][chan] = rdb_qs_conv * 4;
+            validate_array_element(set.vec_uint16s, rdb.vec_uint16s, VecUint16Param::UREG_QSHORT_LENGTH_SAMPLES, board.get_name(), chan);
+         }
+      }
+
+      if (user_register_changed(board_id, 0x500 + chan*4, set_ql_conv)) {
+         board.params().set_user_register(0x500 + chan*4, set_ql_conv);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x500 + chan*4, rdb_ql_conv);
+            rdb.vec_uint16s[VecUint16Param::UREG_QLONG_LENGTH_SAMPLES][chan] = rdb_ql_conv * 4;
+            validate_array_element(set.vec_uint16s, rdb.vec_uint16s, VecUint16Param::UREG_QLONG_LENGTH_SAMPLES, board.get_name(), chan);
+         }
+      }
    }
    
    // Filter settings
-   size_t num_coeffs = set.vec_int16s.at("User registers/FIR filter coefficients").size();
+   size_t num_coeffs = set.vec_int16s[VecInt16Param::UREG_FIR_FILTER_COEFFICIENTS].size();
+   bool any_coeff_changed = false;
    
    for (size_t coeff = 0; coeff < num_coeffs; coeff++) {
-      board.params().set_user_register(0x900 + coeff*4, set.vec_int16s.at("User registers/FIR filter coefficients")[coeff]);
-      board.params().get_user_register(0x900 + coeff*4, rdb.vec_int16s.at("User registers/FIR filter coefficients")[coeff]);
-      validate_array_element(set.vec_int16s, rdb.vec_int16s, "User registers/FIR filter coefficients", board.get_name(), coeff);
+      int16_t set_coeff = set.vec_int16s[VecInt16Param::UREG_FIR_FILTER_COEFFICIENTS][coeff];
+
+      if (user_register_changed(board_id, 0x900 + coeff*4, set_coeff)) {
+         any_coeff_changed = true;
+         board.params().set_user_register(0x900 + coeff*4, set_coeff);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x900 + coeff*4, rdb.vec_int16s[VecInt16Param::UREG_FIR_FILTER_COEFFICIENTS][coeff]);
+            validate_array_element(set.vec_int16s, rdb.vec_int16s, VecInt16Param::UREG_FIR_FILTER_COEFFICIENTS, board.get_name(), coeff);
+         }
+      }
    }
 
-   // Tell the board to load the new FIR coefficients. Self-clears, no need to check result.
-   board.params().set_user_register(0x40, 1);
+   if (any_coeff_changed) {
+      // Tell the board to load the new FIR coefficients. Self-clears, no need to check result.
+      board.params().set_user_register(0x40, 1);
+   }
 
    // Compute the gain and # upper bits to discard
    INT gain_comp_status;
    uint16_t gain, discard;
-   std::tie(gain_comp_status, gain, discard) = compute_fir_gain_and_discard(set.vec_int16s.at("User registers/FIR filter coefficients"));
+   std::tie(gain_comp_status, gain, discard) = compute_fir_gain_and_discard(set.vec_int16s[VecInt16Param::UREG_FIR_FILTER_COEFFICIENTS]);
    
    if (gain_comp_status != SUCCESS) {
       throw CaenSetParamException("Unable to compute valid FIR gain/discard for the given FIR filter coefficients");
@@ -450,35 +1010,51 @@ void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board,
    uint32_t set_gain_reg_val = gain | (((uint32_t)discard) << 16);
 
    for (int chan = 0; chan < 64; chan++) {
+      if (!user_register_changed(board_id, 0xC00 + chan*4, set_gain_reg_val)) {
+         continue;
+      }
+
       uint32_t rdb_gain_reg_val;
-      uint32_t gain_reg_val = gain | (((uint32_t)discard) << 16);
       board.params().set_user_register(0xC00 + chan*4, set_gain_reg_val);
-      board.params().get_user_register(0xC00 + chan*4, rdb_gain_reg_val);
 
-      rdb.vec_uint32s.at("User registers/FIR gain and discard")[chan] = rdb_gain_reg_val;
-      std::stringstream param;
-      param << "FIR gain and discard for chan " << chan;
-      vx2740_comparisons::validate(set_gain_reg_val, rdb_gain_reg_val, param.str(), board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_user_register(0xC00 + chan*4, rdb_gain_reg_val);
+
+         rdb.vec_uint32s[VecUint32Param::UREG_FIR_GAIN_AND_DISCARD][chan] = rdb_gain_reg_val;
+         std::stringstream param;
+         param << "FIR gain and discard for chan " << chan;
+         vx2740_comparisons::validate(set_gain_reg_val, rdb_gain_reg_val, param.str(), board.get_name());
+      }
    }
 
    for (int chan = 0; chan < 64; chan++) {
       // Pre-trigger length
-      if (set.vec_uint16s.at("User registers/Pre-trigger (samples)")[chan] > 0xFFF) {
+      if (set.vec_uint16s[VecUint16Param::UREG_PRE_TRIGGER_SAMPLES][chan] > 0xFFF) {
          throw CaenSetParamException("User registers/Pre-trigger (samples)", "Max user-mode pre-trigger length is 0xFFF samples.");
       }
 
-      board.params().set_user_register(0xB00 + chan*4, set.vec_uint16s.at("User registers/Pre-trigger (samples)")[chan]);
-      board.params().get_user_register(0xB00 + chan*4, rdb.vec_uint16s.at("User registers/Pre-trigger (samples)")[chan]);
-      validate_array_element(set.vec_uint16s, rdb.vec_uint16s, "User registers/Pre-trigger (samples)", board.get_name(), chan);
+      if (user_register_changed(board_id, 0xB00 + chan*4, set.vec_uint16s[VecUint16Param::UREG_PRE_TRIGGER_SAMPLES][chan])) {
+         board.params().set_user_register(0xB00 + chan*4, set.vec_uint16s[VecUint16Param::UREG_PRE_TRIGGER_SAMPLES][chan]);
+
+         if (verify_now(board_id, true)) {
+            board.params().get_user_register(0xB00 + chan*4, rdb.vec_uint16s[VecUint16Param::UREG_PRE_TRIGGER_SAMPLES][chan]);
+            validate_array_element(set.vec_uint16s, rdb.vec_uint16s, VecUint16Param::UREG_PRE_TRIGGER_SAMPLES, board.get_name(), chan);
+         }
+      }
 
       // Trigger settings
-      board.params().set_user_register(0x200 + chan*4, set.vec_uint16s.at("User registers/Darkside trigger threshold")[chan]);
-      board.params().get_user_register(0x200 + chan*4, rdb.vec_uint16s.at("User registers/Darkside trigger threshold")[chan]);
-      validate_array_element(set.vec_uint16s, rdb.vec_uint16s, "User registers/Darkside trigger threshold", board.get_name(), chan);
+      if (user_register_changed(board_id, 0x200 + chan*4, set.vec_uint16s[VecUint16Param::UREG_DARKSIDE_TRIGGER_THRESHOLD][chan])) {
+         board.params().set_user_register(0x200 + chan*4, set.vec_uint16s[VecUint16Param::UREG_DARKSIDE_TRIGGER_THRESHOLD][chan]);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x200 + chan*4, rdb.vec_uint16s[VecUint16Param::UREG_DARKSIDE_TRIGGER_THRESHOLD][chan]);
+            validate_array_element(set.vec_uint16s, rdb.vec_uint16s, VecUint16Param::UREG_DARKSIDE_TRIGGER_THRESHOLD, board.get_name(), chan);
+         }
+      }
    }
 
-   DWORD en_ds_lo = set.uint32s.at("User registers/Darkside trigger en mask(31-0)");
-   DWORD en_ds_hi = set.uint32s.at("User registers/Darkside trigger en mask(63-32)");
+   DWORD en_ds_lo = set.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_LO];
+   DWORD en_ds_hi = set.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_HI];
 
    uint64_t en_ovth_lo = 0;
    uint64_t en_ovth_hi = 0;
@@ -489,35 +1065,35 @@ void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board,
    uint64_t en_glob_lo = 0; 
    uint64_t en_glob_hi = 0;
 
-   if (set.bools.at("User registers/Expert mode for trig settings")) {
+   if (set.bools[BoolParam::UREG_EXPERT_MODE_FOR_TRIG_SETTINGS]) {
       // User has specified exact config
-      en_ovth_lo = set.uint32s.at("User registers/Trigger on threshold (31-0)");
-      en_ovth_hi = set.uint32s.at("User registers/Trigger on threshold (63-32)");
-      en_ext_lo = set.uint32s.at("User registers/Trigger on external (31-0)");
-      en_ext_hi = set.uint32s.at("User registers/Trigger on external (63-32)");
-      en_int_lo = set.uint32s.at("User registers/Trigger on internal (31-0)");
-      en_int_hi = set.uint32s.at("User registers/Trigger on internal (63-32)");
-      en_glob_lo = set.uint32s.at("User registers/Trigger on global (31-0)");
-      en_glob_hi = set.uint32s.at("User registers/Trigger on global (63-32)");
+      en_ovth_lo = set.uint32s[Uint32Param::UREG_TRIGGER_ON_THRESHOLD_LO];
+      en_ovth_hi = set.uint32s[Uint32Param::UREG_TRIGGER_ON_THRESHOLD_HI];
+      en_ext_lo = set.uint32s[Uint32Param::UREG_TRIGGER_ON_EXTERNAL_LO];
+      en_ext_hi = set.uint32s[Uint32Param::UREG_TRIGGER_ON_EXTERNAL_HI];
+      en_int_lo = set.uint32s[Uint32Param::UREG_TRIGGER_ON_INTERNAL_LO];
+      en_int_hi = set.uint32s[Uint32Param::UREG_TRIGGER_ON_INTERNAL_HI];
+      en_glob_lo = set.uint32s[Uint32Param::UREG_TRIGGER_ON_GLOBAL_LO];
+      en_glob_hi = set.uint32s[Uint32Param::UREG_TRIGGER_ON_GLOBAL_HI];
    } else {
       // Use the global trigger settings to also configure the user registers.
-      DWORD readout_lo = set.uint32s.at("Readout channel mask (31-0)");
-      DWORD readout_hi = set.uint32s.at("Readout channel mask (63-32)");
+      DWORD readout_lo = set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_LO];
+      DWORD readout_hi = set.uint32s[Uint32Param::READOUT_CHANNEL_MASK_HI];
 
-      if (set.bools.at("Trigger on external signal") ||
-            set.bools.at("Trigger on software signal") ||
-            set.bools.at("Trigger on test pulse") ||
-            set.bools.at("Trigger on LVDS")) {
+      if (set.bools[BoolParam::TRIGGER_ON_EXTERNAL_SIGNAL] ||
+            set.bools[BoolParam::TRIGGER_ON_SOFTWARE_SIGNAL] ||
+            set.bools[BoolParam::TRIGGER_ON_TEST_PULSE] ||
+            set.bools[BoolParam::TRIGGER_ON_LVDS]) {
          en_glob_lo |= readout_lo;
          en_glob_hi |= readout_hi;
       }
 
-      if (set.bools.at("Trigger on user mode signal")) {
+      if (set.bools[BoolParam::TRIGGER_ON_USER_MODE_SIGNAL]) {
          en_ovth_lo |= readout_lo;
          en_ovth_hi |= readout_hi;
       }
 
-      if (!set.bools.at("User registers/Only read triggering channel")) {
+      if (!set.bools[BoolParam::UREG_ONLY_READ_TRIGGERING_CHANNEL]) {
          en_int_lo |= readout_lo;
          en_int_hi |= readout_hi;
       }
@@ -538,28 +1114,42 @@ void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board,
       en_masks[i] = mask;
    }
 
-   board.params().set_user_register(0xC, en_ds_lo);
-   board.params().set_user_register(0x10, en_ds_hi);
+   if (user_register_changed(board_id, 0xC, en_ds_lo)) {
+      board.params().set_user_register(0xC, en_ds_lo);
+
+      if (verify_now(board_id, false)) {
+         board.params().get_user_register(0xC, rdb.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_LO]);
+         vx2740_comparisons::validate(en_ds_lo, rdb.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_LO], "Darkside trigger en mask(31-0)", board.get_name());
+      }
+   }
 
-   board.params().get_user_register(0xC, rdb.uint32s.at("User registers/Darkside trigger en mask(31-0)"));
-   board.params().get_user_register(0x10, rdb.uint32s.at("User registers/Darkside trigger en mask(63-32)"));
+   if (user_register_changed(board_id, 0x10, en_ds_hi)) {
+      board.params().set_user_register(0x10, en_ds_hi);
 
-   vx2740_comparisons::validate(en_ds_lo, rdb.uint32s.at("User registers/Darkside trigger en mask(31-0)"), "Darkside trigger en mask(31-0)", board.get_name());
-   vx2740_comparisons::validate(en_ds_hi, rdb.uint32s.at("User registers/Darkside trigger en mask(63-32)"), "Darkside trigger en mask(63-32)", board.get_name());
+      if (verify_now(board_id, false)) {
+         board.params().get_user_register(0x10, rdb.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_HI]);
+         vx2740_comparisons::validate(en_ds_hi, rdb.uint32s[Uint32Param::UREG_DARKSIDE_TRIGGER_EN_MASK_HI], "Darkside trigger en mask(63-32)", board.get_name());
+      }
+   }
 
    for (int chan = 0; chan < 64; chan++) {
-      board.params().set_user_register(0x600 + chan*4, en_masks[chan]);
-      board.params().get_user_register(0x600 + chan*4, rdb.vec_uint32s.at("User registers/Channel trigger sources")[chan]);
-      vx2740_comparisons::validate(en_masks[chan], rdb.vec_uint32s.at("User registers/Channel trigger sources")[chan], "User registers/Channel trigger sources", board.get_name());
+      if (user_register_changed(board_id, 0x600 + chan*4, en_masks[chan])) {
+         board.params().set_user_register(0x600 + chan*4, en_masks[chan]);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x600 + chan*4, rdb.vec_uint32s[VecUint32Param::UREG_CHANNEL_TRIGGER_SOURCES][chan]);
+            vx2740_comparisons::validate(en_masks[chan], rdb.vec_uint32s[VecUint32Param::UREG_CHANNEL_TRIGGER_SOURCES][chan], "User registers/Channel trigger sources", board.get_name());
+         }
+      }
    }
 
    // Test signal settings
-   uint64_t en_filt_lo = set.uint32s.at("User registers/Enable FIR filter (31-0)");
-   uint64_t en_filt_hi = set.uint32s.at("User registers/Enable FIR filter (63-32)");
-   uint64_t write_raw_lo = set.uint32s.at("User registers/Write unfiltered data (31-0)");
-   uint64_t write_raw_hi = set.uint32s.at("User registers/Write unfiltered data (63-32)");
+   uint64_t en_filt_lo = set.uint32s[Uint32Param::UREG_ENABLE_FIR_FILTER_LO];
+   uint64_t en_filt_hi = set.uint32s[Uint32Param::UREG_ENABLE_FIR_FILTER_HI];
+   uint64_t write_raw_lo = set.uint32s[Uint32Param::UREG_WRITE_UNFILTERED_DATA_LO];
+   uint64_t write_raw_hi = set.uint32s[Uint32Param::UREG_WRITE_UNFILTERED_DATA_HI];
 
-   if (set.bools.at("User registers/Upper 32 mirror raw of lower 32")) {
+   if (set.bools[BoolParam::UREG_UPPER_32_MIRROR_RAW_OF_LOWER_32]) {
       // Upper 32 channels should not have FIR filter enabled, as they're
       // displaying the raw version of the lower 32 channels.
       en_filt_hi = 0;
@@ -575,12 +1165,12 @@ void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board,
          test_signal[i] |= (1<<6);
       }
 
-      if (set.bools.at("User registers/Trigger on falling edge")) {
+      if (set.bools[BoolParam::UREG_TRIGGER_ON_FALLING_EDGE]) {
          // Set bit 7 (trig on falling edge)
          test_signal[i] |= (1<<7);
       }
 
-      if (set.bools.at("User registers/Upper 32 mirror raw of lower 32") && i >= 32) {
+      if (set.bools[BoolParam::UREG_UPPER_32_MIRROR_RAW_OF_LOWER_32] && i >= 32) {
          // Set bit 8 (mirror lower 32)
          test_signal[i] |= (1<<8);
       }
@@ -592,9 +1182,14 @@ void VX2740FeSettings::set_and_check_user_registers(int board_id, VX2740& board,
    }
 
    for (int chan = 0; chan < 64; chan++) {
-      board.params().set_user_register(0x700 + chan*4, test_signal[chan]);
-      board.params().get_user_register(0x700 + chan*4, rdb.vec_uint32s.at("User registers/Test signal")[chan]);
-      vx2740_comparisons::validate(test_signal[chan], rdb.vec_uint32s.at("User registers/Test signal")[chan], "User registers/Test signal", board.get_name());
+      if (user_register_changed(board_id, 0x700 + chan*4, test_signal[chan])) {
+         board.params().set_user_register(0x700 + chan*4, test_signal[chan]);
+
+         if (verify_now(board_id, false)) {
+            board.params().get_user_register(0x700 + chan*4, rdb.vec_uint32s[VecUint32Param::UREG_TEST_SIGNAL][chan]);
+            vx2740_comparisons::validate(test_signal[chan], rdb.vec_uint32s[VecUint32Param::UREG_TEST_SIGNAL][chan], "User registers/Test signal", board.get_name());
+         }
+      }
    }
 }
 
@@ -6,11 +6,16 @@
 #include "vx2740_wrapper.h"
 #include "fe_settings_strategy.h"
 #include "fe_settings_structs.h"
+#include "caen_snapshot.h"
+#include "caen_zle.h"
+#include "caen_hits.h"
 #include "midas.h"
 #include <map>
 #include <cmath>
 #include <string>
 #include <sstream>
+#include <initializer_list>
+#include <mutex>
 
 namespace vx2740_comparisons {
    // gcc only allows explicit template specializations at the namespace level,
@@ -81,6 +86,12 @@ public:
    // Will throw SettingsException if there's an issue.
    void sync_settings_structs();
 
+   // Make the next sync_settings_structs() re-read every setting, rather
+   // than just the ones the strategy knows have changed.
+   void mark_settings_dirty() {
+      strategy->mark_all_dirty();
+   }
+
    // Sync our BoardReadback structs to the ODB.
    // Will throw SettingsException if there's an issue.
    void handle_board_readback_structs();
@@ -93,10 +104,58 @@ public:
    // Will throw CaenException if there's an issue.
    void write_settings_to_board(int board_id, VX2740& board);
 
+   // Read back everything written by the last write_settings_to_board() and check
+   // it matches. For the Deferred verification policy; `board` may be a separate
+   // monitoring connection to the same board, and is never written to.
+   // `state_mutex` is held while changing our record of what's on the board;
+   // the caller must make sure nothing else writes settings to this board
+   // until we return. Will throw CaenException if there's a mismatch.
+   void verify_settings_on_board(int board_id, VX2740& board, std::mutex& state_mutex);
+
+   // Whether checks were skipped for this board in the last write_settings_to_board().
+   bool needs_deferred_verification(int board_id) {
+      return applied_state.at(board_id).deferred_pending;
+   }
+
+   // Forget what we think is on the board(s), so the next write_settings_to_board()
+   // writes every parameter. Call when a board is reconnected or reset.
+   void invalidate_applied_settings(int board_id);
+   void invalidate_applied_settings();
+
+   // Fingerprint of the settings last successfully written to a board (and
+   // fully verified), or "" if we don't know what's on the board. Stored as
+   // the tag of board snapshots.
+   std::string get_applied_settings_tag(int board_id);
+
+   // User registers as last written to a board (for snapshots, so never
+   // including the reset marker; a restored marker would hide a reset).
+   std::map<uint32_t, uint32_t> get_applied_user_registers(int board_id) {
+      std::map<uint32_t, uint32_t> regs = applied_state.at(board_id).user_registers;
+      regs.erase(get_reset_marker_register());
+      return regs;
+   }
+
+   // A snapshot has been restored to a board. If it was made from the same
+   // settings we now want, treat them as already written, so the next
+   // write_settings_to_board() only writes what differs. Returns whether
+   // the snapshot was accepted.
+   bool adopt_restored_snapshot(int board_id, const CaenSnapshot& snapshot);
+
+   // Whether the reset marker shows the board has been reset/power-cycled
+   // since settings were last applied to it. False if we can't tell.
+   bool board_was_reset(int board_id, VX2740& board) {
+      return can_mark_board(board_id) && !has_reset_marker(board_id, board);
+   }
+
+   // Record on the board that settings have been applied since its last
+   // reset (see "Reset marker user register"). No-op if it can't be marked.
+   void mark_board(int board_id, VX2740& board);
+
    // Call handle_board_readback_structs afterwards
    void set_board_firmware_info(int board_id, std::string firmware_version, std::string model_name);
    void set_board_user_firmware_info(int board_id, uint32_t user_fw_version, uint32_t user_reg_revision, bool user_upper_32_mirror_lower_32);
    void set_lvds_readback(int board_id, uint16_t lvds_ioreg, uint32_t lvds_userreg_out, uint32_t lvds_userreg_in);
+   void set_rates_readback(int board_id, const std::vector<double>& rates); // In VX2740_RATE_READBACK order
 
    // Call handle_board_errors_structs afterwards
    void set_board_errors(int board_id, BoardErrors& err);
@@ -109,20 +168,116 @@ public:
 
    std::vector<int> get_boards_to_read_from();
 
+   // Snapshot of the current settings for use during a run.
+   RunConfig freeze_run_config();
+
    inline std::string get_hostname(int board_id) {
-      return board_settings[board_id].strings.at("Hostname (restart on change)");
+      return board_settings[board_id].strings[StringParam::HOSTNAME];
    }
 
    inline bool is_scope_mode(int board_id) {
-      return board_settings[board_id].bools.at("Scope mode (restart on change)");
+      return board_settings[board_id].bools[BoolParam::SCOPE_MODE];
    }
 
    inline bool is_board_enabled(int board_id) {
-      return board_settings[board_id].bools.at("Enable");
+      return board_settings[board_id].bools[BoolParam::ENABLE];
    }
 
    inline uint32_t get_read_data_timeout(int board_id) {
-      return board_settings[board_id].uint32s.at("Read data timeout (ms)");
+      return board_settings[board_id].uint32s[Uint32Param::READ_DATA_TIMEOUT_MS];
+   }
+
+   inline uint32_t get_ring_buffer_size_mb(int board_id) {
+      return board_settings[board_id].uint32s[Uint32Param::RING_BUFFER_SIZE_MB];
+   }
+
+   inline uint32_t get_max_event_size_mb(int board_id) {
+      return board_settings[board_id].uint32s[Uint32Param::MAX_EVENT_SIZE_MB];
+   }
+
+   // Size of one event from the board with the current readout channel mask
+   // and waveform length(s), in bytes.
+   uint64_t get_expected_event_size_bytes(int board_id);
+
+   // Zero suppression is done by the frontend, and only applies in scope mode.
+   inline bool is_zle_enabled(int board_id) {
+      return board_settings[board_id].bools[BoolParam::ZLE_ENABLE] && is_scope_mode(board_id);
+   }
+
+   inline CaenZleConfig get_zle_config(int board_id) {
+      BoardSettings& set = board_settings[board_id];
+      CaenZleConfig config;
+      config.thresholds_adc = set.vec_uint16s[VecUint16Param::ZLE_THRESHOLD_ADC];
+      config.pre_samples = set.uint32s[Uint32Param::ZLE_PRE_SAMPLES];
+      config.post_samples = set.uint32s[Uint32Param::ZLE_POST_SAMPLES];
+      return config;
+   }
+
+   // Lossless compression is done by the frontend, and only applies in scope mode.
+   inline bool is_packing_enabled(int board_id) {
+      return board_settings[board_id].bools[BoolParam::COMPRESS_WAVEFORMS] && is_scope_mode(board_id);
+   }
+
+   // Pulse finding is done by the frontend, and only applies in scope mode.
+   inline bool is_hits_enabled(int board_id) {
+      return board_settings[board_id].bools[BoolParam::HITS_ENABLE] && is_scope_mode(board_id);
+   }
+
+   inline CaenHitConfig get_hit_config(int board_id) {
+      BoardSettings& set = board_settings[board_id];
+      CaenHitConfig config;
+      config.thresholds_adc = set.vec_uint16s[VecUint16Param::HITS_THRESHOLD_ADC];
+      config.qshort_samples = set.vec_uint16s[VecUint16Param::HITS_QSHORT_SAMPLES];
+      config.qlong_samples = set.vec_uint16s[VecUint16Param::HITS_QLONG_SAMPLES];
+      config.baseline_samples = set.uint32s[Uint32Param::HITS_BASELINE_SAMPLES];
+      config.negative_pulses = set.bools[BoolParam::HITS_NEGATIVE_PULSES];
+      return config;
+   }
+
+   // Keep the waveform of 1 in this many events with pulse finding (0 for none).
+   inline uint32_t get_hits_waveform_prescale(int board_id) {
+      return board_settings[board_id].uint32s[Uint32Param::HITS_WAVEFORM_PRESCALE];
+   }
+
+   inline bool adaptive_ring_buffers() {
+      return group_settings.adaptive_ring_buffers;
+   }
+
+   // Largest size adaptive ring buffers may grow to (0 for the configured size).
+   inline uint32_t get_adaptive_ring_buffer_max_mb() {
+      return group_settings.adaptive_ring_buffer_max_mb;
+   }
+
+   inline uint32_t get_ring_buffer_budget_mb() {
+      return group_settings.ring_buffer_budget_mb;
+   }
+
+   inline uint32_t get_max_config_threads() {
+      return group_settings.max_config_threads;
+   }
+
+   inline bool only_write_changed_settings() {
+      return group_settings.only_write_changed_settings;
+   }
+
+   inline uint32_t get_reset_marker_register() {
+      return group_settings.reset_marker_register;
+   }
+
+   inline VerifyPolicy get_verify_policy() {
+      return group_settings.verify_policy;
+   }
+
+   inline bool stop_run_on_verify_failure() {
+      return group_settings.stop_run_on_verify_failure;
+   }
+
+   inline std::string get_allowed_values_cache_file() {
+      return group_settings.allowed_values_cache_file;
+   }
+
+   inline std::string get_snapshot_dir() {
+      return group_settings.snapshot_dir;
    }
 
    inline bool debug_settings() {
@@ -149,28 +304,84 @@ public:
       return group_settings.multithreaded_readout;
    }
 
+   inline bool write_extended_ids() {
+      return group_settings.write_extended_ids;
+   }
+
+   inline bool channel_major_banks() {
+      return group_settings.channel_major_banks;
+   }
+
+   inline uint32_t get_batch_size_kb() {
+      return group_settings.batch_size_kb;
+   }
+
+   inline uint32_t get_batch_latency_ms() {
+      return group_settings.batch_latency_ms;
+   }
+
 protected:
    std::map<int, BoardSettings> board_settings;
    std::map<int, BoardReadback> board_readback;
    std::map<int, BoardErrors> board_errors;
+   std::map<int, AppliedBoardState> applied_state;
    GroupSettings group_settings;
 
    std::shared_ptr<VX2740FeSettingsStrategyBase> strategy;
 
+   // Whether the board has a "Reset marker user register" we can use.
+   bool can_mark_board(int board_id);
+
+   // Whether the board still has the marker written after we last applied
+   // settings to it (i.e. it hasn't been reset since). False if unreadable;
+   // true if the board can't be marked.
+   bool has_reset_marker(int board_id, VX2740& board);
+
+   // Does the actual work of write_settings_to_board().
+   void write_settings_to_board_unchecked(int board_id, VX2740& board, BoardSettings& this_board_settings, BoardReadback& this_board_readback);
+
+   // Whether any of the named settings differ from what was last applied to
+   // the board (always true if we don't have a valid record for the board).
+   template <class Table> bool changed(int board_id, Table BoardSettings::* table, std::initializer_list<typename Table::id_type> params) {
+      AppliedBoardState& applied = applied_state.at(board_id);
+      bool any_changed = !applied.valid || applied.verify_only;
+
+      for (auto it = params.begin(); it != params.end() && !any_changed; it++) {
+         any_changed = (board_settings.at(board_id).*table)[*it] != (applied.settings.*table)[*it];
+      }
+
+      any_changed ? applied.num_written++ : applied.num_skipped++;
+      return any_changed;
+   }
+
+   // As above, for a single element of an array setting.
+   template <class Table> bool changed(int board_id, Table BoardSettings::* table, typename Table::id_type param, int elem_idx) {
+      AppliedBoardState& applied = applied_state.at(board_id);
+      bool any_changed = !applied.valid || applied.verify_only || (board_settings.at(board_id).*table)[param][elem_idx] != (applied.settings.*table)[param][elem_idx];
+
+      any_changed ? applied.num_written++ : applied.num_skipped++;
+      return any_changed;
+   }
+
+   // Whether to read back and check a parameter we've just written, based
+   // on the verification policy. `critical` settings are always checked.
+   bool verify_now(int board_id, bool critical);
+
+   // Whether user register `reg` needs to be written with `val`. Records `val` as the register's value.
+   bool user_register_changed(int board_id, uint32_t reg, uint32_t val);
+
    std::tuple<INT, uint16_t, uint16_t> compute_fir_gain_and_discard(std::vector<int16_t> coeffs);
 
-   // Will throw VX2740ReadbackException if set_vals[param_name][elem_idx] != rdb_vals[param_name][elem_idx]
-   template <class T> void validate_array_element(const std::map<std::string, std::vector<T>>& set_vals, const std::map<std::string, std::vector<T>>& rdb_vals, std::string param_name, std::string board_name, int elem_idx) {
+   // Will throw VX2740ReadbackException if set_vals[param][elem_idx] != rdb_vals[param][elem_idx]
+   template <class Table> void validate_array_element(const Table& set_vals, const Table& rdb_vals, typename Table::id_type param, std::string board_name, int elem_idx) {
       std::stringstream full_name;
-      full_name << param_name << "[" << elem_idx << "]";
-      T set_val = set_vals.at(param_name)[elem_idx];
-      T rdb_val = rdb_vals.at(param_name)[elem_idx];
-      vx2740_comparisons::validate(set_val, rdb_val, full_name.str(), board_name);
+      full_name << set_vals.name(param) << "[" << elem_idx << "]";
+      vx2740_comparisons::validate(set_vals[param][elem_idx], rdb_vals[param][elem_idx], full_name.str(), board_name);
    }
 
-   // Will throw VX2740ReadbackException if set_vals[param_name] != rdb_vals[param_name]
-   template <class T> void validate(const std::map<std::string, T>& set_vals, const std::map<std::string, T>& rdb_vals, std::string param_name, std::string board_name) {
-      vx2740_comparisons::validate(set_vals.at(param_name), rdb_vals.at(param_name), param_name, board_name);
+   // Will throw VX2740ReadbackException if set_vals[param] != rdb_vals[param]
+   template <class Table> void validate(const Table& set_vals, const Table& rdb_vals, typename Table::id_type param, std::string board_name) {
+      vx2740_comparisons::validate(set_vals[param], rdb_vals[param], set_vals.name(param), board_name);
    }
 
    void set_and_check_trigger_sources(int board_id, VX2740& board, BoardSettings& set, BoardReadback& rdb);
@@ -1,14 +1,23 @@
 #include "fe_settings_strategy.h"
 #include "fe_utils.h"
 #include "caen_exceptions.h"
+#include "msystem.h"
 #include <algorithm>
+#include <cstring>
 
 VX2740FeSettingsODB::VX2740FeSettingsODB(std::string _custom_set_dir, std::string _custom_rdb_dir) :
    custom_set_dir(_custom_set_dir), 
    custom_rdb_dir(_custom_rdb_dir) {}
 
+VX2740FeSettingsODB::~VX2740FeSettingsODB() {
+   for (auto h : hWatched) {
+      db_unwatch(hDB, h);
+   }
+}
+
 void VX2740FeSettingsODB::init(bool _single_fe_mode, int _this_group_index, HNDLE _hDB) {
    odb.set_db_handle(_hDB);
+   hDB = _hDB;
 
    single_fe_mode = _single_fe_mode;
    this_group_index = _this_group_index;
@@ -65,6 +74,199 @@ void VX2740FeSettingsODB::init(bool _single_fe_mode, int _this_group_index, HNDL
    setup_group_odb();
    setup_default_odb();
    setup_board_params();
+   setup_watches();
+}
+
+void VX2740FeSettingsODB::setup_watches() {
+   for (auto h : hWatched) {
+      db_unwatch(hDB, h);
+   }
+
+   hWatched.clear();
+   mark_all_dirty();
+
+   // Board dirs are beneath the group dir. In single FE mode the defaults
+   // dir is also the group dir.
+   std::vector<HNDLE> dirs = {hGroup};
+
+   if (hDefaults != hGroup) {
+      dirs.push_back(hDefaults);
+   }
+
+   for (auto h : dirs) {
+      INT status = db_watch(hDB, h, odb_changed_callback, this);
+
+      if (status == SUCCESS) {
+         hWatched.push_back(h);
+      } else {
+         // We'll just re-read everything every time.
+         fe_utils::ts_printf("Failed to watch settings in ODB (status %d); all settings will be re-read at each begin-of-run\n", status);
+      }
+   }
+}
+
+void VX2740FeSettingsODB::mark_all_dirty() {
+   std::lock_guard<std::mutex> guard(dirty_mutex);
+   group_dirty = true;
+
+   for (int i = 0; i < num_boards; i++) {
+      boards_all_dirty.insert(i);
+   }
+
+   board_dirty_params.clear();
+   board_num_overrides.clear();
+}
+
+void VX2740FeSettingsODB::odb_changed_callback(INT hDB, INT hKey, INT index, void* info) {
+   ((VX2740FeSettingsODB*)info)->handle_odb_change(hKey);
+}
+
+void VX2740FeSettingsODB::handle_odb_change(HNDLE hKey) {
+   // Work out the setting's name relative to the dir it's in (e.g.
+   // "User registers/LVDS output"), and which dir that is.
+   std::string name;
+   HNDLE h = hKey;
+   int board_id = -1;
+   bool in_defaults = false;
+   bool in_group = false;
+   bool is_dir = false;
+
+   for (int depth = 0; h && depth < 10; depth++) {
+      for (auto& it : hBoardSettings) {
+         if (h == it.second && !single_fe_mode) {
+            board_id = it.first;
+         }
+      }
+
+      in_defaults = (h == hDefaults);
+      in_group = (h == hGroup);
+
+      if (board_id >= 0 || in_defaults || in_group) {
+         break;
+      }
+
+      KEY key;
+
+      if (db_get_key(hDB, h, &key) != SUCCESS) {
+         break;
+      }
+
+      if (h == hKey) {
+         is_dir = (key.type == TID_KEY);
+      }
+
+      name = (name == "") ? std::string(key.name) : std::string(key.name) + "/" + name;
+
+      if (db_get_parent(hDB, h, &h) != SUCCESS) {
+         break;
+      }
+   }
+
+   std::lock_guard<std::mutex> guard(dirty_mutex);
+
+   // Only told about a whole directory, so re-read all of it.
+   bool whole_dir = (name == "" || is_dir);
+
+   if (board_id >= 0) {
+      if (whole_dir) {
+         boards_all_dirty.insert(board_id);
+      } else {
+         board_dirty_params[board_id].insert(name);
+      }
+   } else if (in_defaults || in_group) {
+      if (in_group) {
+         group_dirty = true;
+      }
+
+      if (in_defaults) {
+         // Every board that doesn't override it
+         for (int i = 0; i < num_boards; i++) {
+            if (whole_dir) {
+               boards_all_dirty.insert(i);
+            } else {
+               board_dirty_params[i].insert(name);
+            }
+         }
+      }
+   } else {
+      // Something we don't understand; be safe.
+      group_dirty = true;
+
+      for (int i = 0; i < num_boards; i++) {
+         boards_all_dirty.insert(i);
+      }
+   }
+}
+
+bool VX2740FeSettingsODB::board_overrides_changed(int board_id) {
+   if (single_fe_mode || hBoardSettings.find(board_id) == hBoardSettings.end()) {
+      return false;
+   }
+
+   // Hotlinks don't reliably tell us about keys being created or deleted,
+   // so count the keys in the board's dir (including "User registers").
+   INT num_keys = 0;
+   KEY key;
+
+   if (db_get_key(hDB, hBoardSettings[board_id], &key) == SUCCESS) {
+      num_keys = key.num_values;
+   }
+
+   if (odb.has_key(hBoardSettings[board_id], "User registers")) {
+      num_keys += odb.get_key(hBoardSettings[board_id], "User registers").num_values;
+   }
+
+   std::lock_guard<std::mutex> guard(dirty_mutex);
+   auto it = board_num_overrides.find(board_id);
+   bool changed = (it == board_num_overrides.end() || it->second != num_keys);
+   board_num_overrides[board_id] = num_keys;
+   return changed;
+}
+
+bool VX2740FeSettingsODB::update_group_settings_struct(GroupSettings& group_settings) {
+   if (hWatched.size()) {
+      // Process any hotlinks that have arrived but not been dispatched yet,
+      // so a change made just before a run starts is seen.
+      ss_suspend(0, MSG_ODB);
+   }
+
+   {
+      std::lock_guard<std::mutex> guard(dirty_mutex);
+
+      if (hWatched.size() && !group_dirty) {
+         return false;
+      }
+
+      group_dirty = false;
+   }
+
+   fill_group_settings_struct(group_settings);
+   return true;
+}
+
+bool VX2740FeSettingsODB::update_board_settings_struct(BoardSettings& board_settings, int board_id) {
+   bool overrides_changed = board_overrides_changed(board_id);
+   bool all_dirty = false;
+   std::set<std::string> dirty_params;
+
+   {
+      std::lock_guard<std::mutex> guard(dirty_mutex);
+      all_dirty = overrides_changed || boards_all_dirty.count(board_id) || hWatched.empty();
+      boards_all_dirty.erase(board_id);
+      dirty_params.swap(board_dirty_params[board_id]);
+   }
+
+   if (all_dirty) {
+      fill_board_settings_struct(board_settings, board_id, NULL);
+      return true;
+   }
+
+   if (dirty_params.empty()) {
+      return false;
+   }
+
+   fill_board_settings_struct(board_settings, board_id, &dirty_params);
+   return true;
 }
 
 std::string VX2740FeSettingsODB::get_board_subdir_name(int board_id) {
@@ -115,6 +317,14 @@ std::vector<std::string> VX2740FeSettingsODB::get_history_names() {
    return history_names;
 }
 
+std::vector<std::string> VX2740FeSettingsODB::get_rate_history_names() {
+#define VX2740_RATE_HISTORY_NAME(unused, id, name, ...) std::string(name).substr(strlen("Rates/")),
+   std::vector<std::string> history_names = {"Bank version", VX2740_RATE_READBACK(VX2740_RATE_HISTORY_NAME, _)};
+#undef VX2740_RATE_HISTORY_NAME
+
+   return history_names;
+}
+
 std::vector<std::string> VX2740FeSettingsODB::get_deprecated_key_names() {
    std::vector<std::string> deprecated_keys;
    deprecated_keys.push_back("Chan over thresh majority"); // name changed
@@ -224,6 +434,32 @@ void VX2740FeSettingsODB::setup_group_odb() {
    odb.ensure_bool_exists(hGroup, "Debug settings", false);
    odb.ensure_bool_exists(hGroup, "Debug ring buffers", false);
    odb.ensure_bool_exists(hGroup, "Multi-threaded readout", true);
+   odb.ensure_bool_exists(hGroup, "Write extended event ID bank", false);
+   odb.ensure_bool_exists(hGroup, "Write channel-major data banks", false);
+   odb.ensure_bool_exists(hGroup, "Adaptive ring buffer sizes", false);
+   odb.ensure_bool_exists(hGroup, "Only write changed settings", true);
+   odb.ensure_string_exists(hGroup, "Readback verification (Full/Sampled/Deferred)", "Full");
+   odb.ensure_bool_exists(hGroup, "Stop run if deferred verification fails", true);
+   odb.ensure_string_exists(hGroup, "Allowed values cache file", "");
+   odb.ensure_string_exists(hGroup, "Snapshot directory", "");
+
+   uint32_t init_budget_mb = 0;
+   odb.ensure_key_exists_with_type(hGroup, "Ring buffer budget (MB) (0=no limit)", (void*)&init_budget_mb, sizeof(init_budget_mb), 1, TID_UINT32);
+
+   uint32_t init_adaptive_max_mb = 0;
+   odb.ensure_key_exists_with_type(hGroup, "Adaptive ring buffer max (MB) (0=configured size)", (void*)&init_adaptive_max_mb, sizeof(init_adaptive_max_mb), 1, TID_UINT32);
+
+   uint32_t init_config_threads = 0;
+   odb.ensure_key_exists_with_type(hGroup, "Max parallel config threads (0=one per board)", (void*)&init_config_threads, sizeof(init_config_threads), 1, TID_UINT32);
+
+   uint32_t init_batch_size_kb = 0;
+   odb.ensure_key_exists_with_type(hGroup, "Batch size (kB) (0=no batching)", (void*)&init_batch_size_kb, sizeof(init_batch_size_kb), 1, TID_UINT32);
+
+   uint32_t init_batch_latency_ms = 100;
+   odb.ensure_key_exists_with_type(hGroup, "Batch latency (ms)", (void*)&init_batch_latency_ms, sizeof(init_batch_latency_ms), 1, TID_UINT32);
+
+   uint32_t init_marker_reg = 0;
+   odb.ensure_key_exists_with_type(hGroup, "Reset marker user register (0=none)", (void*)&init_marker_reg, sizeof(init_marker_reg), 1, TID_UINT32);
 
    odb.set_value_string_array(hGroup, "Names", get_history_names(), 32);
 }
@@ -234,6 +470,8 @@ void VX2740FeSettingsODB::setup_board_params() {
 
    hBoardReadback.clear();
    hBoardSettings.clear();
+   published_readback.clear();
+   published_errors.clear();
 
    if (single_fe_mode) {
       num_boards = 1;
@@ -263,6 +501,13 @@ void VX2740FeSettingsODB::setup_board_params() {
          }
       }
    }
+
+   // Each board's rate bank has its own history names.
+   for (int i = 0; i < num_boards; i++) {
+      char key_name[32];
+      snprintf(key_name, sizeof(key_name), "Names R%03d", i);
+      odb.set_value_string_array(hGroup, key_name, get_rate_history_names(), 32);
+   }
 }
 
 void VX2740FeSettingsODB::fill_group_settings_struct(GroupSettings& group_settings) {
@@ -272,6 +517,32 @@ void VX2740FeSettingsODB::fill_group_settings_struct(GroupSettings& group_settin
    odb.get_value_bool(hGroup, "Debug settings", &group_settings.debug_settings);
    odb.get_value_bool(hGroup, "Debug ring buffers", &group_settings.debug_ring_buffers);
    odb.get_value_bool(hGroup, "Multi-threaded readout", &group_settings.multithreaded_readout);
+   odb.get_value_bool(hGroup, "Write extended event ID bank", &group_settings.write_extended_ids);
+   odb.get_value_bool(hGroup, "Write channel-major data banks", &group_settings.channel_major_banks);
+   odb.get_value_bool(hGroup, "Adaptive ring buffer sizes", &group_settings.adaptive_ring_buffers);
+   odb.get_value_bool(hGroup, "Only write changed settings", &group_settings.only_write_changed_settings);
+   odb.get_value_bool(hGroup, "Stop run if deferred verification fails", &group_settings.stop_run_on_verify_failure);
+
+   std::string verify_policy;
+   odb.get_value_string(hGroup, "Readback verification (Full/Sampled/Deferred)", 0, &verify_policy);
+   std::transform(verify_policy.begin(), verify_policy.end(), verify_policy.begin(), ::tolower);
+
+   if (verify_policy == "sampled") {
+      group_settings.verify_policy = VerifyPolicy::Sampled;
+   } else if (verify_policy == "deferred") {
+      group_settings.verify_policy = VerifyPolicy::Deferred;
+   } else {
+      group_settings.verify_policy = VerifyPolicy::Full;
+   }
+
+   odb.get_value_string(hGroup, "Allowed values cache file", 0, &group_settings.allowed_values_cache_file);
+   odb.get_value_string(hGroup, "Snapshot directory", 0, &group_settings.snapshot_dir);
+   odb.get_value(hGroup, "Ring buffer budget (MB) (0=no limit)", &group_settings.ring_buffer_budget_mb, sizeof(uint32_t), TID_UINT32, FALSE);
+   odb.get_value(hGroup, "Adaptive ring buffer max (MB) (0=configured size)", &group_settings.adaptive_ring_buffer_max_mb, sizeof(uint32_t), TID_UINT32, FALSE);
+   odb.get_value(hGroup, "Max parallel config threads (0=one per board)", &group_settings.max_config_threads, sizeof(uint32_t), TID_UINT32, FALSE);
+   odb.get_value(hGroup, "Batch size (kB) (0=no batching)", &group_settings.batch_size_kb, sizeof(uint32_t), TID_UINT32, FALSE);
+   odb.get_value(hGroup, "Batch latency (ms)", &group_settings.batch_latency_ms, sizeof(uint32_t), TID_UINT32, FALSE);
+   odb.get_value(hGroup, "Reset marker user register (0=none)", &group_settings.reset_marker_register, sizeof(uint32_t), TID_UINT32, FALSE);
 
    if (odb.has_key(hGroup, "Merge data using event ID")) {
       odb.get_value_bool(hGroup, "Merge data using event ID", &group_settings.merge_data_using_event_id);
@@ -298,33 +569,69 @@ HNDLE VX2740FeSettingsODB::get_board_setting_base_handle(std::string param_name,
 }
 
 void VX2740FeSettingsODB::fill_board_settings_struct(BoardSettings& board_settings, int board_id) {
+   fill_board_settings_struct(board_settings, board_id, NULL);
+}
+
+void VX2740FeSettingsODB::fill_board_settings_struct(BoardSettings& board_settings, int board_id, const std::set<std::string>* only_params) {
    HNDLE hBase;
 
+   auto skip = [&](const char* name) {
+      return only_params && only_params->find(name) == only_params->end();
+   };
+
    for (auto& s : board_settings.strings) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value_string(hBase, s.first, 0, &s.second);
    }
    for (auto& s : board_settings.bools) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
-      odb.get_value_bool(hBase, s.first, &board_settings.bools[s.first]);
+      odb.get_value_bool(hBase, s.first, &s.second);
    }
    for (auto& s : board_settings.uint16s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, &s.second, sizeof(s.second), TID_UINT16, FALSE);
    }
    for (auto& s : board_settings.uint32s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, &s.second, sizeof(s.second), TID_UINT32, FALSE);
    }
    for (auto& s : board_settings.int32s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, &s.second, sizeof(s.second), TID_INT32, FALSE);
    }
    for (auto& s : board_settings.doubles) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, &s.second, sizeof(s.second), TID_DOUBLE, FALSE);
    }
    for (auto& s : board_settings.vec_bools) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       std::vector<BOOL> tmp_bool(s.second.size());
       odb.get_value(hBase, s.first, (void*)tmp_bool.data(), sizeof(BOOL) * tmp_bool.size(), TID_BOOL);
@@ -334,22 +641,42 @@ void VX2740FeSettingsODB::fill_board_settings_struct(BoardSettings& board_settin
       }
    }
    for (auto& s : board_settings.vec_uint32s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, (void*)s.second.data(), sizeof(s.second[0]) * s.second.size(), TID_UINT32);
    }
    for (auto& s : board_settings.vec_int16s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, (void*)s.second.data(), sizeof(s.second[0]) * s.second.size(), TID_INT16);
    }
    for (auto& s : board_settings.vec_uint16s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, (void*)s.second.data(), sizeof(s.second[0]) * s.second.size(), TID_UINT16);
    }
    for (auto& s : board_settings.vec_int32s) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, (void*)s.second.data(), sizeof(s.second[0]) * s.second.size(), TID_INT32);
    }
    for (auto& s : board_settings.vec_strings) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
 
       for (size_t i = 0; i < s.second.size(); i++) {
@@ -357,12 +684,174 @@ void VX2740FeSettingsODB::fill_board_settings_struct(BoardSettings& board_settin
       }
    }
    for (auto& s : board_settings.vec_floats) {
+      if (skip(s.first)) {
+         continue;
+      }
+
       hBase = get_board_setting_base_handle(s.first, board_id);
       odb.get_value(hBase, s.first, (void*)s.second.data(), sizeof(s.second[0]) * s.second.size(), TID_FLOAT);
    }
 }
 
+namespace {
+   void append_json_value(std::string& json, const std::string& val) {
+      json += "\"";
+
+      for (char c : val) {
+         if (c == '"' || c == '\\') {
+            json += '\\';
+            json += c;
+         } else if ((unsigned char)c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            json += esc;
+         } else {
+            json += c;
+         }
+      }
+
+      json += "\"";
+   }
+
+   void append_json_value(std::string& json, bool val) {
+      json += val ? "true" : "false";
+   }
+
+   void append_json_value(std::string& json, int64_t val) {
+      json += std::to_string(val);
+   }
+
+   void append_json_value(std::string& json, uint16_t val) {
+      append_json_value(json, (int64_t)val);
+   }
+
+   void append_json_value(std::string& json, int16_t val) {
+      append_json_value(json, (int64_t)val);
+   }
+
+   void append_json_value(std::string& json, uint32_t val) {
+      append_json_value(json, (int64_t)val);
+   }
+
+   void append_json_value(std::string& json, int32_t val) {
+      append_json_value(json, (int64_t)val);
+   }
+
+   void append_json_value(std::string& json, double val) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.9g", val);
+      json += buf;
+   }
+
+   template <class T> void append_json_value(std::string& json, const std::vector<T>& vals) {
+      json += "[";
+
+      for (size_t i = 0; i < vals.size(); i++) {
+         if (i > 0) {
+            json += ",";
+         }
+
+         append_json_value(json, (T)vals[i]);
+      }
+
+      json += "]";
+   }
+
+   // Add "name": value to `fragments` for each entry of `table` that differs
+   // from `last`. Settings beneath a subdirectory ("User registers/xxx") are
+   // kept separate, as they need to be nested in the JSON.
+   template <class Table> void append_changed_json(std::map<std::string, std::string>& fragments, const Table& table, const Table& last) {
+      auto it_last = last.begin();
+
+      for (auto it = table.begin(); it != table.end(); it++, it_last++) {
+         if (it->second == it_last->second) {
+            continue;
+         }
+
+         std::string name = it->first;
+         std::string dir;
+         size_t slash = name.find('/');
+
+         if (slash != std::string::npos) {
+            dir = name.substr(0, slash);
+            name = name.substr(slash + 1);
+         }
+
+         std::string& json = fragments[dir];
+
+         if (json != "") {
+            json += ", ";
+         }
+
+         append_json_value(json, name);
+         json += ": ";
+         append_json_value(json, it->second);
+      }
+   }
+
+   std::string fragments_to_json(const std::map<std::string, std::string>& fragments) {
+      std::string json;
+
+      for (auto& it : fragments) {
+         if (json != "") {
+            json += ", ";
+         }
+
+         if (it.first == "") {
+            json += it.second;
+         } else {
+            append_json_value(json, it.first);
+            json += ": {" + it.second + "}";
+         }
+      }
+
+      return json == "" ? "" : "{" + json + "}";
+   }
+}
+
 void VX2740FeSettingsODB::handle_board_readback_struct(BoardReadback& board_readback, int board_id) {
+   auto last = published_readback.find(board_id);
+
+   if (last == published_readback.end()) {
+      // First time - write every key, creating any that don't exist yet.
+      write_all_board_readback(board_readback, board_id);
+      published_readback[board_id] = board_readback;
+      return;
+   }
+
+   // Only write what changed, in one go.
+   std::map<std::string, std::string> fragments;
+   BoardReadback& prev = last->second;
+
+   append_changed_json(fragments, board_readback.strings, prev.strings);
+   append_changed_json(fragments, board_readback.bools, prev.bools);
+   append_changed_json(fragments, board_readback.uint16s, prev.uint16s);
+   append_changed_json(fragments, board_readback.uint32s, prev.uint32s);
+   append_changed_json(fragments, board_readback.int32s, prev.int32s);
+   append_changed_json(fragments, board_readback.doubles, prev.doubles);
+   append_changed_json(fragments, board_readback.vec_bools, prev.vec_bools);
+   append_changed_json(fragments, board_readback.vec_int16s, prev.vec_int16s);
+   append_changed_json(fragments, board_readback.vec_uint16s, prev.vec_uint16s);
+   append_changed_json(fragments, board_readback.vec_uint32s, prev.vec_uint32s);
+   append_changed_json(fragments, board_readback.vec_int32s, prev.vec_int32s);
+   append_changed_json(fragments, board_readback.vec_strings, prev.vec_strings);
+   append_changed_json(fragments, board_readback.vec_floats, prev.vec_floats);
+
+   std::string json = fragments_to_json(fragments);
+
+   if (json != "") {
+      try {
+         odb.paste_json(hBoardReadback[board_id], json);
+      } catch (SettingsException& e) {
+         // Maybe someone deleted a key; recreate everything.
+         write_all_board_readback(board_readback, board_id);
+      }
+   }
+
+   prev = board_readback;
+}
+
+void VX2740FeSettingsODB::write_all_board_readback(BoardReadback& board_readback, int board_id) {
    HNDLE subkey = 0;
 
    for (auto& s : board_readback.strings) {
@@ -412,6 +901,36 @@ void VX2740FeSettingsODB::handle_board_readback_struct(BoardReadback& board_read
 }
 
 void VX2740FeSettingsODB::handle_board_errors_struct(BoardErrors& board_errors, int board_id) {
-   odb.set_value(hErrors, get_board_error_key_name(board_id, "Error flags"), &board_errors.bitmask, sizeof(uint32_t), 1, TID_UINT32);
-   odb.set_value_string(hErrors, get_board_error_key_name(board_id, "Error flags text"), board_errors.message);
+   auto last = published_errors.find(board_id);
+
+   if (last == published_errors.end()) {
+      // First time - create the keys if needed.
+      odb.set_value(hErrors, get_board_error_key_name(board_id, "Error flags"), &board_errors.bitmask, sizeof(uint32_t), 1, TID_UINT32);
+      odb.set_value_string(hErrors, get_board_error_key_name(board_id, "Error flags text"), board_errors.message);
+      published_errors[board_id] = board_errors;
+      return;
+   }
+
+   if (last->second.bitmask == board_errors.bitmask && last->second.message == board_errors.message) {
+      return;
+   }
+
+   std::string json = "{";
+   append_json_value(json, get_board_error_key_name(board_id, "Error flags"));
+   json += ": ";
+   append_json_value(json, board_errors.bitmask);
+   json += ", ";
+   append_json_value(json, get_board_error_key_name(board_id, "Error flags text"));
+   json += ": ";
+   append_json_value(json, board_errors.message);
+   json += "}";
+
+   try {
+      odb.paste_json(hErrors, json);
+   } catch (SettingsException& e) {
+      odb.set_value(hErrors, get_board_error_key_name(board_id, "Error flags"), &board_errors.bitmask, sizeof(uint32_t), 1, TID_UINT32);
+      odb.set_value_string(hErrors, get_board_error_key_name(board_id, "Error flags text"), board_errors.message);
+   }
+
+   last->second = board_errors;
 }
\ No newline at end of file
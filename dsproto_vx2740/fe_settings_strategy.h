@@ -7,6 +7,8 @@
 #include "odb_wrapper.h"
 #include "midas.h"
 #include <map>
+#include <set>
+#include <mutex>
 #include <string>
 #include <sstream>
 
@@ -19,6 +21,21 @@ public:
    virtual void fill_board_settings_struct(BoardSettings& board_settings, int board_id) = 0;
    virtual void handle_board_readback_struct(BoardReadback& board_readback, int board_id) = 0;
    virtual void handle_board_errors_struct(BoardErrors& board_errors, int board_id) = 0;
+
+   // Like the fill_xxx() functions, but strategies that can track changes may
+   // only re-read what changed since the last call. Return false if nothing changed.
+   virtual bool update_group_settings_struct(GroupSettings& group_settings) {
+      fill_group_settings_struct(group_settings);
+      return true;
+   }
+
+   virtual bool update_board_settings_struct(BoardSettings& board_settings, int board_id) {
+      fill_board_settings_struct(board_settings, board_id);
+      return true;
+   }
+
+   // Make the next update_xxx() calls re-read everything.
+   virtual void mark_all_dirty() {};
 };
 
 class VX2740FeSettingsManual : public VX2740FeSettingsStrategyBase {
@@ -38,7 +55,7 @@ public:
 class VX2740FeSettingsODB : public VX2740FeSettingsStrategyBase {
 public:
    VX2740FeSettingsODB(std::string _custom_set_dir="", std::string _custom_rdb_dir="");
-   virtual ~VX2740FeSettingsODB() {};
+   virtual ~VX2740FeSettingsODB();
 
    virtual void init(bool _single_fe_mode, int _this_group_index, HNDLE _hDB) override;
 
@@ -47,8 +64,28 @@ public:
    virtual void handle_board_readback_struct(BoardReadback& board_readback, int board_id) override;
    virtual void handle_board_errors_struct(BoardErrors& board_errors, int board_id) override;
 
+   // Only re-read settings that the ODB hotlinks say have changed.
+   virtual bool update_group_settings_struct(GroupSettings& group_settings) override;
+   virtual bool update_board_settings_struct(BoardSettings& board_settings, int board_id) override;
+   virtual void mark_all_dirty() override;
+
 protected:
+   // If `only_params` is given, only read settings with those names.
+   void fill_board_settings_struct(BoardSettings& board_settings, int board_id, const std::set<std::string>* only_params);
+
+   // Hotlinks on the defaults and group/board settings directories.
+   void setup_watches();
+   static void odb_changed_callback(INT hDB, INT hKey, INT index, void* info);
+   void handle_odb_change(HNDLE hKey);
+
+   // Write every key of the readback struct to the ODB.
+   void write_all_board_readback(BoardReadback& board_readback, int board_id);
+
+   // Whether a board override has been added or removed since we last looked.
+   bool board_overrides_changed(int board_id);
+
    std::vector<std::string> get_history_names();
+   std::vector<std::string> get_rate_history_names();
    std::vector<std::string> get_deprecated_key_names();
    std::vector<std::string> get_deprecated_user_reg_names();
 
@@ -87,6 +124,20 @@ protected:
    HNDLE hErrors;
    std::map<int, HNDLE> hBoardSettings;
    std::map<int, HNDLE> hBoardReadback;
+
+   // What has changed in the ODB since the structs were last filled.
+   // Set from the hotlink callback, so protected by `dirty_mutex`.
+   HNDLE hDB = 0;
+   std::mutex dirty_mutex;
+   std::vector<HNDLE> hWatched;
+   bool group_dirty = true;
+   std::set<int> boards_all_dirty;
+   std::map<int, std::set<std::string>> board_dirty_params;
+   std::map<int, INT> board_num_overrides;
+
+   // What we last wrote to the readback/error keys, so we only write changes.
+   std::map<int, BoardReadback> published_readback;
+   std::map<int, BoardErrors> published_errors;
 };
 
 #endif
\ No newline at end of file
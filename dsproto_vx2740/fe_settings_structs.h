@@ -2,11 +2,35 @@
 #define VX_SETTINGS_STRUCTS_H
 
 #include <map>
+#include <array>
+#include <utility>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <bitset>
 #include <inttypes.h>
 
+#define VX2740_MAX_BOARDS_PER_GROUP 64
+
+// How much of what we write to the boards is read back and checked
+// while writing. Settings that affect data correctness are always
+// checked immediately.
+// * Full - check everything immediately
+// * Sampled - check a rotating 1-in-VX2740_VERIFY_SAMPLE_INTERVAL subset
+// * Deferred - check everything in the background once the boards are armed
+enum class VerifyPolicy {
+   Full,
+   Sampled,
+   Deferred
+};
+
+#define VX2740_VERIFY_SAMPLE_INTERVAL 8
+
+// Written to the "Reset marker user register" of each board once its
+// settings have been applied. Anything but 0 (the value after a reset).
+#define VX2740_RESET_MARKER 0x5658524D
+
 typedef struct GroupSettings {
    int32_t num_boards = 1;
    bool merge_data_using_event_id = false;
@@ -15,166 +39,464 @@ typedef struct GroupSettings {
    bool debug_settings = false;
    bool debug_ring_buffers = false;
    bool multithreaded_readout = true;
+   bool write_extended_ids = false;
+   bool channel_major_banks = false;
+   bool adaptive_ring_buffers = false;
+   uint32_t ring_buffer_budget_mb = 0; // 0 means no limit
+   uint32_t adaptive_ring_buffer_max_mb = 0; // 0 means the configured size
+   uint32_t max_config_threads = 0; // 0 means one per board
+   uint32_t batch_size_kb = 0; // 0 means one board event per midas event
+   uint32_t batch_latency_ms = 100;
+   bool only_write_changed_settings = true;
+   uint32_t reset_marker_register = 0; // 0 means no marker
+   VerifyPolicy verify_policy = VerifyPolicy::Full;
+   bool stop_run_on_verify_failure = true;
+   std::string allowed_values_cache_file; // Empty means don't persist
+   std::string snapshot_dir; // Empty means don't save/restore board snapshots
 } GroupSettings;
 
+// Settings needed by the readout/writer threads, frozen at begin-of-run
+// so the data path doesn't need to look anything up by name.
+typedef struct RunConfig {
+   std::bitset<VX2740_MAX_BOARDS_PER_GROUP> boards_enabled;
+   std::bitset<VX2740_MAX_BOARDS_PER_GROUP> boards_to_read;
+   std::vector<int> boards_enabled_list;
+   std::vector<int> boards_to_read_list;
+   std::vector<int> read_data_timeout_ms; // Indexed by board ID
+   bool merge_data = false;
+   bool debug_data = false;
+   bool debug_rates = false;
+   bool debug_ring_buffers = false;
+   bool multithreaded_readout = true;
+   bool write_extended_ids = false;
+   bool channel_major_banks = false;
+   size_t batch_size_bytes = 0; // 0 means no batching
+   uint32_t batch_latency_ms = 0;
+} RunConfig;
+
 typedef struct BoardErrors {
    uint32_t bitmask = 0;
    std::string message;
 } BoardErrors;
 
+// Board-level settings schema. Each list below defines the settings of one
+// type, as X(..., ID, "ODB name", default) for single values or
+// X(..., ID, "ODB name", array length, default) for arrays. The enums used to
+// index BoardSettings, the ODB key names and the default values are all
+// generated from these lists.
+//
 // To add a new board-level setting (of an existing type):
-// * Add it the BoardSettings struct
+// * Add it to the relevant list
 // * Implement writing it to the board in VX2740FeSettings::write_settings_to_board()
 // * Add it to the webpage in custom/vx2740.js
 //
+// Values that are only read back from the board (and not set by the user)
+// go in the *_READBACK lists, and only appear in BoardReadback.
+//
 // To add a new *type* of board-level setting:
-// * Add a map to the BoardSettings struct
+// * Add new lists and a table to the BoardSettings struct
 // * Implement default ODB in VX2740FeSettingsODB::setup_default_odb()
 // * Implement ODB->Struct in VX2740FeSettingsODB::fill_board_settings_struct()
 // * Implement Struct->ODB in VX2740FeSettingsODB::handle_board_readback_struct()
+
+
+#define VX2740_STRING_SETTINGS(X, ...) \
+   X(__VA_ARGS__, HOSTNAME, "Hostname (restart on change)", "") \
+   X(__VA_ARGS__, TRIGGER_ID_MODE, "Trigger ID mode", "TriggerCnt") \
+   X(__VA_ARGS__, TRIGGER_OUT_MODE, "Trigger out mode", "TRGIN") \
+   X(__VA_ARGS__, GPIO_MODE, "GPIO mode", "Disabled") \
+   X(__VA_ARGS__, SYNC_OUT_MODE, "Sync out mode", "Disabled") \
+   X(__VA_ARGS__, BUSY_IN_SOURCE, "Busy in source", "Disabled") \
+   X(__VA_ARGS__, VETO_SOURCE, "Veto source", "Disabled")
+
+#define VX2740_STRING_READBACK(X, ...) \
+   X(__VA_ARGS__, FIRMWARE_VERSION, "Firmware version", "???") \
+   X(__VA_ARGS__, MODEL_NAME, "Model name", "???")
+
+#define VX2740_BOOL_SETTINGS(X, ...) \
+   X(__VA_ARGS__, ENABLE, "Enable", true) \
+   X(__VA_ARGS__, READ_DATA, "Read data", true) \
+   X(__VA_ARGS__, SCOPE_MODE, "Scope mode (restart on change)", true) \
+   X(__VA_ARGS__, USE_NIM_IO, "Use NIM IO", true) \
+   X(__VA_ARGS__, START_ACQ_ON_MIDAS_RUN_START, "Start acq on midas run start", true) \
+   X(__VA_ARGS__, START_ACQ_ON_ENCODED_CLKIN, "Start acq on encoded CLKIN", false) \
+   X(__VA_ARGS__, START_ACQ_ON_SIN_LEVEL, "Start acq on SIN level", false) \
+   X(__VA_ARGS__, START_ACQ_ON_SIN_EDGE, "Start acq on SIN edge", false) \
+   X(__VA_ARGS__, START_ACQ_ON_FIRST_TRIGGER, "Start acq on first trigger", false) \
+   X(__VA_ARGS__, START_ACQ_ON_P0, "Start acq on P0", false) \
+   X(__VA_ARGS__, START_ACQ_ON_LVDS, "Start acq on LVDS", false) \
+   X(__VA_ARGS__, TRIGGER_ON_CH_OVER_THRESH_A, "Trigger on ch over thresh A", false) \
+   X(__VA_ARGS__, TRIGGER_ON_CH_OVER_THRESH_B, "Trigger on ch over thresh B", false) \
+   X(__VA_ARGS__, TRIGGER_ON_CH_OVER_THRESH_A_AND_B, "Trigger on ch over thresh A&&B", false) \
+   X(__VA_ARGS__, TRIGGER_ON_EXTERNAL_SIGNAL, "Trigger on external signal", true) \
+   X(__VA_ARGS__, TRIGGER_ON_SOFTWARE_SIGNAL, "Trigger on software signal", true) \
+   X(__VA_ARGS__, TRIGGER_ON_USER_MODE_SIGNAL, "Trigger on user mode signal", false) \
+   X(__VA_ARGS__, TRIGGER_ON_TEST_PULSE, "Trigger on test pulse", false) \
+   X(__VA_ARGS__, TRIGGER_ON_LVDS, "Trigger on LVDS", false) \
+   X(__VA_ARGS__, ALLOW_TRIGGER_OVERLAP, "Allow trigger overlap", false) \
+   X(__VA_ARGS__, ENABLE_DC_OFFSETS, "Enable DC offsets", true) \
+   X(__VA_ARGS__, USE_EXTERNAL_CLOCK, "Use external clock", false) \
+   X(__VA_ARGS__, ENABLE_CLOCK_OUT, "Enable clock out", false) \
+   X(__VA_ARGS__, VETO_WHEN_SOURCE_IS_HIGH, "Veto when source is high", true) \
+   X(__VA_ARGS__, USE_RELATIVE_TRIG_THRESHOLDS, "Use relative trig thresholds", false) \
+   X(__VA_ARGS__, READ_FAKE_SINEWAVE_DATA, "Read fake sinewave data", false) \
+   X(__VA_ARGS__, UREG_EXPERT_MODE_FOR_TRIG_SETTINGS, "User registers/Expert mode for trig settings", false) \
+   X(__VA_ARGS__, UREG_ENABLE_LVDS_LOOPBACK, "User registers/Enable LVDS loopback", false) \
+   X(__VA_ARGS__, UREG_ONLY_READ_TRIGGERING_CHANNEL, "User registers/Only read triggering channel", true) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_FALLING_EDGE, "User registers/Trigger on falling edge", true) \
+   X(__VA_ARGS__, UREG_UPPER_32_MIRROR_RAW_OF_LOWER_32, "User registers/Upper 32 mirror raw of lower 32", true) \
+   X(__VA_ARGS__, UREG_ENABLE_LVDS_PAIR_12_TRIGGER, "User registers/Enable LVDS pair 12 trigger", false) \
+   X(__VA_ARGS__, ZLE_ENABLE, "Zero suppression/Enable", false) \
+   X(__VA_ARGS__, COMPRESS_WAVEFORMS, "Compress waveforms (lossless)", false) \
+   X(__VA_ARGS__, HITS_ENABLE, "Pulse finding/Enable", false) \
+   X(__VA_ARGS__, HITS_NEGATIVE_PULSES, "Pulse finding/Negative pulses", true)
+
+#define VX2740_BOOL_READBACK(X, ...) \
+   X(__VA_ARGS__, UPPER_32_MIRROR_RAW_OF_LOWER_32, "Upper 32 mirror raw of lower 32", false)
+
+#define VX2740_UINT32_SETTINGS(X, ...) \
+   X(__VA_ARGS__, READ_DATA_TIMEOUT_MS, "Read data timeout (ms)", 100) \
+   X(__VA_ARGS__, RING_BUFFER_SIZE_MB, "Ring buffer size (MB)", 1000) \
+   X(__VA_ARGS__, MAX_EVENT_SIZE_MB, "Max event size (MB)", 320) \
+   X(__VA_ARGS__, READOUT_CHANNEL_MASK_LO, "Readout channel mask (31-0)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, READOUT_CHANNEL_MASK_HI, "Readout channel mask (63-32)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, WAVEFORM_LENGTH_SAMPLES, "Waveform length (samples)", 1000) \
+   X(__VA_ARGS__, TRIGGER_DELAY_SAMPLES, "Trigger delay (samples)", 0) \
+   X(__VA_ARGS__, CH_OVER_THRESH_A_MULTIPLICITY, "Ch over thresh A multiplicity", 1) \
+   X(__VA_ARGS__, CH_OVER_THRESH_A_EN_MASK_LO, "Ch over thresh A en mask(31-0)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, CH_OVER_THRESH_A_EN_MASK_HI, "Ch over thresh A en mask(63-32)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, CH_OVER_THRESH_B_MULTIPLICITY, "Ch over thresh B multiplicity", 1) \
+   X(__VA_ARGS__, CH_OVER_THRESH_B_EN_MASK_LO, "Ch over thresh B en mask(31-0)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, CH_OVER_THRESH_B_EN_MASK_HI, "Ch over thresh B en mask(63-32)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, VETO_WIDTH_NS, "Veto width (ns) (0=source len)", 0) \
+   X(__VA_ARGS__, TEST_PULSE_WIDTH_NS, "Test pulse width (ns)", 104) \
+   X(__VA_ARGS__, RUN_START_DELAY_CYCLES, "Run start delay (cycles)", 0) \
+   X(__VA_ARGS__, UREG_DARKSIDE_TRIGGER_EN_MASK_LO, "User registers/Darkside trigger en mask(31-0)", 0) \
+   X(__VA_ARGS__, UREG_DARKSIDE_TRIGGER_EN_MASK_HI, "User registers/Darkside trigger en mask(63-32)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_THRESHOLD_LO, "User registers/Trigger on threshold (31-0)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_THRESHOLD_HI, "User registers/Trigger on threshold (63-32)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_EXTERNAL_LO, "User registers/Trigger on external (31-0)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_EXTERNAL_HI, "User registers/Trigger on external (63-32)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_INTERNAL_LO, "User registers/Trigger on internal (31-0)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_INTERNAL_HI, "User registers/Trigger on internal (63-32)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_GLOBAL_LO, "User registers/Trigger on global (31-0)", 0) \
+   X(__VA_ARGS__, UREG_TRIGGER_ON_GLOBAL_HI, "User registers/Trigger on global (63-32)", 0) \
+   X(__VA_ARGS__, UREG_ENABLE_FIR_FILTER_LO, "User registers/Enable FIR filter (31-0)", 0) \
+   X(__VA_ARGS__, UREG_ENABLE_FIR_FILTER_HI, "User registers/Enable FIR filter (63-32)", 0) \
+   X(__VA_ARGS__, UREG_WRITE_UNFILTERED_DATA_LO, "User registers/Write unfiltered data (31-0)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, UREG_WRITE_UNFILTERED_DATA_HI, "User registers/Write unfiltered data (63-32)", 0xFFFFFFFF) \
+   X(__VA_ARGS__, ZLE_PRE_SAMPLES, "Zero suppression/Pre samples", 16) \
+   X(__VA_ARGS__, ZLE_POST_SAMPLES, "Zero suppression/Post samples", 16) \
+   X(__VA_ARGS__, HITS_BASELINE_SAMPLES, "Pulse finding/Baseline samples", 16) \
+   X(__VA_ARGS__, HITS_WAVEFORM_PRESCALE, "Pulse finding/Waveform prescale (0=none)", 1)
+
+#define VX2740_UINT32_READBACK(X, ...) \
+   X(__VA_ARGS__, USER_FW_REVISION, "User FW revision", 0) \
+   X(__VA_ARGS__, USER_REGISTER_REVISION, "User register revision", 0) \
+   X(__VA_ARGS__, UREG_LVDS_INPUT, "User registers/LVDS input", 0)
+
+#define VX2740_UINT16_SETTINGS(X, ...) \
+   X(__VA_ARGS__, PRE_TRIGGER_SAMPLES, "Pre-trigger (samples)", 100) \
+   X(__VA_ARGS__, LVDS_IO_REGISTER, "LVDS IO register", 0) \
+   X(__VA_ARGS__, TEST_PULSE_LOW_LEVEL_ADC, "Test pulse low level (ADC)", 0) \
+   X(__VA_ARGS__, TEST_PULSE_HIGH_LEVEL_ADC, "Test pulse high level (ADC)", 1000) \
+   X(__VA_ARGS__, UREG_LVDS_OUTPUT, "User registers/LVDS output", 0)
+
+#define VX2740_UINT16_READBACK(X, ...)
+
+#define VX2740_DOUBLE_SETTINGS(X, ...) \
+   X(__VA_ARGS__, TEST_PULSE_PERIOD_MS, "Test pulse period (ms)", 100)
+
+// Rates computed by the frontend from the data it reads (not from the board).
+// Also written, in this order, to the R%03d bank of the metadata event after
+// a version word; bump VX2740_RATE_BANK_VERSION if the list changes.
+#define VX2740_RATE_BANK_VERSION 1
+
+#define VX2740_RATE_READBACK(X, ...) \
+   X(__VA_ARGS__, RATE_EVENTS_HZ, "Rates/Event rate (Hz)", 0) \
+   X(__VA_ARGS__, RATE_DATA_MB_PER_SEC, "Rates/Data rate (MB/s)", 0) \
+   X(__VA_ARGS__, RATE_MISSED_TRIGGERS, "Rates/Missed triggers", 0) \
+   X(__VA_ARGS__, RATE_MISSED_TRIGGERS_RUN, "Rates/Missed triggers (run)", 0) \
+   X(__VA_ARGS__, RATE_MEAN_TRIGGER_GAP_US, "Rates/Mean trigger gap (us)", 0) \
+   X(__VA_ARGS__, RATE_MAX_TRIGGER_GAP_US, "Rates/Max trigger gap (us)", 0) \
+   X(__VA_ARGS__, RATE_RB_FILL_PCT, "Rates/Ring buffer fill (pct)", 0) \
+   X(__VA_ARGS__, RATE_RB_FULL_PCT, "Rates/RB full deadtime (pct)", 0)
+
+#define VX2740_DOUBLE_READBACK(X, ...) VX2740_RATE_READBACK(X, __VA_ARGS__)
+
+#define VX2740_INT32_SETTINGS(X, ...)
+
+#define VX2740_INT32_READBACK(X, ...)
+
+#define VX2740_VEC_BOOL_SETTINGS(X, ...) \
+   X(__VA_ARGS__, LVDS_QUARTET_IS_INPUT, "LVDS quartet is input", 4, false) \
+   X(__VA_ARGS__, CHAN_OVER_THRESH_RISING_EDGE, "Chan over thresh rising edge", 64, false)
+
+#define VX2740_VEC_BOOL_READBACK(X, ...)
+
+#define VX2740_VEC_STRING_SETTINGS(X, ...) \
+   X(__VA_ARGS__, LVDS_QUARTET_MODE, "LVDS quartet mode", 4, "SelfTriggers")
+
+#define VX2740_VEC_STRING_READBACK(X, ...)
+
+#define VX2740_VEC_INT16_SETTINGS(X, ...) \
+   X(__VA_ARGS__, UREG_FIR_FILTER_COEFFICIENTS, "User registers/FIR filter coefficients", 48, 1)
+
+#define VX2740_VEC_INT16_READBACK(X, ...)
+
+#define VX2740_VEC_UINT16_SETTINGS(X, ...) \
+   X(__VA_ARGS__, UREG_WAVEFORM_LENGTH_SAMPLES, "User registers/Waveform length (samples)", 64, 1000) \
+   X(__VA_ARGS__, UREG_PRE_TRIGGER_SAMPLES, "User registers/Pre-trigger (samples)", 64, 100) \
+   X(__VA_ARGS__, UREG_DARKSIDE_TRIGGER_THRESHOLD, "User registers/Darkside trigger threshold", 64, 32000) \
+   X(__VA_ARGS__, UREG_QSHORT_LENGTH_SAMPLES, "User registers/Qshort length (samples)", 64, 16) \
+   X(__VA_ARGS__, UREG_QLONG_LENGTH_SAMPLES, "User registers/Qlong length (samples)", 64, 32) \
+   X(__VA_ARGS__, ZLE_THRESHOLD_ADC, "Zero suppression/Threshold (ADC)", 64, 100) \
+   X(__VA_ARGS__, HITS_THRESHOLD_ADC, "Pulse finding/Threshold (ADC)", 64, 100) \
+   X(__VA_ARGS__, HITS_QSHORT_SAMPLES, "Pulse finding/Qshort length (samples)", 64, 16) \
+   X(__VA_ARGS__, HITS_QLONG_SAMPLES, "Pulse finding/Qlong length (samples)", 64, 32)
+
+#define VX2740_VEC_UINT16_READBACK(X, ...)
+
+#define VX2740_VEC_UINT32_SETTINGS(X, ...) \
+   X(__VA_ARGS__, LVDS_TRIGGER_MASK_LO, "LVDS trigger mask (31-0)", 16, 0xFFFFFFFF) \
+   X(__VA_ARGS__, LVDS_TRIGGER_MASK_HI, "LVDS trigger mask (63-32)", 16, 0xFFFFFFFF) \
+   X(__VA_ARGS__, CHAN_OVER_THRESH_WIDTH_NS, "Chan over thresh width (ns)", 64, 0)
+
+#define VX2740_VEC_UINT32_READBACK(X, ...) \
+   X(__VA_ARGS__, UREG_FIR_GAIN_AND_DISCARD, "User registers/FIR gain and discard", 64, 0) \
+   X(__VA_ARGS__, UREG_CHANNEL_TRIGGER_SOURCES, "User registers/Channel trigger sources", 64, 0) \
+   X(__VA_ARGS__, UREG_TEST_SIGNAL, "User registers/Test signal", 64, 0)
+
+#define VX2740_VEC_INT32_SETTINGS(X, ...) \
+   X(__VA_ARGS__, CHAN_OVER_THRESH_THRESHOLDS, "Chan over thresh thresholds", 64, 32768)
+
+#define VX2740_VEC_INT32_READBACK(X, ...)
+
+#define VX2740_VEC_FLOAT_SETTINGS(X, ...) \
+   X(__VA_ARGS__, DC_OFFSET_PCT, "DC offset (pct)", 64, 50) \
+   X(__VA_ARGS__, VGA_GAIN, "VGA gain", 4, 2.5)
+
+#define VX2740_VEC_FLOAT_READBACK(X, ...)
+
+#define VX2740_SCHEMA_ENUM(unused, id, ...) id,
+#define VX2740_SCHEMA_COUNT(unused, id, ...) + 1
+#define VX2740_SCHEMA_INIT(table, active, id, name, val) table.init(decltype(table)::id_type::id, name, val, active);
+#define VX2740_SCHEMA_INIT_VEC(table, active, id, name, len, val) table.init(decltype(table)::id_type::id, name, decltype(table)::value_type(len, val), active);
+
+enum class StringParam { VX2740_STRING_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_STRING_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class BoolParam { VX2740_BOOL_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_BOOL_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class Uint32Param { VX2740_UINT32_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_UINT32_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class Uint16Param { VX2740_UINT16_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_UINT16_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class DoubleParam { VX2740_DOUBLE_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_DOUBLE_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class Int32Param { VX2740_INT32_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_INT32_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecBoolParam { VX2740_VEC_BOOL_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_BOOL_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecStringParam { VX2740_VEC_STRING_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_STRING_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecInt16Param { VX2740_VEC_INT16_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_INT16_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecUint16Param { VX2740_VEC_UINT16_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_UINT16_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecUint32Param { VX2740_VEC_UINT32_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_UINT32_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecInt32Param { VX2740_VEC_INT32_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_INT32_READBACK(VX2740_SCHEMA_ENUM, _) };
+enum class VecFloatParam { VX2740_VEC_FLOAT_SETTINGS(VX2740_SCHEMA_ENUM, _) VX2740_VEC_FLOAT_READBACK(VX2740_SCHEMA_ENUM, _) };
+
+#define VX2740_NUM_STRING_PARAMS (0 VX2740_STRING_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_STRING_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_BOOL_PARAMS (0 VX2740_BOOL_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_BOOL_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_UINT32_PARAMS (0 VX2740_UINT32_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_UINT32_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_UINT16_PARAMS (0 VX2740_UINT16_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_UINT16_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_DOUBLE_PARAMS (0 VX2740_DOUBLE_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_DOUBLE_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_INT32_PARAMS (0 VX2740_INT32_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_INT32_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_BOOL_PARAMS (0 VX2740_VEC_BOOL_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_BOOL_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_STRING_PARAMS (0 VX2740_VEC_STRING_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_STRING_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_INT16_PARAMS (0 VX2740_VEC_INT16_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_INT16_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_UINT16_PARAMS (0 VX2740_VEC_UINT16_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_UINT16_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_UINT32_PARAMS (0 VX2740_VEC_UINT32_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_UINT32_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_INT32_PARAMS (0 VX2740_VEC_INT32_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_INT32_READBACK(VX2740_SCHEMA_COUNT, _))
+#define VX2740_NUM_VEC_FLOAT_PARAMS (0 VX2740_VEC_FLOAT_SETTINGS(VX2740_SCHEMA_COUNT, _) VX2740_VEC_FLOAT_READBACK(VX2740_SCHEMA_COUNT, _))
+
+// Fixed set of named settings of one type, stored in an array indexed by an
+// enum generated from the schema. Can also be looked up by ODB name (slower),
+// and iterated over as (name, value) pairs like the std::map it replaces.
+// Only the first `num_active` entries are visible by name or when iterating;
+// the readback-only entries at the end are activated by BoardReadback.
+template <class T, class E, size_t N> class SettingsTable {
+public:
+   typedef T value_type;
+   typedef E id_type;
+   typedef std::pair<const char*, T> Entry;
+
+   T& operator[](E id) {
+      return entries[(size_t)id].second;
+   }
+
+   const T& operator[](E id) const {
+      return entries[(size_t)id].second;
+   }
+
+   T& at(E id) {
+      return entries[(size_t)id].second;
+   }
+
+   const T& at(E id) const {
+      return entries[(size_t)id].second;
+   }
+
+   // ODB name of a setting.
+   const char* name(E id) const {
+      return entries[(size_t)id].first;
+   }
+
+   // Throws std::out_of_range if there's no such setting.
+   T& at(const std::string& name) {
+      return entries[index_of(name)].second;
+   }
+
+   const T& at(const std::string& name) const {
+      return entries[index_of(name)].second;
+   }
+
+   T& operator[](const std::string& name) {
+      return at(name);
+   }
+
+   Entry* begin() {
+      return entries.data();
+   }
+
+   Entry* end() {
+      return entries.data() + num_active;
+   }
+
+   const Entry* begin() const {
+      return entries.data();
+   }
+
+   const Entry* end() const {
+      return entries.data() + num_active;
+   }
+
+   size_t size() const {
+      return num_active;
+   }
+
+   bool operator==(const SettingsTable& other) const {
+      for (size_t i = 0; i < N; i++) {
+         if (!(entries[i].second == other.entries[i].second)) {
+            return false;
+         }
+      }
+
+      return true;
+   }
+
+   bool operator!=(const SettingsTable& other) const {
+      return !(*this == other);
+   }
+
+   void init(E id, const char* name, const T& val, bool active) {
+      entries[(size_t)id] = Entry(name, val);
+
+      if (active && (size_t)id >= num_active) {
+         num_active = (size_t)id + 1;
+      }
+   }
+
+   void activate_all() {
+      num_active = N;
+   }
+
+protected:
+   size_t index_of(const std::string& name) const {
+      for (size_t i = 0; i < num_active; i++) {
+         if (name == entries[i].first) {
+            return i;
+         }
+      }
+
+      throw std::out_of_range("Unknown setting " + name);
+   }
+
+   std::array<Entry, N> entries;
+   size_t num_active = 0;
+};
+
 typedef struct BoardSettings {
-   std::map<std::string, std::string> strings = {
-      {"Hostname (restart on change)", ""},
-      {"Trigger ID mode", "TriggerCnt"},
-      {"Trigger out mode", "TRGIN"},
-      {"GPIO mode", "Disabled"},
-      {"Sync out mode", "Disabled"},
-      {"Busy in source", "Disabled"},
-      {"Veto source", "Disabled"}
-   };
-
-   std::map<std::string, bool> bools = {
-      {"Enable", true},
-      {"Read data", true},
-      {"Scope mode (restart on change)", true},
-      {"Use NIM IO", true},
-      {"Start acq on midas run start", true},
-      {"Start acq on encoded CLKIN", false},
-      {"Start acq on SIN level", false},
-      {"Start acq on SIN edge", false},
-      {"Start acq on first trigger", false},
-      {"Start acq on P0", false},
-      {"Start acq on LVDS", false},
-      {"Trigger on ch over thresh A", false},
-      {"Trigger on ch over thresh B", false},
-      {"Trigger on ch over thresh A&&B", false},
-      {"Trigger on external signal", true},
-      {"Trigger on software signal", true},
-      {"Trigger on user mode signal", false},
-      {"Trigger on test pulse", false},
-      {"Trigger on LVDS", false},
-      {"Allow trigger overlap", false},
-      {"Enable DC offsets", true},
-      {"Use external clock", false},
-      {"Enable clock out", false},
-      {"Veto when source is high", true},
-      {"Use relative trig thresholds", false},
-      {"Read fake sinewave data", false},
-      {"User registers/Expert mode for trig settings", false},
-      {"User registers/Enable LVDS loopback", false},
-      {"User registers/Only read triggering channel", true},
-      {"User registers/Trigger on falling edge", true},
-      {"User registers/Upper 32 mirror raw of lower 32", true},
-      {"User registers/Enable LVDS pair 12 trigger", false}
-   };
-
-   std::map<std::string, uint32_t> uint32s = {
-      {"Read data timeout (ms)", 100},
-      {"Readout channel mask (31-0)", 0xFFFFFFFF},
-      {"Readout channel mask (63-32)", 0xFFFFFFFF},
-      {"Waveform length (samples)", 1000},
-      {"Trigger delay (samples)", 0},
-      {"Ch over thresh A multiplicity", 1},
-      {"Ch over thresh A en mask(31-0)", 0xFFFFFFFF},
-      {"Ch over thresh A en mask(63-32)", 0xFFFFFFFF},
-      {"Ch over thresh B multiplicity", 1},
-      {"Ch over thresh B en mask(31-0)", 0xFFFFFFFF},
-      {"Ch over thresh B en mask(63-32)", 0xFFFFFFFF},
-      {"Veto width (ns) (0=source len)", 0},
-      {"Test pulse width (ns)", 104},
-      {"Run start delay (cycles)", 0},
-      {"User registers/Darkside trigger en mask(31-0)", 0},
-      {"User registers/Darkside trigger en mask(63-32)", 0},
-      {"User registers/Trigger on threshold (31-0)", 0},
-      {"User registers/Trigger on threshold (63-32)", 0},
-      {"User registers/Trigger on external (31-0)", 0},
-      {"User registers/Trigger on external (63-32)", 0},
-      {"User registers/Trigger on internal (31-0)", 0},
-      {"User registers/Trigger on internal (63-32)", 0},
-      {"User registers/Trigger on global (31-0)", 0},
-      {"User registers/Trigger on global (63-32)", 0},
-      {"User registers/Enable FIR filter (31-0)", 0},
-      {"User registers/Enable FIR filter (63-32)", 0},
-      {"User registers/Write unfiltered data (31-0)", 0xFFFFFFFF},
-      {"User registers/Write unfiltered data (63-32)", 0xFFFFFFFF}
-   };
-
-   std::map<std::string, uint16_t> uint16s = {
-      {"Pre-trigger (samples)", 100},
-      {"LVDS IO register", 0},
-      {"Test pulse low level (ADC)", 0},
-      {"Test pulse high level (ADC)", 1000},
-      {"User registers/LVDS output", 0}
-   };
-
-   std::map<std::string, double> doubles = {
-      {"Test pulse period (ms)", 100}
-   };
-
-   std::map<std::string, int32_t> int32s = {
-   };
-
-   std::map<std::string, std::vector<bool>> vec_bools = {
-      {"LVDS quartet is input", std::vector<bool>(4, false)},
-      {"Chan over thresh rising edge", std::vector<bool>(64, false)}
-   };
-
-   std::map<std::string, std::vector<std::string>> vec_strings = {
-      {"LVDS quartet mode", std::vector<std::string>(4, "SelfTriggers")}
-   };
-
-   std::map<std::string, std::vector<int16_t>> vec_int16s = {
-      {"User registers/FIR filter coefficients", std::vector<int16_t>(48, 1)}
-   };
-
-   std::map<std::string, std::vector<uint16_t>> vec_uint16s = {
-      {"User registers/Waveform length (samples)", std::vector<uint16_t>(64, 1000)},
-      {"User registers/Pre-trigger (samples)", std::vector<uint16_t>(64, 100)},
-      {"User registers/Darkside trigger threshold", std::vector<uint16_t>(64, 32000)},
-      {"User registers/Qshort length (samples)", std::vector<uint16_t>(64, 16)},
-      {"User registers/Qlong length (samples)", std::vector<uint16_t>(64, 32)}
-   };
-
-   std::map<std::string, std::vector<uint32_t>> vec_uint32s = {
-      {"LVDS trigger mask (31-0)", std::vector<uint32_t>(16, 0xFFFFFFFF)},
-      {"LVDS trigger mask (63-32)", std::vector<uint32_t>(16, 0xFFFFFFFF)},
-      {"Chan over thresh width (ns)", std::vector<uint32_t>(64, 0)}
-   };
-
-   std::map<std::string, std::vector<int32_t>> vec_int32s = {
-      {"Chan over thresh thresholds", std::vector<int32_t>(64, 32768)}
-   };
-
-   std::map<std::string, std::vector<float>> vec_floats = {
-      {"DC offset (pct)", std::vector<float>(64, 50)},
-      {"VGA gain", std::vector<float>(4, 2.5)}
-   };
+   BoardSettings() {
+      VX2740_STRING_SETTINGS(VX2740_SCHEMA_INIT, strings, true)
+      VX2740_STRING_READBACK(VX2740_SCHEMA_INIT, strings, false)
+      VX2740_BOOL_SETTINGS(VX2740_SCHEMA_INIT, bools, true)
+      VX2740_BOOL_READBACK(VX2740_SCHEMA_INIT, bools, false)
+      VX2740_UINT32_SETTINGS(VX2740_SCHEMA_INIT, uint32s, true)
+      VX2740_UINT32_READBACK(VX2740_SCHEMA_INIT, uint32s, false)
+      VX2740_UINT16_SETTINGS(VX2740_SCHEMA_INIT, uint16s, true)
+      VX2740_UINT16_READBACK(VX2740_SCHEMA_INIT, uint16s, false)
+      VX2740_DOUBLE_SETTINGS(VX2740_SCHEMA_INIT, doubles, true)
+      VX2740_DOUBLE_READBACK(VX2740_SCHEMA_INIT, doubles, false)
+      VX2740_INT32_SETTINGS(VX2740_SCHEMA_INIT, int32s, true)
+      VX2740_INT32_READBACK(VX2740_SCHEMA_INIT, int32s, false)
+      VX2740_VEC_BOOL_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_bools, true)
+      VX2740_VEC_BOOL_READBACK(VX2740_SCHEMA_INIT_VEC, vec_bools, false)
+      VX2740_VEC_STRING_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_strings, true)
+      VX2740_VEC_STRING_READBACK(VX2740_SCHEMA_INIT_VEC, vec_strings, false)
+      VX2740_VEC_INT16_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_int16s, true)
+      VX2740_VEC_INT16_READBACK(VX2740_SCHEMA_INIT_VEC, vec_int16s, false)
+      VX2740_VEC_UINT16_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_uint16s, true)
+      VX2740_VEC_UINT16_READBACK(VX2740_SCHEMA_INIT_VEC, vec_uint16s, false)
+      VX2740_VEC_UINT32_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_uint32s, true)
+      VX2740_VEC_UINT32_READBACK(VX2740_SCHEMA_INIT_VEC, vec_uint32s, false)
+      VX2740_VEC_INT32_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_int32s, true)
+      VX2740_VEC_INT32_READBACK(VX2740_SCHEMA_INIT_VEC, vec_int32s, false)
+      VX2740_VEC_FLOAT_SETTINGS(VX2740_SCHEMA_INIT_VEC, vec_floats, true)
+      VX2740_VEC_FLOAT_READBACK(VX2740_SCHEMA_INIT_VEC, vec_floats, false)
+   }
+
+   SettingsTable<std::string, StringParam, VX2740_NUM_STRING_PARAMS> strings;
+   SettingsTable<bool, BoolParam, VX2740_NUM_BOOL_PARAMS> bools;
+   SettingsTable<uint32_t, Uint32Param, VX2740_NUM_UINT32_PARAMS> uint32s;
+   SettingsTable<uint16_t, Uint16Param, VX2740_NUM_UINT16_PARAMS> uint16s;
+   SettingsTable<double, DoubleParam, VX2740_NUM_DOUBLE_PARAMS> doubles;
+   SettingsTable<int32_t, Int32Param, VX2740_NUM_INT32_PARAMS> int32s;
+   SettingsTable<std::vector<bool>, VecBoolParam, VX2740_NUM_VEC_BOOL_PARAMS> vec_bools;
+   SettingsTable<std::vector<std::string>, VecStringParam, VX2740_NUM_VEC_STRING_PARAMS> vec_strings;
+   SettingsTable<std::vector<int16_t>, VecInt16Param, VX2740_NUM_VEC_INT16_PARAMS> vec_int16s;
+   SettingsTable<std::vector<uint16_t>, VecUint16Param, VX2740_NUM_VEC_UINT16_PARAMS> vec_uint16s;
+   SettingsTable<std::vector<uint32_t>, VecUint32Param, VX2740_NUM_VEC_UINT32_PARAMS> vec_uint32s;
+   SettingsTable<std::vector<int32_t>, VecInt32Param, VX2740_NUM_VEC_INT32_PARAMS> vec_int32s;
+   SettingsTable<std::vector<float>, VecFloatParam, VX2740_NUM_VEC_FLOAT_PARAMS> vec_floats;
 } BoardSettings;
 
 typedef struct BoardReadback : public BoardSettings {
    BoardReadback() : BoardSettings() {
-      strings["Firmware version"] = "???";
-      strings["Model name"] = "???";
-      uint32s["User FW revision"] = 0;
-      uint32s["User register revision"] = 0;
-      bools["Upper 32 mirror raw of lower 32"] = false;
-      uint32s["User registers/LVDS input"] = 0;
-      vec_uint32s["User registers/FIR gain and discard"] = std::vector<uint32_t>(64, 0);
-      uint32s["User registers/Darkside trigger en mask(31-0)"] = 0;
-      uint32s["User registers/Darkside trigger en mask(63-32)"] = 0;
-      vec_uint32s["User registers/Channel trigger sources"] = std::vector<uint32_t>(64, 0);
-      vec_uint32s["User registers/Test signal"] = std::vector<uint32_t>(64, 0);
+      strings.activate_all();
+      bools.activate_all();
+      uint32s.activate_all();
+      uint16s.activate_all();
+      doubles.activate_all();
+      int32s.activate_all();
+      vec_bools.activate_all();
+      vec_strings.activate_all();
+      vec_int16s.activate_all();
+      vec_uint16s.activate_all();
+      vec_uint32s.activate_all();
+      vec_int32s.activate_all();
+      vec_floats.activate_all();
    }
 } BoardReadback;
 
+// What we last successfully wrote to a board, so the next write can skip
+// parameters that haven't changed. Only trusted while `valid` is set;
+// cleared on reconnect, firmware change, or any failure writing settings.
+typedef struct AppliedBoardState {
+   bool valid = false;
+   BoardSettings settings;
+   std::map<uint32_t, uint32_t> user_registers;
+   std::string firmware_version;
+   std::string model_name;
+   int num_written = 0;
+   int num_skipped = 0;
+
+   // Readback verification state of the current write.
+   bool verify_only = false;      // Only reading back, not writing
+   bool deferred_pending = false; // Some checks were skipped until verify_settings_on_board()
+   int verify_counter = 0;
+   int sample_offset = 0;
+} AppliedBoardState;
+
 #endif
\ No newline at end of file
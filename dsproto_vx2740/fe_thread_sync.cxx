@@ -0,0 +1,189 @@
+#include "fe_thread_sync.h"
+#include <algorithm>
+
+void BoardBarrier::reset(const std::vector<int>& board_ids) {
+   std::lock_guard<std::mutex> guard(mutex);
+   start_time = std::chrono::steady_clock::now();
+   arrival_times.clear();
+   arrived_ok.clear();
+   expected_ids = board_ids;
+   any_failed = false;
+}
+
+void BoardBarrier::arrive(int board_id, bool success) {
+   std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+   {
+      std::lock_guard<std::mutex> guard(mutex);
+      arrival_times[board_id] = now;
+      arrived_ok[board_id] = success;
+      any_failed = any_failed || !success;
+   }
+
+   cv.notify_all();
+}
+
+INT BoardBarrier::wait(std::chrono::milliseconds timeout, std::vector<int>& failed_boards) {
+   std::unique_lock<std::mutex> lock(mutex);
+
+   bool done = cv.wait_for(lock, timeout, [this]() {
+      return any_failed || arrived_ok.size() >= expected_ids.size();
+   });
+
+   failed_boards.clear();
+
+   for (auto& it : arrived_ok) {
+      if (!it.second) {
+         failed_boards.push_back(it.first);
+      }
+   }
+
+   if (!done) {
+      for (auto board_id : expected_ids) {
+         if (arrived_ok.find(board_id) == arrived_ok.end()) {
+            failed_boards.push_back(board_id);
+         }
+      }
+
+      return DB_TIMEOUT;
+   }
+
+   return any_failed ? FE_ERR_DRIVER : SUCCESS;
+}
+
+double BoardBarrier::get_elapsed_ms(int board_id) {
+   std::lock_guard<std::mutex> guard(mutex);
+
+   if (arrival_times.find(board_id) == arrival_times.end()) {
+      return -1;
+   }
+
+   return std::chrono::duration<double, std::milli>(arrival_times[board_id] - start_time).count();
+}
+
+double BoardBarrier::get_spread_us() {
+   std::lock_guard<std::mutex> guard(mutex);
+
+   if (arrival_times.empty()) {
+      return 0;
+   }
+
+   std::chrono::steady_clock::time_point first = arrival_times.begin()->second;
+   std::chrono::steady_clock::time_point last = first;
+
+   for (auto& it : arrival_times) {
+      first = std::min(first, it.second);
+      last = std::max(last, it.second);
+   }
+
+   return std::chrono::duration<double, std::micro>(last - first).count();
+}
+
+void ThreadGate::close() {
+   std::lock_guard<std::mutex> guard(mutex);
+   is_open = false;
+   is_aborted = false;
+}
+
+void ThreadGate::open() {
+   {
+      std::lock_guard<std::mutex> guard(mutex);
+      is_open = true;
+   }
+
+   cv.notify_all();
+}
+
+void ThreadGate::abort() {
+   {
+      std::lock_guard<std::mutex> guard(mutex);
+      is_aborted = true;
+   }
+
+   cv.notify_all();
+}
+
+bool ThreadGate::wait() {
+   std::unique_lock<std::mutex> lock(mutex);
+   cv.wait(lock, [this]() { return is_open || is_aborted; });
+   return is_open && !is_aborted;
+}
+
+FeThreadPool::~FeThreadPool() {
+   stop();
+}
+
+void FeThreadPool::resize(int num_threads) {
+   if (num_threads < 1) {
+      num_threads = 1;
+   }
+
+   if (num_threads == (int)workers.size()) {
+      return;
+   }
+
+   stop();
+   stopping = false;
+
+   for (int i = 0; i < num_threads; i++) {
+      workers.push_back(std::thread(&FeThreadPool::run, this));
+   }
+}
+
+void FeThreadPool::submit(std::function<void()> job) {
+   {
+      std::lock_guard<std::mutex> guard(mutex);
+      jobs.push_back(job);
+      num_outstanding++;
+   }
+
+   job_cv.notify_one();
+}
+
+void FeThreadPool::wait_all() {
+   std::unique_lock<std::mutex> lock(mutex);
+   done_cv.wait(lock, [this]() { return num_outstanding == 0; });
+}
+
+void FeThreadPool::stop() {
+   {
+      std::lock_guard<std::mutex> guard(mutex);
+      stopping = true;
+   }
+
+   job_cv.notify_all();
+
+   for (auto& worker : workers) {
+      worker.join();
+   }
+
+   workers.clear();
+}
+
+void FeThreadPool::run() {
+   while (true) {
+      std::function<void()> job;
+
+      {
+         std::unique_lock<std::mutex> lock(mutex);
+         job_cv.wait(lock, [this]() { return stopping || !jobs.empty(); });
+
+         if (jobs.empty()) {
+            // Stopping, and nothing left to do
+            return;
+         }
+
+         job = jobs.front();
+         jobs.pop_front();
+      }
+
+      job();
+
+      {
+         std::lock_guard<std::mutex> guard(mutex);
+         num_outstanding--;
+      }
+
+      done_cv.notify_all();
+   }
+}
@@ -0,0 +1,163 @@
+#ifndef FE_THREAD_SYNC_H
+#define FE_THREAD_SYNC_H
+
+#include "midas.h"
+#include <map>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <functional>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * Barrier for one phase (e.g. configure, arm) of the begin-of-run handshake.
+ * Each board calls `arrive()` when it has finished the phase; the main thread
+ * blocks in `wait()` until every board has arrived or any board has failed.
+ */
+class BoardBarrier {
+public:
+   /**
+    * Start a new phase that the given boards must complete.
+    */
+   void reset(const std::vector<int>& board_ids);
+
+   /**
+    * Record that a board has finished this phase.
+    */
+   void arrive(int board_id, bool success);
+
+   /**
+    * Wait for all boards to arrive.
+    * @param[out] failed_boards Boards that failed (or didn't arrive before the timeout).
+    * @return SUCCESS, FE_ERR_DRIVER if any board failed, or DB_TIMEOUT.
+    */
+   INT wait(std::chrono::milliseconds timeout, std::vector<int>& failed_boards);
+
+   /**
+    * Time from `reset()` until the board arrived, in ms.
+    */
+   double get_elapsed_ms(int board_id);
+
+   /**
+    * Spread between the first and last board arriving, in us.
+    */
+   double get_spread_us();
+
+protected:
+   std::mutex mutex;
+   std::condition_variable cv;
+   std::chrono::steady_clock::time_point start_time;
+   std::map<int, std::chrono::steady_clock::time_point> arrival_times;
+   std::map<int, bool> arrived_ok;
+   std::vector<int> expected_ids;
+   bool any_failed = false;
+};
+
+/**
+ * One-shot gate that worker threads wait on until the main thread
+ * either opens it (all waiters are woken together) or aborts.
+ */
+class ThreadGate {
+public:
+   void close();
+   void open();
+   void abort();
+
+   /**
+    * Block until the gate is opened (returns true) or aborted (returns false).
+    */
+   bool wait();
+
+protected:
+   std::mutex mutex;
+   std::condition_variable cv;
+   bool is_open = false;
+   bool is_aborted = false;
+};
+
+/**
+ * Lock-free hand-off of the latest value of T from one writer thread to one
+ * reader thread (triple buffering). Neither side ever waits for the other;
+ * the reader always sees the most recently published complete value.
+ */
+template <class T> class TripleBuffer {
+public:
+   /**
+    * Writer only. Replaces any value the reader hasn't picked up yet.
+    */
+   void publish(const T& val) {
+      buffers[back] = val;
+      int prev = middle.exchange(back | fresh_flag, std::memory_order_acq_rel);
+      back = prev & index_mask;
+   }
+
+   /**
+    * Reader only. The latest value published (or T() if none yet).
+    * The reference is valid until the next call.
+    */
+   const T& latest() {
+      if (middle.load(std::memory_order_relaxed) & fresh_flag) {
+         int prev = middle.exchange(front, std::memory_order_acq_rel);
+         front = prev & index_mask;
+      }
+
+      return buffers[front];
+   }
+
+protected:
+   static const int fresh_flag = 4;
+   static const int index_mask = 3;
+
+   T buffers[3];
+   int back = 0;  // Owned by the writer
+   std::atomic<int> middle{1};
+   int front = 2; // Owned by the reader
+};
+
+/**
+ * Fixed-size pool of worker threads for running per-board jobs
+ * (e.g. writing settings) concurrently. Threads are created once and
+ * reused, so submitting jobs is cheap.
+ */
+class FeThreadPool {
+public:
+   FeThreadPool() {}
+   ~FeThreadPool();
+
+   /**
+    * Start the workers. Calling again with a different size restarts
+    * the pool; must not be called while jobs are outstanding.
+    */
+   void resize(int num_threads);
+
+   int size() {
+      return workers.size();
+   }
+
+   /**
+    * Queue a job to run on one of the workers.
+    */
+   void submit(std::function<void()> job);
+
+   /**
+    * Block until every job submitted so far has finished.
+    */
+   void wait_all();
+
+protected:
+   void stop();
+   void run();
+
+   std::vector<std::thread> workers;
+   std::deque<std::function<void()>> jobs;
+   std::mutex mutex;
+   std::condition_variable job_cv;
+   std::condition_variable done_cv;
+   int num_outstanding = 0;
+   bool stopping = false;
+};
+
+#endif
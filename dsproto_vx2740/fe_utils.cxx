@@ -1,4 +1,5 @@
 #include "fe_utils.h"
+#include "fe_logger.h"
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/syscall.h>
@@ -9,30 +10,14 @@
 #include <cstdarg>
 
 void fe_utils::ts_printf(const char *format, ...) {
-   // Handle va args for message
+   // Timestamp is added by the logging thread
    va_list argptr;
-   char message[10000];
    va_start(argptr, format);
-   vsnprintf(message, 10000, (char *) format, argptr);
+   fe_log::vlog(fe_log::Level::Info, format, argptr);
    va_end(argptr);
-
-   // Handle timestamp
-   std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-
-   // Get number of milliseconds for the current second
-   int milli = (std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()) % 1000).count();
-
-   // Convert main timestamp to broken time for text formatting
-   time_t timer = std::chrono::system_clock::to_time_t(now);
-   tm buf;
-   char formatted_time[80];
-   strftime(formatted_time, 80, "%Y-%m-%d %H:%M:%S", localtime_r(&timer, &buf));
-
-   // Do the actual print
-   printf("%s.%03d %s", formatted_time, milli, message);
 }
 
-std::string fe_utils::format_bytes(int num_bytes) {
+std::string fe_utils::format_bytes(uint64_t num_bytes) {
    double size = num_bytes;
 
    int idx = 0;
@@ -47,7 +32,7 @@ std::string fe_utils::format_bytes(int num_bytes) {
 
    if (num_bytes < 1024) {
       // Integer exact bytes
-      snprintf(res, 100, "%dB", num_bytes);
+      snprintf(res, 100, "%" PRIu64 "B", num_bytes);
    } else {
       // 2 d.p. with prefix
       snprintf(res, 100, "%.2f%sB", size, prefixes[idx].c_str());
@@ -2,17 +2,19 @@
 #define FE_UTILS_H
 
 #include <string>
+#include <inttypes.h>
 
 namespace fe_utils {
    /**
     * Like printf, but automatically prepend a timestamp.
+    * Printing is done asynchronously by the fe_log thread.
     */ 
    void ts_printf(const char *format, ...);
 
    /**
     * Return a string like "1.23GiB" for human-readable data sizes.
     */ 
-   std::string format_bytes(int num_bytes);
+   std::string format_bytes(uint64_t num_bytes);
 };
 
 #endif
\ No newline at end of file
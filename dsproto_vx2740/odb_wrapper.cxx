@@ -75,6 +75,14 @@ void ODBWrapper::ensure_string_exists(HNDLE hBase, std::string key_name, std::st
    }
 }
 
+void ODBWrapper::paste_json(HNDLE hBase, std::string json) {
+   INT status = db_paste_json(hDB, hBase, json.c_str());
+
+   if (status != SUCCESS) {
+      throw SettingsException(status, "Error pasting JSON", json);
+   }
+}
+
 void ODBWrapper::set_num_values(HNDLE hBase, std::string key_name, INT num_values) {
    HNDLE subkey = find_key(hBase, key_name);
    INT status = db_set_num_values(hDB, subkey, num_values);
@@ -128,6 +128,17 @@ class ODBWrapper {
        */
       void set_value_index(HNDLE hBase, std::string key_name, const void *data, INT size, INT index, DWORD type, BOOL truncate);
       
+      /** 
+       * Set several values at once from a JSON document (in the format
+       * produced by `db_copy_json_values()`), e.g. `{"Key A": 1, "Dir": {"Key B": "x"}}`.
+       * Existing keys keep their type, and the ODB is only locked once.
+       * 
+       * @param[in] hBase - ODB directory the JSON keys are relative to.
+       * @param[in] json - JSON object to paste.
+       * @exception SettingsException if there's a problem.
+       */
+      void paste_json(HNDLE hBase, std::string json);
+
       /** 
        * Resize an ODB array.
        * 
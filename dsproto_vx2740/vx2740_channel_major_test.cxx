@@ -0,0 +1,102 @@
+#include "stdio.h"
+#include "caen_event.h"
+#include "vx2740_test_events.h"
+#include <inttypes.h>
+
+/*
+ * Checks that CaenEvent::encode_channel_major() rearranges scope-mode events
+ * so that CaenChannelMajorEvent gives each channel's samples in order, the
+ * same as reading the original event with CaenEvent. Doesn't need a board.
+ * Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+void check_round_trip(const char* name, const std::vector<std::vector<uint16_t>>& waveforms) {
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 77, 8910, raw);
+   CaenEvent event(raw.data());
+   char what[200];
+
+   std::vector<uint64_t> encoded(event.channel_major_size_words());
+   snprintf(what, sizeof(what), "%s: words written", name);
+   check(what, event.encode_channel_major(encoded.data()), encoded.size());
+
+   CaenChannelMajorEvent transposed(encoded.data(), encoded.size());
+   snprintf(what, sizeof(what), "%s: is_valid()", name);
+   check(what, transposed.is_valid(), true);
+   snprintf(what, sizeof(what), "%s: size in header is the original size", name);
+   check(what, transposed.header.size_64bit_words, raw.size());
+   snprintf(what, sizeof(what), "%s: event counter", name);
+   check(what, transposed.header.event_counter, 77);
+   snprintf(what, sizeof(what), "%s: trigger time", name);
+   check(what, transposed.header.trigger_time, 8910);
+   snprintf(what, sizeof(what), "%s: channel mask", name);
+   check(what, transposed.header.ch_enable_mask, event.header.ch_enable_mask);
+
+   for (size_t c = 0; c < 64; c++) {
+      bool enabled = c < waveforms.size() && waveforms[c].size();
+      const uint16_t* samples = transposed.get_channel_samples(c);
+
+      snprintf(what, sizeof(what), "%s: channel %zu read out", name, c);
+      check(what, samples != nullptr, enabled);
+
+      if (!enabled || !samples) {
+         continue;
+      }
+
+      snprintf(what, sizeof(what), "%s: channel %zu samples per channel", name, c);
+      check(what, transposed.samples_per_chan, waveforms[c].size());
+
+      std::vector<uint16_t> from_raw = event.get_channel_samples_vec(c);
+      int num_wrong = 0;
+
+      for (uint32_t i = 0; i < transposed.samples_per_chan && i < waveforms[c].size(); i++) {
+         if (samples[i] != waveforms[c][i] || samples[i] != from_raw[i]) {
+            num_wrong++;
+         }
+      }
+
+      snprintf(what, sizeof(what), "%s: channel %zu wrong samples", name, c);
+      check(what, num_wrong, 0);
+   }
+
+   snprintf(what, sizeof(what), "%s: truncated is_valid()", name);
+   check(what, CaenChannelMajorEvent(encoded.data(), encoded.size() - 1).is_valid(), false);
+}
+
+void test_all_channels() {
+   check_round_trip("64 channels", make_noisy_waveforms(64, 5000, 3000, 3, {1000, 2500}, 800, 8));
+}
+
+void test_sparse_channels() {
+   std::vector<std::vector<uint16_t>> waveforms(64);
+   waveforms[0] = make_noisy_waveforms(1, 1000, 100, 3, {}, 0, 0, 1)[0];
+   waveforms[17] = make_noisy_waveforms(1, 1000, 200, 3, {}, 0, 0, 2)[0];
+   waveforms[63] = make_noisy_waveforms(1, 1000, 300, 3, {}, 0, 0, 3)[0];
+   check_round_trip("3 channels", waveforms);
+
+   std::vector<std::vector<uint16_t>> one_channel(64);
+   one_channel[5] = make_noisy_waveforms(1, 4, 60000, 100, {}, 0, 0)[0];
+   check_round_trip("1 channel, 4 samples", one_channel);
+}
+
+int main() {
+   test_all_channels();
+   test_sparse_channels();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
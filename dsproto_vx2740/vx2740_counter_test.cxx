@@ -0,0 +1,96 @@
+#include "stdio.h"
+#include "caen_event.h"
+#include <inttypes.h>
+
+/*
+ * Checks that CaenCounterExtender turns the wrapping event counter and
+ * trigger time of the event headers into ever-increasing values.
+ * Doesn't need a board. Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+void test_wrap(int num_bits) {
+   CaenCounterExtender ext(num_bits);
+   uint64_t range = (uint64_t)1 << num_bits;
+   char what[100];
+
+   // Count up through two wraps, in steps that don't divide the range.
+   uint64_t step = range / 7 + 3;
+   uint64_t expected = range - 5;
+
+   for (int i = 0; i < 20; i++) {
+      snprintf(what, sizeof(what), "%d-bit counter, step %d", num_bits, i);
+      check(what, ext.extend(expected & (range - 1)), expected);
+      expected += step;
+   }
+
+   // Bits above the counter's width are ignored.
+   snprintf(what, sizeof(what), "%d-bit counter, high bits set", num_bits);
+   check(what, ext.extend((expected & (range - 1)) | range), expected);
+}
+
+void test_reordering(int num_bits) {
+   CaenCounterExtender ext(num_bits);
+   uint64_t range = (uint64_t)1 << num_bits;
+   char what[100];
+
+   // A couple of values from just before the wrap arrive after it.
+   uint64_t raw[] = {range - 3, range - 1, 1, range - 2, 2, 0, 3};
+   uint64_t expected[] = {range - 3, range - 1, range + 1, range - 2, range + 2, range, range + 3};
+
+   for (int i = 0; i < 7; i++) {
+      snprintf(what, sizeof(what), "%d-bit counter, reordered value %d", num_bits, i);
+      check(what, ext.extend(raw[i]), expected[i]);
+      check("current() after extend()", ext.current(), expected[i]);
+   }
+}
+
+void test_reset() {
+   CaenCounterExtender ext(CAEN_EVENT_COUNTER_BITS);
+   uint64_t range = (uint64_t)1 << CAEN_EVENT_COUNTER_BITS;
+
+   check("current() before any value", ext.current(), 0);
+
+   // Move well past a wrap, then start again.
+   ext.extend(range - 1);
+   ext.extend(10);
+   check("before reset", ext.current(), range + 10);
+
+   ext.reset();
+   check("current() after reset", ext.current(), 0);
+
+   // The first value is taken as-is, however far it is from the old ones,
+   // even if it's near the top of the range.
+   check("first value after reset", ext.extend(range - 2), range - 2);
+   check("second value after reset", ext.extend(3), range + 3);
+
+   ext.reset();
+   check("first value after second reset", ext.extend(5), 5);
+
+   // Small steps back from the first value don't go below 0.
+   check("step back below first value", ext.extend(range - 1), range - 1);
+}
+
+int main() {
+   test_wrap(CAEN_EVENT_COUNTER_BITS);
+   test_wrap(CAEN_TRIGGER_TIME_BITS);
+   test_reordering(CAEN_EVENT_COUNTER_BITS);
+   test_reordering(CAEN_TRIGGER_TIME_BITS);
+   test_reset();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
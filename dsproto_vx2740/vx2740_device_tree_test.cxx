@@ -0,0 +1,208 @@
+#include "stdio.h"
+#include "caen_device_tree.h"
+#include <inttypes.h>
+#include <string>
+
+/*
+ * Checks that CaenDeviceTree::parse() turns the JSON from
+ * CAEN_FELib_GetDeviceTree() into the right nodes, paths and attributes,
+ * including escaped strings, arrays and deep nesting, and rejects malformed
+ * JSON. Doesn't need a board. Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+void check_str(const char* what, const std::string& got, const std::string& expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got \"%s\", expected \"%s\"\n", what, got.c_str(), expected.c_str());
+      num_failures++;
+   }
+}
+
+// Cut-down version of what a VX2740 returns, with the awkward cases added.
+const char* tree_json = R"({
+   "name": "", "type": "DIGITIZER", "handle": 1,
+   "par": {
+      "name": "par", "type": "FOLDER", "handle": 2,
+      "dcoffset": {
+         "name": "dcoffset", "type": "PARAMETER", "handle": 3,
+         "value": "should be dropped",
+         "accessmode": {"name": "accessmode", "type": "ATTRIBUTE", "handle": 4, "value": "READ_WRITE"},
+         "description": {"name": "description", "type": "ATTRIBUTE", "handle": 5,
+                         "value": "Quote \" backslash \\ slash \/ tab\tnewline\n\u0041=A e=\u00e9"},
+         "allowedvalues": [ "a]", "b\"}", {"x": [1, 2, {"y": null}]}, [], {} ],
+         "expuncertain": true, "minvalue": -1.5e3, "maxvalue": null
+      },
+      "serialnum": {
+         "name": "serialnum", "type": "PARAMETER", "handle": 18446744073709551615,
+         "accessmode": {"name": "accessmode", "type": "ATTRIBUTE", "handle": 6, "value": "READ_ONLY"}
+      },
+      "lowercase": {
+         "name": "lowercase", "type": "parameter", "handle": 7,
+         "accessmode": {"name": "accessmode", "type": "attribute", "handle": 8, "value": "read_write"}
+      },
+      "empty": {}
+   },
+   "ch": {
+      "name": "ch", "type": "FOLDER", "handle": 9,
+      "0": {
+         "name": "0", "type": "CHANNEL", "handle": 10,
+         "par": {
+            "name": "par", "type": "FOLDER", "handle": 11,
+            "chenable": {
+               "name": "chenable", "type": "PARAMETER", "handle": 12,
+               "accessmode": {"name": "accessmode", "type": "ATTRIBUTE", "handle": 13, "value": "READ_WRITE"}
+            }
+         }
+      },
+      "1": {
+         "name": "1", "type": "CHANNEL", "handle": 14,
+         "par": {
+            "name": "par", "type": "FOLDER", "handle": 15,
+            "chenable": {"name": "chenable", "type": "PARAMETER", "handle": 16}
+         }
+      }
+   },
+   "we\"ird": {"name": "we\"ird", "type": "FOLDER", "handle": 17}
+}
+)";
+
+void test_parse() {
+   CaenDeviceTree tree;
+   std::string json = tree_json;
+   check("parse()", tree.parse(json.data(), json.size()), true);
+
+   // Root, 9 beneath /par (counting attributes), 8 beneath /ch and the
+   // folder with the odd name.
+   check("number of nodes", tree.size(), 19);
+
+   int root = tree.find("");
+   check("root found", root, 0);
+   check_str("root type", tree.node(root).type, "DIGITIZER");
+   check("root parent", tree.node(root).parent, (uint64_t)-1);
+   check("root children", tree.node(root).children.size(), 3);
+
+   int dcoffset = tree.find("/par/dcoffset");
+   check("/par/dcoffset found", dcoffset >= 0, true);
+
+   if (dcoffset >= 0) {
+      const CaenDeviceTree::Node& node = tree.node(dcoffset);
+      check_str("dcoffset name", node.name, "dcoffset");
+      check_str("dcoffset type", node.type, "PARAMETER");
+      check("dcoffset handle", node.handle, 3);
+      check("dcoffset parent", node.parent, tree.find("/par"));
+      check("dcoffset children", node.children.size(), 2);
+      check("dcoffset value dropped", node.has_value, false);
+      check_str("dcoffset accessmode", node.attributes.count("accessmode") ? node.attributes.at("accessmode") : "", "READ_WRITE");
+      check_str("dcoffset description", node.attributes.count("description") ? node.attributes.at("description") : "",
+                "Quote \" backslash \\ slash / tab\tnewline\nA=A e=?");
+      check_str("dcoffset scalar true", node.attributes.count("expuncertain") ? node.attributes.at("expuncertain") : "", "true");
+      check_str("dcoffset scalar number", node.attributes.count("minvalue") ? node.attributes.at("minvalue") : "", "-1.5e3");
+      check_str("dcoffset scalar null", node.attributes.count("maxvalue") ? node.attributes.at("maxvalue") : "", "null");
+      check("dcoffset array skipped", node.attributes.count("allowedvalues"), 0);
+      check("dcoffset writable", tree.is_writable(dcoffset), true);
+   }
+
+   int accessmode = tree.find("/par/dcoffset/accessmode");
+   check("attribute node found", accessmode >= 0, true);
+
+   if (accessmode >= 0) {
+      check("attribute keeps its value", tree.node(accessmode).has_value, true);
+      check("attribute not writable", tree.is_writable(accessmode), false);
+   }
+
+   int serialnum = tree.find("/par/serialnum");
+   check("/par/serialnum found", serialnum >= 0, true);
+
+   if (serialnum >= 0) {
+      check("64-bit handle", tree.node(serialnum).handle, UINT64_MAX);
+      check("read-only not writable", tree.is_writable(serialnum), false);
+   }
+
+   check("types and access modes ignore case", tree.is_writable(tree.find("/par/lowercase")), true);
+   check("empty object is a node", tree.find("/par/empty") >= 0, true);
+   check("folder not writable", tree.is_writable(tree.find("/par")), false);
+   check("parameter without accessmode not writable", tree.is_writable(tree.find("/ch/1/par/chenable")), false);
+   check("deep path found", tree.find("/ch/0/par/chenable") >= 0, true);
+   check("escaped key", tree.find("/we\"ird") >= 0, true);
+   check("missing path", tree.find("/ch/2/par/chenable"), (uint64_t)-1);
+   check("path is case-sensitive", tree.find("/PAR/dcoffset"), (uint64_t)-1);
+
+   // Subtrees are in tree order, starting with the node itself.
+   std::vector<int> subtree = tree.get_subtree("/ch/0");
+   check("subtree size", subtree.size(), 4);
+
+   if (subtree.size() == 4) {
+      check_str("subtree first", tree.node(subtree[0]).path, "/ch/0");
+      check_str("subtree second", tree.node(subtree[1]).path, "/ch/0/par");
+      check_str("subtree third", tree.node(subtree[2]).path, "/ch/0/par/chenable");
+      check_str("subtree fourth", tree.node(subtree[3]).path, "/ch/0/par/chenable/accessmode");
+   }
+
+   check("whole tree subtree", tree.get_subtree("").size(), tree.size());
+   check("missing subtree", tree.get_subtree("/nope").size(), 0);
+
+   // A trailing NUL (as FELib fills the buffer) is fine, and parsing again
+   // replaces the old tree.
+   std::string small = R"({"name":"","type":"DIGITIZER","handle":1,"par":{"type":"FOLDER","handle":2}})";
+   check("parse() with trailing NUL", tree.parse(small.c_str(), small.size() + 1), true);
+   check("reparsed number of nodes", tree.size(), 2);
+   check("old nodes gone", tree.find("/par/dcoffset"), (uint64_t)-1);
+}
+
+void test_malformed() {
+   const char* bad[] = {
+      "",
+      "[]",
+      "\"root\"",
+      R"({"a":)",
+      R"({"a" 1})",
+      R"({"a":1,})",
+      R"({"a":1} x)",
+      R"({"a":"unterminated})",
+      R"({"a":"trailing backslash\)",
+      R"({"a":"short \u00"})",
+      R"({"a":{"b":1})",
+      R"({"a":[1, 2)",
+      R"({"a":[1 2]})",
+      R"({a:1})",
+   };
+
+   CaenDeviceTree tree;
+   char what[100];
+
+   for (auto json : bad) {
+      std::string good = tree_json;
+      tree.parse(good.data(), good.size());
+
+      std::string str = json;
+      snprintf(what, sizeof(what), "parse(%s)", json);
+      check(what, tree.parse(str.data(), str.size()), false);
+      snprintf(what, sizeof(what), "nodes after parse(%s)", json);
+      check(what, tree.size(), 0);
+   }
+
+   // Only `len` bytes are looked at, even if the string goes on.
+   std::string good = R"({"a":{"type":"FOLDER"}})";
+   check("parse() of truncated length", tree.parse(good.data(), good.size() - 1), false);
+}
+
+int main() {
+   test_parse();
+   test_malformed();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
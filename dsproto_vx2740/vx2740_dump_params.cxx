@@ -1,23 +1,97 @@
 #include "vx2740_wrapper.h"
+#include "caen_snapshot.h"
+#include "caen_exceptions.h"
 #include "stdio.h"
 #include <cstring>
 #include <string>
 #include <vector>
 #include <map>
+#include <fstream>
+#include <sstream>
 
 /**
  * This program connects to a VX2740 board, reads all the parameters that
  * are currently set, and prints them to screen. The user can control a
  * little bit of filtering and/or verbosity in the output.
+ *
+ * With -d, the parameters are compared against a previous dump instead,
+ * and only the differences are printed.
+ *
+ * With -s, a binary snapshot of every writable parameter is saved to a
+ * file instead, for restoring the board later.
  */
 
 void usage(char *prog_name) {
-   printf("Usage: %s <hostname> [-a] [-v] [<only_beneath_this_path>]\n", prog_name);
+   printf("Usage: %s <hostname> [-a] [-v] [-d <previous_dump>] [<only_beneath_this_path>]\n", prog_name);
+   printf("       %s <hostname> -s <snapshot_file>\n", prog_name);
    printf("-a means dump all channels, not just channel 0.\n");
    printf("-v means print attributes of each node as well as the value.\n");
+   printf("-d means only print differences from a file written by a previous dump.\n");
+   printf("-s means save a binary snapshot of all writable parameters.\n");
    printf("Hostname must be the first argument.\n");
    printf("E.g. : %s vx02\n", prog_name);
    printf("E.g. : %s vx02 -v /lvds/2\n", prog_name);
+   printf("E.g. : %s vx02 -a -d params.txt\n", prog_name);
+   printf("E.g. : %s vx02 -s vx02.vxsnap\n", prog_name);
+}
+
+// Split a dump into "path" -> "value" (or "" for nodes without a value).
+std::map<std::string, std::string> parse_dump(std::istream& in) {
+   std::map<std::string, std::string> retval;
+   std::string line;
+
+   while (std::getline(in, line)) {
+      if (line.find("/") != 0) {
+         continue;
+      }
+
+      size_t split_pos = line.find(" = ");
+
+      if (split_pos == std::string::npos) {
+         retval[line] = "";
+      } else {
+         retval[line.substr(0, split_pos)] = line.substr(split_pos + 3);
+      }
+   }
+
+   return retval;
+}
+
+// Print what differs between a previous dump and the current values.
+int print_diff(std::string filename, std::string current) {
+   std::ifstream file(filename);
+
+   if (!file.is_open()) {
+      printf("Failed to open %s\n", filename.c_str());
+      return 1;
+   }
+
+   std::map<std::string, std::string> old_vals = parse_dump(file);
+   std::istringstream current_stream(current);
+   std::map<std::string, std::string> new_vals = parse_dump(current_stream);
+   int num_diff = 0;
+
+   for (auto& it : old_vals) {
+      auto new_it = new_vals.find(it.first);
+
+      if (new_it == new_vals.end()) {
+         printf("- %s = %s\n", it.first.c_str(), it.second.c_str());
+         num_diff++;
+      } else if (new_it->second != it.second) {
+         printf("~ %s = %s (was %s)\n", it.first.c_str(), new_it->second.c_str(), it.second.c_str());
+         num_diff++;
+      }
+   }
+
+   for (auto& it : new_vals) {
+      if (old_vals.find(it.first) == old_vals.end()) {
+         printf("+ %s = %s\n", it.first.c_str(), it.second.c_str());
+         num_diff++;
+      }
+   }
+
+   printf("%d differences\n", num_diff);
+   return 0;
 }
 
 int main(int argc, char **argv) {
@@ -30,7 +104,7 @@ int main(int argc, char **argv) {
       }
    }
 
-   if (argc < 2 || argc > 4 || any_help) {
+   if (argc < 2 || argc > 7 || any_help) {
       usage(argv[0]);
       return 0;
    }
@@ -38,15 +112,37 @@ int main(int argc, char **argv) {
    VX2740 vx;
    vx.connect(argv[1], false, true);
 
+   if (argc == 4 && strcmp(argv[2], "-s") == 0) {
+      CaenSnapshot snapshot;
+
+      try {
+         snapshot.capture(vx.params());
+      } catch (CaenException& e) {
+         printf("Failed to read parameters: %s\n", e.what());
+         return 1;
+      }
+
+      if (!snapshot.save(argv[3])) {
+         printf("Failed to write %s\n", argv[3]);
+         return 1;
+      }
+
+      printf("Saved %d parameters to %s\n", (int)snapshot.params.size(), argv[3]);
+      return 0;
+   }
+
    std::string beneath = "";
    bool only_params = true;
    bool all_chans = false;
+   std::string diff_file = "";
 
    for (int i = 2; i < argc; i++) {
       std::string arg(argv[i]);
 
       if (arg == "-a") {
          all_chans = true;
+      } else if (arg == "-d" && i + 1 < argc) {
+         diff_file = argv[++i];
       } else if (arg == "-v") {
          only_params = false;
       } else if (beneath == "") {
@@ -57,7 +153,20 @@ int main(int argc, char **argv) {
       }
    }
 
-   printf("%s\n", vx.params().get_param_list_human(beneath, all_chans, {}, only_params).c_str());
+   std::string dump;
+
+   try {
+      dump = vx.params().get_param_list_human(beneath, all_chans, {}, only_params);
+   } catch (CaenException& e) {
+      printf("Failed to read parameters: %s\n", e.what());
+      return 1;
+   }
+
+   if (diff_file != "") {
+      return print_diff(diff_file, dump);
+   }
+
+   printf("%s\n", dump.c_str());
 
    return 0;
 }
@@ -0,0 +1,119 @@
+/**
+ * Times the processing that the frontend can do on scope-mode events before
+ * writing them to the ring buffer (channel-major copy, zero suppression,
+ * lossless compression and hit finding), on made-up events of
+ * 64 channels x 5000 samples (noise of a few ADC counts plus a few pulses on
+ * some channels). Prints the time per event, the throughput in raw bytes
+ * and the size relative to the raw event.
+ *
+ * Doesn't need a board.
+ */
+
+#include "stdio.h"
+#include "caen_zle.h"
+#include "caen_packing.h"
+#include "caen_hits.h"
+#include "vx2740_test_events.h"
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+void usage(char *prog_name) {
+   printf("Usage: %s [<num_repeats>]\n", prog_name);
+   printf("E.g. : %s 1000\n", prog_name);
+}
+
+/**
+ * Run `func` `num_repeats` times on an event of `raw_words`, and print the
+ * mean time, throughput and encoded size. `func` returns the encoded size
+ * in words.
+ */
+void bench(const char* name, int num_repeats, uint32_t raw_words, std::function<uint32_t()> func) {
+   uint32_t encoded_words = 0;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   for (int i = 0; i < num_repeats; i++) {
+      encoded_words = func();
+   }
+
+   double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+   double mb_per_s = (double)raw_words * 8 * num_repeats / elapsed_s / 1e6;
+   printf("%-50s %10.1f us %10.0f MB/s %8.2f%% of raw\n", name, elapsed_s / num_repeats * 1e6, mb_per_s, 100. * encoded_words / raw_words);
+}
+
+int main(int argc, char **argv) {
+   int num_repeats = argc > 1 ? atoi(argv[1]) : 200;
+
+   if (num_repeats < 1) {
+      usage(argv[0]);
+      return 0;
+   }
+
+   // Pulses on every 8th channel, as a rough guess at a busy detector.
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(64, 5000, 3000, 3, {1000, 2500}, 800, 8);
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 1, 0, raw);
+   CaenEvent event(raw.data());
+   uint32_t raw_words = raw.size();
+
+   std::vector<uint64_t> transposed(event.channel_major_size_words());
+
+   bench("Channel-major copy", num_repeats, raw_words, [&]() {
+      return event.encode_channel_major(transposed.data());
+   });
+
+   CaenZleEncoder zle;
+   zle.configure(CaenZleConfig());
+   std::vector<uint64_t> zle_buffer(CaenZleEncoder::max_size_words(event));
+
+   bench("Zero suppression, encode", num_repeats, raw_words, [&]() {
+      return zle.encode(event, zle_buffer.data());
+   });
+
+   uint32_t zle_words = zle.encode(event, zle_buffer.data());
+   std::vector<uint16_t> samples;
+
+   bench("Zero suppression, decode all channels", num_repeats, raw_words, [&]() {
+      CaenZleEvent decoded(zle_buffer.data(), zle_words);
+
+      for (int c = 0; c < 64; c++) {
+         decoded.get_channel_samples(c, samples);
+      }
+
+      return zle_words;
+   });
+
+   CaenPackEncoder pack;
+   std::vector<uint64_t> pack_buffer(CaenPackEncoder::max_size_words(event));
+
+   bench("Lossless compression, encode", num_repeats, raw_words, [&]() {
+      return pack.encode(event, pack_buffer.data());
+   });
+
+   uint32_t pack_words = pack.encode(event, pack_buffer.data());
+   samples.resize(5000);
+
+   bench("Lossless compression, decode all channels", num_repeats, raw_words, [&]() {
+      CaenPackedEvent decoded(pack_buffer.data(), pack_words);
+
+      for (int c = 0; c < 64; c++) {
+         decoded.get_channel_samples(c, samples.data(), samples.size());
+      }
+
+      return pack_words;
+   });
+
+   CaenHitFinder finder;
+   finder.configure(CaenHitConfig());
+   std::vector<CaenHit> hits;
+   std::vector<uint64_t> hits_buffer;
+
+   bench("Hit finding, record without waveform", num_repeats, raw_words, [&]() {
+      finder.find_hits(event, hits, 10000);
+      hits_buffer.resize(CaenHitFinder::record_size_words(hits.size(), 0));
+      return CaenHitFinder::encode_record(event.header, hits, 0, nullptr, 0, hits_buffer.data());
+   });
+
+   return 0;
+}
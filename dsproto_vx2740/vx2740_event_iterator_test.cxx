@@ -0,0 +1,163 @@
+#include "stdio.h"
+#include "caen_event.h"
+#include "caen_zle.h"
+#include "caen_hits.h"
+#include "vx2740_test_events.h"
+#include <inttypes.h>
+
+/*
+ * Checks that CaenEventIterator steps through a batch of events of the
+ * different formats the frontend writes, and stops cleanly at a truncated or
+ * corrupt event rather than reading past the end of the buffer. Doesn't need
+ * a board. Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+/**
+ * A batch of a raw scope event, the same zero-suppressed, a hit record and
+ * a header-only event, back to back. The offset and size of each are
+ * appended to `offsets` and `sizes`.
+ */
+std::vector<uint64_t> make_batch(std::vector<size_t>& offsets, std::vector<uint32_t>& sizes) {
+   std::vector<uint64_t> batch;
+   std::vector<uint64_t> raw;
+   make_scope_event(make_noisy_waveforms(8, 1000, 3000, 3, {400}, 800, 2), 1, 100, raw);
+   CaenEvent event(raw.data());
+
+   offsets.push_back(batch.size());
+   sizes.push_back(raw.size());
+   batch.insert(batch.end(), raw.begin(), raw.end());
+
+   CaenZleEncoder zle;
+   zle.configure(CaenZleConfig());
+   std::vector<uint64_t> encoded(CaenZleEncoder::max_size_words(event));
+   encoded.resize(zle.encode(event, encoded.data()));
+   offsets.push_back(batch.size());
+   sizes.push_back(encoded.size());
+   batch.insert(batch.end(), encoded.begin(), encoded.end());
+
+   CaenHitFinder finder;
+   finder.configure(CaenHitConfig());
+   std::vector<CaenHit> hits;
+   finder.find_hits(event, hits, 100);
+   std::vector<uint64_t> record(CaenHitFinder::record_size_words(hits.size(), 0));
+   CaenHitFinder::encode_record(event.header, hits, 0, nullptr, 0, record.data());
+   offsets.push_back(batch.size());
+   sizes.push_back(record.size());
+   batch.insert(batch.end(), record.begin(), record.end());
+
+   uint64_t header_only[3] = {((uint64_t)0x30 << 56) | 3, 0, 0};
+   offsets.push_back(batch.size());
+   sizes.push_back(3);
+   batch.insert(batch.end(), header_only, header_only + 3);
+
+   return batch;
+}
+
+void test_whole_batch() {
+   std::vector<size_t> offsets;
+   std::vector<uint32_t> sizes;
+   std::vector<uint64_t> batch = make_batch(offsets, sizes);
+
+   CaenEventIterator it(batch.data(), batch.size());
+   const uint64_t* event = nullptr;
+   uint32_t size = 0;
+   char what[100];
+   size_t num_events = 0;
+
+   while ((event = it.next(size))) {
+      if (num_events < offsets.size()) {
+         snprintf(what, sizeof(what), "event %zu offset", num_events);
+         check(what, event - batch.data(), offsets[num_events]);
+         snprintf(what, sizeof(what), "event %zu size", num_events);
+         check(what, size, sizes[num_events]);
+      }
+
+      num_events++;
+   }
+
+   check("number of events", num_events, offsets.size());
+   check("at_end()", it.at_end(), true);
+   check("next() after the end", it.next(size) == nullptr, true);
+
+   CaenEventIterator empty(batch.data(), 0);
+   check("empty buffer next()", empty.next(size) == nullptr, true);
+   check("empty buffer at_end()", empty.at_end(), true);
+}
+
+void test_truncated_tail() {
+   std::vector<size_t> offsets;
+   std::vector<uint32_t> sizes;
+   std::vector<uint64_t> batch = make_batch(offsets, sizes);
+
+   // Cut the hit record short, and cut in the middle of its header.
+   size_t cuts[] = {offsets[3] - 1, offsets[2] + 2};
+   size_t complete[] = {2, 2};
+   char what[100];
+
+   for (int i = 0; i < 2; i++) {
+      CaenEventIterator it(batch.data(), cuts[i]);
+      uint32_t size = 0;
+      size_t num_events = 0;
+
+      while (it.next(size)) {
+         num_events++;
+      }
+
+      snprintf(what, sizeof(what), "cut at %zu: complete events", cuts[i]);
+      check(what, num_events, complete[i]);
+      snprintf(what, sizeof(what), "cut at %zu: at_end()", cuts[i]);
+      check(what, it.at_end(), false);
+   }
+}
+
+void test_corrupt_size() {
+   std::vector<size_t> offsets;
+   std::vector<uint32_t> sizes;
+   std::vector<uint64_t> batch = make_batch(offsets, sizes);
+
+   // A size of 0 mustn't loop forever, and one smaller than a header isn't
+   // an event.
+   uint32_t bad_sizes[] = {0, 2};
+   char what[100];
+
+   for (auto bad_size : bad_sizes) {
+      std::vector<uint64_t> corrupt = batch;
+      corrupt[offsets[1]] = (corrupt[offsets[1]] & ~(uint64_t)0xFFFFFFFF) | bad_size;
+
+      CaenEventIterator it(corrupt.data(), corrupt.size());
+      uint32_t size = 0;
+      size_t num_events = 0;
+
+      while (it.next(size) && num_events < 100) {
+         num_events++;
+      }
+
+      snprintf(what, sizeof(what), "size %u: events before the corrupt one", bad_size);
+      check(what, num_events, 1);
+      snprintf(what, sizeof(what), "size %u: at_end()", bad_size);
+      check(what, it.at_end(), false);
+   }
+}
+
+int main() {
+   test_whole_batch();
+   test_truncated_tail();
+   test_corrupt_size();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
@@ -2,6 +2,7 @@
 #include "caen_event.h"
 #include "caen_exceptions.h"
 #include "fe_utils.h"
+#include "fe_logger.h"
 #include "fe_settings.h"
 #include "odbxx.h"
 #include "midas.h"
@@ -19,16 +20,21 @@
 #include <sys/sysinfo.h>
 #endif
 
-#define BUFFER_SIZE 1000000000 // 1000MB (board has 2GB total)
-#define MAX_EV_SIZE 320000000  // 320MB
-
 #define THREAD_STATUS_ERROR -1
 #define THREAD_STATUS_CONFIGURING 1
 #define THREAD_STATUS_CONFIGURED 2
 #define THREAD_STATUS_ARMED 3
 
+#define VERIFY_STATUS_IDLE 0
+#define VERIFY_STATUS_RUNNING 1
+#define VERIFY_STATUS_PASSED 2
+#define VERIFY_STATUS_FAILED 3
+
 #define MIN_USER_MODE_FW 2022102602
 
+// Per call site, for debug messages from the data path
+#define DEBUG_LOG_MAX_PER_SEC 20
+
 #define MAIN_THREAD_CPU_ID 0
 #define MAIN_THREAD_PRIORITY 40
 #define READOUT_THREAD_PRIORITY 40
@@ -87,9 +93,49 @@ VX2740GroupFrontend::VX2740GroupFrontend(std::shared_ptr<VX2740FeSettingsStrateg
    settings(VX2740FeSettings(_strategy)), single_fe_mode(_use_single_fe_mode), enable_data_readout(_enable_data_readout) {}
 
 VX2740GroupFrontend::~VX2740GroupFrontend() {
-   for (auto it : boards) {
-      delete it.second;
+   stop_monitor_thread();
+   join_verify_threads();
+
+   for (int i = 0; i < num_board_contexts; i++) {
+      delete board_contexts[i].board;
+      board_contexts[i].~BoardContext();
+   }
+
+   free(board_contexts);
+}
+
+INT VX2740GroupFrontend::setup_board_contexts() {
+   if (board_contexts) {
+      // Number of boards can only be changed by restarting the frontend.
+      if (settings.get_num_boards() != num_board_contexts) {
+         cm_msg(MERROR, __FUNCTION__, "Number of boards changed from %d to %d. Restart the frontend", num_board_contexts, settings.get_num_boards());
+         return FE_ERR_ODB;
+      }
+
+      return SUCCESS;
+   }
+
+   if (settings.get_num_boards() < 0 || settings.get_num_boards() > VX2740_MAX_BOARDS_PER_GROUP) {
+      cm_msg(MERROR, __FUNCTION__, "Invalid number of boards %d; maximum is %d", settings.get_num_boards(), VX2740_MAX_BOARDS_PER_GROUP);
+      return FE_ERR_ODB;
+   }
+
+   // Contexts are cache-line aligned, which plain new doesn't guarantee in C++11.
+   void* mem = NULL;
+
+   if (posix_memalign(&mem, VX2740_CACHE_LINE_SIZE, sizeof(BoardContext) * settings.get_num_boards()) != 0) {
+      cm_msg(MERROR, __FUNCTION__, "Failed to allocate state for %d boards", settings.get_num_boards());
+      return FE_ERR_DRIVER;
+   }
+
+   num_board_contexts = settings.get_num_boards();
+   board_contexts = static_cast<BoardContext*>(mem);
+
+   for (int i = 0; i < num_board_contexts; i++) {
+      new (&board_contexts[i]) BoardContext();
    }
+
+   return SUCCESS;
 }
 
 INT VX2740GroupFrontend::init(int group_idx, HNDLE hDB, bool enable_jrpc) {
@@ -115,7 +161,11 @@ INT VX2740GroupFrontend::init(int group_idx, HNDLE hDB, bool enable_jrpc) {
       return FE_ERR_ODB;
    }
 
-   if (setup_ring_buffers() != SUCCESS) {
+   if (setup_board_contexts() != SUCCESS) {
+      return FE_ERR_ODB;
+   }
+
+   if (setup_ring_buffers(false) != SUCCESS) {
       return FE_ERR_DRIVER;
    }
 
@@ -136,46 +186,157 @@ INT VX2740GroupFrontend::init(int group_idx, HNDLE hDB, bool enable_jrpc) {
       }
    }
 
+   start_monitor_thread();
+
    fe_utils::ts_printf("Frontend init complete\n");
    return SUCCESS;
 }
 
-INT VX2740GroupFrontend::setup_ring_buffers() {
+INT VX2740GroupFrontend::setup_ring_buffers(bool adapt_to_usage) {
    if (!enable_data_readout) {
       return SUCCESS;
    }
 
    rb_set_nonblocking();
 
-   for (int i = 0; i < settings.get_num_boards(); i++) {
-      INT status = rb_create(BUFFER_SIZE, MAX_EV_SIZE, &(readout_rbs[i]));
+   // Work out the sizes we want before touching any buffers, so we can
+   // enforce the memory budget up-front.
+   std::map<int, int> new_sizes, new_max_ev_sizes;
+   uint64_t total_bytes = 0;
+   uint64_t adaptive_max = (uint64_t)settings.get_adaptive_ring_buffer_max_mb() * 1000000;
+
+   if (adaptive_max > VX2740_MAX_RB_SIZE_BYTES) {
+      cm_msg(MERROR, __FUNCTION__, "Invalid 'Adaptive ring buffer max (MB)': must be at most %d", VX2740_MAX_RB_SIZE_BYTES / 1000000);
+      return FE_ERR_ODB;
+   }
+
+   for (auto i : settings.get_boards_enabled()) {
+      uint64_t size = (uint64_t)settings.get_ring_buffer_size_mb(i) * 1000000;
+      uint64_t max_ev = (uint64_t)settings.get_max_event_size_mb(i) * 1000000;
+
+      if (max_ev == 0 || max_ev > VX2740_MAX_EV_SIZE_BYTES) {
+         cm_msg(MERROR, __FUNCTION__, "Invalid 'Max event size (MB)' for board %02d: must be 1-%d", i, VX2740_MAX_EV_SIZE_BYTES / 1000000);
+         return FE_ERR_ODB;
+      }
+
+      // Need space for a full read from the board (which the ring buffer
+      // reserves at the end), plus a couple of events waiting to be sent.
+      uint64_t ev_size = settings.get_expected_event_size_bytes(i);
+      uint64_t min_size = max_ev + 2 * ev_size + 1000000;
+
+      if (size < min_size || size > VX2740_MAX_RB_SIZE_BYTES) {
+         cm_msg(MERROR, __FUNCTION__, "Invalid 'Ring buffer size (MB)' for board %02d: must be %" PRIu64 "-%d when max event size is %" PRIu64 "MB and events are %s", i, min_size / 1000000 + 1, VX2740_MAX_RB_SIZE_BYTES / 1000000, max_ev / 1000000, fe_utils::format_bytes(ev_size).c_str());
+         return FE_ERR_ODB;
+      }
+
+      if (adapt_to_usage) {
+         uint64_t max_size = std::max(adaptive_max > 0 ? adaptive_max : size, min_size);
+         uint64_t peak = board_ctx(i).rb_peak_level_bytes;
+         size = get_adaptive_rb_size(i, size, min_size, max_size);
+
+         fe_utils::ts_printf("Adaptive ring buffer size for board %02d is %s (peak use in last run %s, events of %s, limits %s-%s)\n", i, fe_utils::format_bytes(size).c_str(), fe_utils::format_bytes(peak).c_str(), fe_utils::format_bytes(ev_size).c_str(), fe_utils::format_bytes(min_size).c_str(), fe_utils::format_bytes(max_size).c_str());
+      }
+
+      new_sizes[i] = size;
+      new_max_ev_sizes[i] = max_ev;
+      total_bytes += size;
+   }
+
+   uint64_t budget_bytes = (uint64_t)settings.get_ring_buffer_budget_mb() * 1000000;
+
+   if (budget_bytes > 0 && total_bytes > budget_bytes) {
+      cm_msg(MERROR, __FUNCTION__, "Ring buffers for group %03d need %s, but budget is only %s. Reduce 'Ring buffer size (MB)' or increase the budget", this_group_index, fe_utils::format_bytes(total_bytes).c_str(), fe_utils::format_bytes(budget_bytes).c_str());
+      return FE_ERR_ODB;
+   }
+
+   // Free the buffers of boards that are no longer enabled.
+   for (int i = 0; i < num_board_contexts; i++) {
+      BoardContext& ctx = board_ctx(i);
+
+      if (ctx.rb_handle != 0 && new_sizes.find(i) == new_sizes.end()) {
+         rb_delete(ctx.rb_handle);
+         ctx.rb_handle = 0;
+         ctx.rb_size_bytes = 0;
+      }
+   }
+
+   for (auto& it : new_sizes) {
+      int i = it.first;
+      BoardContext& ctx = board_ctx(i);
+      ctx.reset_peek_cache();
+
+      if (ctx.rb_handle != 0 && ctx.rb_size_bytes == it.second && ctx.rb_max_event_bytes == new_max_ev_sizes[i]) {
+         // Existing buffer is fine
+         ctx.rb_peak_level_bytes = 0;
+         continue;
+      }
+
+      if (ctx.rb_handle != 0) {
+         fe_utils::ts_printf("Resizing ring buffer for board %02d from %s to %s (peak use was %s)\n", i, fe_utils::format_bytes(ctx.rb_size_bytes).c_str(), fe_utils::format_bytes(it.second).c_str(), fe_utils::format_bytes(ctx.rb_peak_level_bytes).c_str());
+         rb_delete(ctx.rb_handle);
+         ctx.rb_handle = 0;
+      }
+
+      INT status = rb_create(it.second, new_max_ev_sizes[i], &ctx.rb_handle);
 
       if (status != SUCCESS) {
-         cm_msg(MERROR, __FUNCTION__, "Failed to create ring buffer for %s", board_names[i].c_str());
+         cm_msg(MERROR, __FUNCTION__, "Failed to create %s ring buffer for board %02d", fe_utils::format_bytes(it.second).c_str(), i);
+         ctx.rb_handle = 0;
          return status;
       }
+
+      ctx.rb_size_bytes = it.second;
+      ctx.rb_max_event_bytes = new_max_ev_sizes[i];
+      ctx.rb_peak_level_bytes = 0;
+   }
+
+   if (settings.debug_ring_buffers()) {
+      fe_utils::ts_printf("Ring buffers for group %03d use %s in total\n", this_group_index, fe_utils::format_bytes(total_bytes).c_str());
    }
 
    return SUCCESS;
 }
 
+int VX2740GroupFrontend::get_adaptive_rb_size(int board_id, int configured_size, int min_size, int max_size) {
+   if (board_ctx(board_id).rb_handle == 0) {
+      // No history for this board yet
+      return configured_size;
+   }
+
+   // Aim for the peak occupancy of the last run to fill a quarter of the
+   // buffer, rounded up to a whole MB.
+   uint64_t target = (uint64_t)board_ctx(board_id).rb_peak_level_bytes * 4;
+   target = ((target + 999999) / 1000000) * 1000000;
+
+   if (target < (uint64_t)min_size) {
+      target = min_size;
+   }
+
+   if (target > (uint64_t)max_size) {
+      target = max_size;
+   }
+
+   return target;
+}
+
 INT VX2740GroupFrontend::validate_firmare_version(int board_id, char* error) {
    INT status = SUCCESS;
+   BoardContext& ctx = board_ctx(board_id);
 
    // Store the firmware version and model name (VX2740/VX2745) in the board's Readback section.
    std::string fw_ver, model_name;
-   boards[board_id]->params().get_firmware_version(fw_ver);
-   boards[board_id]->params().get_model_name(model_name);
+   ctx.board->params().get_firmware_version(fw_ver);
+   ctx.board->params().get_model_name(model_name);
 
    settings.set_board_firmware_info(board_id, fw_ver, model_name);
 
    std::string fw_type;
-   boards[board_id]->params().get_firmware_type(fw_type);
+   ctx.board->params().get_firmware_type(fw_type);
 
    std::string hostname = settings.get_hostname(board_id);
 
    if (fw_type == "Scope") {
-      if (!scope_mode[board_id]) {
+      if (!ctx.scope_mode) {
          snprintf(error, 255, "Board %s is running firmware %s, but FE is configured for non-scope mode. Edit the 'Scope mode (restart on change)' param and restart", hostname.c_str(), fw_type.c_str());
          cm_msg(MERROR, __FUNCTION__, "%s", error);
          return FE_ERR_ODB;
@@ -184,11 +345,11 @@ INT VX2740GroupFrontend::validate_firmare_version(int board_id, char* error) {
       // Feature only relevant for user mode
       settings.set_board_user_firmware_info(board_id, 0, 0, false);
    } else if (fw_type == "DPP_OPEN") {
-      open_fw[board_id] = true;
+      ctx.open_fw = true;
       uint32_t fw_rev = 0;
       uint32_t reg_rev = 0;
-      boards[board_id]->params().get_user_register(0x0, fw_rev);
-      boards[board_id]->params().get_user_register(0x4, reg_rev);
+      ctx.board->params().get_user_register(0x0, fw_rev);
+      ctx.board->params().get_user_register(0x4, reg_rev);
 
       // Can cause board to hang if we try to access user registers
       // that aren't defined. Make sure we're running a FW version
@@ -205,7 +366,7 @@ INT VX2740GroupFrontend::validate_firmare_version(int board_id, char* error) {
       bool upper_mirrors_lower = true;
       settings.set_board_user_firmware_info(board_id, fw_rev, reg_rev, upper_mirrors_lower);
 
-      if (scope_mode[board_id]) {
+      if (ctx.scope_mode) {
          snprintf(error, 255, "Board %s is running firmware %s, but FE is configured for scope mode. Edit the 'Scope mode (restart on change)' param and restart", hostname.c_str(), fw_type.c_str());
          cm_msg(MERROR, __FUNCTION__, "%s", error);
          return FE_ERR_ODB;
@@ -221,15 +382,21 @@ INT VX2740GroupFrontend::validate_firmare_version(int board_id, char* error) {
 
 INT VX2740GroupFrontend::connect_to_boards(char* error) {
    INT status = SUCCESS;
+   std::vector<int> newly_connected;
 
    for (auto i : settings.get_boards_enabled()) {
-      if (boards.find(i) != boards.end() && boards[i]->is_connected()) {
+      BoardContext& ctx = board_ctx(i);
+
+      if (ctx.board && ctx.board->is_connected()) {
          continue;
       }
 
-      boards[i] = new VX2740();
-      scope_mode[i] = settings.is_scope_mode(i);
-      open_fw[i] = false;
+      ctx.board = new VX2740();
+      ctx.scope_mode = settings.is_scope_mode(i);
+
+      // New connection, so the board may have been reset/power-cycled.
+      settings.invalidate_applied_settings(i);
+      ctx.open_fw = false;
 
       std::string hostname = settings.get_hostname(i);
 
@@ -242,8 +409,8 @@ INT VX2740GroupFrontend::connect_to_boards(char* error) {
 
       fe_utils::ts_printf("Connecting to board %02d at %s\n", i, hostname.c_str());
 
-      status = boards[i]->connect(hostname);
-      board_names[i] = hostname;
+      status = ctx.board->connect(hostname);
+      ctx.name = hostname;
 
       if (status != SUCCESS) {
          snprintf(error, 255, "Failed to connect to board '%s'", hostname.c_str());
@@ -256,18 +423,135 @@ INT VX2740GroupFrontend::connect_to_boards(char* error) {
       if (status != SUCCESS) {
          break;
       }
+
+      newly_connected.push_back(i);
+   }
+
+   // Restoring a snapshot can take a while, so do all the boards at once.
+   std::vector<INT> board_statuses;
+   std::vector<double> board_elapsed_ms;
+
+   run_on_config_pool(newly_connected, [this](int board_id) {
+      restore_board_snapshot(board_id);
+      return SUCCESS;
+   }, board_statuses, board_elapsed_ms);
+
+   for (int i = 0; i < num_board_contexts; i++) {
+      update_monitor_config(i);
    }
 
    return status;
 }
 
+void VX2740GroupFrontend::restore_board_snapshot(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   ctx.snapshot_tag = "";
+
+   std::string dir = settings.get_snapshot_dir();
+
+   if (dir == "") {
+      return;
+   }
+
+   std::string model_name, serial_number, fw_ver;
+   CaenSnapshot snapshot;
+
+   try {
+      ctx.board->params().get_model_name(model_name);
+      ctx.board->params().get_serial_number(serial_number);
+      ctx.board->params().get_firmware_version(fw_ver);
+   } catch (CaenException& e) {
+      return;
+   }
+
+   std::string filename = CaenSnapshot::get_filename(dir, model_name, serial_number, fw_ver);
+
+   if (!snapshot.load(filename) || !snapshot.matches(model_name, serial_number, fw_ver)) {
+      return;
+   }
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::string errors;
+
+   // Reconnecting doesn't mean the board lost its settings. Unless the reset
+   // marker shows that it did, read what's there so only differences are
+   // written; reading is much cheaper than a full restore.
+   bool full_restore = settings.board_was_reset(board_id, *ctx.board);
+   CaenSnapshot current;
+
+   if (!full_restore) {
+      try {
+         current.capture(ctx.board->params());
+      } catch (CaenException& e) {
+         full_restore = true;
+      }
+   }
+
+   if (snapshot.restore(ctx.board->params(), full_restore ? nullptr : &current, &errors) != 0) {
+      cm_msg(MINFO, __FUNCTION__, "Failed to restore all of snapshot %s to %s; will write all settings from the ODB. Errors: %s", filename.c_str(), ctx.name.c_str(), errors.c_str());
+      return;
+   }
+
+   if (settings.adopt_restored_snapshot(board_id, snapshot)) {
+      ctx.snapshot_tag = snapshot.tag;
+
+      // The next write_settings_to_board() trusts the snapshot only if the
+      // board hasn't been reset since.
+      settings.mark_board(board_id, *ctx.board);
+   }
+
+   fe_utils::ts_printf("Restored snapshot of %s from %s in %.1fms (%s, %s)\n", ctx.name.c_str(), filename.c_str(),
+                       std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+                       full_restore ? "all parameters" : "changed parameters only",
+                       ctx.snapshot_tag == "" ? "ODB settings have changed since" : "matches ODB settings");
+}
+
+INT VX2740GroupFrontend::save_board_snapshot(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   // Settings must have passed any deferred verification.
+   if (settings.get_snapshot_dir() == "" || ctx.verify_status == VERIFY_STATUS_RUNNING || ctx.verify_status == VERIFY_STATUS_FAILED) {
+      return SUCCESS;
+   }
+
+   std::lock_guard<std::mutex> guard(ctx.mutex);
+   std::string tag = settings.get_applied_settings_tag(board_id);
+
+   if (tag == "" || tag == ctx.snapshot_tag) {
+      return SUCCESS;
+   }
+
+   CaenSnapshot snapshot;
+
+   try {
+      snapshot.capture(ctx.board->params(), settings.get_applied_user_registers(board_id));
+   } catch (CaenException& e) {
+      cm_msg(MERROR, __FUNCTION__, "Failed to read snapshot of %s: %s", ctx.name.c_str(), e.what());
+      return FE_ERR_DRIVER;
+   }
+
+   snapshot.tag = tag;
+   std::string filename = CaenSnapshot::get_filename(settings.get_snapshot_dir(), snapshot.model_name, snapshot.serial_number, snapshot.firmware_version);
+
+   if (!snapshot.save(filename)) {
+      cm_msg(MERROR, __FUNCTION__, "Failed to write snapshot of %s to %s", ctx.name.c_str(), filename.c_str());
+      return FE_ERR_DRIVER;
+   }
+
+   ctx.snapshot_tag = tag;
+   return SUCCESS;
+}
+
 INT VX2740GroupFrontend::begin_of_run(INT run_num, char* error) {
    INT status = SUCCESS;
-   timeval start_bor, end_connect, end_config;
-   gettimeofday(&start_bor, NULL);
+   std::chrono::steady_clock::time_point start_bor = std::chrono::steady_clock::now();
+
+   // Tidy up after a previous begin-of-run that failed part-way through.
+   arm_gate.abort();
+   join_readout_threads();
+
+   // Settings mustn't change under a verification that's still running.
+   join_verify_threads();
 
-   abort_arming = false;
-   ready_to_arm_acq = false;
    in_end_of_run = false;
    warned_corruption = false;
 
@@ -278,14 +562,51 @@ INT VX2740GroupFrontend::begin_of_run(INT run_num, char* error) {
       return FE_ERR_ODB;
    }
 
+   if (setup_board_contexts() != SUCCESS) {
+      snprintf(error, 255, "Number of boards changed; restart the frontend");
+      return FE_ERR_ODB;
+   }
+
+   run_config = settings.freeze_run_config();
+
+   if (run_config.batch_size_bytes > VX2740_MAX_EV_SIZE_BYTES) {
+      cm_msg(MERROR, __FUNCTION__, "Invalid 'Batch size (kB)': must be at most %d", VX2740_MAX_EV_SIZE_BYTES / 1000);
+      snprintf(error, 255, "Invalid batch size");
+      return FE_ERR_ODB;
+   }
+
+   // Data path debug messages are only formatted if one of the flags is on.
+   bool any_debug = run_config.debug_data || run_config.debug_rates || run_config.debug_ring_buffers;
+   fe_log::set_level(any_debug ? fe_log::Level::Debug : fe_log::Level::Info);
+
+   if (setup_ring_buffers(settings.adaptive_ring_buffers()) != SUCCESS) {
+      snprintf(error, 255, "Failed to set up ring buffers");
+      return FE_ERR_DRIVER;
+   }
+
+   for (int i = 0; i < num_board_contexts; i++) {
+      BoardContext& ctx = board_ctx(i);
+      ctx.reset_run_counters();
+      ctx.zle_enabled = settings.is_zle_enabled(i);
+      ctx.zle.configure(settings.get_zle_config(i));
+      ctx.zle.reset();
+      ctx.pack_enabled = settings.is_packing_enabled(i);
+      ctx.hits_enabled = settings.is_hits_enabled(i);
+      ctx.hit_finder.configure(settings.get_hit_config(i));
+      ctx.hit_finder.reset();
+      ctx.hits_waveform_prescale = settings.get_hits_waveform_prescale(i);
+      ctx.hits_num_events = 0;
+      ctx.encode_passthrough_bytes = 0;
+   }
+
    bool any_not_scope = false;
 
-   for (auto& i : settings.get_boards_to_read_from()) {
-      any_not_scope = any_not_scope || !scope_mode[i];
+   for (auto& i : run_config.boards_to_read_list) {
+      any_not_scope = any_not_scope || !board_ctx(i).scope_mode;
    }
 
    // Doesn't make sense to merge data in DPP_OPEN mode
-   if (enable_data_readout && settings.merge_data() && any_not_scope) {
+   if (enable_data_readout && run_config.merge_data && any_not_scope) {
       snprintf(error, 255, "Not possible to run in 'merge data using event ID' mode with boards using open DPP firmware");
       cm_msg(MERROR, __FUNCTION__, "%s", error);
       return FE_ERR_ODB;
@@ -296,113 +617,95 @@ INT VX2740GroupFrontend::begin_of_run(INT run_num, char* error) {
       return FE_ERR_DRIVER;
    }
 
-   gettimeofday(&end_connect, NULL);
+   std::chrono::steady_clock::time_point end_connect = std::chrono::steady_clock::now();
 
-   for (auto i : settings.get_boards_enabled()) {
-      if (settings.multithreaded_readout()) {
+   const std::vector<int>& boards_enabled = run_config.boards_enabled_list;
+   configure_barrier.reset(boards_enabled);
+   arm_barrier.reset(boards_enabled);
+   arm_gate.close();
+
+   for (auto i : boards_enabled) {
+      board_ctx(i).readout_status = THREAD_STATUS_CONFIGURING;
+   }
+
+   if (run_config.multithreaded_readout) {
+      for (auto i : boards_enabled) {
          // Spawn thread to set up settings
          thread_args[i].obj = this;
          thread_args[i].board_index = i;
-         readout_threads[i] = new std::thread(thread_data_readout_helper, &thread_args[i]);
-         readout_status[i] = THREAD_STATUS_CONFIGURING;
-      } else {
-         readout_status[i] = configure_board(i);
+         board_ctx(i).readout_thread = new std::thread(thread_data_readout_helper, &thread_args[i]);
       }
+   } else {
+      // Readout happens on the main thread, but configuration can still
+      // be done for all boards concurrently.
+      std::vector<INT> board_statuses;
+      std::vector<double> board_elapsed_ms;
+
+      run_on_config_pool(boards_enabled, [this](int board_id) {
+         board_ctx(board_id).readout_status = configure_board(board_id);
+         configure_barrier.arrive(board_id, board_ctx(board_id).readout_status == THREAD_STATUS_CONFIGURED);
+         return (INT)board_ctx(board_id).readout_status;
+      }, board_statuses, board_elapsed_ms);
    }
 
    set_thread_cpu_and_priority(MAIN_THREAD_CPU_ID, MAIN_THREAD_PRIORITY, "main");
 
    // Wait until all boards report that they configured the board okay.
-   int timeout_secs = settings.multithreaded_readout() ? 10 : 1;
-
-   while (true) {
-      bool all_okay = true;
-      bool any_fail = false;
-
-      for (auto i : settings.get_boards_enabled()) {
-         if (readout_status[i] != THREAD_STATUS_CONFIGURED) {
-            all_okay = false;
-         }
-
-         if (readout_status[i] == THREAD_STATUS_ERROR) {
-            snprintf(error, 255, "Error when configuring %s", board_names[i].c_str());
-            cm_msg(MERROR, __FUNCTION__, "%s", error);
-            any_fail = true;
-         }
-      }
-
-      if (any_fail) {
-         abort_arming = true;
-         return FE_ERR_DRIVER;
-      }
-
-      if (all_okay) {
-         break;
-      }
+   std::vector<int> failed_boards;
+   status = configure_barrier.wait(std::chrono::seconds(10), failed_boards);
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
-
-      timeval now;
-      gettimeofday(&now, NULL);
-
-      if (now.tv_sec - end_connect.tv_sec > timeout_secs) {
-         snprintf(error, 255, "Timeout waiting for all boards to be configured");
+   if (status != SUCCESS) {
+      for (auto i : failed_boards) {
+         snprintf(error, 255, "%s when configuring %s", status == DB_TIMEOUT ? "Timeout" : "Error", board_ctx(i).name.c_str());
          cm_msg(MERROR, __FUNCTION__, "%s", error);
-         return FE_ERR_DRIVER;
       }
-   }
 
-   gettimeofday(&end_config, NULL);
-   double ms = (end_config.tv_sec - start_bor.tv_sec) * 1e3 + (end_config.tv_usec - start_bor.tv_usec) * 1e-3;
-   fe_utils::ts_printf("Took %.3lfms to configure boards\n", ms);
+      arm_gate.abort();
+      return FE_ERR_DRIVER;
+   }
 
-   // Signal the threads that we can start arming the boards
-   ready_to_arm_acq = true;
+   std::chrono::steady_clock::time_point end_config = std::chrono::steady_clock::now();
 
-   if (!settings.multithreaded_readout()) {
-      for (auto i : settings.get_boards_enabled()) {
-         readout_status[i] = arm_board(i);
+   if (settings.debug_settings()) {
+      for (auto i : boards_enabled) {
+         fe_utils::ts_printf("Took %.3lfms to configure %s\n", configure_barrier.get_elapsed_ms(i), board_ctx(i).name.c_str());
       }
    }
 
-   // Wait until all boards report that they configured the board okay.
-   timeout_secs = settings.multithreaded_readout() ? 10 : 0;
-
-   while (true) {
-      bool all_okay = true;
-      bool any_fail = false;
+   fe_utils::ts_printf("Took %.3lfms to connect and %.3lfms to configure boards\n",
+                       std::chrono::duration<double, std::milli>(end_connect - start_bor).count(),
+                       std::chrono::duration<double, std::milli>(end_config - end_connect).count());
 
-      for (auto i : settings.get_boards_enabled()) {
-         if (readout_status[i] != THREAD_STATUS_ARMED) {
-            all_okay = false;
-         }
+   // Release all the threads at once so they arm their boards together.
+   arm_gate.open();
 
-         if (readout_status[i] == THREAD_STATUS_ERROR) {
-            snprintf(error, 255, "Error when arming %s", board_names[i].c_str());
-            cm_msg(MERROR, __FUNCTION__, "%s", error);
-            any_fail = true;
-         }
+   if (!run_config.multithreaded_readout) {
+      for (auto i : boards_enabled) {
+         board_ctx(i).readout_status = arm_board(i);
+         arm_barrier.arrive(i, board_ctx(i).readout_status == THREAD_STATUS_ARMED);
       }
+   }
 
-      if (any_fail) {
-         abort_arming = true;
-         return FE_ERR_DRIVER;
-      }
+   // Wait until all boards report that they armed okay.
+   status = arm_barrier.wait(std::chrono::seconds(10), failed_boards);
 
-      if (all_okay) {
-         break;
+   if (status != SUCCESS) {
+      for (auto i : failed_boards) {
+         snprintf(error, 255, "%s when arming %s", status == DB_TIMEOUT ? "Timeout" : "Error", board_ctx(i).name.c_str());
+         cm_msg(MERROR, __FUNCTION__, "%s", error);
       }
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      return FE_ERR_DRIVER;
+   }
 
-      timeval now;
-      gettimeofday(&now, NULL);
+   std::chrono::steady_clock::time_point end_arm = std::chrono::steady_clock::now();
+   fe_utils::ts_printf("Took %.3lfms to arm boards (skew between boards %.0fus). Total begin-of-run time %.3lfms\n",
+                       std::chrono::duration<double, std::milli>(end_arm - end_config).count(),
+                       arm_barrier.get_spread_us(),
+                       std::chrono::duration<double, std::milli>(end_arm - start_bor).count());
 
-      if (now.tv_sec - end_config.tv_sec > timeout_secs) {
-         snprintf(error, 255, "Timeout waiting for all boards to be armed");
-         cm_msg(MERROR, __FUNCTION__, "%s", error);
-         return FE_ERR_DRIVER;
-      }
+   if (settings.get_verify_policy() == VerifyPolicy::Deferred) {
+      start_deferred_verification();
    }
 
    fe_utils::ts_printf("All boards armed. End of begin-of-run procedure.\n");
@@ -419,6 +722,10 @@ INT VX2740GroupFrontend::jrpc_handler(int index, void** params) {
    INT max_reply_len = (*((INT*)params[3]));
 
    if (strcmp(cmd, "force_write") == 0) {
+      // User explicitly wants every parameter re-read and written.
+      join_verify_threads();
+      settings.mark_settings_dirty();
+      settings.invalidate_applied_settings();
       return force_write_settings(buf_p);
    } else {
       return FE_ERR_ODB;
@@ -428,6 +735,8 @@ INT VX2740GroupFrontend::jrpc_handler(int index, void** params) {
 INT VX2740GroupFrontend::force_write_settings(char* error) {
    INT status = SUCCESS;
 
+   join_verify_threads();
+
    try {
       settings.sync_settings_structs();
    } catch (SettingsException& e) {
@@ -435,35 +744,54 @@ INT VX2740GroupFrontend::force_write_settings(char* error) {
       return FE_ERR_ODB;
    }
 
+   if (setup_board_contexts() != SUCCESS) {
+      snprintf(error, 255, "Number of boards changed; restart the frontend");
+      return FE_ERR_ODB;
+   }
+
    // Connect to any boards that were previously disabled
    if (connect_to_boards(error) != SUCCESS) {
       return FE_ERR_DRIVER;
    }
 
+   std::vector<int> boards_enabled;
+
    for (int i = 0; i < settings.get_num_boards(); i++) {
-      if (!settings.is_board_enabled(i)) {
+      if (settings.is_board_enabled(i)) {
+         boards_enabled.push_back(i);
+      } else {
          cm_msg(MINFO, __FUNCTION__, "Board %02d from group %03d is disabled", i, this_group_index);
-         continue;
       }
+   }
 
-      std::lock_guard<std::mutex> guard(vx_mutexes[i]);
+   // Each board takes hundreds of FELib round trips, so write them all at once.
+   std::vector<INT> board_statuses;
+   std::vector<double> board_elapsed_ms;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-      INT fw_status = validate_firmare_version(i, error);
+   run_on_config_pool(boards_enabled, [this](int board_id) {
+      char board_error[255];
+      return write_board_settings(board_id, board_error);
+   }, board_statuses, board_elapsed_ms);
 
-      if (fw_status != SUCCESS) {
-         status = fw_status;
-         break;
-      }
+   double total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
 
-      try {
-         settings.write_settings_to_board(i, *boards[i]);
-      } catch(CaenException& e) {
-         cm_msg(MERROR, __FUNCTION__, "Failure writing settings to board for %s: %s", board_names[i].c_str(), e.what());
-         status = FE_ERR_DRIVER;
-         break;
+   for (size_t i = 0; i < boards_enabled.size(); i++) {
+      BoardContext& ctx = board_ctx(boards_enabled[i]);
+
+      if (board_statuses[i] != SUCCESS) {
+         // First failure is what we report to the caller; all are in the midas log.
+         if (status == SUCCESS) {
+            snprintf(error, 255, "Failure writing settings to board %s", ctx.name.c_str());
+            status = board_statuses[i];
+         }
+      } else if (settings.debug_settings()) {
+         fe_utils::ts_printf("Took %.3lfms to write settings to %s\n", board_elapsed_ms[i], ctx.name.c_str());
       }
    }
 
+   fe_utils::ts_printf("Took %.3lfms to write settings to %d boards using %d threads\n", total_ms, (int)boards_enabled.size(), config_pool.size());
+
    try {
       settings.handle_board_readback_structs();
    } catch(SettingsException& e) {
@@ -474,8 +802,63 @@ INT VX2740GroupFrontend::force_write_settings(char* error) {
    return status;
 }
 
+INT VX2740GroupFrontend::write_board_settings(int board_id, char* error) {
+   BoardContext& ctx = board_ctx(board_id);
+   std::lock_guard<std::mutex> guard(ctx.mutex);
+
+   INT status = validate_firmare_version(board_id, error);
+
+   if (status != SUCCESS) {
+      return status;
+   }
+
+   try {
+      settings.write_settings_to_board(board_id, *ctx.board);
+   } catch(CaenException& e) {
+      snprintf(error, 255, "Failure writing settings to board for %s: %s", ctx.name.c_str(), e.what());
+      cm_msg(MERROR, __FUNCTION__, "%s", error);
+      return FE_ERR_DRIVER;
+   }
+
+   return SUCCESS;
+}
+
+void VX2740GroupFrontend::run_on_config_pool(const std::vector<int>& board_ids, std::function<INT(int)> job, std::vector<INT>& statuses, std::vector<double>& elapsed_ms) {
+   statuses.assign(board_ids.size(), SUCCESS);
+   elapsed_ms.assign(board_ids.size(), 0);
+
+   if (board_ids.empty()) {
+      return;
+   }
+
+   int num_threads = board_ids.size();
+   uint32_t max_threads = settings.get_max_config_threads();
+
+   if (max_threads > 0 && (int)max_threads < num_threads) {
+      num_threads = max_threads;
+   }
+
+   config_pool.resize(num_threads);
+
+   for (size_t i = 0; i < board_ids.size(); i++) {
+      // Each job only touches its own slot of the output vectors.
+      INT* this_status = &statuses[i];
+      double* this_elapsed = &elapsed_ms[i];
+      int board_id = board_ids[i];
+
+      config_pool.submit([=]() {
+         std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+         *this_status = job(board_id);
+         *this_elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      });
+   }
+
+   config_pool.wait_all();
+}
+
 INT VX2740GroupFrontend::configure_board(int board_id) {
-   VX2740& vx = *(boards[board_id]);
+   BoardContext& ctx = board_ctx(board_id);
+   VX2740& vx = *ctx.board;
    INT status = SUCCESS;
 
    // Ensure board isn't already running
@@ -483,31 +866,19 @@ INT VX2740GroupFrontend::configure_board(int board_id) {
 
    // Write settings, based on defaults and/or overrides.
    // Also checks that values were set correctly.
-   std::lock_guard<std::mutex> guard(vx_mutexes[board_id]);
-
    char error[255];
-   status = validate_firmare_version(board_id, error);
 
-   if (status != SUCCESS) {
-      return status;
-   }
-
-   try {
-      settings.write_settings_to_board(board_id, *boards[board_id]);
-   } catch(CaenException& e) {
-      cm_msg(MERROR, __FUNCTION__, "Failure writing board settings for %s: %s", board_names[board_id].c_str(), e.what());
+   if (write_board_settings(board_id, error) != SUCCESS) {
       return THREAD_STATUS_ERROR;
    }
 
-   guard.~lock_guard();
-
-   int rb_handle = readout_rbs[board_id];
+   int rb_handle = ctx.rb_handle;
 
    // Set up raw data handle for scope mode; decoded handle for user DPP mode
-   bool use_raw_handle = scope_mode[board_id];
+   bool use_raw_handle = ctx.scope_mode;
 
    if (vx.data().setup_data_handle(use_raw_handle, vx.params()) != SUCCESS) {
-      cm_msg(MERROR, __FUNCTION__, "Failure setting up data handle for %s", board_names[board_id].c_str());
+      cm_msg(MERROR, __FUNCTION__, "Failure setting up data handle for %s", ctx.name.c_str());
       return THREAD_STATUS_ERROR;
    }
 
@@ -517,17 +888,23 @@ INT VX2740GroupFrontend::configure_board(int board_id) {
       status = rb_get_buffer_level(rb_handle, &buf_level);
 
       if (status != SUCCESS) {
-         cm_msg(MERROR, __FUNCTION__, "Failure reading buffer level for %s: %d", board_names[board_id].c_str(), status);
+         cm_msg(MERROR, __FUNCTION__, "Failure reading buffer level for %s: %d", ctx.name.c_str(), status);
          return THREAD_STATUS_ERROR;
       }
 
-      fe_utils::ts_printf("Skipping over %d unused bytes in ring buffer for %s\n", buf_level, board_names[board_id].c_str());
-      empty_ring_buffer(rb_handle, MAX_EV_SIZE);
+      fe_utils::ts_printf("Skipping over %d unused bytes in ring buffer for %s\n", buf_level, ctx.name.c_str());
+      empty_ring_buffer(rb_handle, ctx.rb_max_event_bytes);
 
       try {
-         vx.params().get_max_raw_bytes_per_read(max_bytes_per_read[board_id]);
+         vx.params().get_max_raw_bytes_per_read(ctx.max_bytes_per_read);
       } catch (CaenException& e) {
-         cm_msg(MERROR, __FUNCTION__, "Failure max bytes per read for %s", board_names[board_id].c_str());
+         cm_msg(MERROR, __FUNCTION__, "Failure max bytes per read for %s", ctx.name.c_str());
+         return THREAD_STATUS_ERROR;
+      }
+
+      // Each read is written contiguously into the ring buffer.
+      if (ctx.max_bytes_per_read > (DWORD)ctx.rb_max_event_bytes) {
+         cm_msg(MERROR, __FUNCTION__, "%s may return up to %u bytes per read, but 'Max event size (MB)' is only %d bytes", ctx.name.c_str(), ctx.max_bytes_per_read, ctx.rb_max_event_bytes);
          return THREAD_STATUS_ERROR;
       }
    }
@@ -536,44 +913,46 @@ INT VX2740GroupFrontend::configure_board(int board_id) {
 }
 
 INT VX2740GroupFrontend::arm_board(int board_id) {
-   VX2740& vx = *(boards[board_id]);
-   fe_utils::ts_printf("Arming %s\n", board_names[board_id].c_str());
+   BoardContext& ctx = board_ctx(board_id);
+   VX2740& vx = *ctx.board;
+   fe_utils::ts_printf("Arming %s\n", ctx.name.c_str());
 
    // Arm the acquisition
    if (vx.commands().start_acq(vx.params().is_sw_start_enabled()) != SUCCESS) {
-      cm_msg(MERROR, __FUNCTION__, "Failure starting acquisition for %s", board_names[board_id].c_str());
+      cm_msg(MERROR, __FUNCTION__, "Failure starting acquisition for %s", ctx.name.c_str());
       return THREAD_STATUS_ERROR;
    }
 
-   fe_utils::ts_printf("Armed %s\n", board_names[board_id].c_str());
+   fe_utils::ts_printf("Armed %s\n", ctx.name.c_str());
    return THREAD_STATUS_ARMED;
 }
 
 INT VX2740GroupFrontend::read_into_rb(int board_id, DWORD read_timeout_ms, uint16_t* tmp_waveform) {
+   BoardContext& ctx = board_ctx(board_id);
    if (!enable_data_readout || !should_read_from_board(board_id)) {
       return VX_NO_EVENT;
    }
 
-   int rb_handle = readout_rbs[board_id];
+   int rb_handle = ctx.rb_handle;
 
    unsigned char* wp = NULL;
    INT status = rb_get_wp(rb_handle, (void**) &wp, 0);
 
    if (status == DB_TIMEOUT) {
-      if (settings.debug_ring_buffers()) {
-         fe_utils::ts_printf("DEBUG: timeout waiting for wp for board %d\n", board_id);
+      if (run_config.debug_ring_buffers) {
+         FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: timeout waiting for wp for board %d\n", board_id);
       }
 
       std::this_thread::sleep_for(std::chrono::milliseconds(1));
       return VX_NO_EVENT;
    } else if (status != SUCCESS) {
       cm_msg(MERROR, __FUNCTION__, "Failed to get write pointer: %d", status);
-      readout_status[board_id] = THREAD_STATUS_ERROR;
+      ctx.readout_status = THREAD_STATUS_ERROR;
       return THREAD_STATUS_ERROR;
    }
 
-   if (settings.debug_ring_buffers()) {
-      fe_utils::ts_printf("DEBUG: wp is currently %p\n", wp);
+   if (run_config.debug_ring_buffers) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: wp is currently %p\n", wp);
    }
 
    int buf_level = 0;
@@ -581,29 +960,41 @@ INT VX2740GroupFrontend::read_into_rb(int board_id, DWORD read_timeout_ms, uint1
 
    if (status != SUCCESS) {
       cm_msg(MERROR, __FUNCTION__, "Failed to read buffer level: %d", status);
-      readout_status[board_id] = THREAD_STATUS_ERROR;
+      ctx.readout_status = THREAD_STATUS_ERROR;
       return THREAD_STATUS_ERROR;
    }
 
-   unsigned long int buffer_left_bytes = BUFFER_SIZE - buf_level;
+   unsigned long int buffer_left_bytes = ctx.rb_size_bytes - buf_level;
+   uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+   uint64_t rb_full_since_ns = ctx.rb_full_since_ns.load(std::memory_order_relaxed);
+
+   if (buffer_left_bytes <= ctx.max_bytes_per_read + 1024) {
+      // Not reading from the board, so it may be accruing deadtime.
+      if (rb_full_since_ns == 0) {
+         ctx.rb_full_since_ns.store(now_ns, std::memory_order_relaxed);
+      }
 
-   if (buffer_left_bytes <= max_bytes_per_read[board_id] + 1024) {
       return VX_NO_EVENT;
    }
 
-   if (settings.debug_ring_buffers()) {
-      fe_utils::ts_printf("RB headroom is %lu bytes, going to read out up to %u bytes\n", buffer_left_bytes, max_bytes_per_read[board_id]);
+   if (rb_full_since_ns != 0) {
+      add_relaxed(ctx.rb_full_ns, now_ns - rb_full_since_ns);
+      ctx.rb_full_since_ns.store(0, std::memory_order_relaxed);
+   }
+
+   if (run_config.debug_ring_buffers) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "RB headroom is %lu bytes, going to read out up to %u bytes\n", buffer_left_bytes, ctx.max_bytes_per_read);
    }
 
    size_t read_size_bytes = 0;
 
-   VX2740& vx = *(boards[board_id]);
-   std::lock_guard<std::mutex> guard(vx_mutexes[board_id]);
+   VX2740& vx = *ctx.board;
+   std::lock_guard<std::mutex> guard(ctx.mutex);
 
    timeval start, end;
    gettimeofday(&start, NULL);
 
-   if (scope_mode[board_id]) {
+   if (ctx.scope_mode) {
       // Read directly into ring buffer
       status = vx.data().get_raw_data(read_timeout_ms, wp, read_size_bytes);
    } else {
@@ -625,60 +1016,184 @@ INT VX2740GroupFrontend::read_into_rb(int board_id, DWORD read_timeout_ms, uint1
       return VX_NO_EVENT;
    } else if (status != SUCCESS) {
       fe_utils::ts_printf("get_raw_data() returned %d. Break.\n", status);
-      readout_status[board_id] = THREAD_STATUS_ERROR;
+      ctx.readout_status = THREAD_STATUS_ERROR;
       return THREAD_STATUS_ERROR;
    }
 
    double elapsed_us = (end.tv_sec - start.tv_sec)*1e6 + (end.tv_usec - start.tv_usec);
    double rate = (read_size_bytes/1024./1024.)/(elapsed_us/1e6);
 
-   if (settings.debug_rates()) {
-      fe_utils::ts_printf("Read %s in %.0f us (%.1f MiB/s) from %s.\n", fe_utils::format_bytes(read_size_bytes).c_str(), elapsed_us, rate, board_names[board_id].c_str());
+   if (run_config.debug_rates) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "Read %s in %.0f us (%.1f MiB/s) from %s.\n", fe_utils::format_bytes(read_size_bytes).c_str(), elapsed_us, rate, ctx.name.c_str());
+   }
+
+   if (ctx.zle_enabled || ctx.pack_enabled || ctx.hits_enabled) {
+      encode_read(ctx, wp, read_size_bytes);
    }
 
    status = rb_increment_wp(rb_handle, read_size_bytes);
 
    if (status != SUCCESS) {
       cm_msg(MERROR, __FUNCTION__, "Failed to increment wp!");
-      readout_status[board_id] = THREAD_STATUS_ERROR;
+      ctx.readout_status = THREAD_STATUS_ERROR;
       return THREAD_STATUS_ERROR;
    }
 
-   if (settings.debug_ring_buffers()) {
+   // Track peak usage for sizing the buffer in the next run.
+   if (buf_level + (int)read_size_bytes > ctx.rb_peak_level_bytes) {
+      ctx.rb_peak_level_bytes = buf_level + read_size_bytes;
+   }
+
+   if (run_config.debug_ring_buffers) {
       rb_get_buffer_level(rb_handle, &buf_level);
-      fe_utils::ts_printf("DEBUG: incremented wp; RB headroom is now %d bytes\n", BUFFER_SIZE - buf_level);
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: incremented wp; RB headroom is now %d bytes\n", ctx.rb_size_bytes - buf_level);
    }
 
    return SUCCESS;
 }
 
-void *VX2740GroupFrontend::thread_data_readout(int board_id) {
-   fe_utils::ts_printf("Spawned thread to configure/readout %s (board %02d)\n", board_names[board_id].c_str(), board_id);
-
-   readout_status[board_id] = configure_board(board_id);
+void VX2740GroupFrontend::encode_read(BoardContext& ctx, unsigned char* data, size_t& num_bytes) {
+   // The result is built up separately, as hit records that keep their
+   // waveforms can be bigger than the events they came from. rb_get_wp()
+   // guaranteed there's space for a max-size event at `data`.
+   size_t max_out_bytes = std::max(num_bytes, (size_t)ctx.rb_max_event_bytes);
+   size_t out_words = 0;
 
-   if (readout_status[board_id] != THREAD_STATUS_CONFIGURED) {
-      return NULL;
+   if (ctx.encode_out.size() < (num_bytes + 7) / sizeof(uint64_t)) {
+      ctx.encode_out.resize((num_bytes + 7) / sizeof(uint64_t));
    }
 
-   // Wait until main thread tells us that all boards have been configured correctly
-   // before we actually arm the board.
-   while (!ready_to_arm_acq) {
-      if (abort_arming) {
-         return NULL;
+   // Skip the rest of an event that began in an earlier read.
+   size_t in_pos = std::min(ctx.encode_passthrough_bytes, num_bytes);
+   ctx.encode_passthrough_bytes -= in_pos;
+   memcpy(ctx.encode_out.data(), data, in_pos);
+   out_words = in_pos / sizeof(uint64_t);
+
+   // Reads are whole 64-bit words, so the size word of each event is always
+   // in the read it starts in.
+   while (in_pos + sizeof(uint64_t) <= num_bytes) {
+      uint64_t* event_ptr = (uint64_t*)(data + in_pos);
+      size_t event_bytes = (size_t)(event_ptr[0] & 0xFFFFFFFF) * sizeof(uint64_t);
+
+      if (event_bytes < 3 * sizeof(uint64_t) || in_pos + event_bytes > num_bytes) {
+         // Incomplete (or nonsense) event; leave the rest of the data alone.
+         if (event_bytes >= 3 * sizeof(uint64_t)) {
+            ctx.encode_passthrough_bytes = in_pos + event_bytes - num_bytes;
+         }
+
+         break;
       }
 
-      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      CaenEvent event(event_ptr);
+      size_t event_words = event_bytes / sizeof(uint64_t);
+      in_pos += event_bytes;
+
+      bool find_hits = ctx.hits_enabled && event.header.format == 0x10;
+      bool keep_waveform = true;
+      uint8_t hits_flags = 0;
+
+      if (find_hits) {
+         // Limit the hits so a record without the waveform is never bigger
+         // than the original event.
+         uint32_t max_hits = event_words > CAEN_HITS_HEADER_WORDS ? (event_words - CAEN_HITS_HEADER_WORDS) / CAEN_HIT_WORDS : 0;
+
+         if (!ctx.hit_finder.find_hits(event, ctx.hits, max_hits)) {
+            hits_flags |= CAEN_HITS_FLAG_HITS_DROPPED;
+         }
+
+         keep_waveform = ctx.hits_waveform_prescale && ctx.hits_num_events % ctx.hits_waveform_prescale == 0;
+         ctx.hits_num_events++;
+      }
+
+      // Each encoder copies the original if it can't make it smaller.
+      // Compress what zero suppression didn't shrink.
+      const uint64_t* encoded = event_ptr;
+      size_t encoded_words = keep_waveform ? event_words : 0;
+
+      if (keep_waveform && (ctx.zle_enabled || ctx.pack_enabled)) {
+         uint32_t max_words = std::max(CaenZleEncoder::max_size_words(event), CaenPackEncoder::max_size_words(event));
+
+         if (ctx.encode_buffer.size() < max_words) {
+            ctx.encode_buffer.resize(max_words);
+         }
+
+         if (ctx.zle_enabled) {
+            encoded_words = ctx.zle.encode(event, ctx.encode_buffer.data());
+            encoded = ctx.encode_buffer.data();
+         }
+
+         if (ctx.pack_enabled && encoded_words == event_words) {
+            encoded_words = ctx.packer.encode(event, ctx.encode_buffer.data());
+            encoded = ctx.encode_buffer.data();
+         }
+      }
+
+      size_t needed_words = encoded_words;
+
+      if (find_hits) {
+         needed_words = CaenHitFinder::record_size_words(ctx.hits.size(), encoded_words);
+
+         // Everything after this event must still fit (unchanged, at worst),
+         // so drop the waveform rather than overflow the ring buffer.
+         if (encoded_words && (out_words + needed_words) * sizeof(uint64_t) + (num_bytes - in_pos) > max_out_bytes) {
+            hits_flags |= CAEN_HITS_FLAG_WAVEFORM_DROPPED;
+            encoded_words = 0;
+            needed_words = CaenHitFinder::record_size_words(ctx.hits.size(), 0);
+         }
+      }
+
+      if (ctx.encode_out.size() < out_words + needed_words) {
+         ctx.encode_out.resize(std::max(out_words + needed_words, ctx.encode_out.size() * 2));
+      }
+
+      uint64_t* out = ctx.encode_out.data() + out_words;
+
+      if (find_hits) {
+         CaenHitFinder::encode_record(event.header, ctx.hits, hits_flags, encoded_words ? encoded : nullptr, encoded_words, out);
+      } else {
+         memcpy(out, encoded, encoded_words * sizeof(uint64_t));
+      }
+
+      out_words += needed_words;
+   }
+
+   size_t tail_bytes = num_bytes - in_pos;
+
+   if (ctx.encode_out.size() < out_words + (tail_bytes + 7) / sizeof(uint64_t)) {
+      ctx.encode_out.resize(out_words + (tail_bytes + 7) / sizeof(uint64_t));
    }
 
-   readout_status[board_id] = arm_board(board_id);
+   memcpy(ctx.encode_out.data() + out_words, data + in_pos, tail_bytes);
+   num_bytes = out_words * sizeof(uint64_t) + tail_bytes;
+   memcpy(data, ctx.encode_out.data(), num_bytes);
+}
+
+void *VX2740GroupFrontend::thread_data_readout(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   fe_utils::ts_printf("Spawned thread to configure/readout %s (board %02d)\n", ctx.name.c_str(), board_id);
 
-   if (readout_status[board_id] != THREAD_STATUS_ARMED) {
+   ctx.readout_status = configure_board(board_id);
+   configure_barrier.arrive(board_id, ctx.readout_status == THREAD_STATUS_CONFIGURED);
+
+   if (ctx.readout_status != THREAD_STATUS_CONFIGURED) {
+      return NULL;
+   }
+
+   // Wait until main thread tells us that all boards have been configured correctly
+   // before we actually arm the board.
+   if (!arm_gate.wait()) {
+      return NULL;
+   }
+
+   ctx.readout_status = arm_board(board_id);
+   arm_barrier.arrive(board_id, ctx.readout_status == THREAD_STATUS_ARMED);
+
+   if (ctx.readout_status != THREAD_STATUS_ARMED) {
       return NULL;
    }
 
    timeval last_sleep;
-   DWORD timeout_ms = settings.get_read_data_timeout(board_id);
+   DWORD timeout_ms = run_config.read_data_timeout_ms[board_id];
    uint16_t* tmp_waveform = (uint16_t*) calloc(0x8000, sizeof(uint16_t));
 
    while (enable_data_readout && !in_end_of_run) {
@@ -710,32 +1225,258 @@ void *VX2740GroupFrontend::thread_data_readout(int board_id) {
 }
 
 INT VX2740GroupFrontend::end_of_run(INT run_num, char* error) {
+   join_readout_threads();
+
+   for (auto board_id : run_config.boards_enabled_list) {
+      BoardContext& ctx = board_ctx(board_id);
+      std::lock_guard<std::mutex> guard(ctx.mutex);
+      ctx.board->commands().stop_acq();
+   }
+
+   // Verification must finish before the snapshots (which need to know if it
+   // passed) and before anything writes settings for the next run. A failure
+   // leaves the board to be fully written next time.
+   join_verify_threads();
+
+   // The settings we started this run with are now known to be good. This
+   // reads every parameter, so is only done when the settings have changed.
+   if (settings.get_snapshot_dir() != "") {
+      std::vector<INT> statuses;
+      std::vector<double> elapsed_ms;
+      run_on_config_pool(run_config.boards_enabled_list, [this](int board_id) {
+         return save_board_snapshot(board_id);
+      }, statuses, elapsed_ms);
+   }
+
+   return SUCCESS;
+}
+
+void VX2740GroupFrontend::join_readout_threads() {
    in_end_of_run = true;
 
-   for (auto board_id : settings.get_boards_enabled()) {
-      if (readout_threads[board_id]) {
-         readout_threads[board_id]->join();
-         delete readout_threads[board_id];
-         readout_threads[board_id] = NULL;
+   for (int i = 0; i < num_board_contexts; i++) {
+      BoardContext& ctx = board_ctx(i);
+
+      if (ctx.readout_thread) {
+         ctx.readout_thread->join();
+         delete ctx.readout_thread;
+         ctx.readout_thread = NULL;
+      }
+   }
+}
+
+void VX2740GroupFrontend::start_deferred_verification() {
+   for (auto board_id : run_config.boards_enabled_list) {
+      BoardContext& ctx = board_ctx(board_id);
+
+      if (!settings.needs_deferred_verification(board_id)) {
+         continue;
       }
 
-      std::lock_guard<std::mutex> guard(vx_mutexes[board_id]);
-      boards[board_id]->commands().stop_acq();
+      ctx.verify_status = VERIFY_STATUS_RUNNING;
+      ctx.verify_thread = new std::thread(&VX2740GroupFrontend::verify_board_settings, this, board_id);
    }
+}
 
-   return SUCCESS;
+void VX2740GroupFrontend::verify_board_settings(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+
+   // Shares the monitor thread's connection, as a board only allows two
+   // monitor-only connections. The monitor thread's reads are interleaved
+   // with ours.
+   std::shared_ptr<VX2740> monitor_board = get_monitor_connection(ctx);
+
+   if (!monitor_board) {
+      ctx.verify_error = "Failed to open monitoring connection";
+      ctx.verify_status = VERIFY_STATUS_FAILED;
+      return;
+   }
+
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   try {
+      settings.verify_settings_on_board(board_id, *monitor_board, ctx.mutex);
+   } catch (CaenException& e) {
+      ctx.verify_error = e.what();
+      ctx.verify_status = VERIFY_STATUS_FAILED;
+      return;
+   }
+
+   if (settings.debug_settings()) {
+      fe_utils::ts_printf("Took %.3lfms to verify settings of %s in the background\n",
+                          std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), ctx.name.c_str());
+   }
+
+   ctx.verify_status = VERIFY_STATUS_PASSED;
+}
+
+void VX2740GroupFrontend::handle_verify_failure(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   ctx.verify_status = VERIFY_STATUS_IDLE;
+
+   char alarm_name[255] = {};
+   snprintf(alarm_name, 255, "Settings verification - %s", ctx.name.c_str());
+
+   char message[80] = {};
+   snprintf(message, 80, "%s - settings readback mismatch", ctx.name.c_str());
+
+   cm_msg(MERROR, __FUNCTION__, "Deferred settings verification failed for %s: %s", ctx.name.c_str(), ctx.verify_error.c_str());
+   al_trigger_alarm(alarm_name, message, "Alarm", "", AT_INTERNAL);
+
+   if (settings.stop_run_on_verify_failure()) {
+      char errstr[255];
+      cm_transition(TR_STOP, 0, errstr, 255, TR_ASYNC, FALSE);
+   }
 }
 
-int VX2740GroupFrontend::peek_rb_event_id(int board_id) {
+void VX2740GroupFrontend::join_verify_threads() {
+   for (int i = 0; i < num_board_contexts; i++) {
+      BoardContext& ctx = board_ctx(i);
+
+      if (ctx.verify_thread) {
+         ctx.verify_thread->join();
+         delete ctx.verify_thread;
+         ctx.verify_thread = NULL;
+      }
+   }
+}
+
+void VX2740GroupFrontend::update_monitor_config(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   std::lock_guard<std::mutex> guard(ctx.monitor_mutex);
+
+   bool enabled = settings.is_board_enabled(board_id) && ctx.board && ctx.board->is_connected();
+
+   if (!enabled || ctx.monitor_name != ctx.name) {
+      // Board disabled or reconnected (maybe to a different host); start afresh.
+      ctx.monitor_board.reset();
+   }
+
+   ctx.monitor_enabled = enabled;
+   ctx.monitor_name = ctx.name;
+   ctx.monitor_open_fw = ctx.open_fw;
+}
+
+std::shared_ptr<VX2740> VX2740GroupFrontend::get_monitor_connection(BoardContext& ctx) {
+   std::lock_guard<std::mutex> guard(ctx.monitor_mutex);
+
+   if (!ctx.monitor_enabled) {
+      return nullptr;
+   }
+
+   if (ctx.monitor_board && ctx.monitor_board->is_connected()) {
+      return ctx.monitor_board;
+   }
+
+   ctx.monitor_board = std::make_shared<VX2740>();
+
+   if (ctx.monitor_board->connect(ctx.monitor_name, false, true) != SUCCESS) {
+      ctx.monitor_board.reset();
+      return nullptr;
+   }
+
+   ctx.monitor_board->params().set_call_mutex(&ctx.monitor_mutex);
+   return ctx.monitor_board;
+}
+
+void VX2740GroupFrontend::poll_board_monitor(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   BoardMonitorData data;
+
+   std::shared_ptr<VX2740> monitor_board = get_monitor_connection(ctx);
+   std::string monitor_name;
+   bool open_fw = false;
+
+   {
+      std::lock_guard<std::mutex> guard(ctx.monitor_mutex);
+      monitor_name = ctx.monitor_name;
+      open_fw = ctx.monitor_open_fw;
+   }
+
+   if (monitor_board) {
+      CaenParameters& params = monitor_board->params();
+
+      try {
+         params.get_acquisition_status(data.acq_status);
+         params.get_temperatures(data.temp_air_in, data.temp_air_out, data.temp_hottest_adc);
+         params.get_error_flags(data.error_flags);
+         params.get_lvds_io_register(data.lvds_ioreg);
+
+         if (open_fw) {
+            params.get_user_register(0x44, data.lvds_userreg_out);
+            params.get_user_register(0x48, data.lvds_userreg_in);
+         }
+
+         data.valid = true;
+      } catch (CaenException& e) {
+         FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Warning, "Failed to read monitoring values from %s: %s\n", monitor_name.c_str(), e.what());
+         data = BoardMonitorData();
+
+         // Reconnect next time (unless it's already been replaced).
+         std::lock_guard<std::mutex> guard(ctx.monitor_mutex);
+
+         if (ctx.monitor_board == monitor_board) {
+            ctx.monitor_board.reset();
+         }
+      }
+   }
+
+   ctx.monitor_data.publish(data);
+}
+
+void VX2740GroupFrontend::thread_monitor() {
+   while (!stop_monitor) {
+      for (int board_id = 0; board_id < num_board_contexts && !stop_monitor; board_id++) {
+         poll_board_monitor(board_id);
+      }
+
+      std::unique_lock<std::mutex> lock(monitor_wake_mutex);
+      monitor_wake_cv.wait_for(lock, std::chrono::milliseconds(VX2740_MONITOR_PERIOD_MS), [this]() { return stop_monitor.load(); });
+   }
+}
+
+void VX2740GroupFrontend::start_monitor_thread() {
+   if (monitor_thread) {
+      return;
+   }
+
+   stop_monitor = false;
+   monitor_thread = new std::thread(&VX2740GroupFrontend::thread_monitor, this);
+}
+
+void VX2740GroupFrontend::stop_monitor_thread() {
+   if (!monitor_thread) {
+      return;
+   }
+
+   {
+      std::lock_guard<std::mutex> lock(monitor_wake_mutex);
+      stop_monitor = true;
+   }
+
+   monitor_wake_cv.notify_all();
+   monitor_thread->join();
+   delete monitor_thread;
+   monitor_thread = nullptr;
+}
+
+int64_t VX2740GroupFrontend::peek_rb_event_id(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
    unsigned char* rp = NULL;
    int buf_level = 0;
-   int rb_handle = readout_rbs[board_id];
+   int rb_handle = ctx.rb_handle;
+
+   // The event at rp can't change until we consume it, so reuse the last
+   // result if we've already seen a complete event.
+   if (ctx.peek_rp != NULL) {
+      return ctx.peek_event_id;
+   }
 
    INT status = rb_get_buffer_level(rb_handle, &buf_level);
 
    if (status != SUCCESS) {
-      cm_msg(MERROR, __FUNCTION__, "Failed to get buffer level for %s: %d", board_names[board_id].c_str(), status);
-      return 0;
+      cm_msg(MERROR, __FUNCTION__, "Failed to get buffer level for %s: %d", ctx.name.c_str(), status);
+      return -1;
    }
 
    if (buf_level < 24) {
@@ -746,18 +1487,18 @@ int VX2740GroupFrontend::peek_rb_event_id(int board_id) {
    status = rb_get_rp(rb_handle, (void**) &rp, 0);
 
    if (status != SUCCESS) {
-      cm_msg(MERROR, __FUNCTION__, "Failed to get rp for %s: %d", board_names[board_id].c_str(), status);
+      cm_msg(MERROR, __FUNCTION__, "Failed to get rp for %s: %d", ctx.name.c_str(), status);
       return -1;
    }
 
-   if (settings.debug_ring_buffers()) {
-      fe_utils::ts_printf("DEBUG: rp is currently %p\n", rp);
+   if (run_config.debug_ring_buffers) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: rp is currently %p\n", rp);
    }
 
    // Parse the event header
    CaenEventHeader header((uint64_t*)(rp));
 
-   if (header.size_bytes() > BUFFER_SIZE) {
+   if (header.size_bytes() > ctx.rb_size_bytes) {
       if (!warned_corruption) {
          warned_corruption = true;
          cm_msg(MERROR, __FUNCTION__, "Data corruption or event size too large; event is reporting a size of %u bytes", header.size_bytes());
@@ -770,11 +1511,67 @@ int VX2740GroupFrontend::peek_rb_event_id(int board_id) {
 
    if (buf_level < header.size_bytes()) {
       // Fragmented event that hasn't been fully read out yet.
-      printf("%d < %d\n", buf_level, header.size_bytes());
+      if (run_config.debug_ring_buffers) {
+         FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: partial event from %s (%d < %u bytes)\n", ctx.name.c_str(), buf_level, header.size_bytes());
+      }
+
       return -1;
    }
 
-   return header.event_counter;
+   ctx.peek_rp = rp;
+
+   if (is_data_event(header)) {
+      ctx.peek_event_id = ctx.event_counter_ext.extend(header.event_counter);
+      ctx.peek_trigger_time = ctx.trigger_time_ext.extend(header.trigger_time);
+   } else {
+      // Don't let junk counters of start/end of run events move the
+      // extenders; label them with those of the last real event.
+      ctx.peek_event_id = ctx.event_counter_ext.current();
+      ctx.peek_trigger_time = ctx.trigger_time_ext.current();
+   }
+
+   ctx.peek_size_bytes = header.size_bytes();
+
+   count_event(ctx, header);
+
+   return ctx.peek_event_id;
+}
+
+bool VX2740GroupFrontend::is_data_event(const CaenEventHeader& header) {
+   return header.format == 0x10 || header.format == CAEN_ZLE_FORMAT || header.format == CAEN_PACKED_FORMAT || header.format == CAEN_HITS_FORMAT;
+}
+
+void VX2740GroupFrontend::count_event(BoardContext& ctx, CaenEventHeader& header) {
+   add_relaxed(ctx.stat_events, 1);
+   add_relaxed(ctx.stat_bytes, header.size_bytes());
+
+   if (!is_data_event(header)) {
+      return;
+   }
+
+   uint64_t event_counter = ctx.peek_event_id;
+   uint64_t trigger_time = ctx.peek_trigger_time;
+
+   if (ctx.have_last_event && event_counter >= ctx.last_event_counter && trigger_time >= ctx.last_trigger_time) {
+      uint64_t counter_step = event_counter - ctx.last_event_counter;
+      uint64_t gap_ticks = trigger_time - ctx.last_trigger_time;
+
+      if (counter_step > 1) {
+         add_relaxed(ctx.stat_missed_triggers, counter_step - 1);
+      }
+
+      add_relaxed(ctx.stat_trigger_gaps, 1);
+      add_relaxed(ctx.stat_trigger_gap_sum_ticks, gap_ticks);
+
+      // write_metadata() resets the max, so this one can't be a plain store.
+      uint64_t max_ticks = ctx.stat_trigger_gap_max_ticks.load(std::memory_order_relaxed);
+
+      while (gap_ticks > max_ticks && !ctx.stat_trigger_gap_max_ticks.compare_exchange_weak(max_ticks, gap_ticks, std::memory_order_relaxed)) {}
+   }
+
+   ctx.have_last_event = true;
+   ctx.last_event_counter = event_counter;
+   ctx.last_trigger_time = trigger_time;
 }
 
 bool VX2740GroupFrontend::is_event_ready() {
@@ -782,24 +1579,57 @@ bool VX2740GroupFrontend::is_event_ready() {
       return false;
    }
 
-   if (!settings.multithreaded_readout()) {
+   if (!run_config.multithreaded_readout) {
       uint16_t* tmp_waveform = (uint16_t*) calloc(0x8000, sizeof(uint16_t));
 
-      for (auto& i : settings.get_boards_enabled()) {
-         read_into_rb(i, settings.get_read_data_timeout(i), tmp_waveform);
+      for (auto& i : run_config.boards_enabled_list) {
+         read_into_rb(i, run_config.read_data_timeout_ms[i], tmp_waveform);
       }
 
       free(tmp_waveform);
    }
 
-   if (!single_fe_mode && settings.merge_data()) {
+   if (!find_event_to_write()) {
+      batch_wait_start_ms = 0;
+      return false;
+   }
+
+   if (run_config.batch_size_bytes == 0 || in_end_of_run) {
+      return true;
+   }
+
+   // Hold events back until there's enough for a batch, or the oldest has
+   // waited long enough.
+   uint64_t now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+   if (batch_wait_start_ms == 0) {
+      batch_wait_start_ms = now_ms;
+   }
+
+   if (now_ms - batch_wait_start_ms >= run_config.batch_latency_ms) {
+      return true;
+   }
+
+   size_t buffered_bytes = 0;
+
+   for (auto i : run_config.boards_to_read_list) {
+      int buf_level = 0;
+      rb_get_buffer_level(board_ctx(i).rb_handle, &buf_level);
+      buffered_bytes += buf_level;
+   }
+
+   return buffered_bytes >= run_config.batch_size_bytes;
+}
+
+bool VX2740GroupFrontend::find_event_to_write() {
+   if (!single_fe_mode && run_config.merge_data) {
       // Need an event from all boards
-      int match_id = -2;
+      int64_t match_id = -2;
       int mismatch_board_id = -1;
-      int mismatch_missing_id = -1;
+      int64_t mismatch_missing_id = -1;
 
-      for (auto i : settings.get_boards_to_read_from()) {
-         int this_id = peek_rb_event_id(i);
+      for (auto i : run_config.boards_to_read_list) {
+         int64_t this_id = peek_rb_event_id(i);
 
          if (this_id == -1) {
             // No event from this board; can't merge data from all boards..
@@ -810,12 +1640,12 @@ bool VX2740GroupFrontend::is_event_ready() {
          } else if (match_id != this_id) {
             // Event ID mismatch.
             mismatch_missing_id = std::min(match_id, this_id);
-            mismatch_board_id = (mismatch_missing_id == this_id) ? i : settings.get_boards_to_read_from()[0];
+            mismatch_board_id = (mismatch_missing_id == this_id) ? i : run_config.boards_to_read_list[0];
          }
       }
 
       if (mismatch_board_id >= 0) {
-         cm_msg(MERROR, __FUNCTION__, "Board %s missed trigger #%d", board_names[mismatch_board_id].c_str(), mismatch_missing_id);
+         cm_msg(MERROR, __FUNCTION__, "Board %s missed trigger #%" PRId64, board_ctx(mismatch_board_id).name.c_str(), mismatch_missing_id);
          event_id_to_write = mismatch_missing_id;
       } else {
          event_id_to_write = match_id;
@@ -825,8 +1655,8 @@ bool VX2740GroupFrontend::is_event_ready() {
       return true;
    } else {
       // Need an event from any board
-      for (auto i : settings.get_boards_to_read_from()) {
-         int this_id = peek_rb_event_id(i);
+      for (auto i : run_config.boards_to_read_list) {
+         int64_t this_id = peek_rb_event_id(i);
 
          if (this_id != -1) {
             // Board has an event
@@ -840,180 +1670,410 @@ bool VX2740GroupFrontend::is_event_ready() {
    }
 }
 
-int VX2740GroupFrontend::write_data(char* pevent) {
-   if (!enable_data_readout) {
-      return 0;
-   }
-
-   std::vector<int> board_ids_to_write;
+void VX2740GroupFrontend::find_boards_to_write(std::vector<int>& board_ids_to_write) {
+   board_ids_to_write.clear();
 
-   if (!single_fe_mode && settings.merge_data()) {
+   if (!single_fe_mode && run_config.merge_data) {
       // Write data from all boards (unless they missed this trigger)
-      for (auto board_id : settings.get_boards_to_read_from()) {
+      for (auto board_id : run_config.boards_to_read_list) {
          if (peek_rb_event_id(board_id) == event_id_to_write) {
             board_ids_to_write.push_back(board_id);
          }
       }
    } else {
       // Write data from first board with data available
-      for (auto i : settings.get_boards_to_read_from()) {
+      for (auto i : run_config.boards_to_read_list) {
          if (peek_rb_event_id(i) == event_id_to_write) {
             board_ids_to_write.push_back(i);
             break;
          }
       }
    }
+}
+
+int VX2740GroupFrontend::write_data(char* pevent) {
+   if (!enable_data_readout) {
+      return 0;
+   }
+
+   if (run_config.batch_size_bytes) {
+      return write_batched_data(pevent);
+   }
+
+   std::vector<int> board_ids_to_write;
+   find_boards_to_write(board_ids_to_write);
 
    bk_init32(pevent);
    TRIGGER_MASK(pevent) = this_group_index;
 
    for (auto board_id : board_ids_to_write) {
-      unsigned char* rp = NULL;
-      int buf_level = 0;
-      int rb_handle = readout_rbs[board_id];
+      // peek_rb_event_id() has already found a complete event at rp.
+      BoardContext& ctx = board_ctx(board_id);
+      unsigned char* rp = ctx.peek_rp;
+      int rb_handle = ctx.rb_handle;
 
-      INT status = rb_get_rp(rb_handle, (void**) &rp, 0);
+      // Parse the event header
+      CaenEvent event((uint64_t*)rp);
+      CaenEventHeader& header = event.header;
 
-      if (status != SUCCESS) {
-         cm_msg(MERROR, __FUNCTION__, "Failed to get rp: %d", status);
-         return 0;
+      if (run_config.debug_data && fe_log::would_log(fe_log::Level::Debug)) {
+         log_event_summary(ctx, event);
       }
 
-      status = rb_get_buffer_level(rb_handle, &buf_level);
+      // Copy data from buffer into bank
+      uint64_t* pdata;
+      char bank_name[5];
 
-      if (status != SUCCESS) {
-         cm_msg(MERROR, __FUNCTION__, "Failed to get buffer level");
-         return 0;
+      if (header.format == CAEN_HITS_FORMAT) {
+         // Hits found by the readout thread, then the waveforms (if kept)
+         // in their own bank.
+         uint64_t* record = (uint64_t*)rp;
+         uint32_t hits_words = CaenHitFinder::record_size_words(record[3] & 0xFFFFFFFF, 0);
+
+         snprintf(bank_name, 5, "H%03d", board_id);
+         bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+         memcpy(pdata, record, hits_words * sizeof(uint64_t));
+         pdata[0] = (pdata[0] & 0xFFFFFFFF00000000) | hits_words;
+         pdata += hits_words;
+         bk_close(pevent, pdata);
+
+         if (hits_words < header.size_64bit_words) {
+            CaenEvent waveform(record + hits_words);
+            write_waveform_bank(pevent, board_id, waveform);
+         }
+      } else {
+         write_waveform_bank(pevent, board_id, event);
       }
 
-      // Parse the event header
-      CaenEvent event((uint64_t*)rp);
-      CaenEventHeader& header = event.header;
+      if (run_config.write_extended_ids) {
+         // The header's event counter and trigger time, extended to 64 bits.
+         snprintf(bank_name, 5, "X%03d", board_id);
+         bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+         *pdata++ = ctx.peek_event_id;
+         *pdata++ = ctx.peek_trigger_time;
+         bk_close(pevent, pdata);
+      }
+
+      rb_increment_rp(rb_handle, header.size_bytes());
+      ctx.reset_peek_cache();
+
+      if (run_config.debug_ring_buffers) {
+         rb_get_rp(rb_handle, (void**) &rp, 0);
+         FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "DEBUG: incremented rp to %p\n", rp);
+      }
+   }
+
+   if (run_config.debug_data) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "Final event size: %s\n", fe_utils::format_bytes(bk_size(pevent)).c_str());
+   }
+
+   return bk_size(pevent);
+}
+
+int VX2740GroupFrontend::write_batched_data(char* pevent) {
+   // Each board gets a B bank (and an X bank), each with a header and up
+   // to 7 bytes of padding.
+   size_t banks_per_board = run_config.write_extended_ids ? 2 : 1;
+   size_t ids_bytes = run_config.write_extended_ids ? 2 * sizeof(uint64_t) : 0;
+   size_t max_bytes = std::min(run_config.batch_size_bytes, (size_t)VX2740_MAX_EV_SIZE_BYTES);
+   size_t total_bytes = sizeof(BANK_HEADER) + run_config.boards_to_read_list.size() * banks_per_board * (sizeof(BANK32) + 7);
+   int num_events = 0;
+   std::vector<int> board_ids_to_write;
+
+   for (auto board_id : run_config.boards_to_read_list) {
+      board_ctx(board_id).batch_data.clear();
+      board_ctx(board_id).batch_ids.clear();
+   }
+
+   // Gather whole (merged) events until the next one wouldn't fit, or there
+   // are none left. A bank can't be reopened once another has been created,
+   // so each board's events are collected first.
+   do {
+      find_boards_to_write(board_ids_to_write);
+      size_t step_bytes = 0;
+
+      for (auto board_id : board_ids_to_write) {
+         step_bytes += board_ctx(board_id).peek_size_bytes + ids_bytes;
+      }
+
+      if (num_events > 0 && total_bytes + step_bytes > max_bytes) {
+         break;
+      }
+
+      for (auto board_id : board_ids_to_write) {
+         // peek_rb_event_id() has already found a complete event at rp.
+         BoardContext& ctx = board_ctx(board_id);
+         const uint64_t* rp = (const uint64_t*)ctx.peek_rp;
 
-      if (settings.debug_data()) {
-         if (header.format == 0x10) {
-            fe_utils::ts_printf("Writing event # 0x%x from %s.\n", header.event_counter, board_names[board_id].c_str());
-            fe_utils::ts_printf("  Format:       0x%x\n", header.format);
-            fe_utils::ts_printf("  Size:         0x%x bytes (%s)\n", header.size_bytes(), fe_utils::format_bytes(header.size_bytes()).c_str());
-            fe_utils::ts_printf("  Channel mask: 0x%llx\n", header.ch_enable_mask);
-            fe_utils::ts_printf("  Trigger time: 0x%llx (%fs)\n", header.trigger_time, (double)header.trigger_time/1.25e8);
-            
-            // Find first enabled channel
-            int chan = 0;
-
-            for (int i = 0; i < 64; i++) {
-               if (header.ch_enable_mask & ((uint64_t)1<<i)) {
-                  chan = i;
-                  break;
-               }
-            }
-
-            // Print samples of first enabled channel
-            uint16_t samples[10];
-            int num_read = event.get_channel_samples(chan, samples, 10);
-            fe_utils::ts_printf("First %d samples from chan %d: ", num_read, chan);
-            for (int i = 0; i < num_read; i++) {
-               printf("0x%x ", samples[i]);
-            }
-            printf("\n");
-         } else {
-            fe_utils::ts_printf("Writing special event from %s.\n", board_names[board_id].c_str());
-            fe_utils::ts_printf("  Format:       0x%x\n", header.format);
-            fe_utils::ts_printf("  Trigger time: 0x%llx (%fs)\n", header.trigger_time, (double)header.trigger_time/1.25e8);
+         if (run_config.debug_data && fe_log::would_log(fe_log::Level::Debug)) {
+            CaenEvent event((uint64_t*)rp);
+            log_event_summary(ctx, event);
          }
+
+         ctx.batch_data.insert(ctx.batch_data.end(), rp, rp + ctx.peek_size_bytes / sizeof(uint64_t));
+         ctx.batch_ids.push_back(ctx.peek_event_id);
+         ctx.batch_ids.push_back(ctx.peek_trigger_time);
+
+         rb_increment_rp(ctx.rb_handle, ctx.peek_size_bytes);
+         ctx.reset_peek_cache();
       }
 
-      // Copy data from buffer into bank
+      total_bytes += step_bytes;
+      num_events++;
+   } while (find_event_to_write());
+
+   bk_init32(pevent);
+   TRIGGER_MASK(pevent) = this_group_index;
+
+   for (auto board_id : run_config.boards_to_read_list) {
+      BoardContext& ctx = board_ctx(board_id);
       uint64_t* pdata;
       char bank_name[5];
-      snprintf(bank_name, 5, "D%03d", board_id);
 
+      if (ctx.batch_data.empty()) {
+         continue;
+      }
+
+      // Events exactly as they are in the ring buffer, back to back.
+      snprintf(bank_name, 5, "B%03d", board_id);
+      bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+      memcpy(pdata, ctx.batch_data.data(), ctx.batch_data.size() * sizeof(uint64_t));
+      pdata += ctx.batch_data.size();
+      bk_close(pevent, pdata);
+
+      if (run_config.write_extended_ids) {
+         // Extended event counter and trigger time of each event in turn.
+         snprintf(bank_name, 5, "X%03d", board_id);
+         bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+         memcpy(pdata, ctx.batch_ids.data(), ctx.batch_ids.size() * sizeof(uint64_t));
+         pdata += ctx.batch_ids.size();
+         bk_close(pevent, pdata);
+      }
+   }
+
+   batch_wait_start_ms = 0;
+
+   if (run_config.debug_data) {
+      FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "Batched %d events; final event size: %s\n", num_events, fe_utils::format_bytes(bk_size(pevent)).c_str());
+   }
+
+   return bk_size(pevent);
+}
+
+void VX2740GroupFrontend::write_waveform_bank(char* pevent, int board_id, CaenEvent& event) {
+   CaenEventHeader& header = event.header;
+   uint64_t* pdata;
+   char bank_name[5];
+
+   if (header.format == CAEN_ZLE_FORMAT) {
+      // Already zero-suppressed by the readout thread.
+      snprintf(bank_name, 5, "Z%03d", board_id);
+      bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+      event.hencode(pdata);
+      pdata += header.size_bytes()/sizeof(uint64_t);
+      bk_close(pevent, pdata);
+   } else if (header.format == CAEN_PACKED_FORMAT) {
+      // Already compressed by the readout thread.
+      snprintf(bank_name, 5, "P%03d", board_id);
       bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
       event.hencode(pdata);
       pdata += header.size_bytes()/sizeof(uint64_t);
       bk_close(pevent, pdata);
+   } else if (run_config.channel_major_banks && header.format == 0x10) {
+      // De-interleave the channels once here, rather than in every reader.
+      snprintf(bank_name, 5, "C%03d", board_id);
+      bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+      pdata += event.encode_channel_major(pdata);
+      bk_close(pevent, pdata);
+   } else {
+      snprintf(bank_name, 5, "D%03d", board_id);
+      bk_create(pevent, bank_name, TID_QWORD, (void**)&pdata);
+      event.hencode(pdata);
+      pdata += header.size_bytes()/sizeof(uint64_t);
+      bk_close(pevent, pdata);
+   }
+}
 
-      rb_increment_rp(rb_handle, header.size_bytes());
+void VX2740GroupFrontend::log_event_summary(BoardContext& ctx, CaenEvent& event) {
+   CaenEventHeader& header = event.header;
+   char msg[1000];
 
-      if (settings.debug_ring_buffers()) {
-         rb_get_rp(rb_handle, (void**) &rp, 0);
-         fe_utils::ts_printf("DEBUG: incremented rp to %p\n", rp);
+   if (header.format == 0x10) {
+      // Find first enabled channel
+      int chan = 0;
+
+      for (int i = 0; i < 64; i++) {
+         if (header.ch_enable_mask & ((uint64_t)1<<i)) {
+            chan = i;
+            break;
+         }
       }
-   }
 
-   if (settings.debug_data()) {
-      fe_utils::ts_printf("Final event size: %s\n", fe_utils::format_bytes(bk_size(pevent)).c_str());
+      // Show samples of first enabled channel
+      uint16_t samples[10];
+      int num_read = event.get_channel_samples(chan, samples, 10);
+      char samples_str[100] = {};
+      int len = 0;
+
+      for (int i = 0; i < num_read; i++) {
+         len += snprintf(samples_str + len, sizeof(samples_str) - len, "0x%x ", samples[i]);
+      }
+
+      snprintf(msg, sizeof(msg), "Writing event # 0x%x from %s.\n"
+                                 "  Format:       0x%x\n"
+                                 "  Size:         0x%x bytes (%s)\n"
+                                 "  Channel mask: 0x%" PRIx64 "\n"
+                                 "  Trigger time: 0x%" PRIx64 " (%fs)\n"
+                                 "First %d samples from chan %d: %s\n",
+               header.event_counter, ctx.name.c_str(), header.format,
+               header.size_bytes(), fe_utils::format_bytes(header.size_bytes()).c_str(),
+               (uint64_t)header.ch_enable_mask, (uint64_t)header.trigger_time, (double)header.trigger_time/1.25e8,
+               num_read, chan, samples_str);
+   } else {
+      snprintf(msg, sizeof(msg), "Writing special event from %s.\n"
+                                 "  Format:       0x%x\n"
+                                 "  Trigger time: 0x%" PRIx64 " (%fs)\n",
+               ctx.name.c_str(), header.format, (uint64_t)header.trigger_time, (double)header.trigger_time/1.25e8);
    }
 
-   return bk_size(pevent);
+   // Whole summary is one message so lines from different events don't interleave.
+   FE_LOG_RATE_LIMITED(DEBUG_LOG_MAX_PER_SEC, fe_log::Level::Debug, "%s", msg);
 }
 
 int VX2740GroupFrontend::write_metadata(char* pevent) {
    // Store metadata from VX2740.
    bk_init32(pevent);
 
-   for (int board_id = 0; board_id < settings.get_num_boards(); board_id++) {
+   for (int board_id = 0; board_id < num_board_contexts; board_id++) {
       DWORD* pdata;
       char bank_name[5];
       snprintf(bank_name, 5, "M%03d", board_id);
 
       // If you add more settings here, also update the list of Names in
       // setup_group_and_board_params()!
-      DWORD status = 0;
-      float temp_air_in = 0, temp_air_out = 0, temp_hottest_adc = 0;
-      uint32_t error_flags = 0;
-      std::vector<int> boards_enabled = settings.get_boards_enabled();
+      // Values come from the monitor thread, so we never wait on the board here.
+      BoardMonitorData data;
 
-      if (std::find(boards_enabled.begin(), boards_enabled.end(), board_id) != boards_enabled.end()) {
-         VX2740& vx = *(boards[board_id]);
-         vx_mutexes[board_id].lock();
-         vx.params().get_acquisition_status(status);
-         vx.params().get_temperatures(temp_air_in, temp_air_out, temp_hottest_adc);
-         vx.params().get_error_flags(error_flags);
-         vx_mutexes[board_id].unlock();
+      if (settings.is_board_enabled(board_id)) {
+         data = board_ctx(board_id).monitor_data.latest();
       }
 
       bk_create(pevent, bank_name, TID_DWORD, (void**)&pdata);
 
-      *pdata++ = status;
-      *pdata++ = (DWORD)temp_air_in;
-      *pdata++ = (DWORD)temp_hottest_adc;
-      *pdata++ = error_flags;
+      *pdata++ = data.acq_status;
+      *pdata++ = (DWORD)data.temp_air_in;
+      *pdata++ = (DWORD)data.temp_hottest_adc;
+      *pdata++ = data.error_flags;
 
       bk_close(pevent, pdata);
 
+      // Rates/deadtime from the data we've read, after a version word.
+      // History names are set in VX2740FeSettingsODB::setup_board_params().
+      std::vector<double> rates = compute_board_rates(board_id);
+      settings.set_rates_readback(board_id, rates);
+
+      float* prates;
+      snprintf(bank_name, 5, "R%03d", board_id);
+      bk_create(pevent, bank_name, TID_FLOAT, (void**)&prates);
+
+      *prates++ = VX2740_RATE_BANK_VERSION;
+
+      for (auto rate : rates) {
+         *prates++ = rate;
+      }
+
+      bk_close(pevent, prates);
    }
 
    return bk_size(pevent);
 }
 
+std::vector<double> VX2740GroupFrontend::compute_board_rates(int board_id) {
+   BoardContext& ctx = board_ctx(board_id);
+   BoardRateTotals now;
+   now.time = std::chrono::steady_clock::now();
+   now.events = ctx.stat_events.load(std::memory_order_relaxed);
+   now.bytes = ctx.stat_bytes.load(std::memory_order_relaxed);
+   now.missed_triggers = ctx.stat_missed_triggers.load(std::memory_order_relaxed);
+   now.trigger_gaps = ctx.stat_trigger_gaps.load(std::memory_order_relaxed);
+   now.trigger_gap_sum_ticks = ctx.stat_trigger_gap_sum_ticks.load(std::memory_order_relaxed);
+   now.rb_full_ns = ctx.rb_full_ns.load(std::memory_order_relaxed);
+   uint64_t max_gap_ticks = ctx.stat_trigger_gap_max_ticks.exchange(0, std::memory_order_relaxed);
+
+   // Include a wait for ring buffer space that hasn't finished yet.
+   uint64_t rb_full_since_ns = ctx.rb_full_since_ns.load(std::memory_order_relaxed);
+   uint64_t now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time.time_since_epoch()).count();
+
+   if (rb_full_since_ns != 0 && now_ns > rb_full_since_ns) {
+      now.rb_full_ns += now_ns - rb_full_since_ns;
+   }
+
+   const BoardRateTotals& prev = ctx.rate_prev;
+   double elapsed_s = std::chrono::duration<double>(now.time - prev.time).count();
+   uint64_t num_gaps = now.trigger_gaps - prev.trigger_gaps;
+   double ticks_per_us = 125.; // 8ns per trigger time tick
+
+   std::vector<double> rates;
+
+   if (elapsed_s > 0) {
+      rates.push_back((now.events - prev.events) / elapsed_s);
+      rates.push_back((now.bytes - prev.bytes) / elapsed_s / 1e6);
+   } else {
+      rates.push_back(0);
+      rates.push_back(0);
+   }
+
+   rates.push_back(now.missed_triggers - prev.missed_triggers);
+   rates.push_back(now.missed_triggers);
+   rates.push_back(num_gaps ? (now.trigger_gap_sum_ticks - prev.trigger_gap_sum_ticks) / (double)num_gaps / ticks_per_us : 0);
+   rates.push_back(max_gap_ticks / ticks_per_us);
+
+   int buf_level = 0;
+
+   if (ctx.rb_handle && ctx.rb_size_bytes > 0 && rb_get_buffer_level(ctx.rb_handle, &buf_level) == SUCCESS) {
+      rates.push_back(100. * buf_level / ctx.rb_size_bytes);
+   } else {
+      rates.push_back(0);
+   }
+
+   // Totals include any unfinished wait, so the wait isn't counted twice.
+   uint64_t rb_full_ns = now.rb_full_ns > prev.rb_full_ns ? now.rb_full_ns - prev.rb_full_ns : 0;
+   rates.push_back(elapsed_s > 0 ? 100. * rb_full_ns / (elapsed_s * 1e9) : 0);
+
+   ctx.rate_prev = now;
+
+   return rates;
+}
+
 int VX2740GroupFrontend::check_errors(char* pevent) {
-   for (int board_id = 0; board_id < settings.get_num_boards(); board_id++) {
-      uint16_t lvds_ioreg = 0;
-      uint32_t lvds_userreg_in = 0;
-      uint32_t lvds_userreg_out = 0;
+   for (int board_id = 0; board_id < num_board_contexts; board_id++) {
+      BoardContext& ctx = board_ctx(board_id);
+      BoardMonitorData data;
       BoardErrors err;
-      std::vector<int> boards_enabled = settings.get_boards_enabled();
 
-      if (std::find(boards_enabled.begin(), boards_enabled.end(), board_id) != boards_enabled.end()) {
-         VX2740& vx = *(boards[board_id]);
-         std::lock_guard<std::mutex> guard(vx_mutexes[board_id]);
-         vx.params().get_error_flags(err.bitmask);
-         vx.params().get_lvds_io_register(lvds_ioreg);
-
-         if (open_fw[board_id]) {
-            vx.params().get_user_register(0x44, lvds_userreg_out);
-            vx.params().get_user_register(0x48, lvds_userreg_in);
-         }
+      if (settings.is_board_enabled(board_id)) {
+         data = ctx.monitor_data.latest();
+      }
 
-         err.message = vx.params().error_to_text(err.bitmask);
+      if (data.valid && ctx.board) {
+         err.bitmask = data.error_flags;
+         err.message = ctx.board->params().error_to_text(err.bitmask);
       }
 
       settings.set_board_errors(board_id, err);
-      settings.set_lvds_readback(board_id, lvds_ioreg, lvds_userreg_out, lvds_userreg_in);
+      settings.set_lvds_readback(board_id, data.lvds_ioreg, data.lvds_userreg_out, data.lvds_userreg_in);
 
       std::string hostname = settings.get_hostname(board_id);
 
+      if (ctx.verify_status == VERIFY_STATUS_FAILED) {
+         handle_verify_failure(board_id);
+      }
+
+      if (!data.valid) {
+         // Don't know the error state; leave the alarm as it is.
+         continue;
+      }
+
       char alarm_name[255] = {};
       snprintf(alarm_name, 255, "Digitizer error - %s", hostname.c_str());
 
@@ -1065,19 +2125,29 @@ INT VX2740GroupFrontend::empty_ring_buffer(int rb_handle, int max_event_size_byt
 }
 
 std::map<int, VX2740*> VX2740GroupFrontend::get_boards() {
-   return boards;
+   std::map<int, VX2740*> retval;
+
+   for (int i = 0; i < num_board_contexts; i++) {
+      if (board_contexts[i].board) {
+         retval[i] = board_contexts[i].board;
+      }
+   }
+
+   return retval;
 }
 
 std::map<int, std::string> VX2740GroupFrontend::get_board_names() {
-   return board_names;
-}
+   std::map<int, std::string> retval;
 
-bool VX2740GroupFrontend::should_read_from_board(int board_id) {
-   for (auto& b : settings.get_boards_to_read_from()) {
-      if (b == board_id) {
-         return true;
+   for (int i = 0; i < num_board_contexts; i++) {
+      if (board_contexts[i].board) {
+         retval[i] = board_contexts[i].name;
       }
    }
 
-   return false;
+   return retval;
+}
+
+bool VX2740GroupFrontend::should_read_from_board(int board_id) {
+   return run_config.boards_to_read.test(board_id);
 }
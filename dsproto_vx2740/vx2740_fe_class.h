@@ -6,13 +6,188 @@
 #include "vx2740_wrapper.h"
 #include "fe_settings.h"
 #include "fe_settings_strategy.h"
+#include "fe_thread_sync.h"
+#include "caen_event.h"
+#include "caen_zle.h"
+#include "caen_packing.h"
+#include "caen_hits.h"
 #include <map>
+#include <atomic>
 #include <cmath>
 #include <mutex>
 #include <sstream>
 #include <thread>
+#include <functional>
+#include <chrono>
 #include <stdexcept>
 
+// Limits for the per-board ring buffers. The actual sizes are set per board
+// by the "Ring buffer size (MB)" and "Max event size (MB)" settings; the mfe
+// frontends also use these to size the midas event buffers.
+#define VX2740_DEFAULT_RB_SIZE_BYTES 1000000000 // 1000MB (board has 2GB total)
+#define VX2740_MAX_RB_SIZE_BYTES 2000000000     // rb_create() takes an int
+#define VX2740_MAX_EV_SIZE_BYTES 320000000      // 320MB
+
+#define VX2740_CACHE_LINE_SIZE 64
+
+// How often the monitor thread reads slow-control values from each board.
+#define VX2740_MONITOR_PERIOD_MS 1000
+
+// Slow-control values of a board, as last read by the monitor thread.
+struct BoardMonitorData {
+   bool valid = false; // False if not read yet, or the last read failed
+   uint32_t acq_status = 0;
+   float temp_air_in = 0;
+   float temp_air_out = 0;
+   float temp_hottest_adc = 0;
+   uint32_t error_flags = 0;
+   uint16_t lvds_ioreg = 0;
+   uint32_t lvds_userreg_out = 0;
+   uint32_t lvds_userreg_in = 0;
+};
+
+// Counters with a single writing thread can skip the locked increment.
+inline void add_relaxed(std::atomic<uint64_t>& counter, uint64_t n) {
+   counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+// Totals used for the rate/deadtime accounting, as of the last metadata event.
+struct BoardRateTotals {
+   std::chrono::steady_clock::time_point time;
+   uint64_t events = 0;
+   uint64_t bytes = 0;
+   uint64_t missed_triggers = 0;
+   uint64_t trigger_gaps = 0;
+   uint64_t trigger_gap_sum_ticks = 0;
+   uint64_t rb_full_ns = 0;
+};
+
+// Per-board state of the frontend. Fields are grouped by which thread writes
+// them during a run, with each group starting on a new cache line so the
+// readout thread and the thread writing midas events don't contend.
+struct alignas(VX2740_CACHE_LINE_SIZE) BoardContext {
+   // Set by the main thread at init/begin-of-run; read-only during a run.
+   VX2740* board = nullptr;
+   std::string name;
+   std::thread* readout_thread = nullptr;
+   int rb_handle = 0;
+   int rb_size_bytes = 0;
+   int rb_max_event_bytes = 0;
+   bool scope_mode = false;
+   bool open_fw = false;
+
+   // Deferred readback verification of the settings, using the monitoring
+   // connection so it can run alongside the readout.
+   std::thread* verify_thread = nullptr;
+   std::atomic<INT> verify_status{0};
+   std::string verify_error; // Set before verify_status changes to failed
+
+   // Tag of the snapshot last saved/restored for this board.
+   std::string snapshot_tag;
+
+   // Written by the readout thread.
+   alignas(VX2740_CACHE_LINE_SIZE) std::atomic<INT> readout_status{0};
+   DWORD max_bytes_per_read = 0;
+   int rb_peak_level_bytes = 0;
+
+   // Time spent waiting for space in the ring buffer (so not reading from
+   // the board), and when the current wait started (0 if not waiting).
+   std::atomic<uint64_t> rb_full_ns{0};
+   std::atomic<uint64_t> rb_full_since_ns{0};
+
+   // Zero suppression, lossless compression and/or pulse finding, done on
+   // each read before it's made visible in the ring buffer (configured at
+   // begin-of-run). Events that straddle two reads are left as they are.
+   bool zle_enabled = false;
+   bool pack_enabled = false;
+   bool hits_enabled = false;
+   CaenZleEncoder zle;
+   CaenPackEncoder packer;
+   CaenHitFinder hit_finder;
+   std::vector<CaenHit> hits;
+   uint32_t hits_waveform_prescale = 1;
+   uint64_t hits_num_events = 0; // For the prescale
+   std::vector<uint64_t> encode_buffer;
+   std::vector<uint64_t> encode_out; // The whole read, re-encoded
+   size_t encode_passthrough_bytes = 0; // Rest of an event begun in an earlier read
+
+   // Written by the thread writing midas events. Caches the complete
+   // event at the ring buffer's read pointer until it is consumed.
+   alignas(VX2740_CACHE_LINE_SIZE) unsigned char* peek_rp = nullptr;
+   int64_t peek_event_id = -1; // Extended to 64 bits
+   uint64_t peek_trigger_time = 0; // Extended to 64 bits
+   uint32_t peek_size_bytes = 0;
+
+   // Also written by the thread writing midas events. Events (and their
+   // extended event counter/trigger time) gathered for the next batch.
+   std::vector<uint64_t> batch_data;
+   std::vector<uint64_t> batch_ids;
+
+   // Extend the wrapping event counter and trigger time of each event as it
+   // reaches the read pointer, so merging survives the counter wrapping.
+   CaenCounterExtender event_counter_ext{CAEN_EVENT_COUNTER_BITS};
+   CaenCounterExtender trigger_time_ext{CAEN_TRIGGER_TIME_BITS};
+
+   // Accounting of the events seen at the read pointer this run. The
+   // counters are read by write_metadata().
+   bool have_last_event = false;
+   uint64_t last_event_counter = 0; // Extended
+   uint64_t last_trigger_time = 0; // Extended
+   std::atomic<uint64_t> stat_events{0};
+   std::atomic<uint64_t> stat_bytes{0};
+   std::atomic<uint64_t> stat_missed_triggers{0};
+   std::atomic<uint64_t> stat_trigger_gaps{0};
+   std::atomic<uint64_t> stat_trigger_gap_sum_ticks{0};
+   std::atomic<uint64_t> stat_trigger_gap_max_ticks{0}; // Reset by write_metadata()
+
+   // Totals at the last metadata event; only used by write_metadata().
+   BoardRateTotals rate_prev;
+
+   // Serialises access to the board's main connection between the readout
+   // thread and anything configuring the board.
+   alignas(VX2740_CACHE_LINE_SIZE) std::mutex mutex;
+
+   // Second, monitor-only connection to the board, used by the monitor
+   // thread and deferred verification so slow-control reads never hold up
+   // the readout. These fields are guarded by monitor_mutex, which is also
+   // held for each FELib call on the connection (not for a whole sequence
+   // of reads, so verification doesn't hold up the monitor thread). Users
+   // take a copy of the pointer, so it stays valid if replaced meanwhile.
+   alignas(VX2740_CACHE_LINE_SIZE) std::mutex monitor_mutex;
+   std::shared_ptr<VX2740> monitor_board;
+   bool monitor_enabled = false;
+   std::string monitor_name;
+   bool monitor_open_fw = false;
+
+   // Latest values read by the monitor thread (its only writer, including
+   // the empty values of disabled boards); read by the main thread.
+   TripleBuffer<BoardMonitorData> monitor_data;
+
+   void reset_peek_cache() {
+      peek_rp = nullptr;
+      peek_event_id = -1;
+      peek_trigger_time = 0;
+      peek_size_bytes = 0;
+   }
+
+   // Only call while no readout or event-writing is happening.
+   void reset_run_counters() {
+      event_counter_ext.reset();
+      trigger_time_ext.reset();
+      rb_full_ns = 0;
+      rb_full_since_ns = 0;
+      have_last_event = false;
+      stat_events = 0;
+      stat_bytes = 0;
+      stat_missed_triggers = 0;
+      stat_trigger_gaps = 0;
+      stat_trigger_gap_sum_ticks = 0;
+      stat_trigger_gap_max_ticks = 0;
+      rate_prev = BoardRateTotals();
+      rate_prev.time = std::chrono::steady_clock::now();
+   }
+};
+
 class VX2740GroupFrontend {
 public:
    VX2740GroupFrontend(std::shared_ptr<VX2740FeSettingsStrategyBase> _strategy, bool _use_single_fe_mode, bool _enable_data_readout=true);
@@ -44,18 +219,108 @@ public:
 
 
 protected:
-   INT setup_ring_buffers();
+   // Allocate the per-board contexts, or check the number of boards
+   // hasn't changed if they already exist.
+   INT setup_board_contexts();
+
+   inline BoardContext& board_ctx(int board_id) {
+      return board_contexts[board_id];
+   }
+
+   // Create/resize the ring buffers of enabled boards, and free those of
+   // disabled boards. If `adapt_to_usage` is true, sizes are based on
+   // the peak occupancy seen in the previous run, between `min_size` (set
+   // by the expected event size) and `max_size`.
+   INT setup_ring_buffers(bool adapt_to_usage);
+   int get_adaptive_rb_size(int board_id, int configured_size, int min_size, int max_size);
    virtual INT connect_to_boards(char* error);
    virtual INT validate_firmare_version(int board_id, char* error);
 
+   // Warm restore: put a newly-connected board back to the state in its
+   // last-known-good snapshot (see "Snapshot directory"), so only settings
+   // that have since changed in the ODB need to be written. Only writes
+   // what differs from the board's current state, unless the reset marker
+   // shows the board was reset. Run on the config pool.
+   void restore_board_snapshot(int board_id);
+
+   // Save a snapshot of a board's state, if its settings have changed since
+   // the last one and were written (and verified) successfully.
+   INT save_board_snapshot(int board_id);
+
+   // Validate firmware and write settings to one board, holding its mutex.
+   INT write_board_settings(int board_id, char* error);
+
+   // Run `job` for each board on config_pool and wait for them all to finish.
+   // Status and wall time of each job are returned in the same order as `board_ids`.
+   void run_on_config_pool(const std::vector<int>& board_ids, std::function<INT(int)> job, std::vector<INT>& statuses, std::vector<double>& elapsed_ms);
+
    INT configure_board(int board_id);
    INT arm_board(int board_id);
+   void join_readout_threads();
+
+   // Slow-control polling, on its own thread and connections. The periodic
+   // equipment (write_metadata/check_errors) only uses the latest values.
+   void start_monitor_thread();
+   void stop_monitor_thread();
+   void thread_monitor();
+   void poll_board_monitor(int board_id);
+
+   // Tell the monitor thread which boards to poll (after connecting or
+   // enabling/disabling boards).
+   void update_monitor_config(int board_id);
+
+   // Open the monitor connection if needed, and return it (or null if it
+   // can't be opened).
+   std::shared_ptr<VX2740> get_monitor_connection(BoardContext& ctx);
+
+   // For the Deferred verification policy: check the settings of boards
+   // we've just configured in background threads, and wait for them.
+   void start_deferred_verification();
+   void verify_board_settings(int board_id);
+   void handle_verify_failure(int board_id);
+   void join_verify_threads();
    INT read_into_rb(int board_id, DWORD read_timeout_ms, uint16_t* tmp_waveform);
 
+   // Zero-suppress/compress/find hits in the events in a read of `num_bytes`
+   // at `data`, in place. Updates `num_bytes` to the new size, which may be
+   // bigger (up to the ring buffer's max event size) if hits and waveforms
+   // are both kept.
+   void encode_read(BoardContext& ctx, unsigned char* data, size_t& num_bytes);
+
    INT force_write_settings(char* error);
 
-   int peek_rb_event_id(int board_id);
+   // Extended event ID of the complete event at the ring buffer's read
+   // pointer, or -1 if there isn't one yet (or the ring buffer can't be
+   // read). Callers must treat -1 as "no event"; 0 is a valid ID.
+   int64_t peek_rb_event_id(int board_id);
 
+   // Set event_id_to_write from the events at the read pointers. Returns
+   // false if there's nothing to write yet.
+   bool find_event_to_write();
+
+   // Boards with event_id_to_write at their read pointer that should be
+   // written to the next midas event.
+   void find_boards_to_write(std::vector<int>& board_ids_to_write);
+
+   // Write as many events as fit in the batch size to one midas event
+   // (B banks; see README).
+   int write_batched_data(char* pevent);
+
+   // Update the rate/deadtime accounting for a new event at the read pointer.
+   void count_event(BoardContext& ctx, CaenEventHeader& header);
+
+   // Whether the event has a real event counter/trigger time (i.e. isn't a
+   // start/end of run event).
+   static bool is_data_event(const CaenEventHeader& header);
+
+   // Rates since the last call, in VX2740_RATE_READBACK order.
+   std::vector<double> compute_board_rates(int board_id);
+
+   // Log the header and first few samples of an event we're writing.
+   void log_event_summary(BoardContext& ctx, CaenEvent& event);
+
+   // Add the bank for an event's waveforms (D, C, Z or P) to a midas event.
+   void write_waveform_bank(char* pevent, int board_id, CaenEvent& event);
 
    // Empty a midas ring buffer, so the write pointer and read pointer
    // are in the same place.
@@ -63,27 +328,37 @@ protected:
 
    VX2740FeSettings settings;
 
+   // Frozen at begin-of-run; used by the readout/writer threads.
+   RunConfig run_config;
+
    bool enable_data_readout;
    bool single_fe_mode;
 
    int this_group_index = -1;
 
-   int event_id_to_write = -1;
-   bool in_end_of_run = false;
+   int64_t event_id_to_write = -1;
+   uint64_t batch_wait_start_ms = 0; // When events started waiting for a batch (0 if none are)
+   std::atomic<bool> in_end_of_run{false};
    bool warned_corruption = false;
 
-   bool ready_to_arm_acq = false;
-   bool abort_arming = false;
-
-   std::map<int, VX2740*> boards;
-   std::map<int, std::string> board_names;
-   std::map<int, std::thread*> readout_threads;
-   std::map<int, INT> readout_status;
-   std::map<int, int> readout_rbs;
-   std::map<int, DWORD> max_bytes_per_read;
-   std::map<int, std::mutex> vx_mutexes;
-   std::map<int, bool> scope_mode;
-   std::map<int, bool> open_fw;
+   // Begin-of-run handshake with the readout threads. Threads configure
+   // their board, arrive at configure_barrier, wait for arm_gate to open,
+   // then arm their board and arrive at arm_barrier.
+   BoardBarrier configure_barrier;
+   BoardBarrier arm_barrier;
+   ThreadGate arm_gate;
+
+   // Used to write settings to several boards at once.
+   FeThreadPool config_pool;
+
+   std::thread* monitor_thread = nullptr;
+   std::atomic<bool> stop_monitor{false};
+   std::mutex monitor_wake_mutex;
+   std::condition_variable monitor_wake_cv;
+
+   // Indexed by board ID
+   BoardContext* board_contexts = nullptr;
+   int num_board_contexts = 0;
 };
 
 
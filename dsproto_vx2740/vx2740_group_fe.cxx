@@ -11,6 +11,7 @@
 #include "mfe.h"
 #include "fe_settings_strategy.h"
 #include "vx2740_fe_class.h"
+#include "fe_logger.h"
 
 /*-- Globals -------------------------------------------------------*/
 
@@ -25,17 +26,14 @@ BOOL frontend_call_loop = TRUE;
 /* a frontend status page is displayed with this frequency in ms */
 INT display_period = 0;
 
-#define BUFFER_SIZE 1000000000 // 1000MB (board has 2GB total)
-#define MAX_EV_SIZE 320000000  // 320MB
-
 /* maximum event size produced by this frontend */
-INT max_event_size = MAX_EV_SIZE + 100;
+INT max_event_size = VX2740_MAX_EV_SIZE_BYTES + 100;
 
 /* maximum event size for fragmented events (EQ_FRAGMENTED) */
 INT max_event_size_frag = 5 * 1024 * 1024;
 
 /* buffer size to hold events */
-INT event_buffer_size = BUFFER_SIZE;
+INT event_buffer_size = VX2740_DEFAULT_RB_SIZE_BYTES;
 
 /*-- Function declarations -----------------------------------------*/
 
@@ -129,7 +127,8 @@ INT read_errors(char *pevent, INT off) {
 }
 
 // Polling to check whether events are ready to be written to midas buffer.
-// We require the ring buffer to contain at least 1 full event.
+// We require the ring buffer to contain at least 1 full event (and, if
+// batching, enough for a batch or an event that has waited long enough).
 INT poll_event(INT source, INT count, BOOL test) {
    if (test) {
       for (int i = 0; i < count - 1; i++) {
@@ -142,7 +141,8 @@ INT poll_event(INT source, INT count, BOOL test) {
    return vx_group.is_event_ready();
 }
 
-// Place the most recently-read event into a midas bank.
+// Place the most recently-read event (or a batch of events, if "Batch size
+// (kB)" is set) into midas banks.
 // Currently we also print some debugging information.
 INT read_waveforms(char *pevent, INT off) {
    return vx_group.write_data(pevent);
@@ -160,10 +160,18 @@ INT frontend_init() {
 
    cm_register_transition(TR_STARTABORT, end_of_run, 500);
 
-   return vx_group.init(gFrontendIndex, hDB);
+   INT status = vx_group.init(gFrontendIndex, hDB);
+
+   if (status != SUCCESS) {
+      // Make sure the reason is printed before we exit.
+      fe_log::flush();
+   }
+
+   return status;
 }
 
 INT frontend_exit() {
+   fe_log::flush();
    return SUCCESS;
 }
 
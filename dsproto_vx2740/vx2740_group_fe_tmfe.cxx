@@ -2,6 +2,7 @@
 #include "tmfe.h"
 #include "fe_settings_strategy.h"
 #include "vx2740_fe_class.h"
+#include "fe_logger.h"
 
 // Object for interacting with registers.
 // Here we specify to use "group fe mode"
@@ -131,6 +132,8 @@ public:
       INT status = vx_group.init(fFeIndex, fMfe->fDB);
 
       if (status != SUCCESS) {
+         // Make sure the reason is printed before we exit.
+         fe_log::flush();
          return TMFeResult(status, "Failed to init");
       }
 
@@ -143,7 +146,9 @@ public:
       return TMFeOk();
    };
    
-   void HandleFrontendExit() override {};
+   void HandleFrontendExit() override {
+      fe_log::flush();
+   };
 };
 
 int main(int argc, char* argv[]) {
@@ -0,0 +1,244 @@
+#include "stdio.h"
+#include "caen_hits.h"
+#include "vx2740_test_events.h"
+#include <inttypes.h>
+#include <cstdlib>
+#include <cstring>
+
+/*
+ * Checks that CaenHitFinder finds the pulses in made-up scope events with
+ * the right charges, and that hit records written by encode_record() read
+ * back through CaenHitsEvent, with and without the waveform. Doesn't need
+ * a board. Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+const int num_chans = 64;
+const uint32_t num_samples = 5000;
+const uint16_t baseline = 3000;
+const std::vector<uint32_t> pulse_starts = {500, 2000, 4000};
+const int pulse_every = 4;
+
+void test_find_hits() {
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(num_chans, num_samples, baseline, 3, pulse_starts, 800, pulse_every);
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 1, 0, raw);
+   CaenEvent event(raw.data());
+
+   CaenHitConfig config;
+   config.qshort_samples.assign(64, 18); // Rounded down to 16
+   CaenHitFinder finder;
+   finder.configure(config);
+
+   std::vector<CaenHit> hits;
+   check("find_hits() kept all hits", finder.find_hits(event, hits, 10000), true);
+   check("number of hits", hits.size(), pulse_starts.size() * num_chans / pulse_every);
+
+   char what[100];
+   size_t idx = 0;
+
+   for (int c = 0; c < num_chans; c += pulse_every) {
+      for (auto start : pulse_starts) {
+         if (idx >= hits.size()) {
+            break;
+         }
+
+         const CaenHit& hit = hits[idx++];
+         snprintf(what, sizeof(what), "channel %d pulse at %u: channel", c, start);
+         check(what, hit.channel, c);
+         snprintf(what, sizeof(what), "channel %d pulse at %u: first sample", c, start);
+         check(what, hit.first_sample, start);
+         snprintf(what, sizeof(what), "channel %d pulse at %u: flags", c, start);
+         check(what, hit.flags, 0);
+         snprintf(what, sizeof(what), "channel %d pulse at %u: baseline near %u", c, start, baseline);
+         check(what, abs(hit.baseline - baseline) <= 3, true);
+
+         int64_t qshort = 0;
+         int64_t qlong = 0;
+
+         for (uint32_t i = 0; i < 32 && hit.first_sample + i < num_samples; i++) {
+            int64_t diff = (int64_t)hit.baseline - waveforms[c][hit.first_sample + i];
+            qlong += diff;
+
+            if (i < 16) {
+               qshort += diff;
+            }
+         }
+
+         snprintf(what, sizeof(what), "channel %d pulse at %u: qshort", c, start);
+         check(what, hit.qshort, qshort);
+         snprintf(what, sizeof(what), "channel %d pulse at %u: qlong", c, start);
+         check(what, hit.qlong, qlong);
+      }
+   }
+
+   // Only the first hits are kept.
+   std::vector<CaenHit> few_hits;
+   check("find_hits() with max 5", finder.find_hits(event, few_hits, 5), false);
+   check("hits kept with max 5", few_hits.size(), 5);
+
+   // A waveform that starts mid-pulse can't give a baseline, so the one from
+   // the previous event is used.
+   for (int c = 0; c < num_chans; c++) {
+      for (uint32_t i = 0; i < 60; i++) {
+         waveforms[c][i] = baseline - 10 * i;
+      }
+   }
+
+   make_scope_event(waveforms, 2, 0, raw);
+   CaenEvent noisy_start(raw.data());
+   finder.find_hits(noisy_start, hits, 10000);
+   int num_without_flag = 0;
+
+   for (auto& hit : hits) {
+      if (!(hit.flags & CAEN_HIT_FLAG_OLD_BASELINE)) {
+         num_without_flag++;
+      }
+   }
+
+   check("hits after noisy start", hits.size() >= pulse_starts.size() * num_chans / pulse_every, true);
+   check("hits after noisy start without old baseline flag", num_without_flag, 0);
+}
+
+void test_positive_pulses() {
+   // Invert the usual pulses about the baseline.
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(8, 1000, 1000, 3, {300}, 500, 1);
+
+   for (auto& wf : waveforms) {
+      for (auto& s : wf) {
+         s = 2 * 1000 - s;
+      }
+   }
+
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 1, 0, raw);
+   CaenEvent event(raw.data());
+
+   CaenHitConfig config;
+   config.negative_pulses = false;
+   CaenHitFinder finder;
+   finder.configure(config);
+
+   std::vector<CaenHit> hits;
+   finder.find_hits(event, hits, 100);
+   check("positive pulses: number of hits", hits.size(), 8);
+
+   for (auto& hit : hits) {
+      check("positive pulses: first sample", hit.first_sample, 300);
+      check("positive pulses: qlong is positive", hit.qlong > 0, true);
+   }
+
+   // A pulse near the end has its windows cut short.
+   waveforms[0] = make_noisy_waveforms(1, 1000, 1000, 3, {990}, 500, 1)[0];
+
+   for (auto& s : waveforms[0]) {
+      s = 2 * 1000 - s;
+   }
+
+   make_scope_event(waveforms, 2, 0, raw);
+   CaenEvent late_event(raw.data());
+   finder.find_hits(late_event, hits, 100);
+   check("late pulse: number of hits", hits.size(), 8);
+
+   if (hits.size()) {
+      check("late pulse: first sample", hits[0].first_sample, 990);
+      check("late pulse: truncated flag", hits[0].flags & CAEN_HIT_FLAG_TRUNCATED, CAEN_HIT_FLAG_TRUNCATED);
+   }
+}
+
+void test_record_round_trip() {
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(num_chans, num_samples, baseline, 3, pulse_starts, 800, pulse_every);
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 1234, 98765, raw);
+   CaenEvent event(raw.data());
+
+   CaenHitFinder finder;
+   finder.configure(CaenHitConfig());
+   std::vector<CaenHit> hits;
+   finder.find_hits(event, hits, 10000);
+
+   // Negative charges and large sample numbers survive too.
+   CaenHit odd_hit;
+   odd_hit.channel = 63;
+   odd_hit.flags = CAEN_HIT_FLAG_TRUNCATED | CAEN_HIT_FLAG_OLD_BASELINE;
+   odd_hit.baseline = 65535;
+   odd_hit.first_sample = 0xFFFFFFF0;
+   odd_hit.qshort = -123456;
+   odd_hit.qlong = -2000000000;
+   hits.push_back(odd_hit);
+
+   // With the waveform.
+   std::vector<uint64_t> record(CaenHitFinder::record_size_words(hits.size(), raw.size()));
+   uint32_t size = CaenHitFinder::encode_record(event.header, hits, 0, raw.data(), raw.size(), record.data());
+   check("record size", size, record.size());
+
+   CaenHitsEvent decoded(record.data(), size);
+   check("is_valid()", decoded.is_valid(), true);
+   check("format", decoded.header.format, CAEN_HITS_FORMAT);
+   check("size in header", decoded.header.size_64bit_words, size);
+   check("event counter", decoded.header.event_counter, 1234);
+   check("trigger time", decoded.header.trigger_time, 98765);
+   check("flags", decoded.flags, 0);
+   check("number of hits", decoded.hits.size(), hits.size());
+   check("waveform size", decoded.waveform_size_words, raw.size());
+   check("waveform unchanged", decoded.waveform && memcmp(decoded.waveform, raw.data(), raw.size() * sizeof(uint64_t)) == 0, true);
+
+   char what[100];
+
+   for (size_t i = 0; i < hits.size() && i < decoded.hits.size(); i++) {
+      snprintf(what, sizeof(what), "hit %zu channel", i);
+      check(what, decoded.hits[i].channel, hits[i].channel);
+      snprintf(what, sizeof(what), "hit %zu flags", i);
+      check(what, decoded.hits[i].flags, hits[i].flags);
+      snprintf(what, sizeof(what), "hit %zu baseline", i);
+      check(what, decoded.hits[i].baseline, hits[i].baseline);
+      snprintf(what, sizeof(what), "hit %zu first sample", i);
+      check(what, decoded.hits[i].first_sample, hits[i].first_sample);
+      snprintf(what, sizeof(what), "hit %zu qshort", i);
+      check(what, decoded.hits[i].qshort, hits[i].qshort);
+      snprintf(what, sizeof(what), "hit %zu qlong", i);
+      check(what, decoded.hits[i].qlong, hits[i].qlong);
+   }
+
+   check("truncated is_valid()", CaenHitsEvent(record.data(), size - 1).is_valid(), false);
+
+   // Without the waveform.
+   size = CaenHitFinder::encode_record(event.header, hits, CAEN_HITS_FLAG_WAVEFORM_DROPPED, nullptr, 0, record.data());
+   check("record size without waveform", size, CaenHitFinder::record_size_words(hits.size(), 0));
+
+   CaenHitsEvent no_waveform(record.data(), size);
+   check("without waveform: is_valid()", no_waveform.is_valid(), true);
+   check("without waveform: flags", no_waveform.flags, CAEN_HITS_FLAG_WAVEFORM_DROPPED);
+   check("without waveform: number of hits", no_waveform.hits.size(), hits.size());
+   check("without waveform: waveform", no_waveform.waveform == nullptr, true);
+   check("without waveform: waveform size", no_waveform.waveform_size_words, 0);
+   check("without waveform: truncated is_valid()", CaenHitsEvent(record.data(), size - 1).is_valid(), false);
+
+   // No hits at all.
+   std::vector<CaenHit> no_hits;
+   size = CaenHitFinder::encode_record(event.header, no_hits, 0, nullptr, 0, record.data());
+   check("empty record size", size, CAEN_HITS_HEADER_WORDS);
+   check("empty record is_valid()", CaenHitsEvent(record.data(), size).is_valid(), true);
+}
+
+int main() {
+   test_find_hits();
+   test_positive_pulses();
+   test_record_round_trip();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
@@ -1,243 +1,304 @@
 #include "vx2740_wrapper.h"
+#include "caen_snapshot.h"
+#include "caen_exceptions.h"
 #include "stdio.h"
-#include <sys/time.h>
+#include <sys/stat.h>
 #include <cstring>
 #include <string>
 #include <vector>
 #include <fstream>
-#include <map>
-#include <algorithm>
-#include <unistd.h>
-#include "CAEN_FELib.h"
+#include <sstream>
+#include <set>
+#include <thread>
+#include <functional>
+#include <chrono>
 
 /**
- * This program connects to a VX2740 board, and loads a set of parameters
- * that were previously dumped using the `vx2740_dump_params` program.
- * 
- * If --take-data is specified, a short run of 10s will be started/stopped
+ * This program connects to one or more VX2740 boards, and loads a set of
+ * parameters that were previously saved using the `vx2740_dump_params`
+ * program - either a text dump, or a binary snapshot (-s). If a directory
+ * is given, each board loads the snapshot for its own serial number and
+ * firmware version from that directory.
+ *
+ * Boards are loaded concurrently. The current values are read first (one
+ * device tree request plus the values), and only parameters that differ
+ * are written, unless --all is specified.
+ *
+ * Binary snapshots are only loaded onto the board (and firmware version)
+ * they were taken from, unless --force is specified (e.g. to copy one
+ * board's settings to another).
+ *
+ * If --take-data is specified, a short run of 5s will be started/stopped
  * after the parameters have been loaded.
- * 
+ *
  * E.g.
  * vx2740_dump_params vx02 -a > params.txt
  * vx2740_load_params vx02 params.txt
+ * vx2740_load_params vx02,vx03,vx04 snapshot_dir/
  */
 
 void usage(char *prog_name) {
-   printf("Usage: %s <hostname> <filename> [--take-data]\n", prog_name);
+   printf("Usage: %s <hostname>[,<hostname>...] <filename_or_snapshot_dir> [--all] [--force] [--take-data]\n", prog_name);
+   printf("--all means write every parameter, even if the board already has that value.\n");
+   printf("--force means load a binary snapshot even if it was taken from a different board or firmware.\n");
+   printf("--take-data means read raw data for 5s after loading.\n");
 }
 
-int main(int argc, char **argv) {
-   bool any_help = false;
+struct LoadResult {
+   std::string hostname;
+   bool ok = false;
+   std::string error;
+   int num_params = 0;
+   int num_written = 0;
+   int num_failed = 0;
+   uint64_t num_felib_calls = 0;
+   double connect_ms = 0;
+   double read_ms = 0;
+   double write_ms = 0;
+   int num_events_read = 0;
+};
+
+// Read a text dump. LVDSTrgMask is dumped as a list of all lines, but is
+// set one line at a time ("<line>=<mask>").
+bool read_text_dump(std::string filename, CaenSnapshot& snapshot) {
+   std::ifstream file(filename);
 
-   for (int i = 1; i < argc; i++) {
-      if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-         any_help = true;
-         break;
-      }
+   if (!file.is_open()) {
+      return false;
    }
 
-   if (argc < 2 || argc > 4 || any_help) {
-      usage(argv[0]);
-      return 0;
-   }
+   std::string line;
 
-   VX2740 vx;
-   vx.connect(argv[1], false, false);
+   while (getline(file, line)) {
+      size_t split_pos = line.find(" = ");
 
-   vx.stop_acq();
+      if (split_pos == std::string::npos || line.find("/") != 0) {
+         continue;
+      }
 
-   std::string filename = "";
-   bool take_data = false;
+      std::string param = line.substr(0, split_pos);
+      std::string value = line.substr(split_pos + 3);
 
-   for (int i = 2; i < argc; i++) {
-      std::string arg(argv[i]);
+      if (value.find("** UNKNOWN **") == 0) {
+         continue;
+      }
 
-      if (arg == "--take-data") {
-         take_data = true;
-      } else if (filename == "") {
-         filename = arg;
+      if (CaenParameters::str_to_lower(param) == "/par/lvdstrgmask") {
+         std::stringstream ss(value);
+         std::string mask;
+         int mask_line = 0;
+
+         while (std::getline(ss, mask, ',')) {
+            mask.erase(0, mask.find_first_not_of(' '));
+            snapshot.params.push_back(std::make_pair(param, std::to_string(mask_line++) + "=" + mask));
+         }
       } else {
-         usage(argv[0]);
-         return 0;
+         snapshot.params.push_back(std::make_pair(param, value));
       }
    }
 
-   std::ifstream file(filename);
+   return true;
+}
 
-   if (!file.is_open()) {
-      printf("Failed to open %s\n", filename.c_str());
-      return 1;
+double ms_since(std::chrono::steady_clock::time_point start) {
+   return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void take_data(VX2740& vx, LoadResult& result) {
+   if (vx.data().setup_data_handle(true, vx.params()) != SUCCESS) {
+      result.error = "Failed to setup data handle";
+      result.ok = false;
+      return;
    }
 
-   std::string line;
+   vx.commands().start_acq(vx.params().is_sw_start_enabled());
+   size_t num_bytes_read = 0;
+   uint32_t max_bytes = 0;
+   vx.params().get_max_raw_bytes_per_read(max_bytes);
+   std::vector<uint8_t> buffer(max_bytes);
 
-   std::vector<std::string> known_ch_skip = {
-      "/par/adctovolts",
-      "/par/chstatus",
-      "/par/gainfactor"
-   };
-
-   std::vector<std::string> known_skip = {
-      "/endpoint/par/activeendpoint",
-      "/par/acquisitionstatus",
-      "/par/adc_nbit",
-      "/par/adc_samplrate",
-      "/par/boardready",
-      "/par/cupver",
-      "/par/dutycyclesensdcdc",
-      "/par/errorflags",
-      "/par/familycode",
-      "/par/formfactor",
-      "/par/fpga_fwver",
-      "/par/freqsenscore",
-      "/par/fwtype",
-      "/par/gateway",
-      "/par/inputrange",
-      "/par/inputtype",
-      "/par/ioutsensdcdc",
-      "/par/ipaddress",
-      "/par/ledstatus",
-      "/par/license",
-      "/par/licenseremainingtime",
-      "/par/licensestatus",
-      "/par/maxrawdatasize",
-      "/par/modelcode",
-      "/par/modelname",
-      "/par/netmask",
-      "/par/numch",
-      "/par/opendataaddress",
-      "/par/opendatamode",
-      "/par/opendatasize",
-      "/par/pbcode",
-      "/par/pcbrev_mb",
-      "/par/pcbrev_pb",
-      "/par/serialnum",
-      "/par/speedsensfan1",
-      "/par/speedsensfan2",
-      "/par/tempsensadc0",
-      "/par/tempsensadc7",
-      "/par/tempsensairin",
-      "/par/tempsensairout",
-      "/par/tempsenscore",
-      "/par/tempsensdcdc",
-      "/par/tempsensfirstadc",
-      "/par/tempsenshottestadc",
-      "/par/tempsenslastadc",
-      "/par/vinsensdcdc",
-      "/par/voutsensdcdc",
-      "/par/zin"
-   };
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-   while (getline(file, line)) {
-      size_t split_pos = line.find("=");
-      if (split_pos == std::string::npos || line.find("/") != 0) {
-         continue;
+   while (ms_since(start) < 5000) {
+      if (vx.data().get_raw_data(100, buffer.data(), num_bytes_read) == SUCCESS) {
+         result.num_events_read++;
       }
+   }
 
-      std::string param = line.substr(0, split_pos - 1);
-      std::string value = line.substr(split_pos + 2, std::string::npos);
+   vx.commands().stop_acq();
+}
 
-      uint64_t param_handle = 0;
+// If `check_match`, the snapshot must have been taken from this board and firmware.
+void load_board(std::string hostname, const CaenSnapshot* file_snapshot, bool check_match, std::string snapshot_dir, bool write_all, bool do_take_data, LoadResult& result) {
+   result.hostname = hostname;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-      if (value.find("** UNKNOWN **") == 0) {
-         continue;
-      }
+   VX2740 vx;
 
-      if (std::find(known_skip.begin(), known_skip.end(), param) != known_skip.end()) {
-         continue;
-      }
+   if (vx.connect(hostname, false, false) != SUCCESS) {
+      result.error = "Failed to connect";
+      return;
+   }
 
-      if (param.find("/ch") == 0) {
-         bool skip_chan_param = false;
+   vx.commands().stop_acq();
+   result.connect_ms = ms_since(start);
+   vx.params().reset_num_felib_calls();
 
-         for (auto& ch_skip : known_ch_skip) {
-            if (param.find(ch_skip) != std::string::npos) {
-               skip_chan_param = true;
-               break;
-            }
-         }
+   try {
+      CaenSnapshot wanted;
+      std::string model, serial, fw_ver;
+      vx.params().get_model_name(model);
+      vx.params().get_serial_number(serial);
+      vx.params().get_firmware_version(fw_ver);
 
-         if (skip_chan_param) {
-            continue;
+      if (file_snapshot) {
+         wanted = *file_snapshot;
+      } else {
+         std::string filename = CaenSnapshot::get_filename(snapshot_dir, model, serial, fw_ver);
+
+         if (!wanted.load(filename)) {
+            result.error = "Failed to load snapshot " + filename;
+            return;
          }
       }
 
-      char name[32];
-      CAEN_FELib_NodeType_t type;
-      int status = CAEN_FELib_GetHandle(vx._get_root_handle(), param.c_str(), &param_handle);
-
-      if (status != CAEN_FELib_Success) {
-         printf("Failed to get handle for %s\n", param.c_str());
-         continue;
+      if (check_match && !wanted.matches(model, serial, fw_ver)) {
+         result.error = "Snapshot is of " + wanted.model_name + " serial " + wanted.serial_number + " with firmware " + wanted.firmware_version +
+                        ", but board is " + model + " serial " + serial + " with firmware " + fw_ver + " (use --force to load it anyway)";
+         return;
       }
 
-      status = CAEN_FELib_GetNodeProperties(param_handle, "", name, &type);
+      // One device tree request gives us every writable parameter and its
+      // handle; then read their current values.
+      start = std::chrono::steady_clock::now();
+      CaenSnapshot current;
+      vx.params().get_writable_params(current.params);
+      result.read_ms = ms_since(start);
 
-      if (status != CAEN_FELib_Success) {
-         printf("Failed to get properties of %s\n", param.c_str());
-         continue;
+      // Only try to set parameters that can be set.
+      std::set<std::string> writable;
+
+      for (auto& param : current.params) {
+         writable.insert(param.first);
       }
 
-      if (type != CAEN_FELib_PARAMETER) {
-         continue;
+      CaenSnapshot to_write;
+      to_write.user_registers = wanted.user_registers;
+
+      for (auto& param : wanted.params) {
+         if (writable.count(param.first)) {
+            to_write.params.push_back(param);
+         }
       }
-      
-      if (param == "/par/lvdstrgmask") {
-         continue;
+
+      result.num_params = to_write.params.size();
+      start = std::chrono::steady_clock::now();
+      result.num_failed = to_write.restore(vx.params(), write_all ? nullptr : &current, &result.error, &result.num_written);
+      result.write_ms = ms_since(start);
+   } catch (CaenException& e) {
+      result.error = e.what();
+      return;
+   }
+
+   result.num_felib_calls = vx.params().get_num_felib_calls();
+   result.ok = (result.num_failed == 0);
+
+   if (do_take_data && result.ok) {
+      take_data(vx, result);
+   }
+}
+
+int main(int argc, char **argv) {
+   bool any_help = false;
+
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+         any_help = true;
+         break;
       }
+   }
 
-      if (vx._set(vx._get_root_handle(), param, value) != SUCCESS) {
-         printf("Failed to set %s to %s\n", param.c_str(), value.c_str());
+   if (argc < 3 || argc > 6 || any_help) {
+      usage(argv[0]);
+      return 0;
+   }
+
+   std::vector<std::string> hostnames;
+   std::stringstream hosts_ss(argv[1]);
+   std::string host;
+
+   while (std::getline(hosts_ss, host, ',')) {
+      if (host != "") {
+         hostnames.push_back(host);
       }
    }
 
-   file.close();
-   printf("Set parameters...\n");
+   std::string filename = argv[2];
+   bool do_take_data = false;
+   bool write_all = false;
+   bool force = false;
+
+   for (int i = 3; i < argc; i++) {
+      std::string arg(argv[i]);
+
+      if (arg == "--take-data") {
+         do_take_data = true;
+      } else if (arg == "--all") {
+         write_all = true;
+      } else if (arg == "--force") {
+         force = true;
+      } else {
+         usage(argv[0]);
+         return 0;
+      }
+   }
 
-   if (take_data) {
-      if (vx.setup_data_handle(true) != SUCCESS) {
-         printf("Failed to setup data handle\n");
-         return 2;
-      } 
+   // Work out what we're loading: a snapshot per board (directory), one
+   // binary snapshot, or a text dump.
+   struct stat st;
+   bool is_dir = (stat(filename.c_str(), &st) == 0 && S_ISDIR(st.st_mode));
+   CaenSnapshot file_snapshot;
+   bool is_binary = !is_dir && file_snapshot.load(filename);
 
-      printf("Reading raw data for 5s...\n");
+   if (!is_dir && !is_binary && !read_text_dump(filename, file_snapshot)) {
+      printf("Failed to open %s\n", filename.c_str());
+      return 1;
+   }
 
-      vx.start_acq();
-      size_t num_bytes_read = 0;
-      uint8_t* buffer = (uint8_t*)calloc(1000000, sizeof(uint8_t));
-      int num_read = 0;
-      int num_empty = 0;
-      int num_err = 0;
+   // Text dumps don't record where they came from.
+   bool check_match = (is_dir || is_binary) && !force;
 
-      timeval start = {};
-      gettimeofday(&start, NULL);
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::vector<LoadResult> results(hostnames.size());
+   std::vector<std::thread> threads;
 
-      while (true) {
-         int status = vx.get_raw_data(100, buffer, num_bytes_read);
+   for (size_t i = 0; i < hostnames.size(); i++) {
+      threads.push_back(std::thread(load_board, hostnames[i], is_dir ? nullptr : &file_snapshot, check_match, is_dir ? filename : "", write_all, do_take_data, std::ref(results[i])));
+   }
 
-         if (status == SUCCESS) {
-            num_read++;
-         } else if (status == VX_NO_EVENT) {
-            num_empty++;
-         } else {
-            num_err++;
-         }
+   for (auto& thread : threads) {
+      thread.join();
+   }
 
-         usleep(1000);
-         timeval now = {};
-         gettimeofday(&now, NULL);
+   double total_ms = ms_since(start);
+   int num_bad = 0;
 
-         if (now.tv_sec - start.tv_sec > 5) {
-            break;
-         }
+   for (auto& result : results) {
+      if (!result.ok) {
+         num_bad++;
+         printf("%s: FAILED: %s\n", result.hostname.c_str(), result.error.c_str());
       }
 
-      vx.stop_acq();
-      printf("Read %d events in raw mode\n", num_read);
+      printf("%s: %d params, %d written, %d failed; connect %.0fms, read %.0fms, write %.0fms (%" PRIu64 " FELib calls)\n",
+             result.hostname.c_str(), result.num_params, result.num_written, result.num_failed,
+             result.connect_ms, result.read_ms, result.write_ms, result.num_felib_calls);
 
-      free(buffer);
+      if (do_take_data && result.ok) {
+         printf("%s: read %d events in raw mode\n", result.hostname.c_str(), result.num_events_read);
+      }
    }
 
-   return 0;
-}
+   printf("Set parameters on %d/%d boards in %.0fms\n", (int)(results.size() - num_bad), (int)results.size(), total_ms);
 
+   return num_bad ? 1 : 0;
+}
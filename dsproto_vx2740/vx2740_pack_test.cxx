@@ -0,0 +1,178 @@
+#include "stdio.h"
+#include "caen_packing.h"
+#include "vx2740_test_events.h"
+#include <inttypes.h>
+#include <algorithm>
+#include <random>
+
+/*
+ * Checks that events compressed by CaenPackEncoder read back through
+ * CaenPackedEvent exactly as they were, for waveforms that are flat, noisy,
+ * jump across the full ADC range or aren't a whole number of blocks long.
+ * Doesn't need a board. Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+/**
+ * Encode the waveforms, check the packed event decodes to them exactly (or
+ * that the raw event was copied, if `expect_packed` is false) and return its
+ * size in words.
+ */
+uint32_t check_round_trip(const char* name, const std::vector<std::vector<uint16_t>>& waveforms, bool expect_packed=true) {
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 9, 4567, raw);
+   CaenEvent event(raw.data());
+
+   CaenPackEncoder encoder;
+   std::vector<uint64_t> encoded(CaenPackEncoder::max_size_words(event));
+   uint32_t size = encoder.encode(event, encoded.data());
+   char what[200];
+
+   snprintf(what, sizeof(what), "%s: size within max_size_words()", name);
+   check(what, size <= encoded.size(), true);
+   snprintf(what, sizeof(what), "%s: format", name);
+   check(what, encoded[0] >> 56, expect_packed ? CAEN_PACKED_FORMAT : 0x10);
+
+   if (!expect_packed) {
+      snprintf(what, sizeof(what), "%s: raw event size", name);
+      check(what, size, raw.size());
+      snprintf(what, sizeof(what), "%s: raw event unchanged", name);
+      check(what, std::equal(raw.begin(), raw.end(), encoded.begin()), true);
+      return size;
+   }
+
+   CaenPackedEvent packed(encoded.data(), size);
+   snprintf(what, sizeof(what), "%s: is_valid()", name);
+   check(what, packed.is_valid(), true);
+   snprintf(what, sizeof(what), "%s: size in header", name);
+   check(what, packed.header.size_64bit_words, size);
+   snprintf(what, sizeof(what), "%s: event counter", name);
+   check(what, packed.header.event_counter, 9);
+   snprintf(what, sizeof(what), "%s: trigger time", name);
+   check(what, packed.header.trigger_time, 4567);
+
+   for (size_t c = 0; c < 64; c++) {
+      uint32_t expected_samples = c < waveforms.size() ? waveforms[c].size() : 0;
+      std::vector<uint16_t> samples = packed.get_channel_samples_vec(c);
+
+      snprintf(what, sizeof(what), "%s: channel %zu number of samples", name, c);
+      check(what, samples.size(), expected_samples);
+
+      if (expected_samples && samples.size() == expected_samples) {
+         snprintf(what, sizeof(what), "%s: channel %zu samples match", name, c);
+         check(what, samples == waveforms[c], true);
+      }
+   }
+
+   snprintf(what, sizeof(what), "%s: truncated is_valid()", name);
+   check(what, CaenPackedEvent(encoded.data(), size - 1).is_valid(), false);
+   return size;
+}
+
+void test_noisy() {
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(64, 5000, 3000, 3, {1000, 2500}, 800, 8);
+   uint32_t size = check_round_trip("noisy", waveforms);
+
+   // 16-bit samples with a few bits of noise should pack to well under half.
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 9, 4567, raw);
+   check("noisy: less than half the raw size", size < raw.size() / 2, true);
+}
+
+void test_flat() {
+   // Every delta is 0, so every block has width 0.
+   std::vector<std::vector<uint16_t>> waveforms(64, std::vector<uint16_t>(5000, 1234));
+   check_round_trip("flat", waveforms);
+}
+
+void test_full_range() {
+   // Steps between 0 and 65535 either way, which only round-trip if the
+   // deltas wrap modulo 2^16.
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(4, 1000, 3000, 3, {}, 0, 0);
+
+   for (auto& wf : waveforms) {
+      wf[10] = 65535;
+      wf[11] = 0;
+      wf[12] = 65535;
+      wf[500] = 0;
+      wf[501] = 65535;
+      wf[502] = 0;
+   }
+
+   check_round_trip("full range", waveforms);
+
+   // Random 16-bit values don't compress, so are copied unchanged.
+   std::mt19937 rng(2);
+
+   for (auto& wf : waveforms) {
+      for (auto& s : wf) {
+         s = rng();
+      }
+   }
+
+   check_round_trip("random", waveforms, false);
+}
+
+void test_lengths() {
+   // A single partial block, and a partly filled last block, on a few
+   // sparse channels.
+   uint32_t lengths[] = {60, 64, 68, 100, 1284};
+   char name[100];
+
+   for (auto length : lengths) {
+      std::vector<std::vector<uint16_t>> waveforms(64);
+
+      for (int c = 1; c < 64; c += 20) {
+         waveforms[c] = make_noisy_waveforms(1, length, 100 * c, 5, {}, 0, 0, c)[0];
+      }
+
+      snprintf(name, sizeof(name), "%u samples", length);
+      check_round_trip(name, waveforms);
+   }
+}
+
+void test_partial_decode() {
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(2, 1000, 3000, 3, {}, 0, 0);
+   waveforms[0][7] = 65535;
+   waveforms[0][8] = 0;
+
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 1, 1, raw);
+   CaenEvent event(raw.data());
+   CaenPackEncoder encoder;
+   std::vector<uint64_t> encoded(CaenPackEncoder::max_size_words(event));
+   uint32_t size = encoder.encode(event, encoded.data());
+   CaenPackedEvent packed(encoded.data(), size);
+
+   // Only as many samples as fit in the caller's buffer.
+   std::vector<uint16_t> samples(100, 0);
+   check("partial decode count", packed.get_channel_samples(0, samples.data(), 100), 100);
+   check("partial decode matches", std::equal(samples.begin(), samples.end(), waveforms[0].begin()), true);
+   check("partial decode sample 7", samples[7], 65535);
+   check("partial decode sample 8", samples[8], 0);
+   check("channel not read out", packed.get_channel_samples(5, samples.data(), 100), 0);
+}
+
+int main() {
+   test_noisy();
+   test_flat();
+   test_full_range();
+   test_lengths();
+   test_partial_decode();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
@@ -0,0 +1,179 @@
+/**
+ * Times writing/reading per-channel parameters of all 64 channels, and
+ * counts the FELib calls needed, comparing one call per channel with the
+ * channel-range paths used by CaenParameters::set_chans(), and full paths
+ * relative to the root with the node handles cached by CaenParameters.
+ *
+ * Don't run this while the board is taking data. The original values are
+ * written back at the end.
+ */
+
+#include "stdio.h"
+#include "vx2740_wrapper.h"
+#include "caen_exceptions.h"
+#include "CAEN_FELib.h"
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+void usage(char *prog_name) {
+   printf("Usage: %s <hostname> [<num_repeats>]\n", prog_name);
+   printf("E.g. : %s vx02 10\n", prog_name);
+}
+
+// Gives access to the root handle, to call FELib directly.
+class BenchVX2740 : public VX2740 {
+public:
+   uint64_t get_root_handle() {
+      return dev->get_root_handle();
+   }
+};
+
+/**
+ * Run `func` `num_repeats` times, and print the mean time and FELib calls.
+ * `func` returns the number of FELib calls it made itself (not through
+ * CaenParameters).
+ */
+void bench(VX2740& vx, const char* name, int num_repeats, std::function<int()> func) {
+   vx.params().reset_num_felib_calls();
+   uint64_t direct_calls = 0;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   for (int i = 0; i < num_repeats; i++) {
+      direct_calls += func();
+   }
+
+   double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+   double calls = (double)(vx.params().get_num_felib_calls() + direct_calls) / num_repeats;
+   printf("%-50s %8.1f FELib calls %10.3f ms\n", name, calls, elapsed_ms / num_repeats);
+}
+
+int main(int argc, char **argv) {
+   if (argc < 2) {
+      usage(argv[0]);
+      return 0;
+   }
+
+   int num_repeats = argc > 2 ? atoi(argv[2]) : 10;
+
+   if (num_repeats < 1) {
+      usage(argv[0]);
+      return 0;
+   }
+
+   BenchVX2740 vx;
+
+   if (vx.connect(argv[1], false, true) != SUCCESS) {
+      printf("Failed to connect to %s\n", argv[1]);
+      return 1;
+   }
+
+   CaenParameters& params = vx.params();
+   std::vector<float> orig_offsets(64);
+   std::vector<int32_t> orig_thresholds(64);
+   std::vector<bool> orig_rising(64);
+   std::vector<uint32_t> orig_widths(64);
+   bool orig_relative = true;
+
+   try {
+      params.get_channel_dc_offsets(orig_offsets);
+
+      for (int c = 0; c < 64; c++) {
+         bool rising = false;
+         params.get_channel_trigger_threshold(c, orig_relative, orig_thresholds[c], rising, orig_widths[c]);
+         orig_rising[c] = rising;
+      }
+   } catch (CaenException& e) {
+      printf("Failed to read original values: %s\n", e.what());
+      return 1;
+   }
+
+   // Same value on every channel (the usual case), and a different value on
+   // every channel (the worst case for channel ranges).
+   std::vector<float> same_offsets(64, 20);
+   std::vector<float> diff_offsets(64);
+   std::vector<int32_t> same_thresholds(64, 100);
+   std::vector<bool> same_rising(64, false);
+   std::vector<uint32_t> same_widths(64, 64);
+
+   for (int c = 0; c < 64; c++) {
+      diff_offsets[c] = 20 + c * 0.5;
+   }
+
+   try {
+      bench(vx, "DC offsets, one channel at a time", num_repeats, [&]() {
+         for (int c = 0; c < 64; c++) {
+            params.set_channel_dc_offset(c, same_offsets[c]);
+         }
+
+         return 0;
+      });
+
+      bench(vx, "DC offsets, channel ranges, same value", num_repeats, [&]() {
+         params.set_channel_dc_offsets(same_offsets);
+         return 0;
+      });
+
+      bench(vx, "DC offsets, channel ranges, different values", num_repeats, [&]() {
+         params.set_channel_dc_offsets(diff_offsets);
+         return 0;
+      });
+
+      bench(vx, "DC offsets, readback, cached handles", num_repeats, [&]() {
+         std::vector<float> rdb(64);
+         params.get_channel_dc_offsets(rdb);
+         return 0;
+      });
+
+      bench(vx, "Trigger thresholds, one channel at a time", num_repeats, [&]() {
+         for (int c = 0; c < 64; c++) {
+            params.set_channel_trigger_threshold(c, true, same_thresholds[c], same_rising[c], same_widths[c]);
+         }
+
+         return 0;
+      });
+
+      bench(vx, "Trigger thresholds, channel ranges, same value", num_repeats, [&]() {
+         params.set_channel_trigger_thresholds(true, same_thresholds, same_rising, same_widths);
+         return 0;
+      });
+
+      // Without the handle cache, FELib has to resolve the path on every call.
+      bench(vx, "DC offsets, readback, path relative to root", num_repeats, [&]() {
+         char path[256];
+         char val[CAEN_PARAM_VALUE_LEN];
+
+         for (int c = 0; c < 64; c++) {
+            snprintf(path, sizeof(path), "/ch/%d/par/DcOffset", c);
+            val[0] = 0;
+
+            if (CAEN_FELib_GetValue(vx.get_root_handle(), path, val) != CAEN_FELib_Success) {
+               throw CaenException(std::string("Failed to get ") + path);
+            }
+         }
+
+         return 64;
+      });
+
+      // As the first access after connecting, when each handle is looked up.
+      bench(vx, "DC offsets, readback, empty handle cache", num_repeats, [&]() {
+         std::vector<float> rdb(64);
+         params.clear_handle_cache();
+         params.get_channel_dc_offsets(rdb);
+         return 0;
+      });
+   } catch (CaenException& e) {
+      printf("Benchmark failed: %s\n", e.what());
+   }
+
+   try {
+      params.set_channel_dc_offsets(orig_offsets);
+      params.set_channel_trigger_thresholds(orig_relative, orig_thresholds, orig_rising, orig_widths);
+   } catch (CaenException& e) {
+      printf("Failed to restore original values: %s\n", e.what());
+      return 1;
+   }
+
+   return 0;
+}
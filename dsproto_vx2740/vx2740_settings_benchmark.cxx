@@ -0,0 +1,139 @@
+/**
+ * Times looking up and copying the board settings structs, comparing the
+ * enum-indexed tables generated from the schema in fe_settings_structs.h
+ * with a std::map<std::string, T> per type (as the structs used to be),
+ * filled with the same names and defaults.
+ *
+ * Doesn't need a board.
+ */
+
+#include "stdio.h"
+#include "fe_settings_structs.h"
+#include <chrono>
+#include <cstdlib>
+#include <inttypes.h>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+void usage(char *prog_name) {
+   printf("Usage: %s [<num_repeats>]\n", prog_name);
+   printf("E.g. : %s 1000000\n", prog_name);
+}
+
+// The same settings, stored by name.
+struct MapBoardReadback {
+   std::map<std::string, std::string> strings;
+   std::map<std::string, bool> bools;
+   std::map<std::string, uint32_t> uint32s;
+   std::map<std::string, uint16_t> uint16s;
+   std::map<std::string, double> doubles;
+   std::map<std::string, int32_t> int32s;
+   std::map<std::string, std::vector<bool>> vec_bools;
+   std::map<std::string, std::vector<std::string>> vec_strings;
+   std::map<std::string, std::vector<int16_t>> vec_int16s;
+   std::map<std::string, std::vector<uint16_t>> vec_uint16s;
+   std::map<std::string, std::vector<uint32_t>> vec_uint32s;
+   std::map<std::string, std::vector<int32_t>> vec_int32s;
+   std::map<std::string, std::vector<float>> vec_floats;
+};
+
+template <class Map, class Table> void fill_map(Map& map, const Table& table) {
+   for (auto& entry : table) {
+      map[entry.first] = entry.second;
+   }
+}
+
+MapBoardReadback make_map_readback(const BoardReadback& rdb) {
+   MapBoardReadback map;
+   fill_map(map.strings, rdb.strings);
+   fill_map(map.bools, rdb.bools);
+   fill_map(map.uint32s, rdb.uint32s);
+   fill_map(map.uint16s, rdb.uint16s);
+   fill_map(map.doubles, rdb.doubles);
+   fill_map(map.int32s, rdb.int32s);
+   fill_map(map.vec_bools, rdb.vec_bools);
+   fill_map(map.vec_strings, rdb.vec_strings);
+   fill_map(map.vec_int16s, rdb.vec_int16s);
+   fill_map(map.vec_uint16s, rdb.vec_uint16s);
+   fill_map(map.vec_uint32s, rdb.vec_uint32s);
+   fill_map(map.vec_int32s, rdb.vec_int32s);
+   fill_map(map.vec_floats, rdb.vec_floats);
+   return map;
+}
+
+/**
+ * Run `func` `num_repeats` times, and print the mean time. `func` returns a
+ * value that's summed, so the compiler can't skip the work.
+ */
+void bench(const char* name, int num_repeats, std::function<uint64_t()> func) {
+   uint64_t sum = 0;
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+   for (int i = 0; i < num_repeats; i++) {
+      sum += func();
+   }
+
+   double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+   printf("%-50s %12.1f ns (%" PRIu64 ")\n", name, elapsed_ns / num_repeats, sum);
+}
+
+int main(int argc, char **argv) {
+   int num_repeats = argc > 1 ? atoi(argv[1]) : 100000;
+
+   if (num_repeats < 1) {
+      usage(argv[0]);
+      return 0;
+   }
+
+   BoardReadback rdb;
+   MapBoardReadback map_rdb = make_map_readback(rdb);
+
+   // A handful of settings of different types, as looked up when writing
+   // settings to a board.
+   bench("Lookup 5 settings, enum", num_repeats, [&]() {
+      return rdb.uint32s[Uint32Param::WAVEFORM_LENGTH_SAMPLES] + rdb.uint32s[Uint32Param::READOUT_CHANNEL_MASK_HI] +
+             rdb.bools[BoolParam::HITS_NEGATIVE_PULSES] + rdb.uint16s[Uint16Param::PRE_TRIGGER_SAMPLES] +
+             rdb.vec_floats[VecFloatParam::DC_OFFSET_PCT][63];
+   });
+
+   bench("Lookup 5 settings, std::map by name", num_repeats, [&]() {
+      return map_rdb.uint32s.at("Waveform length (samples)") + map_rdb.uint32s.at("Readout channel mask (63-32)") +
+             map_rdb.bools.at("Pulse finding/Negative pulses") + map_rdb.uint16s.at("Pre-trigger (samples)") +
+             map_rdb.vec_floats.at("DC offset (pct)")[63];
+   });
+
+   bench("Lookup 5 settings, table by name", num_repeats, [&]() {
+      return rdb.uint32s.at("Waveform length (samples)") + rdb.uint32s.at("Readout channel mask (63-32)") +
+             rdb.bools.at("Pulse finding/Negative pulses") + rdb.uint16s.at("Pre-trigger (samples)") +
+             rdb.vec_floats.at("DC offset (pct)")[63];
+   });
+
+   // As done for every board when the settings are synced or read back.
+   int copy_repeats = num_repeats / 100 + 1;
+
+   bench("Copy BoardReadback, tables", copy_repeats, [&]() {
+      BoardReadback copy = rdb;
+      return copy.uint32s.size();
+   });
+
+   bench("Copy BoardReadback, std::maps", copy_repeats, [&]() {
+      MapBoardReadback copy = map_rdb;
+      return copy.uint32s.size();
+   });
+
+   // As done to see what has changed since the last write.
+   BoardReadback other_rdb = rdb;
+   MapBoardReadback other_map_rdb = map_rdb;
+
+   bench("Compare uint32 and uint16 array settings, tables", copy_repeats, [&]() {
+      return rdb.uint32s == other_rdb.uint32s && rdb.vec_uint16s == other_rdb.vec_uint16s;
+   });
+
+   bench("Compare uint32 and uint16 array settings, std::maps", copy_repeats, [&]() {
+      return map_rdb.uint32s == other_map_rdb.uint32s && map_rdb.vec_uint16s == other_map_rdb.vec_uint16s;
+   });
+
+   return 0;
+}
@@ -10,6 +10,7 @@
 #include "msystem.h"
 #include "mfe.h"
 #include "vx2740_fe_class.h"
+#include "fe_logger.h"
 
 /*-- Globals -------------------------------------------------------*/
 
@@ -24,17 +25,14 @@ BOOL frontend_call_loop = TRUE;
 /* a frontend status page is displayed with this frequency in ms */
 INT display_period = 0;
 
-#define BUFFER_SIZE 1000000000 // 1000MB (board has 2GB total)
-#define MAX_EV_SIZE 320000000  // 320MB
-
 /* maximum event size produced by this frontend */
-INT max_event_size = MAX_EV_SIZE + 100;
+INT max_event_size = VX2740_MAX_EV_SIZE_BYTES + 100;
 
 /* maximum event size for fragmented events (EQ_FRAGMENTED) */
 INT max_event_size_frag = 5 * 1024 * 1024;
 
 /* buffer size to hold events */
-INT event_buffer_size = BUFFER_SIZE;
+INT event_buffer_size = VX2740_DEFAULT_RB_SIZE_BYTES;
 
 /*-- Function declarations -----------------------------------------*/
 
@@ -159,10 +157,18 @@ INT frontend_init() {
 
    cm_register_transition(TR_STARTABORT, end_of_run, 500);
 
-   return vx_group.init(gFrontendIndex, hDB);
+   INT status = vx_group.init(gFrontendIndex, hDB);
+
+   if (status != SUCCESS) {
+      // Make sure the reason is printed before we exit.
+      fe_log::flush();
+   }
+
+   return status;
 }
 
 INT frontend_exit() {
+   fe_log::flush();
    return SUCCESS;
 }
 
@@ -0,0 +1,184 @@
+#include "stdio.h"
+#include "caen_snapshot.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+/*
+ * Checks that a CaenSnapshot saved to file loads back unchanged, and that
+ * files that are corrupt, truncated or missing are rejected rather than
+ * loaded. Doesn't need a board (restoring is left to vx2740_load_params).
+ * Returns non-zero if any check fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+CaenSnapshot make_snapshot() {
+   CaenSnapshot snap;
+   snap.model_name = "VX2740";
+   snap.serial_number = "12345";
+   snap.firmware_version = "2023052400 v1.0";
+   snap.firmware_type = "DPP_OPEN";
+   snap.tag = "run 42 settings";
+
+   snap.params.push_back(std::make_pair("/par/startsource", "SWcmd"));
+
+   for (int c = 0; c < 64; c++) {
+      snap.params.push_back(std::make_pair("/ch/" + std::to_string(c) + "/par/dcoffset", c < 40 ? "50" : "20.5"));
+   }
+
+   for (int c = 0; c < 64; c++) {
+      snap.params.push_back(std::make_pair("/ch/" + std::to_string(c) + "/par/triggerthr", std::to_string(100 + c)));
+   }
+
+   // Values that are empty or contain spaces/newlines, and a path that only
+   // looks like a channel parameter.
+   snap.params.push_back(std::make_pair("/lvds/0/par/lvdsmode", "IORegister"));
+   snap.params.push_back(std::make_pair("/par/empty", ""));
+   snap.params.push_back(std::make_pair("/par/spaces", "a b\nc"));
+   snap.params.push_back(std::make_pair("/ch/x/par/notachannel", "1"));
+
+   snap.user_registers[0x44] = 3;
+   snap.user_registers[0x1FC] = 0xFFFFFFFF;
+   return snap;
+}
+
+std::string read_file(const std::string& filename) {
+   std::string contents;
+   FILE* fp = fopen(filename.c_str(), "rb");
+
+   if (!fp) {
+      return contents;
+   }
+
+   char buf[4096];
+   size_t n = 0;
+
+   while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      contents.append(buf, n);
+   }
+
+   fclose(fp);
+   return contents;
+}
+
+void write_file(const std::string& filename, const std::string& contents) {
+   FILE* fp = fopen(filename.c_str(), "wb");
+
+   if (fp) {
+      fwrite(contents.data(), 1, contents.size(), fp);
+      fclose(fp);
+   }
+}
+
+void test_round_trip(const std::string& dir) {
+   CaenSnapshot snap = make_snapshot();
+   std::string filename = CaenSnapshot::get_filename(dir, snap.model_name, snap.serial_number, snap.firmware_version);
+
+   check("filename has no spaces", filename.find(' ') == std::string::npos, true);
+   check("filename in directory", filename.compare(0, dir.size() + 1, dir + "/"), 0);
+   check("save()", snap.save(filename), true);
+   check("no temporary file left", access((filename + ".tmp").c_str(), F_OK) == 0, false);
+
+   CaenSnapshot loaded;
+   check("load()", loaded.load(filename), true);
+   check("model name", loaded.model_name == snap.model_name, true);
+   check("serial number", loaded.serial_number == snap.serial_number, true);
+   check("firmware version", loaded.firmware_version == snap.firmware_version, true);
+   check("firmware type", loaded.firmware_type == snap.firmware_type, true);
+   check("tag", loaded.tag == snap.tag, true);
+   check("number of params", loaded.params.size(), snap.params.size());
+   check("params (in order)", loaded.params == snap.params, true);
+   check("user registers", loaded.user_registers == snap.user_registers, true);
+
+   check("matches() same board", loaded.matches("VX2740", "12345", "2023052400 v1.0"), true);
+   check("matches() other serial", loaded.matches("VX2740", "12346", "2023052400 v1.0"), false);
+   check("matches() other firmware", loaded.matches("VX2740", "12345", "2023052400 v1.1"), false);
+
+   // Loading replaces whatever was there before.
+   CaenSnapshot reused = make_snapshot();
+   reused.params.push_back(std::make_pair("/par/extra", "1"));
+   reused.user_registers[0x48] = 1;
+   check("load() into used snapshot", reused.load(filename), true);
+   check("used snapshot params", reused.params == snap.params, true);
+   check("used snapshot user registers", reused.user_registers == snap.user_registers, true);
+
+   unlink(filename.c_str());
+}
+
+void test_corrupt(const std::string& dir) {
+   CaenSnapshot snap = make_snapshot();
+   std::string filename = dir + "/snap.vxsnap";
+   std::string bad_filename = dir + "/bad.vxsnap";
+   snap.save(filename);
+   std::string good = read_file(filename);
+   check("file not empty", good.size() > 100, true);
+
+   CaenSnapshot loaded;
+   char what[100];
+
+   // Any single changed byte fails the checksum (or the magic/version).
+   size_t positions[] = {0, 8, 12, 30, good.size() / 2, good.size() - 5, good.size() - 1};
+
+   for (auto pos : positions) {
+      std::string bad = good;
+      bad[pos] ^= 0x20;
+      write_file(bad_filename, bad);
+      snprintf(what, sizeof(what), "load() with byte %zu changed", pos);
+      check(what, loaded.load(bad_filename), false);
+   }
+
+   // Truncated anywhere, including inside the checksum.
+   size_t lengths[] = {0, 4, 8, 20, good.size() / 2, good.size() - 4, good.size() - 1};
+
+   for (auto length : lengths) {
+      write_file(bad_filename, good.substr(0, length));
+      snprintf(what, sizeof(what), "load() truncated to %zu bytes", length);
+      check(what, loaded.load(bad_filename), false);
+   }
+
+   // Extra data after the checksum.
+   write_file(bad_filename, good + "x");
+   check("load() with trailing byte", loaded.load(bad_filename), false);
+
+   check("load() missing file", loaded.load(dir + "/missing.vxsnap"), false);
+   check("save() to missing directory", snap.save(dir + "/missing/snap.vxsnap"), false);
+
+   // The good file still loads after all that.
+   check("load() good file", loaded.load(filename), true);
+   check("good file params", loaded.params == snap.params, true);
+
+   unlink(filename.c_str());
+   unlink(bad_filename.c_str());
+}
+
+int main() {
+   char dir_template[] = "/tmp/vx2740_snapshot_test_XXXXXX";
+
+   if (!mkdtemp(dir_template)) {
+      printf("Failed to create a temporary directory\n");
+      return 1;
+   }
+
+   std::string dir = dir_template;
+   test_round_trip(dir);
+   test_corrupt(dir);
+   rmdir(dir.c_str());
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef VX2740_TEST_EVENTS_H
+#define VX2740_TEST_EVENTS_H
+
+#include "caen_event.h"
+#include <inttypes.h>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/*
+ * Helpers for the tests and benchmarks that make scope-mode events in
+ * memory rather than reading them from a board.
+ */
+
+/**
+ * Fill `event` with a scope-mode event holding the given waveforms, as the
+ * board would send it (samples interleaved between channels, 4 per word).
+ * Channel `c` is enabled if `waveforms[c]` isn't empty; all the non-empty
+ * waveforms must be the same length, a multiple of 4 samples.
+ */
+inline void make_scope_event(const std::vector<std::vector<uint16_t>>& waveforms, uint32_t event_counter, uint64_t trigger_time, std::vector<uint64_t>& event) {
+   uint64_t ch_enable_mask = 0;
+   uint32_t num_samples = 0;
+   int num_chans = 0;
+
+   for (size_t c = 0; c < waveforms.size() && c < 64; c++) {
+      if (waveforms[c].size()) {
+         ch_enable_mask |= (uint64_t)1 << c;
+         num_samples = waveforms[c].size();
+         num_chans++;
+      }
+   }
+
+   uint32_t words_per_chan = num_samples / 4;
+   event.assign(3 + num_chans * words_per_chan, 0);
+
+   CaenEventHeader header;
+   header.format = 0x10;
+   header.event_counter = event_counter;
+   header.size_64bit_words = event.size();
+   header.flags = 0;
+   header.overlap = 0;
+   header.trigger_time = trigger_time;
+   header.ch_enable_mask = ch_enable_mask;
+   header.hencode(event.data());
+
+   for (uint32_t w = 0; w < words_per_chan; w++) {
+      int i = 0;
+
+      for (size_t c = 0; c < waveforms.size() && c < 64; c++) {
+         if (waveforms[c].empty()) {
+            continue;
+         }
+
+         uint64_t word = 0;
+
+         for (int k = 0; k < 4; k++) {
+            word |= (uint64_t)waveforms[c][w * 4 + k] << (16 * k);
+         }
+
+         event[3 + w * num_chans + i] = word;
+         i++;
+      }
+   }
+}
+
+/**
+ * Waveforms of `num_samples` on each of `num_chans` channels: gaussian noise
+ * around `baseline`, plus negative pulses (fast rise, 10-sample decay) of
+ * `pulse_height` starting at each of `pulse_starts` on every `pulse_every`th
+ * channel.
+ */
+inline std::vector<std::vector<uint16_t>> make_noisy_waveforms(int num_chans, uint32_t num_samples, uint16_t baseline, double noise_sigma,
+                                                               const std::vector<uint32_t>& pulse_starts, uint16_t pulse_height, int pulse_every, unsigned seed=1) {
+   std::mt19937 rng(seed);
+   std::normal_distribution<double> noise(0, noise_sigma);
+   std::vector<std::vector<uint16_t>> waveforms(num_chans, std::vector<uint16_t>(num_samples));
+
+   for (int c = 0; c < num_chans; c++) {
+      for (uint32_t i = 0; i < num_samples; i++) {
+         waveforms[c][i] = baseline + (int)lround(noise(rng));
+      }
+
+      if (pulse_every < 1 || c % pulse_every) {
+         continue;
+      }
+
+      for (auto start : pulse_starts) {
+         for (uint32_t i = start; i < start + 60 && i < num_samples; i++) {
+            waveforms[c][i] -= (uint16_t)(pulse_height * exp(-(double)(i - start) / 10));
+         }
+      }
+   }
+
+   return waveforms;
+}
+
+#endif
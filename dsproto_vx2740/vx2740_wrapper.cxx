@@ -17,6 +17,7 @@ INT VX2740::connect(std::string hostname, bool do_reset, bool monitor_only) {
    dev = std::make_shared<CaenDevice>();
    dev->connect(hostname, do_reset, monitor_only);
 
+   // Also drops the handles looked up on any earlier connection.
    params_helper.set_device(dev);
    data_helper.set_device(dev);
    commands_helper.set_device(dev);
@@ -31,6 +31,8 @@ public:
    INT connect(std::string hostname, bool do_reset = false, bool monitor_only = false);
    
    INT disconnect() {
+      // Node handles die with the connection.
+      params_helper.clear_handle_cache();
       return dev->disconnect();
    }
 
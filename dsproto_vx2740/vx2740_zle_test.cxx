@@ -0,0 +1,188 @@
+#include "stdio.h"
+#include "caen_zle.h"
+#include "vx2740_test_events.h"
+#include <inttypes.h>
+#include <algorithm>
+#include <cstdlib>
+
+/*
+ * Checks that events zero-suppressed by CaenZleEncoder read back through
+ * CaenZleEvent with every sample near an excursion kept exactly, and the
+ * rest at the baseline. Doesn't need a board. Returns non-zero if any check
+ * fails.
+ */
+
+int num_failures = 0;
+
+void check(const char* what, uint64_t got, uint64_t expected) {
+   if (got != expected) {
+      printf("FAIL: %s: got %" PRIu64 " (0x%" PRIx64 "), expected %" PRIu64 " (0x%" PRIx64 ")\n", what, got, got, expected, expected);
+      num_failures++;
+   }
+}
+
+const int num_chans = 64;
+const uint32_t num_samples = 5000;
+const uint16_t baseline = 3000;
+const uint16_t threshold = 50;
+
+// Noise of a few ADC counts, a 100-sample dip on every 8th channel, two
+// close spikes on channel 5 and one in the very last sample of channel 6.
+std::vector<std::vector<uint16_t>> make_waveforms() {
+   std::vector<std::vector<uint16_t>> waveforms = make_noisy_waveforms(num_chans, num_samples, baseline, 3, {}, 0, 0);
+
+   for (int c = 0; c < num_chans; c += 8) {
+      for (uint32_t i = 1000; i < 1100; i++) {
+         waveforms[c][i] -= 500;
+      }
+   }
+
+   waveforms[5][2000] += 200;
+   waveforms[5][2010] += 200;
+   waveforms[6][num_samples - 1] += 200;
+   return waveforms;
+}
+
+void test_round_trip() {
+   std::vector<std::vector<uint16_t>> waveforms = make_waveforms();
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 5, 123, raw);
+   CaenEvent event(raw.data());
+
+   CaenZleConfig config;
+   config.thresholds_adc.assign(64, threshold);
+   CaenZleEncoder encoder;
+   encoder.configure(config);
+
+   std::vector<uint64_t> encoded(CaenZleEncoder::max_size_words(event));
+   uint32_t size = encoder.encode(event, encoded.data());
+   check("encoded event is smaller", size < raw.size(), true);
+
+   CaenZleEvent zle(encoded.data(), size);
+   check("is_valid()", zle.is_valid(), true);
+   check("format", zle.header.format, CAEN_ZLE_FORMAT);
+   check("size in header", zle.header.size_64bit_words, size);
+   check("event counter", zle.header.event_counter, 5);
+   check("trigger time", zle.header.trigger_time, 123);
+   check("samples per channel", zle.samples_per_chan, num_samples);
+
+   char what[100];
+   std::vector<uint16_t> samples;
+
+   for (int c = 0; c < num_chans; c++) {
+      snprintf(what, sizeof(what), "channel %d number of samples", c);
+      check(what, zle.get_channel_samples(c, samples), num_samples);
+
+      if (samples.size() != num_samples) {
+         continue;
+      }
+
+      uint16_t chan_baseline = zle.get_baseline(c);
+      snprintf(what, sizeof(what), "channel %d baseline near %u", c, baseline);
+      check(what, abs(chan_baseline - baseline) <= 3, true);
+
+      // Excursions are kept exactly, and everything else is either kept
+      // exactly or replaced by the baseline.
+      int num_wrong = 0;
+
+      for (uint32_t i = 0; i < num_samples; i++) {
+         bool excursion = abs(waveforms[c][i] - chan_baseline) > threshold;
+
+         if (samples[i] != waveforms[c][i] && (excursion || samples[i] != chan_baseline)) {
+            num_wrong++;
+         }
+      }
+
+      snprintf(what, sizeof(what), "channel %d wrong samples", c);
+      check(what, num_wrong, 0);
+
+      num_wrong = 0;
+
+      for (auto& seg : zle.get_segments(c)) {
+         for (uint32_t i = 0; i < seg.num_samples; i++) {
+            if (seg.samples[i] != waveforms[c][seg.first_sample + i]) {
+               num_wrong++;
+            }
+         }
+      }
+
+      snprintf(what, sizeof(what), "channel %d wrong samples in segments", c);
+      check(what, num_wrong, 0);
+   }
+
+   // The dip is kept with pre_samples before and post_samples after.
+   check("dip segments", zle.get_segments(0).size(), 1);
+
+   if (zle.get_segments(0).size() == 1) {
+      check("dip segment start", zle.get_segments(0)[0].first_sample, 1000 - config.pre_samples);
+      check("dip segment length", zle.get_segments(0)[0].num_samples, 100 + config.pre_samples + config.post_samples);
+   }
+
+   // Spikes closer than pre + post samples share a segment.
+   check("close spikes segments", zle.get_segments(5).size(), 1);
+
+   // A segment at the end of the waveform stops at the last sample.
+   check("segments at end", zle.get_segments(6).size(), 1);
+
+   if (zle.get_segments(6).size() == 1) {
+      check("segment at end finishes at last sample", zle.get_segments(6)[0].first_sample + zle.get_segments(6)[0].num_samples, num_samples);
+   }
+
+   check("quiet channel segments", zle.get_segments(1).size(), 0);
+
+   // Reading stops at the end of the buffer.
+   check("truncated is_valid()", CaenZleEvent(encoded.data(), size - 1).is_valid(), false);
+}
+
+void test_fallback_to_raw() {
+   std::vector<std::vector<uint16_t>> waveforms = make_waveforms();
+   std::vector<uint64_t> raw;
+   make_scope_event(waveforms, 6, 456, raw);
+   CaenEvent event(raw.data());
+
+   CaenZleConfig config;
+   config.thresholds_adc.assign(64, threshold);
+   CaenZleEncoder encoder;
+   encoder.configure(config);
+   std::vector<uint64_t> encoded(CaenZleEncoder::max_size_words(event));
+   encoder.encode(event, encoded.data());
+
+   // Every sample far from the baselines learnt from the first event, so
+   // suppression wouldn't save anything.
+   for (int c = 0; c < num_chans; c++) {
+      waveforms[c].assign(num_samples, 0);
+   }
+
+   make_scope_event(waveforms, 7, 789, raw);
+   CaenEvent busy_event(raw.data());
+   uint32_t size = encoder.encode(busy_event, encoded.data());
+   check("busy event size", size, raw.size());
+   check("busy event format", encoded[0] >> 56, 0x10);
+   check("busy event unchanged", std::equal(raw.begin(), raw.end(), encoded.begin()), true);
+}
+
+void test_non_data_event() {
+   // Only the header; e.g. a start/stop event.
+   uint64_t raw[3] = {((uint64_t)0x30 << 56) | 3, 0, 0};
+   CaenEvent event(raw);
+
+   CaenZleEncoder encoder;
+   std::vector<uint64_t> encoded(CaenZleEncoder::max_size_words(event));
+   uint32_t size = encoder.encode(event, encoded.data());
+   check("non-data event size", size, 3);
+   check("non-data event unchanged", std::equal(raw, raw + 3, encoded.begin()), true);
+}
+
+int main() {
+   test_round_trip();
+   test_fallback_to_raw();
+   test_non_data_event();
+
+   if (num_failures) {
+      printf("%d checks failed\n", num_failures);
+      return 1;
+   }
+
+   printf("All checks passed\n");
+   return 0;
+}